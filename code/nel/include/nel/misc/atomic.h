@@ -0,0 +1,172 @@
+// NeL - MMORPG Framework <http://dev.ryzom.com/projects/nel/>
+// Copyright (C) 2010  Winch Gate Property Limited
+//
+// This program is free software: you can redistribute it and/or modify
+// it under the terms of the GNU Affero General Public License as
+// published by the Free Software Foundation, either version 3 of the
+// License, or (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU Affero General Public License for more details.
+//
+// You should have received a copy of the GNU Affero General Public License
+// along with this program.  If not, see <http://www.gnu.org/licenses/>.
+
+#ifndef NL_ATOMIC_H
+#define NL_ATOMIC_H
+
+#include "types_nl.h"
+
+#ifdef NL_COMP_VC
+#	include <intrin.h>
+#endif
+
+
+namespace NLMISC {
+
+
+/*
+ * Atomic operations on integers shared between threads or processes (in a CSharedMemory segment).
+ *
+ * The values must be naturally aligned, of 8, 16, 32 or 64 bits for the loads and stores, and of
+ * 32 or 64 bits for the read-modify-write operations (which are full barriers).
+ * With VC, they are implemented on x86/x64 only: volatile accesses have acquire/release
+ * semantics there, and _ReadWriteBarrier() prevents the compiler from reordering them.
+ */
+
+#ifdef NL_COMP_VC
+
+/// Implementation of the read-modify-write operations by size (VC)
+template <uint Size>
+struct CAtomicOps;
+
+template <>
+struct CAtomicOps<4>
+{
+	template <class T> static T		exchange( volatile T *p, T v )				{ return (T)_InterlockedExchange( (volatile long*)p, (long)v ); }
+	template <class T> static T		compareExchange( volatile T *p, T e, T v )	{ return (T)_InterlockedCompareExchange( (volatile long*)p, (long)v, (long)e ); }
+	template <class T> static T		fetchAdd( volatile T *p, T n )				{ return (T)_InterlockedExchangeAdd( (volatile long*)p, (long)n ); }
+	template <class T> static T		load( const volatile T *p )					{ return *p; }
+};
+
+template <>
+struct CAtomicOps<8>
+{
+	template <class T> static T		compareExchange( volatile T *p, T e, T v )	{ return (T)_InterlockedCompareExchange64( (volatile __int64*)p, (__int64)v, (__int64)e ); }
+	template <class T> static T		exchange( volatile T *p, T v )				{ T e = *p, prev; while ( (prev = compareExchange( p, e, v )) != e ) e = prev; return prev; }
+	template <class T> static T		fetchAdd( volatile T *p, T n )				{ T e = *p, prev; while ( (prev = compareExchange( p, e, (T)(e + n) )) != e ) e = prev; return prev; }
+#ifdef _M_IX86
+	// a 64 bit volatile read is made of two 32 bit reads on x86
+	template <class T> static T		load( const volatile T *p )					{ return compareExchange( const_cast<volatile T*>(p), (T)0, (T)0 ); }
+#else
+	template <class T> static T		load( const volatile T *p )					{ return *p; }
+#endif
+};
+
+template <> struct CAtomicOps<2> { template <class T> static T load( const volatile T *p ) { return *p; } };
+template <> struct CAtomicOps<1> { template <class T> static T load( const volatile T *p ) { return *p; } };
+
+#endif // NL_COMP_VC
+
+
+/// Read a value that no other data depends on
+template <class T>
+inline T		atomicLoadRelaxed( const volatile T *p )
+{
+#ifdef NL_COMP_VC
+	return CAtomicOps<sizeof(T)>::load( p );
+#else
+	return __atomic_load_n( p, __ATOMIC_RELAXED );
+#endif
+}
+
+/// Write a value that no other data depends on
+template <class T>
+inline void		atomicStoreRelaxed( volatile T *p, T v )
+{
+#if defined(NL_COMP_VC) && defined(_M_IX86)
+	if ( sizeof(T) == 8 )
+		CAtomicOps<8>::exchange( (volatile sint64*)p, (sint64)v ); // a 64 bit volatile write is made of two 32 bit writes on x86
+	else
+		*p = v;
+#elif defined(NL_COMP_VC)
+	*p = v;
+#else
+	__atomic_store_n( p, v, __ATOMIC_RELAXED );
+#endif
+}
+
+/// Read a value written by another thread, before reading the data it protects
+template <class T>
+inline T		atomicLoadAcquire( const volatile T *p )
+{
+#ifdef NL_COMP_VC
+	T v = CAtomicOps<sizeof(T)>::load( p );
+	_ReadWriteBarrier();
+	return v;
+#else
+	return __atomic_load_n( p, __ATOMIC_ACQUIRE );
+#endif
+}
+
+/// Write a value read by another thread, after writing the data it protects
+template <class T>
+inline void		atomicStoreRelease( volatile T *p, T v )
+{
+#ifdef NL_COMP_VC
+	_ReadWriteBarrier();
+	atomicStoreRelaxed( p, v );
+#else
+	__atomic_store_n( p, v, __ATOMIC_RELEASE );
+#endif
+}
+
+/// Set a value and return its previous value
+template <class T>
+inline T		atomicExchange( volatile T *p, T v )
+{
+#ifdef NL_COMP_VC
+	return CAtomicOps<sizeof(T)>::exchange( p, v );
+#else
+	return __atomic_exchange_n( p, v, __ATOMIC_SEQ_CST );
+#endif
+}
+
+/// Set a value if it is equal to expected. Return false (and do nothing) if it has another value.
+template <class T>
+inline bool		atomicCompareExchange( volatile T *p, T expected, T v )
+{
+#ifdef NL_COMP_VC
+	return CAtomicOps<sizeof(T)>::compareExchange( p, expected, v ) == expected;
+#else
+	return __atomic_compare_exchange_n( p, &expected, v, false, __ATOMIC_SEQ_CST, __ATOMIC_SEQ_CST );
+#endif
+}
+
+/// Add n to a value and return its previous value
+template <class T>
+inline T		atomicFetchAdd( volatile T *p, T n )
+{
+#ifdef NL_COMP_VC
+	return CAtomicOps<sizeof(T)>::fetchAdd( p, n );
+#else
+	return __atomic_fetch_add( p, n, __ATOMIC_SEQ_CST );
+#endif
+}
+
+/// Subtract n from a value and return its previous value
+template <class T>
+inline T		atomicFetchSub( volatile T *p, T n )
+{
+	return atomicFetchAdd( p, (T)(0 - n) );
+}
+
+
+} // NLMISC
+
+
+#endif // NL_ATOMIC_H
+
+/* End of atomic.h */
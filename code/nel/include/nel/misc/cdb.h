@@ -67,6 +67,18 @@ public:
 		TEXT, Nb_Prop_Type
 	};
 
+	/**
+	 * Packed delta format (see CCDBNodeBranch::readAndMapPackedDelta()), must match the writing
+	 * in CCDBSynchronised::writeDelta() on the server.
+	 */
+	enum
+	{
+		PackedDeltaMarker = 0xFFFF,			// written instead of the change count
+		PackedDeltaCommonLevelsBits = 4,	// number of bits of the number of levels shared with the previous node
+		PackedDeltaNibbleCountBits = 3,		// number of bits of the number of 4-bit groups of a value difference
+		PackedDeltaMinValueBits = 9			// below this size, the values are never coded as a difference
+	};
+
 
 	/**
 	 * observer interface to a database property
@@ -113,9 +113,19 @@ public:
 	/// Update the database from the delta, but map the first level with the bank mapping (see _CDBBankToUnifiedIndexMapping)
 	void readAndMapDelta( TGameCycle gc, CBitMemStream& s, uint bank, CCDBBankHandler *bankHandler );
 
+	/**
+	 * Update the database from a change of a packed delta, mapping the first level with the bank mapping.
+	 * The id of the changed node is coded from the id of the previous node (path, in server ids),
+	 * and the values may be coded as the difference with the last value received in a packed delta.
+	 */
+	void readAndMapPackedDelta( TGameCycle gc, CBitMemStream& s, uint bank, CCDBBankHandler *bankHandler, std::vector<uint32>& path );
+
 	/// Update the database from a stream coming from the FE
 	void readDelta( TGameCycle gc, CBitMemStream & f );
 
+	/// Read the changed leaves of an atomic branch (bitfield then values), in packed delta format or not
+	void readAtomDelta( TGameCycle gc, CBitMemStream & f, bool packed );
+
 	/**
 	 * Return the value of a property (the update flag is set to false)
 	 * \param id is the text id of the property/grp
@@ -95,6 +95,7 @@ public:
 		_Type = UNKNOWN;
 		_Changed = false;
 		_LastChangeGC = 0;
+		_LastPackedValue = 0;
 	}
 
 	/**
@@ -137,6 +138,12 @@ public:
 	 */
 	void readDelta(TGameCycle gc, CBitMemStream & f );
 
+	/**
+	 * Update the database from a packed delta (see CCDBNodeBranch::readAndMapPackedDelta()).
+	 * \param f : the stream.
+	 */
+	void readPackedDelta(TGameCycle gc, CBitMemStream & f );
+
 	/**
 	 * Return the value of a property (the update flag is set to false)
 	 * \param id is the text id of the property/grp
@@ -229,6 +236,9 @@ private:
 	sint64				_Property;
 	sint64				_oldProperty;
 
+	/// last value received in a packed delta (the base of the differences)
+	sint64				_LastPackedValue;
+
 	/// property type
 	EPropType			_Type;
 
@@ -245,6 +255,12 @@ private:
 private:
 	void notifyObservers();
 
+	/// Return the number of bits of the value in a delta
+	uint getDeltaBitSize() const;
+
+	/// Set the value read in a delta
+	void setValueFromDelta(TGameCycle gc, uint64 recvd, uint bits);
+
 };
 
 ////////////////////
@@ -0,0 +1,94 @@
+// NeL - MMORPG Framework <http://dev.ryzom.com/projects/nel/>
+// Copyright (C) 2010  Winch Gate Property Limited
+//
+// This program is free software: you can redistribute it and/or modify
+// it under the terms of the GNU Affero General Public License as
+// published by the Free Software Foundation, either version 3 of the
+// License, or (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU Affero General Public License for more details.
+//
+// You should have received a copy of the GNU Affero General Public License
+// along with this program.  If not, see <http://www.gnu.org/licenses/>.
+
+#ifndef NL_MAPPED_FILE_H
+#define NL_MAPPED_FILE_H
+
+#include "types_nl.h"
+
+#include <string>
+#include <vector>
+
+
+namespace NLMISC {
+
+
+/**
+ * Read-only view of the whole content of a file, mapped in memory by the system
+ * (mmap() or MapViewOfFile()) so that only the pages actually read are loaded.
+ * If the file can't be mapped, it is read in a buffer instead, so the caller
+ * doesn't need another code path.
+ *
+ *\code
+	CMappedFile file;
+	if ( file.open( "data.bin" ) )
+		parse( file.data(), file.size() );
+ *\endcode
+ */
+class CMappedFile
+{
+public:
+
+	/// Constructor
+	CMappedFile();
+
+	/// Destructor (calls close())
+	~CMappedFile();
+
+	/** Map a file, closing the previous one. Set sequential if the file will be read once from
+	 * start to end (hint for the system). Return false if the file is empty or can't be read.
+	 */
+	bool			open( const std::string& fileName, bool sequential = false );
+
+	/// Unmap the file (the data is not valid anymore)
+	void			close();
+
+	/// Return true if a file is open
+	bool			isOpen() const	{ return _Data != NULL; }
+
+	/// Return true if the file is mapped (false if it was read in a buffer)
+	bool			isMapped() const	{ return _MappedData != NULL; }
+
+	/// Content of the file
+	const uint8		*data() const	{ return _Data; }
+
+	/// Size of the file
+	uint32			size() const	{ return _Size; }
+
+private:
+
+	// not copyable
+	CMappedFile( const CMappedFile& );
+	CMappedFile&	operator=( const CMappedFile& );
+
+	const uint8			*_Data;
+	uint32				_Size;
+
+	/// The mapping of the file (NULL if the file is not mapped) and its system handle
+	void				*_MappedData;
+	void				*_MappingHandle;
+
+	/// Buffer the file is read in when it can't be mapped
+	std::vector<uint8>	_Buffer;
+};
+
+
+} // NLMISC
+
+
+#endif // NL_MAPPED_FILE_H
+
+/* End of mapped_file.h */
@@ -0,0 +1,139 @@
+// NeL - MMORPG Framework <http://dev.ryzom.com/projects/nel/>
+// Copyright (C) 2010  Winch Gate Property Limited
+//
+// This program is free software: you can redistribute it and/or modify
+// it under the terms of the GNU Affero General Public License as
+// published by the Free Software Foundation, either version 3 of the
+// License, or (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU Affero General Public License for more details.
+//
+// You should have received a copy of the GNU Affero General Public License
+// along with this program.  If not, see <http://www.gnu.org/licenses/>.
+
+#ifndef NL_WORKER_POOL_H
+#define NL_WORKER_POOL_H
+
+#include "types_nl.h"
+#include "time_nl.h"
+
+#include <vector>
+
+
+namespace NLMISC {
+
+
+class IThread;
+
+
+/**
+ * Set of independent jobs run by a CWorkerPool.
+ */
+class IWorkerJobs
+{
+public:
+
+	virtual ~IWorkerJobs() {}
+
+	/** Run the job of the specified index.
+	 * Called concurrently by the workers: a job must only write data owned by the job itself
+	 * or by the worker (workerIndex is in [0, CWorkerPool::nbWorkers()[).
+	 */
+	virtual void	runJob( uint jobIndex, uint workerIndex ) = 0;
+};
+
+
+/**
+ * Fork-join pool of worker threads, for a main loop that needs to spread a burst of
+ * independent jobs on several cores and wait for all of them to complete.
+ *
+ * The threads are created once by init() and sleep between two calls to run(). The thread
+ * calling run() is the worker 0 and takes part in the work. Jobs are picked in increasing
+ * index order by the first available worker, so the load is balanced even when the jobs
+ * have very different costs. With one worker (or before init()), run() simply calls the
+ * jobs in order on the calling thread.
+ *
+ *\code
+	class CMyJobs : public IWorkerJobs
+	{
+		virtual void runJob( uint jobIndex, uint workerIndex ) { Results[jobIndex] = compute( Inputs[jobIndex] ); }
+		...
+	};
+
+	CWorkerPool pool;
+	pool.init( 4 );
+	CMyJobs jobs;
+	pool.run( jobs, (uint)jobs.Inputs.size() ); // then merge jobs.Results in order
+ *\endcode
+ */
+class CWorkerPool
+{
+public:
+
+	/// Constructor
+	CWorkerPool();
+
+	/// Destructor (calls release())
+	~CWorkerPool();
+
+	/// Start the threads (nbWorkers includes the calling thread; 0 or 1 means no thread)
+	void			init( uint nbWorkers );
+
+	/// Stop the threads
+	void			release();
+
+	/// Return the number of workers, including the thread calling run()
+	uint			nbWorkers() const { return (uint)_Threads.size() + 1; }
+
+	/// Run the jobs [0, nbJobs[ and return when they are all done. Not reentrant.
+	void			run( IWorkerJobs& jobs, uint nbJobs );
+
+	/// Return the time spent in jobs by a worker during the last run()
+	TTicks			lastRunTicks( uint workerIndex ) const { return _WorkerTicks[workerIndex]; }
+
+	/// Return the number of jobs run by a worker during the last run()
+	uint			lastRunNbJobs( uint workerIndex ) const { return _WorkerNbJobs[workerIndex]; }
+
+private:
+
+	friend class CWorkerPoolThread;
+
+	/// Run jobs until there is no more job to pick (called by all the workers)
+	void			work( uint workerIndex );
+
+	/// Threads of the workers 1..n
+	std::vector<IThread*>	_Threads;
+
+	/// Semaphore to wake up the threads (platform-specific)
+	void					*_StartSemaphore;
+
+	/// Semaphore signalled by each thread when it has finished its jobs (platform-specific)
+	void					*_DoneSemaphore;
+
+	/// Jobs of the current run
+	IWorkerJobs				*_Jobs;
+
+	/// Number of jobs of the current run
+	uint32					_NbJobs;
+
+	/// Index of the next job to pick (incremented atomically)
+	volatile uint32			_NextJob;
+
+	/// Stats of the last run, by worker
+	std::vector<TTicks>		_WorkerTicks;
+	std::vector<uint>		_WorkerNbJobs;
+
+	/// Exit flag for the threads
+	volatile bool			_ExitRequired;
+};
+
+
+} // NLMISC
+
+
+#endif // NL_WORKER_POOL_H
+
+/* End of worker_pool.h */
@@ -28,12 +28,26 @@
 
 // POLL1 (ignore POLL comments)
 
+/*
+ * On Linux, the receive threads can use epoll instead of select (see UseEpollInBufServer).
+ * epoll has no FD_SETSIZE limit and its cost does not depend on the number of idle connections.
+ */
+#if defined(NL_OS_UNIX) && !defined(NL_OS_MAC)
+#	define NL_BUF_SERVER_EPOLL
+#endif
+
 namespace NLNET {
 
 
 class CInetAddress;
 class CBufServer;
 
+/// Use epoll in the receive threads of the servers created afterwards (config file variable, Linux only)
+extern NLMISC::CVariable<bool> UseEpollInBufServer;
+
+/// Max number of sockets handled by one receive thread when using epoll (config file variable)
+extern NLMISC::CVariable<uint16> MaxSocketsPerEpollThread;
+
 
 /**
  * Common part of CListenTask and CServerReceiveTask
@@ -123,6 +137,9 @@ typedef std::vector<NLMISC::IThread*> CThreadPool;
 #define DEFAULT_MAX_SOCKETS_PER_THREADS 16
 #endif
 
+// Max sockets per thread when the receive threads use epoll (not limited by FD_SETSIZE)
+#define DEFAULT_MAX_SOCKETS_PER_EPOLL_THREADS 1024
+
 
 /**
  * Server class for layer 1
@@ -275,6 +292,9 @@ public:
 	/// Returns the number of connections (at the last update())
 	uint32	nbConnections() const { return _NbConnections; }
 
+	/// Returns true if the receive threads use epoll instead of select
+	bool	usesEpoll() const { return _UseEpoll; }
+
 protected:
 
 	friend class CServerBufSock;
@@ -383,6 +403,9 @@ private:
 	/// Replay mode flag
 	bool							_ReplayMode;
 
+	/// Receive threads use epoll (edge-triggered) instead of select (set at construction)
+	bool							_UseEpoll;
+
   /*
 	/// Number of bytes pushed into the receive queue (by the receive threads) since the beginning.
 	NLMISC::CSynchronized<uint32>	_BytesPushedIn;
@@ -409,7 +432,10 @@ class CServerReceiveTask : public NLMISC::IRunnable, public CServerTask
 public:
 
 	/// Constructor
-	CServerReceiveTask( CBufServer *server ) : CServerTask(), _Server(server), _Connections("CServerReceiveTask::_Connections"), _RemoveSet("CServerReceiveTask::_RemoveSet") {}
+	CServerReceiveTask( CBufServer *server );
+
+	/// Destructor
+	virtual ~CServerReceiveTask();
 
 	/// Run
 	virtual void run();
@@ -434,6 +460,10 @@ public:
 			NLMISC::CSynchronized<CConnections>::CAccessor connectionssync( &_Connections );
 			connectionssync.value().insert( sockid );
 		}
+#ifdef NL_BUF_SERVER_EPOLL
+		if ( _EpollHandle != -1 )
+			registerSocketInEpoll( sockid );
+#endif
 		// POLL3
 	}
 
@@ -476,6 +506,25 @@ public:
 
 private:
 
+	/// Loop of the select() version (called by run())
+	void	runSelect();
+
+#ifdef NL_BUF_SERVER_EPOLL
+
+	/// Loop of the epoll version (called by run())
+	void	runEpoll();
+
+	/// Add the socket descriptor into the epoll set (thread-safe, can be called from the listen thread)
+	void	registerSocketInEpoll( TSockId sockid );
+
+	/// Read all data available on an edge-triggered socket and push the received blocks
+	void	receiveAllFromSocket( TSockId sockid );
+
+	/// epoll descriptor, or -1 if the server uses select
+	int										_EpollHandle;
+
+#endif
+
 	CBufServer								*_Server;
 
 	/* List of sockets and send buffer.
@@ -294,6 +294,11 @@ protected:
 	 */
 	bool						receivePart( uint32 nbExtraBytes );
 
+	/** Return true if the last call to receivePart() emptied the socket input buffer (the next
+	 * receive would block). Used by edge-triggered pollers which must read until there is nothing left.
+	 */
+	bool						receiveDrained() const { return _ReceiveDrained; }
+
 	/// Fill the event type byte at pos length()(for a client connection)
 	void						fillEventTypeOnly() { _ReceiveBuffer[_Length] = (uint8)CBufNetBase::User; }
 
@@ -324,6 +329,9 @@ private:
 	// Length of buffer to read
 	TBlockSize					_Length;
 
+	// True if the last receivePart() got less data than requested
+	bool						_ReceiveDrained;
+
 };
 
 
@@ -132,6 +132,11 @@ public:
 	/// send the transport class to a specified service using the service name
 	void send (const std::string &serviceName);
 
+	/** Write the transport class in a message, to send it another way than send().
+	 *	The message is shared by all the transport classes, it is only valid until the next write.
+	 */
+	NLNET::CMessage &write ();
+
 	/** The name of the transport class. Must be unique for each class.
 	 */
 	void className (const std::string &name);
@@ -375,9 +380,6 @@ protected:
 	// Read the TempMessage and call the callback
 	bool read (const std::string &name, NLNET::TServiceId sid);
 
-	// Used to create a TempMessage with this class
-	NLNET::CMessage &write ();
-
 
 	//
 	// Static Variables
@@ -34,6 +34,22 @@ class CUdpSock : public CSock
 {
 public:
 
+	/// Max number of datagrams transferred by one system call in receivedFromBatch() and sendToBatch()
+	enum { MaxDatagramBatch = 64 };
+
+	/// Description of a datagram for batched receive and send
+	struct TDatagram
+	{
+		/// Address of buffer
+		uint8			*Buffer;
+
+		/// Size of buffer (receive), then actual number of bytes received; or number of bytes to send
+		uint			Length;
+
+		/// Address of sender (receive) or destination (send)
+		CInetAddress	*Addr;
+	};
+
 	/// @name Socket setup
 	//@{
 
@@ -69,6 +85,14 @@ public:
 	 */
 	bool				receivedFrom( uint8 *buffer, uint& len, CInetAddress& addr, bool throw_exception=true );
 
+	/** Receives several datagrams in one system call when possible (recvmmsg() on Linux). (blocking function)
+	 * Waits for the first datagram, then takes the ones already queued without waiting, up to
+	 * min(nb, MaxDatagramBatch). Returns the number of datagrams received, their Length and Addr are set.
+	 * If an error occurs on the first datagram, throws ESocket or returns 0 (the Addr of the first datagram
+	 * is set as in receivedFrom()).
+	 */
+	uint				receivedFromBatch( TDatagram *datagrams, uint nb, bool throw_exception=true );
+
 	//@}
 
 
@@ -78,12 +102,24 @@ public:
 	/// Sends data to the specified host (unreliable sockets only)
 	void				sendTo( const uint8 *buffer, uint len, const CInetAddress& addr );
 
+	/** Sends several datagrams with as few system calls as possible (sendmmsg() on Linux).
+	 * Returns the number of datagrams sent before an error occurred (nb if no error): if the
+	 * result is lower than nb, the datagram at this index could not be sent.
+	 * Several threads may call it at the same time on the same socket.
+	 */
+	uint				sendToBatch( const TDatagram *datagrams, uint nb );
+
 	//@}
 
 private:
 
-	/// True after calling bind() or sendTo()
-	bool				_Bound;
+	/// Retrieve the local address after the first send, if the socket is not bound
+	void				setLocalAddressOnce();
+
+	enum TBindState { Unbound, Binding, Bound };
+
+	/// TBindState, Bound after calling bind() or sendTo() (accessed atomically by the sending threads)
+	volatile uint32		_BindState;
 
 };
 
@@ -293,6 +293,12 @@ public:
 	 */
 	void	update (NLMISC::TTime timeout = 0);
 
+	/** Make the current or next update() return without waiting for the end of its timeout.
+	 * Can be called from any thread, for example by a thread receiving events by another way than
+	 * the network, that must be processed by the main thread (see IServiceUpdatable).
+	 */
+	void	wakeUp ();
+
 	/** Sends a message to a specific serviceName. If there's more than one service with this name, all services of this name will receive the message.
 	 * \param serviceName name of the service you want to send the message (may not be unique.)
 	 * \param msg the message you want to send.
@@ -699,8 +705,14 @@ private:
 #ifdef NL_OS_UNIX
 	/// Pipe to select() on data available (shared among all connections)
 	int											_MainDataAvailablePipe [2];
+
+	/// Pipe to select() on wake-up requests (see wakeUp())
+	int											_WakeUpPipe [2];
 #endif
 
+	/// Set by wakeUp()
+	volatile bool								_WakeUpRequested;
+
 	/// Service id of the running service
 	TServiceId									_SId;
 
@@ -714,6 +726,7 @@ private:
 		_ExtSId(256),
 		_LastRetry(0),
 		_NextUpdateTime(0),
+		_WakeUpRequested(false),
 		_Initialised(false)
 	{
 	}
@@ -0,0 +1,252 @@
+// NeL - MMORPG Framework <http://dev.ryzom.com/projects/nel/>
+// Copyright (C) 2010  Winch Gate Property Limited
+//
+// This program is free software: you can redistribute it and/or modify
+// it under the terms of the GNU Affero General Public License as
+// published by the Free Software Foundation, either version 3 of the
+// License, or (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU Affero General Public License for more details.
+//
+// You should have received a copy of the GNU Affero General Public License
+// along with this program.  If not, see <http://www.gnu.org/licenses/>.
+
+/*
+ * CBufServer connection-count scaling benchmark.
+ *
+ * For each number of connections, a server is created and as many client sockets are connected
+ * to it. Most of them stay idle; a few probe connections send small blocks that the server echoes
+ * back, and the round-trip time is measured. With the select() receive threads, the cost of a
+ * wake-up grows with the number of sockets handled by the thread; with epoll it should not.
+ *
+ * Usage: nl_sample_buf_server_bench [select|epoll|both] [nbMessagesPerRound]
+ */
+
+#include "nel/misc/types_nl.h"
+
+#include <string>
+#include <vector>
+#include <algorithm>
+
+#include "nel/misc/common.h"
+#include "nel/misc/time_nl.h"
+#include "nel/misc/mem_stream.h"
+
+#include "nel/net/buf_server.h"
+#include "nel/net/tcp_sock.h"
+#include "nel/net/inet_address.h"
+
+#ifdef NL_OS_WINDOWS
+#	include <winsock2.h>
+#elif defined NL_OS_UNIX
+#	include <sys/select.h>
+#	include <arpa/inet.h>
+#endif
+
+using namespace std;
+using namespace NLMISC;
+using namespace NLNET;
+
+// Number of connections tested
+static const uint ConnectionCounts [] = { 10, 100, 250, 500, 1000, 2000, 5000 };
+
+// Number of connections used to send probe messages
+static const uint NbProbes = 10;
+
+// Size of the probe messages
+static const uint PayloadSize = 32;
+
+// Number of messages sent before measuring
+static const uint NbWarmUpMessages = 100;
+
+static const uint16 BasePort = 37800;
+
+static uint NbConnected = 0;
+
+void cbConnection( TSockId /* from */, void * /* arg */ )
+{
+	++NbConnected;
+}
+
+void cbDisconnection( TSockId /* from */, void * /* arg */ )
+{
+	--NbConnected;
+}
+
+
+/*
+ * Send a block with the same framing as CBufSock (big-endian length prefix + payload)
+ */
+static void sendBlock( CTcpSock *sock, const vector<uint8> &payload )
+{
+	vector<uint8> frame( sizeof(TBlockSize) + payload.size() );
+	TBlockSize netlen = htonl( (TBlockSize)payload.size() );
+	memcpy( &frame[0], &netlen, sizeof(netlen) );
+	memcpy( &frame[sizeof(netlen)], &payload[0], payload.size() );
+	uint32 len = (uint32)frame.size();
+	sock->send( &frame[0], len );
+}
+
+
+/*
+ * Receive a block sent by CBufServer (blocking socket)
+ */
+static void receiveBlock( CTcpSock *sock, vector<uint8> &payload )
+{
+	TBlockSize netlen;
+	uint32 len = sizeof(netlen);
+	sock->receive( (uint8*)&netlen, len );
+	payload.resize( ntohl( netlen ) );
+	len = (uint32)payload.size();
+	sock->receive( &payload[0], len );
+}
+
+
+/*
+ * Run one round. Returns false if the round could not be run.
+ */
+static bool runRound( bool useEpoll, uint nbConnections, uint nbMessages, uint16 port, double &meanUs, double &p99Us )
+{
+	UseEpollInBufServer = useEpoll;
+
+	CBufServer server;
+	server.setConnectionCallback( cbConnection, NULL );
+	server.setDisconnectionCallback( cbDisconnection, NULL );
+	server.init( port );
+
+	CInetAddress addr( "127.0.0.1", port );
+	vector<CTcpSock*> clients;
+	clients.reserve( nbConnections );
+	NbConnected = 0;
+	try
+	{
+		for ( uint i=0; i!=nbConnections; ++i )
+		{
+			CTcpSock *sock = new CTcpSock( false );
+			clients.push_back( sock );
+			sock->connect( addr );
+			sock->setNoDelay( true );
+
+			// Process the connection events while connecting, to keep the receive queue short
+			if ( (i % 64) == 0 )
+			{
+				server.update();
+				server.dataAvailable();
+			}
+		}
+	}
+	catch (const ESocket &e)
+	{
+		printf( "Connection failed after %u sockets: %s\n", (uint)clients.size(), e.what() );
+		for ( uint i=0; i!=clients.size(); ++i )
+			delete clients[i];
+		return false;
+	}
+
+	// Wait until all the connection events are processed
+	TTime timeout = CTime::getLocalTime() + 30000;
+	while ( (NbConnected < nbConnections) && (CTime::getLocalTime() < timeout) )
+	{
+		server.update();
+		server.dataAvailable();
+		nlSleep( 1 );
+	}
+	if ( NbConnected < nbConnections )
+	{
+		printf( "Only %u connections out of %u were accepted\n", NbConnected, nbConnections );
+	}
+
+	// Ping-pong through probe connections spread among the idle ones
+	vector<uint8> payload( PayloadSize, 0x55 ), reply;
+	vector<double> samples;
+	samples.reserve( nbMessages );
+	uint probeStep = max( nbConnections / NbProbes, (uint)1 );
+	CMemStream received;
+	for ( uint m=0; m!=NbWarmUpMessages+nbMessages; ++m )
+	{
+		CTcpSock *probe = clients[((m % NbProbes) * probeStep) % nbConnections];
+
+		TTicks before = CTime::getPerformanceTime();
+		sendBlock( probe, payload );
+
+#ifdef NL_OS_UNIX
+		server.sleepUntilDataAvailable();
+#else
+		while ( ! server.dataAvailable() )
+			nlSleep( 0 );
+#endif
+
+		TSockId from;
+		server.receive( received, &from );
+		vector<uint8> echo( received.buffer(), received.buffer() + received.length() );
+		CMemStream out;
+		out.serialBuffer( &echo[0], (uint)echo.size() );
+		server.send( out, from );
+		server.flush( from );
+
+		receiveBlock( probe, reply );
+		if ( m >= NbWarmUpMessages )
+			samples.push_back( CTime::ticksToSecond( CTime::getPerformanceTime() - before ) * 1000000.0 );
+	}
+
+	sort( samples.begin(), samples.end() );
+	double sum = 0;
+	for ( uint i=0; i!=samples.size(); ++i )
+		sum += samples[i];
+	meanUs = samples.empty() ? 0 : sum / samples.size();
+	p99Us = samples.empty() ? 0 : samples[(samples.size() * 99) / 100];
+
+	for ( uint i=0; i!=clients.size(); ++i )
+	{
+		clients[i]->disconnect();
+		delete clients[i];
+	}
+	return true;
+}
+
+
+int main( int argc, char **argv )
+{
+	NLMISC::CApplicationContext applicationContext;
+
+	string mode = (argc > 1) ? argv[1] : "both";
+	uint nbMessages = 2000;
+	if ( argc > 2 )
+		NLMISC::fromString( string(argv[2]), nbMessages );
+
+	vector<bool> modes;
+	if ( (mode == "select") || (mode == "both") )
+		modes.push_back( false );
+	if ( (mode == "epoll") || (mode == "both") )
+		modes.push_back( true );
+
+	// Each connection uses two descriptors in this process (client and server side)
+	printf( "%-8s %12s %12s %12s\n", "mode", "connections", "mean (us)", "p99 (us)" );
+	uint16 port = BasePort;
+	for ( uint im=0; im!=modes.size(); ++im )
+	{
+		for ( uint ic=0; ic!=sizeof(ConnectionCounts)/sizeof(ConnectionCounts[0]); ++ic )
+		{
+			uint nbConnections = ConnectionCounts[ic];
+			const char *modeName = modes[im] ? "epoll" : "select";
+#ifdef NL_OS_UNIX
+			if ( (! modes[im]) && (nbConnections*2 + 64 >= FD_SETSIZE) )
+			{
+				printf( "%-8s %12u %12s %12s\n", modeName, nbConnections, "n/a", "(FD_SETSIZE)" );
+				continue;
+			}
+#endif
+			double meanUs, p99Us;
+			if ( runRound( modes[im], nbConnections, nbMessages, port++, meanUs, p99Us ) )
+				printf( "%-8s %12u %12.1f %12.1f\n", modeName, nbConnections, meanUs, p99Us );
+			else
+				printf( "%-8s %12u %12s %12s\n", modeName, nbConnections, "failed", "" );
+			fflush( stdout );
+		}
+	}
+
+	return 0;
+}
@@ -419,6 +419,80 @@ void CCDBNodeBranch::readAndMapDelta( TGameCycle gc, CBitMemStream& s, uint bank
 }
 
 
+/*
+ * Update the database from a change of a packed delta, mapping the first level with the bank mapping
+ */
+void CCDBNodeBranch::readAndMapPackedDelta( TGameCycle gc, CBitMemStream& s, uint bank, CCDBBankHandler *bankHandler, std::vector<uint32>& path )
+{
+	nlassert( ! isAtomic() ); // root node mustn't be atomic
+
+	// Read the levels of the id shared with the previous node
+	uint nbCommonLevels;
+	bool isNextSibling;
+	s.serialBit( isNextSibling );
+	if ( isNextSibling )
+	{
+		if ( path.empty() )
+			throw Exception( "CDB: packed delta starting with a next sibling" );
+		++path.back();
+		nbCommonLevels = (uint)path.size();
+	}
+	else
+	{
+		uint32 nbLevels = 0;
+		s.serial( nbLevels, PackedDeltaCommonLevelsBits );
+		if ( nbLevels > path.size() )
+			throw Exception( "CDB: packed delta sharing %u levels with a previous id of %u levels", nbLevels, (uint)path.size() );
+		nbCommonLevels = nbLevels;
+		path.resize( nbCommonLevels );
+	}
+
+	// Browse the id down to the changed leaf or atom branch, reading the levels that are not shared
+	CCDBNodeBranch *branch = this;
+	for ( uint level=0; ; ++level )
+	{
+		uint32 idx = 0;
+		if ( level < nbCommonLevels )
+		{
+			idx = path[level];
+		}
+		else
+		{
+			s.serial( idx, (level == 0) ? bankHandler->getFirstLevelIdBits( bank ) : branch->_IdBits );
+			path.push_back( idx );
+		}
+
+		// Translate bank index -> unified index
+		if ( level == 0 )
+			idx = bankHandler->getServerToClientUIDMapping( bank, idx );
+		if ( idx >= branch->_Nodes.size() )
+		{
+			throw Exception ("idx %d > _Nodes.size() %d ", idx, (sint)branch->_Nodes.size());
+		}
+
+		ICDBNode *node = branch->_Nodes[idx];
+		if ( verboseDatabase )
+		{
+			nlinfo( "CDB: Reading packed: %s %u/%d", node->getName()->c_str(), idx, (level == 0) ? bankHandler->getFirstLevelIdBits( bank ) : branch->_IdBits );
+		}
+
+		if ( node->isLeaf() )
+		{
+			path.resize( level+1 );
+			static_cast<CCDBNodeLeaf*>(node)->readPackedDelta( gc, s );
+			return;
+		}
+		branch = static_cast<CCDBNodeBranch*>(node);
+		if ( branch->isAtomic() )
+		{
+			path.resize( level+1 );
+			branch->readAtomDelta( gc, s, true );
+			return;
+		}
+	}
+}
+
+
 //-----------------------------------------------
 //	readDelta
 //
@@ -427,40 +501,7 @@ void CCDBNodeBranch::readDelta( TGameCycle gc, CBitMemStream & f )
 {
 	if ( isAtomic() )
 	{
-		// Read the atom bitfield
-		uint nbAtomElements = countLeaves();
-		if(verboseDatabase)
-			nlinfo( "CDB/ATOM: %u leaves", nbAtomElements );
-		CBitSet bitfield( nbAtomElements );
-		f.readBits( bitfield );
-		if ( ! bitfield.getVector().empty() )
-		{
-			if(verboseDatabase)
-			{
-				nldebug( "CDB/ATOM: Bitfield: %s LastBits:", bitfield.toString().c_str() );
-				f.displayLastBits( bitfield.size() );
-			}
-		}
-
-		// Set each modified property
-		uint atomIndex;
-		for ( uint i=0; i!=bitfield.size(); ++i )
-		{
-			if ( bitfield[i] )
-			{
-				if(verboseDatabase)
-				{
-					nldebug( "CDB/ATOM: Reading prop[%u] of atom", i );
-				}
-
-				atomIndex = i;
-				CCDBNodeLeaf *leaf = findLeafAtCount( atomIndex );
-				if ( leaf )
-					leaf->readDelta( gc, f );
-				else
-					nlwarning( "CDB: Can't find leaf with index %u in atom branch %s", i, getParent()?getName()->c_str():"(root)" );
-			}
-		}
+		readAtomDelta( gc, f, false );
 	}
 	else
 	{
@@ -486,6 +527,54 @@ void CCDBNodeBranch::readDelta( TGameCycle gc, CBitMemStream & f )
 }// readDelta //
 
 
+//-----------------------------------------------
+//	readAtomDelta
+//
+//-----------------------------------------------
+void CCDBNodeBranch::readAtomDelta( TGameCycle gc, CBitMemStream & f, bool packed )
+{
+	// Read the atom bitfield
+	uint nbAtomElements = countLeaves();
+	if(verboseDatabase)
+		nlinfo( "CDB/ATOM: %u leaves", nbAtomElements );
+	CBitSet bitfield( nbAtomElements );
+	f.readBits( bitfield );
+	if ( ! bitfield.getVector().empty() )
+	{
+		if(verboseDatabase)
+		{
+			nldebug( "CDB/ATOM: Bitfield: %s LastBits:", bitfield.toString().c_str() );
+			f.displayLastBits( bitfield.size() );
+		}
+	}
+
+	// Set each modified property
+	uint atomIndex;
+	for ( uint i=0; i!=bitfield.size(); ++i )
+	{
+		if ( bitfield[i] )
+		{
+			if(verboseDatabase)
+			{
+				nldebug( "CDB/ATOM: Reading prop[%u] of atom", i );
+			}
+
+			atomIndex = i;
+			CCDBNodeLeaf *leaf = findLeafAtCount( atomIndex );
+			if ( leaf )
+			{
+				if ( packed )
+					leaf->readPackedDelta( gc, f );
+				else
+					leaf->readDelta( gc, f );
+			}
+			else
+				nlwarning( "CDB: Can't find leaf with index %u in atom branch %s", i, getParent()?getName()->c_str():"(root)" );
+		}
+	}
+}// readAtomDelta //
+
+
 
 //-----------------------------------------------
 //	clear
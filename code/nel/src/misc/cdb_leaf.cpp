@@ -137,50 +137,103 @@ void CCDBNodeLeaf::readDelta(TGameCycle gc, CBitMemStream & f )
 	{
 		// Read the Property Value according to the Property Type.
 		uint64 recvd = 0;
-		uint bits;
-		if (_Type == TEXT)
-			bits = 32;
-		else if (_Type <= I64)
-			bits = _Type;
-		else
-			bits = _Type - 64;
+		uint bits = getDeltaBitSize();
 		f.serial(recvd, bits);
 
+		setValueFromDelta(gc, recvd, bits);
+	}
+	else
+		nlwarning("CCDBNodeLeaf::readDelta : Property Type Unknown ('%d') -> not serialized.", (uint)_Type);
+}// readDelta //
 
-		// if the DB update is older than last DB update, abort (but after the read!!)
-		if(gc<_LastChangeGC)
-			return;
-
-		// bkup _oldProperty
-		_oldProperty = _Property;
-
-		// setup new one
-		_Property = (sint64)recvd;
+//-----------------------------------------------
+//	readPackedDelta
+//-----------------------------------------------
+void CCDBNodeLeaf::readPackedDelta(TGameCycle gc, CBitMemStream & f )
+{
+	// If the property Type is valid.
+	if(_Type > UNKNOWN && _Type < Nb_Prop_Type)
+	{
+		uint64 recvd = 0;
+		uint bits = getDeltaBitSize();
 
-		// if signed
-		if (! ((_Type == TEXT) || (_Type <= I64)))
+		// The numeric values may be coded as the difference with the last value received in a packed delta
+		bool isDifference = false;
+		if ((_Type != TEXT) && (bits >= PackedDeltaMinValueBits))
+			f.serialBit(isDifference);
+		if (isDifference)
 		{
-			// extend bit sign
-			sint64 mask = (((sint64)1)<<bits)-(sint64)1;
-			if( (_Property >> (bits-1))==1 )
-			{
-				_Property |= ~mask;
-			}
+			uint32 nbNibbles = 0;
+			f.serial(nbNibbles, PackedDeltaNibbleCountBits);
+			uint64 zigzag = 0;
+			f.serial(zigzag, (nbNibbles+1)*4);
+			sint64 difference = (sint64)(zigzag >> 1) ^ -(sint64)(zigzag & 1);
+			recvd = (uint64)(_LastPackedValue + difference);
+			if (bits < 64)
+				recvd &= (((uint64)1)<<bits)-(uint64)1;
 		}
-		if ( verboseDatabase )
+		else
 		{
-			nlinfo( "CDB: Read value (%u bits) %" NL_I64 "d", bits, _Property );
+			f.serial(recvd, bits);
 		}
 
-		// bkup the date of change
-		_LastChangeGC= gc;
-
-		notifyObservers();
+		// The base of the next difference is updated even if the value is not applied (see setValueFromDelta())
+		_LastPackedValue = (sint64)recvd;
 
+		setValueFromDelta(gc, recvd, bits);
 	}
 	else
-		nlwarning("CCDBNodeLeaf::readDelta : Property Type Unknown ('%d') -> not serialized.", (uint)_Type);
-}// readDelta //
+		nlwarning("CCDBNodeLeaf::readPackedDelta : Property Type Unknown ('%d') -> not serialized.", (uint)_Type);
+}// readPackedDelta //
+
+//-----------------------------------------------
+//	getDeltaBitSize
+//-----------------------------------------------
+uint CCDBNodeLeaf::getDeltaBitSize() const
+{
+	if (_Type == TEXT)
+		return 32;
+	else if (_Type <= I64)
+		return _Type;
+	else
+		return _Type - 64;
+}
+
+//-----------------------------------------------
+//	setValueFromDelta
+//-----------------------------------------------
+void CCDBNodeLeaf::setValueFromDelta(TGameCycle gc, uint64 recvd, uint bits)
+{
+	// if the DB update is older than last DB update, abort (but after the read!!)
+	if(gc<_LastChangeGC)
+		return;
+
+	// bkup _oldProperty
+	_oldProperty = _Property;
+
+	// setup new one
+	_Property = (sint64)recvd;
+
+	// if signed
+	if (! ((_Type == TEXT) || (_Type <= I64)))
+	{
+		// extend bit sign
+		sint64 mask = (((sint64)1)<<bits)-(sint64)1;
+		if( (_Property >> (bits-1))==1 )
+		{
+			_Property |= ~mask;
+		}
+	}
+	if ( verboseDatabase )
+	{
+		nlinfo( "CDB: Read value (%u bits) %" NL_I64 "d", bits, _Property );
+	}
+
+	// bkup the date of change
+	_LastChangeGC= gc;
+
+	notifyObservers();
+}
 
 
 //-----------------------------------------------
@@ -191,6 +244,7 @@ void CCDBNodeLeaf::resetData(TGameCycle gc, bool forceReset)
 	if(forceReset)
 	{
 		_LastChangeGC = 0;
+		_LastPackedValue = 0;
 		setValue64(0);
 	}
 	else if (gc>=_LastChangeGC)	// apply only if happens after the DB change
@@ -0,0 +1,160 @@
+// NeL - MMORPG Framework <http://dev.ryzom.com/projects/nel/>
+// Copyright (C) 2010  Winch Gate Property Limited
+//
+// This program is free software: you can redistribute it and/or modify
+// it under the terms of the GNU Affero General Public License as
+// published by the Free Software Foundation, either version 3 of the
+// License, or (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU Affero General Public License for more details.
+//
+// You should have received a copy of the GNU Affero General Public License
+// along with this program.  If not, see <http://www.gnu.org/licenses/>.
+
+#include "stdmisc.h"
+
+#include "nel/misc/mapped_file.h"
+#include "nel/misc/file.h"
+#include "nel/misc/path.h"
+#include "nel/misc/common.h"
+
+#ifndef NL_OS_WINDOWS
+#	include <sys/types.h>
+#	include <sys/stat.h>
+#	include <sys/mman.h>
+#	include <fcntl.h>
+#	include <unistd.h>
+#endif
+
+#ifdef DEBUG_NEW
+	#define new DEBUG_NEW
+#endif
+
+namespace NLMISC {
+
+
+/*
+ * Constructor
+ */
+CMappedFile::CMappedFile() :
+	_Data( NULL ),
+	_Size( 0 ),
+	_MappedData( NULL ),
+	_MappingHandle( NULL )
+{
+}
+
+
+/*
+ * Destructor
+ */
+CMappedFile::~CMappedFile()
+{
+	close();
+}
+
+
+/*
+ * Map a file
+ */
+bool CMappedFile::open( const std::string& fileName, bool sequential )
+{
+	close();
+
+	uint32 size = CFile::getFileSize( fileName );
+	if ( size == 0 )
+		return false;
+
+#ifdef NL_OS_WINDOWS
+
+	HANDLE file = CreateFileW( utf8ToWide(fileName), GENERIC_READ, FILE_SHARE_READ, NULL, OPEN_EXISTING, sequential ? FILE_FLAG_SEQUENTIAL_SCAN : FILE_ATTRIBUTE_NORMAL, NULL );
+	if ( file != INVALID_HANDLE_VALUE )
+	{
+		HANDLE mapping = CreateFileMappingA( file, NULL, PAGE_READONLY, 0, 0, NULL );
+		CloseHandle( file );
+		if ( mapping != NULL )
+		{
+			_MappedData = MapViewOfFile( mapping, FILE_MAP_READ, 0, 0, size );
+			if ( _MappedData != NULL )
+				_MappingHandle = mapping;
+			else
+				CloseHandle( mapping );
+		}
+	}
+
+#else
+
+	int fd = ::open( fileName.c_str(), O_RDONLY );
+	if ( fd >= 0 )
+	{
+		void *data = mmap( NULL, size, PROT_READ, MAP_PRIVATE, fd, 0 );
+		::close( fd );
+		if ( data != MAP_FAILED )
+		{
+			if ( sequential )
+				madvise( data, size, MADV_SEQUENTIAL );
+			_MappedData = data;
+		}
+	}
+
+#endif
+
+	_Size = size;
+	if ( _MappedData != NULL )
+	{
+		_Data = (const uint8*)_MappedData;
+		return true;
+	}
+
+	// the file can't be mapped, read it
+	CIFile f;
+	if ( ! f.open( fileName ) )
+	{
+		close();
+		return false;
+	}
+	_Buffer.resize( size );
+	try
+	{
+		f.serialBuffer( &_Buffer[0], size );
+	}
+	catch (const Exception&)
+	{
+		nlwarning( "Failed to read file '%s'", fileName.c_str() );
+		close();
+		return false;
+	}
+	_Data = &_Buffer[0];
+	return true;
+}
+
+
+/*
+ * Unmap the file
+ */
+void CMappedFile::close()
+{
+	if ( _MappedData != NULL )
+	{
+#ifdef NL_OS_WINDOWS
+		UnmapViewOfFile( _MappedData );
+		CloseHandle( (HANDLE)_MappingHandle );
+#else
+		munmap( _MappedData, _Size );
+#endif
+		_MappedData = NULL;
+		_MappingHandle = NULL;
+	}
+
+	_Data = NULL;
+	_Size = 0;
+	contReset( _Buffer );
+}
+
+
+} // NLMISC
+
+/* End of mapped_file.cpp */
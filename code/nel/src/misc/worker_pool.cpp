@@ -0,0 +1,264 @@
+// NeL - MMORPG Framework <http://dev.ryzom.com/projects/nel/>
+// Copyright (C) 2010  Winch Gate Property Limited
+//
+// This program is free software: you can redistribute it and/or modify
+// it under the terms of the GNU Affero General Public License as
+// published by the Free Software Foundation, either version 3 of the
+// License, or (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU Affero General Public License for more details.
+//
+// You should have received a copy of the GNU Affero General Public License
+// along with this program.  If not, see <http://www.gnu.org/licenses/>.
+
+#include "stdmisc.h"
+
+#include "nel/misc/worker_pool.h"
+#include "nel/misc/thread.h"
+#include "nel/misc/debug.h"
+#include "nel/misc/atomic.h"
+
+#ifdef NL_OS_WINDOWS
+#	ifndef NL_COMP_MINGW
+#		define NOMINMAX
+#	endif
+#	include <windows.h>
+#else
+#	include <pthread.h>
+#endif
+
+#ifdef DEBUG_NEW
+	#define new DEBUG_NEW
+#endif
+
+namespace NLMISC {
+
+
+/*
+ * Counting semaphore used to park the worker threads between two runs
+ */
+#ifdef NL_OS_WINDOWS
+
+static void *createSemaphore()				{ return CreateSemaphore( NULL, 0, 0x7fffffff, NULL ); }
+static void deleteSemaphore( void *sem )	{ CloseHandle( (HANDLE)sem ); }
+static void postSemaphore( void *sem, uint n ) { ReleaseSemaphore( (HANDLE)sem, (LONG)n, NULL ); }
+static void waitSemaphore( void *sem )		{ WaitForSingleObject( (HANDLE)sem, INFINITE ); }
+
+#else
+
+// Unnamed POSIX semaphores are not available on every Unix (Mac OS X), use a mutex and a condition
+struct CPSemaphore
+{
+	pthread_mutex_t	Mutex;
+	pthread_cond_t	Cond;
+	uint			Count;
+};
+
+static void *createSemaphore()
+{
+	CPSemaphore *sem = new CPSemaphore;
+	pthread_mutex_init( &sem->Mutex, NULL );
+	pthread_cond_init( &sem->Cond, NULL );
+	sem->Count = 0;
+	return sem;
+}
+
+static void deleteSemaphore( void *p )
+{
+	CPSemaphore *sem = (CPSemaphore*)p;
+	pthread_cond_destroy( &sem->Cond );
+	pthread_mutex_destroy( &sem->Mutex );
+	delete sem;
+}
+
+static void postSemaphore( void *p, uint n )
+{
+	CPSemaphore *sem = (CPSemaphore*)p;
+	pthread_mutex_lock( &sem->Mutex );
+	sem->Count += n;
+	if ( n == 1 )
+		pthread_cond_signal( &sem->Cond );
+	else
+		pthread_cond_broadcast( &sem->Cond );
+	pthread_mutex_unlock( &sem->Mutex );
+}
+
+static void waitSemaphore( void *p )
+{
+	CPSemaphore *sem = (CPSemaphore*)p;
+	pthread_mutex_lock( &sem->Mutex );
+	while ( sem->Count == 0 )
+		pthread_cond_wait( &sem->Cond, &sem->Mutex );
+	--sem->Count;
+	pthread_mutex_unlock( &sem->Mutex );
+}
+
+#endif
+
+
+/*
+ * Thread of a worker (except worker 0 which is the thread calling run())
+ */
+class CWorkerPoolThread : public IRunnable
+{
+public:
+
+	CWorkerPoolThread( CWorkerPool *pool, uint workerIndex ) : _Pool(pool), _WorkerIndex(workerIndex) {}
+
+	virtual void run()
+	{
+		for (;;)
+		{
+			waitSemaphore( _Pool->_StartSemaphore );
+			if ( _Pool->_ExitRequired )
+				break;
+			_Pool->work( _WorkerIndex );
+			postSemaphore( _Pool->_DoneSemaphore, 1 );
+		}
+	}
+
+	virtual void getName( std::string &result ) const
+	{
+		result = "CWorkerPool" + toString( _WorkerIndex );
+	}
+
+private:
+
+	CWorkerPool	*_Pool;
+	uint		_WorkerIndex;
+};
+
+
+/*
+ * Constructor
+ */
+CWorkerPool::CWorkerPool() :
+	_StartSemaphore( NULL ),
+	_DoneSemaphore( NULL ),
+	_Jobs( NULL ),
+	_NbJobs( 0 ),
+	_NextJob( 0 ),
+	_WorkerTicks( 1, 0 ),
+	_WorkerNbJobs( 1, 0 ),
+	_ExitRequired( false )
+{
+}
+
+
+/*
+ * Destructor
+ */
+CWorkerPool::~CWorkerPool()
+{
+	release();
+}
+
+
+/*
+ * Init
+ */
+void CWorkerPool::init( uint nbWorkers )
+{
+	release();
+
+	if ( nbWorkers == 0 )
+		nbWorkers = 1;
+	_WorkerTicks.clear();
+	_WorkerTicks.resize( nbWorkers, 0 );
+	_WorkerNbJobs.clear();
+	_WorkerNbJobs.resize( nbWorkers, 0 );
+	if ( nbWorkers == 1 )
+		return;
+
+	_StartSemaphore = createSemaphore();
+	_DoneSemaphore = createSemaphore();
+	_ExitRequired = false;
+	for ( uint i=1; i!=nbWorkers; ++i )
+	{
+		IThread *thread = IThread::create( new CWorkerPoolThread( this, i ) );
+		nlassert( thread );
+		thread->start();
+		_Threads.push_back( thread );
+	}
+}
+
+
+/*
+ * Release
+ */
+void CWorkerPool::release()
+{
+	if ( _Threads.empty() )
+		return;
+
+	_ExitRequired = true;
+	postSemaphore( _StartSemaphore, (uint)_Threads.size() );
+	for ( uint i=0; i!=_Threads.size(); ++i )
+	{
+		_Threads[i]->wait();
+		delete _Threads[i]->getRunnable();
+		delete _Threads[i];
+	}
+	_Threads.clear();
+
+	deleteSemaphore( _StartSemaphore );
+	deleteSemaphore( _DoneSemaphore );
+	_StartSemaphore = NULL;
+	_DoneSemaphore = NULL;
+}
+
+
+/*
+ * Run the jobs
+ */
+void CWorkerPool::run( IWorkerJobs& jobs, uint nbJobs )
+{
+	_Jobs = &jobs;
+	_NbJobs = nbJobs;
+	_NextJob = 0;
+
+	// The semaphores provide the memory barriers between the main thread and the workers
+	uint nbThreadsToWake = std::min( (uint)_Threads.size(), (nbJobs == 0) ? 0 : nbJobs-1 );
+	for ( uint i=0; i!=nbWorkers(); ++i )
+	{
+		_WorkerTicks[i] = 0;
+		_WorkerNbJobs[i] = 0;
+	}
+	if ( nbThreadsToWake != 0 )
+		postSemaphore( _StartSemaphore, nbThreadsToWake );
+
+	work( 0 );
+
+	for ( uint i=0; i!=nbThreadsToWake; ++i )
+		waitSemaphore( _DoneSemaphore );
+	_Jobs = NULL;
+}
+
+
+/*
+ * Run jobs until there is no more job to pick
+ */
+void CWorkerPool::work( uint workerIndex )
+{
+	TTicks before = CTime::getPerformanceTime();
+	uint nbJobsDone = 0;
+	for (;;)
+	{
+		uint32 jobIndex = atomicFetchAdd( &_NextJob, (uint32)1 );
+		if ( jobIndex >= _NbJobs )
+			break;
+		_Jobs->runJob( jobIndex, workerIndex );
+		++nbJobsDone;
+	}
+	// A thread may be woken twice in the same run (by the token of a slower one), hence the sums
+	_WorkerTicks[workerIndex] += CTime::getPerformanceTime() - before;
+	_WorkerNbJobs[workerIndex] += nbJobsDone;
+}
+
+
+} // NLMISC
+
+/* End of worker_pool.cpp */
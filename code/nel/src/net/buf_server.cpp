@@ -33,6 +33,10 @@
 #	include <sys/time.h>
 #endif
 
+#ifdef NL_BUF_SERVER_EPOLL
+#	include <sys/epoll.h>
+#endif
+
 /*
  * On Linux, the default limit of descriptors is usually 1024, you can increase it with ulimit
  */
@@ -45,6 +49,18 @@ namespace NLNET {
 uint32 	NbServerListenTask = 0;
 uint32 	NbServerReceiveTask = 0;
 
+/*
+ * Read when a CBufServer is constructed: changing them affects only the servers created afterwards.
+ * UseEpollInBufServer is ignored where epoll is not available.
+ */
+CVariable<bool> UseEpollInBufServer("nel", "UseEpollInBufServer", "If true, the server receive threads use edge-triggered epoll instead of select (Linux only)", false, 0, true );
+CVariable<uint16> MaxSocketsPerEpollThread("nel", "MaxSocketsPerEpollThread", "Max number of connections handled by one server receive thread when using epoll", DEFAULT_MAX_SOCKETS_PER_EPOLL_THREADS, 0, true );
+
+#ifdef NL_BUF_SERVER_EPOLL
+// Max number of events returned by one epoll_wait() call
+static const int EpollMaxEvents = 256;
+#endif
+
 /***************************************************************************************************
  * User main thread (initialization)
  **************************************************************************************************/
@@ -73,9 +89,19 @@ CBufServer::CBufServer( TThreadStategy strategy,
 	_PrevBytesPushedOut( 0 ),
 	_NbConnections (0),
 	_NoDelay( nodelay ),
-	_ReplayMode( replaymode )
+	_ReplayMode( replaymode ),
+	_UseEpoll( false )
 {
 	nlnettrace( "CBufServer::CBufServer" );
+#ifdef NL_BUF_SERVER_EPOLL
+	_UseEpoll = UseEpollInBufServer.get();
+	if ( _UseEpoll )
+	{
+		// One epoll thread can handle many more sockets than a select thread
+		_MaxSocketsPerThread = max( _MaxSocketsPerThread, MaxSocketsPerEpollThread.get() );
+		LNETL1_DEBUG( "LNETL1: Server receive threads will use epoll (%hu sockets per thread)", _MaxSocketsPerThread );
+	}
+#endif
 	if ( ! _ReplayMode )
 	{
 		_ListenTask = new CListenTask( this );
@@ -966,6 +992,57 @@ void CBufServer::addNewThread( CThreadPool& threadpool, CServerBufSock *bufsock
  **************************************************************************************************/
 
 
+/*
+ * Constructor
+ */
+CServerReceiveTask::CServerReceiveTask( CBufServer *server ) :
+	CServerTask(),
+#ifdef NL_BUF_SERVER_EPOLL
+	_EpollHandle( -1 ),
+#endif
+	_Server( server ),
+	_Connections( "CServerReceiveTask::_Connections" ),
+	_RemoveSet( "CServerReceiveTask::_RemoveSet" )
+{
+#ifdef NL_BUF_SERVER_EPOLL
+	if ( _Server->usesEpoll() )
+	{
+		_EpollHandle = epoll_create1( 0 );
+		if ( _EpollHandle == -1 )
+		{
+			nlwarning( "LNETL1: epoll_create1() failed: code=%d '%s', falling back to select", errno, strerror(errno) );
+			return;
+		}
+
+		// The wake-up pipe is level-triggered: it is read once per wake-up, like with select
+		epoll_event ev;
+		ev.events = EPOLLIN;
+		ev.data.ptr = NULL;
+		if ( epoll_ctl( _EpollHandle, EPOLL_CTL_ADD, _WakeUpPipeHandle[PipeRead], &ev ) == -1 )
+		{
+			nlwarning( "LNETL1: epoll_ctl() failed for wake-up pipe: code=%d '%s', falling back to select", errno, strerror(errno) );
+			close( _EpollHandle );
+			_EpollHandle = -1;
+		}
+	}
+#endif
+}
+
+
+/*
+ * Destructor
+ */
+CServerReceiveTask::~CServerReceiveTask()
+{
+#ifdef NL_BUF_SERVER_EPOLL
+	if ( _EpollHandle != -1 )
+	{
+		close( _EpollHandle );
+	}
+#endif
+}
+
+
 /*
  * Code of receiving threads for servers
  */
@@ -975,9 +1052,6 @@ void CServerReceiveTask::run()
 	NbServerReceiveTask++;
 	nlnettrace( "CServerReceiveTask::run" );
 
-	SOCKET descmax;
-	fd_set readers;
-
 #if defined NL_OS_UNIX
 	// POLL7
 	if (nice( 2 ) == -1) // is this really useful as long as select() sleeps?
@@ -986,6 +1060,27 @@ void CServerReceiveTask::run()
 	}
 #endif // NL_OS_UNIX
 
+#ifdef NL_BUF_SERVER_EPOLL
+	if ( _EpollHandle != -1 )
+		runEpoll();
+	else
+#endif
+		runSelect();
+
+	nlnettrace( "Exiting CServerReceiveTask::run" );
+	NbServerReceiveTask--;
+	NbNetworkTask--;
+}
+
+
+/*
+ * Receive loop using select() on the sockets handled in the present thread
+ */
+void CServerReceiveTask::runSelect()
+{
+	SOCKET descmax;
+	fd_set readers;
+
 	// Copy of _Connections
 	vector<TSockId>	connections_copy;
 
@@ -1085,7 +1180,7 @@ void CServerReceiveTask::run()
 				}*/
 				//nlerror( "LNETL1: Select failed (in receive thread): %s (code %u)", CSock::errorString( CSock::getLastError() ).c_str(), CSock::getLastError() );
 				LNETL1_DEBUG( "LNETL1: Select failed (in receive thread): %s (code %u)", CSock::errorString( CSock::getLastError() ).c_str(), CSock::getLastError() );
-				goto end;
+				return;
 		}
 
 		// 4. Get results
@@ -1160,13 +1255,114 @@ void CServerReceiveTask::run()
 
 		NbLoop++;
 	}
-end:
-	nlnettrace( "Exiting CServerReceiveTask::run" );
-	NbServerReceiveTask--;
-	NbNetworkTask--;
 }
 
 
+#ifdef NL_BUF_SERVER_EPOLL
+
+/*
+ * Add the socket descriptor into the epoll set.
+ * epoll_ctl() is thread-safe, so this is called directly by addNewSocket() in the listen thread.
+ * The descriptor leaves the set automatically when the socket object is deleted (closed).
+ */
+void CServerReceiveTask::registerSocketInEpoll( TSockId sockid )
+{
+	epoll_event ev;
+	ev.events = EPOLLIN | EPOLLRDHUP | EPOLLET;
+	ev.data.ptr = sockid;
+	if ( epoll_ctl( _EpollHandle, EPOLL_CTL_ADD, sockid->Sock->descriptor(), &ev ) == -1 )
+	{
+		nlwarning( "LNETL1: epoll_ctl() failed for %s: code=%d '%s'", sockid->asString().c_str(), errno, strerror(errno) );
+		sockid->Sock->disconnect();
+	}
+}
+
+
+/*
+ * Receive loop using edge-triggered epoll on the sockets handled in the present thread.
+ * Unlike the select version, nothing is rebuilt per wake-up: the cost depends only on the number of
+ * sockets that actually received data.
+ */
+void CServerReceiveTask::runEpoll()
+{
+	epoll_event events [EpollMaxEvents];
+
+	while ( ! exitRequired() )
+	{
+		// 1. Remove closed connections (only here, so that the pointers returned by epoll_wait() stay valid in step 3)
+		clearClosedConnections();
+
+		// 2. Wait for incoming data or wake-up
+		int res = epoll_wait( _EpollHandle, events, EpollMaxEvents, -1 );
+		if ( res == -1 )
+		{
+			// Interrupted system call (caused by a CTRL-C or by a debugger)
+			if ( errno == EINTR )
+				continue;
+
+			LNETL1_DEBUG( "LNETL1: epoll_wait failed (in receive thread): %s (code %u)", CSock::errorString( CSock::getLastError() ).c_str(), CSock::getLastError() );
+			break;
+		}
+
+		// 3. Get results
+		for ( int i=0; i!=res; ++i )
+		{
+			if ( events[i].data.ptr == NULL )
+			{
+				// Test wake-up pipe
+				uint8 b;
+				if ( read( _WakeUpPipeHandle[PipeRead], &b, 1 ) == -1 ) // we were woken-up by the wake-up pipe
+				{
+					LNETL1_DEBUG( "LNETL1: In CServerReceiveTask::runEpoll(): read() failed" );
+				}
+				LNETL1_DEBUG( "LNETL1: Receive thread epoll woken-up" );
+			}
+			else
+			{
+				receiveAllFromSocket( (TSockId)events[i].data.ptr );
+			}
+		}
+
+		NbLoop++;
+	}
+}
+
+
+/*
+ * With edge-triggered notification, the socket must be read until it is empty, otherwise
+ * the remaining data would not be signaled again.
+ */
+void CServerReceiveTask::receiveAllFromSocket( TSockId sockid )
+{
+	CServerBufSock *serverbufsock = static_cast<CServerBufSock*>(static_cast<CBufSock*>(sockid));
+	try
+	{
+		// Exclude disconnected sockets that are not deleted yet
+		while ( serverbufsock->Sock->connected() )
+		{
+			if ( serverbufsock->receivePart( sizeof(TSockId) + 1 ) ) // +1 for the event type
+			{
+				serverbufsock->fillSockIdAndEventType( sockid );
+
+				// Push message into receive queue
+				_Server->pushMessageIntoReceiveQueue( serverbufsock->receivedBuffer() );
+			}
+			else if ( serverbufsock->receiveDrained() )
+			{
+				break;
+			}
+		}
+	}
+	catch (const ESocket&)
+	{
+		LNETL1_DEBUG( "LNETL1: Connection %s broken", serverbufsock->asString().c_str() );
+		sockid->Sock->disconnect();
+	}
+}
+
+#endif // NL_BUF_SERVER_EPOLL
+
+
 /*
  * Delete all connections referenced in the remove list (double-mutexed)
  */
@@ -384,7 +384,8 @@ CNonBlockingBufSock::CNonBlockingBufSock( CTcpSock *sock, uint32 maxExpectedBloc
 	_MaxExpectedBlockSize( maxExpectedBlockSize ),
 	_NowReadingBuffer( false ),
 	_BytesRead( 0 ),
-	_Length( 0 )
+	_Length( 0 ),
+	_ReceiveDrained( false )
 {
 	nlnettrace( "CNonBlockingBufSock::CNonBlockingBufSock" );
 }
@@ -414,12 +415,14 @@ bool CNonBlockingBufSock::receivePart( uint32 nbExtraBytes )
 	nlassert (this != InvalidSockId);	// invalid bufsock
 	nlnettrace( "CNonBlockingBufSock::receivePart" );
 
-	TBlockSize actuallen;
+	TBlockSize actuallen, requestedlen;
+	_ReceiveDrained = false;
 	if ( ! _NowReadingBuffer )
 	{
 		// Receiving length prefix
-		actuallen = sizeof(_Length)-_BytesRead;
+		actuallen = requestedlen = sizeof(_Length)-_BytesRead;
 		CSock :: TSockResult ret = Sock->receive( (uint8*)(&_Length)+_BytesRead, actuallen, false );
+		_ReceiveDrained = (actuallen < requestedlen);
 		if (ret == CSock::ConnectionClosed)
 		{
 			LNETL1_DEBUG( "LNETL1: Connection %s closed", asString().c_str() );
@@ -461,8 +464,9 @@ bool CNonBlockingBufSock::receivePart( uint32 nbExtraBytes )
 	if ( _NowReadingBuffer )
 	{
 		// Receiving payload buffer
-		actuallen = _Length-_BytesRead;
+		actuallen = requestedlen = _Length-_BytesRead;
 		Sock->receive( &*_ReceiveBuffer.begin()+_BytesRead, actuallen );
+		_ReceiveDrained = (actuallen < requestedlen);
 		_BytesRead += actuallen;
 
 		if ( _BytesRead == _Length )
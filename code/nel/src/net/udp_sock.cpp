@@ -18,6 +18,7 @@
 
 #include "nel/net/udp_sock.h"
 #include "nel/net/net_log.h"
+#include "nel/misc/atomic.h"
 
 #ifdef NL_OS_WINDOWS
 #	include <winsock2.h>
@@ -45,6 +46,11 @@
 typedef int SOCKET;
 #endif
 
+// Batched datagram system calls (Linux only)
+#if defined(NL_OS_UNIX) && !defined(NL_OS_MAC)
+#	define NL_UDP_SOCK_MMSG
+#endif
+
 using namespace NLMISC;
 
 namespace NLNET {
@@ -55,7 +61,7 @@ namespace NLNET {
  */
 CUdpSock::CUdpSock( bool logging ) :
 	CSock( logging ),
-	_Bound( false )
+	_BindState( Unbound )
 {
 	// Socket creation
 	createSocket( SOCK_DGRAM, IPPROTO_UDP );
@@ -95,7 +101,7 @@ void CUdpSock::bind( const CInetAddress& addr )
 	{
 		throw ESocket( "Bind failed" );
 	}
-	_Bound = true;
+	atomicStoreRelease( &_BindState, (uint32)Bound );
 	if ( _Logging )
 	{
 		LNETL0_DEBUG( "LNETL0: Socket %d bound at %s", _Sock, _LocalAddr.asString().c_str() );
@@ -114,7 +120,7 @@ void CUdpSock::sendTo( const uint8 *buffer, uint len, const CInetAddress& addr )
 	{
 		throw ESocket( "Unable to send datagram" );
 	}
-	_BytesSent += len;
+	atomicFetchAdd( &_BytesSent, (uint64)len );
 
 	if ( _Logging )
 	{
@@ -122,10 +128,9 @@ void CUdpSock::sendTo( const uint8 *buffer, uint len, const CInetAddress& addr )
 	}
 
 	// If socket is unbound, retrieve local address
-	if ( ! _Bound )
+	if ( atomicLoadAcquire( &_BindState ) != Bound )
 	{
-		setLocalAddress();
-		_Bound = true;
+		setLocalAddressOnce();
 	}
 
 #ifdef NL_OS_WINDOWS
@@ -144,6 +149,21 @@ void CUdpSock::sendTo( const uint8 *buffer, uint len, const CInetAddress& addr )
 }
 
 
+/*
+ * Retrieve the local address of a socket bound by sending. Several threads may send on the
+ * same socket (sendToBatch()): the first one retrieves the address, and the socket is seen
+ * as bound only once the address is set.
+ */
+void CUdpSock::setLocalAddressOnce()
+{
+	if ( atomicCompareExchange( &_BindState, (uint32)Unbound, (uint32)Binding ) )
+	{
+		setLocalAddress();
+		atomicStoreRelease( &_BindState, (uint32)Bound );
+	}
+}
+
+
 /*
  * Receives data from the peer. (blocking function)
  */
@@ -203,4 +223,122 @@ bool CUdpSock::receivedFrom( uint8 *buffer, uint& len, CInetAddress& addr, bool
 }
 
 
+/*
+ * Receives several datagrams in one system call when possible (blocking function)
+ */
+uint CUdpSock::receivedFromBatch( TDatagram *datagrams, uint nb, bool throw_exception )
+{
+	nlassert( nb != 0 );
+#ifdef NL_UDP_SOCK_MMSG
+	if ( nb > (uint)MaxDatagramBatch )
+		nb = (uint)MaxDatagramBatch;
+
+	mmsghdr msgs [MaxDatagramBatch];
+	iovec iovecs [MaxDatagramBatch];
+	sockaddr_in saddrs [MaxDatagramBatch];
+	memset( msgs, 0, nb*sizeof(mmsghdr) );
+	memset( &saddrs[0], 0, sizeof(sockaddr_in) );
+	for ( uint i=0; i!=nb; ++i )
+	{
+		iovecs[i].iov_base = datagrams[i].Buffer;
+		iovecs[i].iov_len = datagrams[i].Length;
+		msgs[i].msg_hdr.msg_name = &saddrs[i];
+		msgs[i].msg_hdr.msg_namelen = sizeof(sockaddr_in);
+		msgs[i].msg_hdr.msg_iov = &iovecs[i];
+		msgs[i].msg_hdr.msg_iovlen = 1;
+	}
+
+	// Block until the first datagram, then take only what is already there
+	int res = ::recvmmsg( _Sock, msgs, nb, MSG_WAITFORONE, NULL );
+	if ( res == SOCKET_ERROR )
+	{
+		// When the remote socket is closed, get sender's address to know who is quitting
+		datagrams[0].Addr->setSockAddr( &saddrs[0] );
+		if ( throw_exception )
+			throw ESocket( "Cannot receive data" );
+		return 0;
+	}
+
+	for ( int i=0; i!=res; ++i )
+	{
+		datagrams[i].Length = msgs[i].msg_len;
+		datagrams[i].Addr->setSockAddr( &saddrs[i] );
+		_BytesReceived += msgs[i].msg_len;
+	}
+	if ( _Logging )
+	{
+		LNETL0_DEBUG( "LNETL0: Socket %d received %d datagrams", _Sock, res );
+	}
+	return (uint)res;
+#else
+	return receivedFrom( datagrams[0].Buffer, datagrams[0].Length, *datagrams[0].Addr, throw_exception ) ? 1 : 0;
+#endif
+}
+
+
+/*
+ * Sends several datagrams with as few system calls as possible
+ */
+uint CUdpSock::sendToBatch( const TDatagram *datagrams, uint nb )
+{
+#ifdef NL_UDP_SOCK_MMSG
+	mmsghdr msgs [MaxDatagramBatch];
+	iovec iovecs [MaxDatagramBatch];
+	uint nbSent = 0;
+	uint64 nbBytesSent = 0;
+	while ( nbSent < nb )
+	{
+		uint nbInCall = std::min( nb - nbSent, (uint)MaxDatagramBatch );
+		memset( msgs, 0, nbInCall*sizeof(mmsghdr) );
+		for ( uint i=0; i!=nbInCall; ++i )
+		{
+			const TDatagram& datagram = datagrams[nbSent+i];
+			iovecs[i].iov_base = datagram.Buffer;
+			iovecs[i].iov_len = datagram.Length;
+			msgs[i].msg_hdr.msg_name = const_cast<sockaddr_in*>(datagram.Addr->sockAddr());
+			msgs[i].msg_hdr.msg_namelen = sizeof(sockaddr_in);
+			msgs[i].msg_hdr.msg_iov = &iovecs[i];
+			msgs[i].msg_hdr.msg_iovlen = 1;
+		}
+
+		int res = ::sendmmsg( _Sock, msgs, nbInCall, 0 );
+		if ( res == SOCKET_ERROR )
+			break;
+		for ( int i=0; i!=res; ++i )
+			nbBytesSent += msgs[i].msg_len;
+		nbSent += (uint)res;
+		if ( res != (int)nbInCall )
+			break; // the next one failed
+	}
+
+	if ( _Logging )
+	{
+		LNETL0_DEBUG( "LNETL0: Socket %d sent %u datagrams out of %u", _Sock, nbSent, nb );
+	}
+
+	atomicFetchAdd( &_BytesSent, nbBytesSent );
+
+	// If socket is unbound, retrieve local address
+	if ( (nbSent != 0) && (atomicLoadAcquire( &_BindState ) != Bound) )
+	{
+		setLocalAddressOnce();
+	}
+	return nbSent;
+#else
+	for ( uint i=0; i!=nb; ++i )
+	{
+		try
+		{
+			sendTo( datagrams[i].Buffer, datagrams[i].Length, *datagrams[i].Addr );
+		}
+		catch (const ESocket&)
+		{
+			return i;
+		}
+	}
+	return nb;
+#endif
+}
+
+
 } // NLNET
@@ -26,6 +26,7 @@
 
 #ifdef NL_OS_UNIX
 #include <sched.h>
+#include <fcntl.h>
 #endif
 
 using namespace std;
@@ -566,6 +567,12 @@ bool	CUnifiedNetwork::init(const CInetAddress *addr, CCallbackNetBase::TRecordin
 	if ( ::pipe( _MainDataAvailablePipe ) != 0 )
 		nlwarning( "Unable to create main D.A. pipe" );
 	//nldebug( "Pipe: created" );
+
+	/// Init the wake-up pipe (non-blocking, as it is drained without knowing how many bytes were written)
+	if ( ::pipe( _WakeUpPipe ) != 0 )
+		nlwarning( "Unable to create wake-up pipe" );
+	::fcntl( _WakeUpPipe[PipeRead], F_SETFL, O_NONBLOCK );
+	::fcntl( _WakeUpPipe[PipeWrite], F_SETFL, O_NONBLOCK );
 #endif
 
 	// setup the server callback only if server port != 0, otherwise there's no server callback
@@ -754,6 +761,8 @@ void	CUnifiedNetwork::release(bool mustFlushSendQueues, const std::vector<std::s
 #ifdef NL_OS_UNIX
 	::close( _MainDataAvailablePipe[PipeRead] );
 	::close( _MainDataAvailablePipe[PipeWrite] );
+	::close( _WakeUpPipe[PipeRead] );
+	::close( _WakeUpPipe[PipeWrite] );
 #endif
 }
 
@@ -1128,6 +1137,13 @@ void	CUnifiedNetwork::update(TTime timeout)
 		//
 		//      t0 -------------- currentTime ---------------------- t0 + timeout
 		//                                        remainingTime
+		// Don't sleep if a wake-up was requested
+		if ( _WakeUpRequested )
+		{
+			_WakeUpRequested = false;
+			break;
+		}
+
 		TTime prevRemainingTime = remainingTime;
 		TTime currentTime = CTime::getLocalTime();
 		remainingTime = t0 + timeout - currentTime;
@@ -1234,7 +1250,8 @@ void CUnifiedNetwork::sleepUntilDataAvailable( TTime msecMax )
 	fd_set readers;
 	FD_ZERO( &readers );
 	FD_SET( _MainDataAvailablePipe[PipeRead], &readers );
-	SOCKET descmax = _MainDataAvailablePipe[PipeRead] + 1;
+	FD_SET( _WakeUpPipe[PipeRead], &readers );
+	SOCKET descmax = std::max( _MainDataAvailablePipe[PipeRead], _WakeUpPipe[PipeRead] ) + 1;
 
 	// Select
 	timeval tv;
@@ -1246,10 +1263,32 @@ void CUnifiedNetwork::sleepUntilDataAvailable( TTime msecMax )
 	if ( res == -1 )
 		nlwarning( "HNETL5: Select failed in sleepUntilDataAvailable");
 	//nldebug( "Slept %u ms", (uint)(CTime::getLocalTime()-before) );
+
+	// Drain the wake-up pipe (the request itself is in _WakeUpRequested)
+	if ( (res > 0) && FD_ISSET( _WakeUpPipe[PipeRead], &readers ) )
+	{
+		uint8 buf [16];
+		while ( ::read( _WakeUpPipe[PipeRead], buf, sizeof(buf) ) > 0 ) {}
+	}
 }
 #endif
 
 
+/*
+ * Can be called from any thread
+ */
+void CUnifiedNetwork::wakeUp()
+{
+	_WakeUpRequested = true;
+#ifdef NL_OS_UNIX
+	// Interrupt select() in sleepUntilDataAvailable() (if the pipe is full, it is already interrupted)
+	uint8 b = 0;
+	if ( ::write( _WakeUpPipe[PipeWrite], &b, 1 ) == -1 && (errno != EAGAIN) )
+		nlwarning( "HNETL5: Write pipe failed in wakeUp" );
+#endif
+}
+
+
 
 bool CUnifiedNetwork::isConnectionConnected(TServiceId sid) const
 {
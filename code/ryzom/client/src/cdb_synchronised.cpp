@@ -57,7 +57,7 @@ uint32 NbDatabaseChanges = 0;
 //	CCDBSynchronised
 //
 //-----------------------------------------------
-CCDBSynchronised::CCDBSynchronised() : CCDBManager("SERVER", NB_CDB_BANKS), _InitInProgress(true), _InitDeltaReceived(0)
+CCDBSynchronised::CCDBSynchronised() : CCDBManager("SERVER", NB_CDB_BANKS), _InitInProgress(true), _InitDeltaReceived(0), _NextPackedDeltaSequence(0)
 {
 }
 
@@ -204,6 +204,11 @@ void CCDBSynchronised::readDelta( NLMISC::TGameCycle gc, CBitMemStream& s, uint
 	//displayBitStream2( f, f.getPosInBit(), f.getPosInBit() + 64 );
 	uint16 propertyCount = 0;
 	s.serial( propertyCount );
+	if ( propertyCount == ICDBNode::PackedDeltaMarker )
+	{
+		readPackedDelta( gc, s, bank );
+		return;
+	}
 
 	if ( NLMISC::ICDBNode::isDatabaseVerbose() )
 		nlinfo( "CDB: Reading delta (%hu changes)", propertyCount );
@@ -238,6 +243,62 @@ void CCDBSynchronised::readDelta( NLMISC::TGameCycle gc, CBitMemStream& s, uint
 } // readDelta //
 
 
+//-----------------------------------------------
+//	readPackedDelta
+//
+//-----------------------------------------------
+void CCDBSynchronised::readPackedDelta( NLMISC::TGameCycle gc, CBitMemStream& s, uint bank )
+{
+	uint16 sequence = 0;
+	s.serial( sequence );
+	if ( sequence != _NextPackedDeltaSequence )
+	{
+		if ( NLMISC::ICDBNode::isDatabaseVerbose() )
+			nlinfo( "CDB: Packed delta %hu received before %hu", sequence, _NextPackedDeltaSequence );
+		CPendingPackedDelta& pending = _PendingPackedDeltas[sequence];
+		pending.GameCycle = gc;
+		pending.Bank = bank;
+		pending.Stream = s; // keeps the reading position
+		return;
+	}
+
+	applyPackedDelta( gc, s, bank );
+
+	// Apply the deltas that were waiting for this one
+	std::map<uint16, CPendingPackedDelta>::iterator it;
+	while ( (it = _PendingPackedDeltas.find( _NextPackedDeltaSequence )) != _PendingPackedDeltas.end() )
+	{
+		CPendingPackedDelta pending = (*it).second;
+		_PendingPackedDeltas.erase( it );
+		applyPackedDelta( pending.GameCycle, pending.Stream, pending.Bank );
+	}
+} // readPackedDelta //
+
+
+//-----------------------------------------------
+//	applyPackedDelta
+//
+//-----------------------------------------------
+void CCDBSynchronised::applyPackedDelta( NLMISC::TGameCycle gc, CBitMemStream& s, uint bank )
+{
+	// Don't block the next deltas if this one can't be read
+	++_NextPackedDeltaSequence;
+
+	uint16 propertyCount = 0;
+	s.serial( propertyCount );
+
+	if ( NLMISC::ICDBNode::isDatabaseVerbose() )
+		nlinfo( "CDB: Reading packed delta (%hu changes)", propertyCount );
+	NbDatabaseChanges += propertyCount;
+
+	std::vector<uint32> path;
+	for( uint i=0; i!=propertyCount; ++i )
+	{
+		_Database->readAndMapPackedDelta( gc, s, bank, &bankHandler, path );
+	}
+} // applyPackedDelta //
+
+
 //-----------------------------------------------
 //	getProp
 //
@@ -23,6 +23,9 @@
 #include "nel/misc/cdb.h"
 #include "nel/misc/cdb_branch.h"
 #include "nel/misc/cdb_manager.h"
+#include "nel/misc/bit_mem_stream.h"
+
+#include <map>
 
 /**
  * Class to manage a database of properties
@@ -41,6 +44,20 @@ class CCDBSynchronised : public NLMISC::CCDBManager
 	/// The number of "init database packet" received
 	uint8					_InitDeltaReceived;
 
+	/// Packed delta received before the previous ones (see readPackedDelta())
+	struct CPendingPackedDelta
+	{
+		NLMISC::TGameCycle		GameCycle;
+		uint					Bank;
+		NLMISC::CBitMemStream	Stream;
+	};
+
+	/// Packed deltas waiting for the previous ones, by sequence number
+	std::map<uint16, CPendingPackedDelta>	_PendingPackedDeltas;
+
+	/// Sequence number of the next packed delta to apply
+	uint16					_NextPackedDeltaSequence;
+
 public:
 
 	/// exception thrown when database is not initialized
@@ -130,7 +147,7 @@ public:
 	void test();
 
 	/// Reset the init state (if you relauch the game from scratch)
-	void resetInitState() { _InitDeltaReceived = 0; _InitInProgress = true; writeInitInProgressIntoUIDB(); }
+	void resetInitState() { _InitDeltaReceived = 0; _InitInProgress = true; _NextPackedDeltaSequence = 0; _PendingPackedDeltas.clear(); writeInitInProgressIntoUIDB(); }
 
 	/// Called after flushObserversCalls() as it calls the observers for branches
 	void setChangesProcessed()
@@ -152,6 +169,18 @@ private:
 
 	void writeInitInProgressIntoUIDB();
 
+	/**
+	 * Update the database from a packed delta, in the order of the sequence numbers.
+	 * The values may be coded as a difference with the previous value sent, so the deltas
+	 * must be applied in the order they were sent, but the database impulsions use several
+	 * channels on the FS: a delta received before the previous ones is stored until they arrive.
+	 * Thus the stream must not contain anything after a packed delta.
+	 */
+	void readPackedDelta( NLMISC::TGameCycle gc, NLMISC::CBitMemStream& s, uint bank );
+
+	/// Apply a packed delta (after the sequence number)
+	void applyPackedDelta( NLMISC::TGameCycle gc, NLMISC::CBitMemStream& s, uint bank );
+
 	NLMISC::CRefPtr<NLMISC::CCDBNodeLeaf> m_CDBInitInProgressDB;
 };
 
@@ -104,6 +104,7 @@ const char *CBackupMsgSaveFile::_TypesStr [CBackupMsgSaveFile::NbTypes] =
 	"SAVE_CHECK_FILE",
 	"append_file",
 	"append_file_check",
+	"append_delta",
 };
 
 
@@ -84,6 +84,7 @@ struct CBackupMsgSaveFile
 		SaveFileCheck,		// Save file and create directory tree if not existing (same as above)
 		AppendFile,			// Append file and create directory tree if not existing
 		AppendFileCheck,	// Append file and create directory tree if not existing (same as above)
+		AppendDelta,		// Append a CPDRDelta record to the delta journal of the file (see persistent_data_delta.h)
 
 		NbTypes
 	};
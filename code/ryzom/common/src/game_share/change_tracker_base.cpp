@@ -58,6 +58,27 @@ void		CChangeTrackerBase::recordChange( TDataSetIndex entityIndex )
 	nlassertex( (entityIndex != INVALID_DATASET_INDEX) && (entityIndex != LAST_CHANGED), ("E%d", entityIndex) );
 #endif
 
+#ifdef USE_LOCK_FREE_TRACKERS
+
+	// Set the entityIndex as changed, unless it is already in the list
+	if ( ! NLMISC::atomicCompareExchange( &_Array[entityIndex].NextChanged, INVALID_DATASET_INDEX, LAST_CHANGED ) )
+		return;
+
+#ifdef COUNT_MIRROR_PROP_CHANGES
+	NLMISC::atomicFetchAdd( &_Header->NbDistinctChanges, (sint32)1 );
+#endif
+
+	// Set the new last one, then link the previous last one to it (or set the first one
+	// if the list was empty). Until the link is written, the reader sees the list ending
+	// at the previous last one, and can't pop it (see popLastChanged()).
+	TDataSetIndex previousLast = NLMISC::atomicExchange( &_Header->Last, entityIndex );
+	if ( previousLast != INVALID_DATASET_INDEX )
+		NLMISC::atomicStoreRelease( &_Array[previousLast].NextChanged, entityIndex );
+	else
+		NLMISC::atomicStoreRelease( &_Header->First, entityIndex );
+
+#else
+
 	// Protect consistency of two parallel calls to recordChange() for the same tracker
 	// and between recordChange() and popFirstChanged()
 	trackerMutex().enter();
@@ -100,9 +121,36 @@ void		CChangeTrackerBase::recordChange( TDataSetIndex entityIndex )
 		//nldebug( "Tracker (smid %u): E%d already in list (pointing to %d)", smid(), entityIndex, _Array[entityIndex].NextChanged );
 	trackerMutex().leave();
 
+#endif
 }
 
 
+#ifdef USE_LOCK_FREE_TRACKERS
+
+/*
+ * Pop the first change when it has no next changed yet (lock-free mode)
+ */
+void		CChangeTrackerBase::popLastChanged( TDataSetIndex first )
+{
+	// Empty the list. The writers only set First when they find the list empty,
+	// so it must be reset before Last.
+	NLMISC::atomicStoreRelease( &_Header->First, LAST_CHANGED );
+	if ( ! NLMISC::atomicCompareExchange( &_Header->Last, first, INVALID_DATASET_INDEX ) )
+	{
+		// A writer has just set a new last one, wait until it links it to the first one
+		TDataSetIndex next;
+		while ( (next = NLMISC::atomicLoadAcquire( &_Array[first].NextChanged )) == LAST_CHANGED )
+			NLMISC::nlSleep( 0 );
+		_Header->First = next;
+	}
+
+	// Now the item can be recorded again
+	NLMISC::atomicStoreRelease( &_Array[first].NextChanged, INVALID_DATASET_INDEX );
+}
+
+#endif
+
+
 /*
  * Remove a change (slow) (assumes isAllocated())
  */
@@ -112,6 +160,11 @@ void		CChangeTrackerBase::cancelChange( TDataSetIndex entityIndex )
 	nlassertex( (entityIndex != INVALID_DATASET_INDEX) && (entityIndex != LAST_CHANGED), ("E%d", entityIndex) );
 #endif
 
+#ifdef USE_LOCK_FREE_TRACKERS
+	// The writers don't lock the mutex, the list can only be modified at its ends
+	nlwarning( "Cannot cancel the change of E%u in a lock-free tracker", entityIndex );
+#else
+
 	trackerMutex().enter();
 
 	// Find the change before the specified one, to make the link skip it
@@ -145,6 +198,7 @@ void		CChangeTrackerBase::cancelChange( TDataSetIndex entityIndex )
 		}
 	}
 	trackerMutex().leave();
+#endif
 }
 
 
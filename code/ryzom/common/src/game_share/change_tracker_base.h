@@ -34,6 +34,20 @@
  */
 #define COUNT_MIRROR_PROP_CHANGES
 
+/*
+ * Set this define (here or in the compiler flags) to record and pop the changes without the
+ * tracker mutex: the list of changes is linked with atomic operations. Any number of writers
+ * (the local services and the mirror service) can record changes while the owner of the
+ * tracker pops them.
+ * cancelChange() is not available in this mode (it only logs a warning).
+ * Important note: all the user services and the mirror service should have the same value!
+ */
+//#define USE_LOCK_FREE_TRACKERS
+
+#ifdef USE_LOCK_FREE_TRACKERS
+#	include "nel/misc/atomic.h"
+#endif
+
 
 /**
  * Header of a tracker
@@ -132,11 +146,36 @@ public:
 	void					cancelChange( TDataSetIndex entityIndex );
 
 	/// Get the entity index of the first changed (assumes isAllocated()). Returns LAST_CHANGED if there is no change.
+#ifdef USE_LOCK_FREE_TRACKERS
+	uint32					getFirstChanged() const { return NLMISC::atomicLoadAcquire( &_Header->First ); }
+#else
 	uint32					getFirstChanged() const { /*nlinfo( "Array = %p, First = %d, _Array[First].NextChanged = %d, _Array[0].NextChanged = %d", _Array, _Header->First, _Array[_Header->First].NextChanged, _Array[0].NextChanged );*/ return _Header->First; }
+#endif
 
 	/// Pop the first change out of the tracker. Do not call if getFirstChanged() returned LAST_CHANGED.
 	void					popFirstChanged()
 	{
+#ifdef USE_LOCK_FREE_TRACKERS
+		// Only the reader changes First while the list is not empty
+		TDataSetIndex first = _Header->First;
+#ifdef NL_DEBUG
+		nlassert( first != LAST_CHANGED );
+#endif
+		TDataSetIndex next = NLMISC::atomicLoadAcquire( &_Array[first].NextChanged );
+		if ( next != LAST_CHANGED )
+		{
+			_Header->First = next;
+			// Now the item can be recorded again
+			NLMISC::atomicStoreRelease( &_Array[first].NextChanged, INVALID_DATASET_INDEX );
+		}
+		else
+		{
+			popLastChanged( first );
+		}
+#ifdef COUNT_MIRROR_PROP_CHANGES
+		NLMISC::atomicFetchSub( &_Header->NbDistinctChanges, (sint32)1 );
+#endif
+#else
 		// Protect consistency of popFirstChanged() in parallel with recordChange()
 		// (there can't be two parallels calls to popFirstChanged()
 		trackerMutex().enter();
@@ -154,6 +193,7 @@ public:
 		--_Header->NbDistinctChanges;
 #endif
 		trackerMutex().leave();
+#endif
 	}
 
 	/// Return the number of changes (assumes isAllocated()) (slow)
@@ -188,6 +228,13 @@ protected:
 	/// Get the entity index of the next changed (assumes isAllocated() and entityIndex is valid). Returns LAST_CHANGED if there is no more change.
 	TDataSetRow				getNextChanged( const TDataSetRow& entityIndex ) const { /*nlinfo( "_Array[%d].NextChanged = %d", entityIndex, _Array[entityIndex].NextChanged );*/ return TDataSetRow(_Array[entityIndex.getIndex()].NextChanged); }
 
+#ifdef USE_LOCK_FREE_TRACKERS
+
+	/// Pop the first change when it has no next changed yet (lock-free mode)
+	void					popLastChanged( TDataSetIndex first );
+
+#endif
+
 	/// Shared memory numeric id
 	sint32					_SMId;
 
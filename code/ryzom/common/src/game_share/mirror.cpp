@@ -20,6 +20,8 @@
 #include "mirror.h"
 #include "synchronised_message.h"
 #include "tick_proxy_time_measure.h"
+#include "nel/misc/tds.h"
+#include "nel/misc/mutex.h"
 
 using namespace NLMISC;
 using namespace NLNET;
@@ -1652,6 +1654,9 @@ void CMirror::release()
 	// Execute mirror release command before destroying all the data
 	executeMirrorReleaseCommands();
 
+	// Stop receiving the ticks
+	CTickEventHandler::release();
+
 	// Release the trackers
 	TSDataSets::iterator ids;
 	for ( ids=_SDataSets.begin(); ids!=_SDataSets.end(); ++ids )
@@ -2086,6 +2091,7 @@ void	cbUpdateMirrorAndReceiveMessages( CMessage &msgin, const string&, TServiceI
 void	CMirror::updateMirrorAndReceiveMessages( CMessage& msgin )
 {
 	_IsExecutingSynchronizedCode = true;
+	CTickEventHandler::onUMMReceived();
 
 	// Synchronized release code
 	if ( _ClosureRequested )
@@ -2368,11 +2374,162 @@ void	CMirror::userSyncCallback()
 }
 
 
+/*
+ * Message buffer of each thread (see setThreadMessageBuffer())
+ */
+static CTDS	ThreadMessageBuffer;
+
+
+/*
+ *
+ */
+void	setThreadMessageBuffer( CSynchronisedMessageBuffer *buffer )
+{
+	ThreadMessageBuffer.setPointer( buffer );
+}
+
+
+/*
+ *
+ */
+CSynchronisedMessageBuffer	*getThreadMessageBuffer()
+{
+	return (CSynchronisedMessageBuffer*)ThreadMessageBuffer.getPointer();
+}
+
+
+/*
+ *
+ */
+void	CSynchronisedMessageBuffer::add( TSendMode mode, const std::string& serviceName, NLNET::TServiceId serviceId, const NLNET::CMessage& msgout )
+{
+	_Messages.resize( _Messages.size()+1 );
+	TBufferedMessage& bufferedMsg = _Messages.back();
+	bufferedMsg.Mode = mode;
+	bufferedMsg.ServiceName = serviceName;
+	bufferedMsg.ServiceId = serviceId;
+	bufferedMsg.Msg = msgout;
+}
+
+
+/*
+ *
+ */
+void	CSynchronisedMessageBuffer::flush()
+{
+	// the buffer may be the one of the calling thread
+	CSynchronisedMessageBuffer *threadBuffer = getThreadMessageBuffer();
+	setThreadMessageBuffer( NULL );
+
+	for ( uint i=0; i!=_Messages.size(); ++i )
+	{
+		TBufferedMessage& bufferedMsg = _Messages[i];
+		switch ( bufferedMsg.Mode )
+		{
+		case ViaMirrorByName:
+			sendMessageViaMirror( bufferedMsg.ServiceName, bufferedMsg.Msg );
+			break;
+		case ViaMirrorById:
+			sendMessageViaMirror( bufferedMsg.ServiceId, bufferedMsg.Msg );
+			break;
+		case ViaMirrorToAll:
+			sendMessageViaMirrorToAll( bufferedMsg.Msg );
+			break;
+		case Direct:
+			sendMessageDirect( bufferedMsg.ServiceName, bufferedMsg.Msg );
+			break;
+		case DirectById:
+			sendMessageDirect( bufferedMsg.ServiceId, bufferedMsg.Msg );
+			break;
+		}
+	}
+	_Messages.clear();
+
+	setThreadMessageBuffer( threadBuffer );
+}
+
+
+/*
+ *
+ */
+void	sendMessageDirect( const std::string& destServiceName, CMessage& msgout )
+{
+	CSynchronisedMessageBuffer *buffer = getThreadMessageBuffer();
+	if ( buffer )
+	{
+		buffer->add( CSynchronisedMessageBuffer::Direct, destServiceName, TServiceId::InvalidId, msgout );
+		return;
+	}
+
+	CUnifiedNetwork::getInstance()->send( destServiceName, msgout );
+}
+
+
+/*
+ *
+ */
+void	sendMessageDirect( TServiceId destServiceId, CMessage& msgout )
+{
+	CSynchronisedMessageBuffer *buffer = getThreadMessageBuffer();
+	if ( buffer )
+	{
+		buffer->add( CSynchronisedMessageBuffer::DirectById, std::string(), destServiceId, msgout );
+		return;
+	}
+
+	CUnifiedNetwork::getInstance()->send( destServiceId, msgout );
+}
+
+
+// the transport classes are all written in the static message of CTransportClass
+static NLMISC::CMutex	TransportClassMutex;
+
+/*
+ *
+ */
+void	sendTransportClass( CSynchronisedMessageBuffer::TSendMode mode, CTransportClass& transportClass, const std::string& destServiceName, TServiceId destServiceId )
+{
+	CSynchronisedMessageBuffer *buffer = getThreadMessageBuffer();
+	if ( buffer )
+	{
+		NLMISC::CAutoMutex<NLMISC::CMutex> lock( TransportClassMutex );
+		buffer->add( mode, destServiceName, destServiceId, transportClass.write() );
+		return;
+	}
+
+	switch ( mode )
+	{
+	case CSynchronisedMessageBuffer::ViaMirrorByName:
+		sendMessageViaMirror( destServiceName, transportClass.write() );
+		break;
+	case CSynchronisedMessageBuffer::ViaMirrorById:
+		sendMessageViaMirror( destServiceId, transportClass.write() );
+		break;
+	case CSynchronisedMessageBuffer::ViaMirrorToAll:
+		sendMessageViaMirrorToAll( transportClass.write() );
+		break;
+	case CSynchronisedMessageBuffer::Direct:
+		sendMessageDirect( destServiceName, transportClass.write() );
+		break;
+	case CSynchronisedMessageBuffer::DirectById:
+		sendMessageDirect( destServiceId, transportClass.write() );
+		break;
+	}
+}
+
+
 /*
  *
  */
 void	sendMessageViaMirror( const std::string& destServiceName, CMessage& msgout )
 {
+	CSynchronisedMessageBuffer *buffer = getThreadMessageBuffer();
+	if ( buffer )
+	{
+		buffer->add( CSynchronisedMessageBuffer::ViaMirrorByName, destServiceName, TServiceId::InvalidId, msgout );
+		return;
+	}
+
 	if (MirrorInstance->localMSId()==TServiceId::InvalidId)
 	{
 		nlwarning("Ignoring attempt to send a message via the mirror before mirror ready: %s",msgout.getName().c_str());
@@ -2432,6 +2589,13 @@ void	sendMessageViaMirror( const std::string& destServiceName, CMessage& msgout
  */
 void	sendMessageViaMirror( TServiceId destServiceId, CMessage& msgout )
 {
+	CSynchronisedMessageBuffer *buffer = getThreadMessageBuffer();
+	if ( buffer )
+	{
+		buffer->add( CSynchronisedMessageBuffer::ViaMirrorById, string(), destServiceId, msgout );
+		return;
+	}
+
 	if (MirrorInstance->localMSId()==TServiceId::InvalidId)
 	{
 		nlwarning("Ignoring attempt to send a message via the mirror before mirror ready: %s",msgout.getName().c_str());
@@ -2452,6 +2616,13 @@ void	sendMessageViaMirror( TServiceId destServiceId, CMessage& msgout )
  */
 void	sendMessageViaMirrorToAll( NLNET::CMessage& msgout )
 {
+	CSynchronisedMessageBuffer *buffer = getThreadMessageBuffer();
+	if ( buffer )
+	{
+		buffer->add( CSynchronisedMessageBuffer::ViaMirrorToAll, string(), TServiceId::InvalidId, msgout );
+		return;
+	}
+
 	if (MirrorInstance->localMSId()==TServiceId::InvalidId)
 	{
 		nlwarning("Ignoring attempt to send a message via the mirror before mirror ready: %s",msgout.getName().c_str());
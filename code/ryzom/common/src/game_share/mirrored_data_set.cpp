@@ -47,6 +47,9 @@ CMirroredDataSet *DataSetQuickArray [MAX_NB_DATASETS];
 bool VerboseMultipleChangesOfAProperty = false;
 bool VerboseWarnWhenMirrorReturningUnknownEntityId = false;
 
+/// Area handled by the service, applied as a filter to the properties it reads (see CMirroredDataSet::setPropertyFilter())
+NLMISC::CVariable<string> MirrorFilterArea( "ms", "MirrorFilterArea", "Area handled by the service, in meters ('minX minY maxX maxY'): only the changes of the entities in it are notified and sent to its machine. Empty: whole world", "", 0, true );
+
 
 #define LOG_TRACE(str) \
 nlinfo( "%sTRACE:%u:%s", IService::getInstance()->getServiceShortName().c_str(), CTickEventHandler::getGameCycle(), str );
@@ -119,6 +122,41 @@ void	CMirroredDataSet::declareProperty( const std::string& propName, TPropSubscr
 {
 	_PropAllocator->allocProperty( propName, options, notifyGroupByPropName );
 	// will be ready when _PropAllocator->getPropertySegment( propName ) will not return NULL
+
+	// Filter the property if the service handles only an area
+	if ( (! MirrorFilterArea.get().empty()) && (! (options & PSOWriteOnly)) &&
+		 (getPropertyIndex( "X" ) != INVALID_PROPERTY_INDEX) && (getPropertyIndex( "Y" ) != INVALID_PROPERTY_INDEX) )
+	{
+		sint32 minX, minY, maxX, maxY;
+		if ( sscanf( MirrorFilterArea.get().c_str(), "%d %d %d %d", &minX, &minY, &maxX, &maxY ) == 4 )
+		{
+			CMirrorPropFilter filter;
+			filter.setArea( minX*1000, minY*1000, maxX*1000, maxY*1000 );
+			setPropertyFilter( propName, filter );
+		}
+		else
+		{
+			nlwarning( "MIRROR: Invalid MirrorFilterArea '%s', expected 'minX minY maxX maxY'", MirrorFilterArea.get().c_str() );
+		}
+	}
+}
+
+
+/*
+ * Filter the changes of a property notified to this service
+ */
+void	CMirroredDataSet::setPropertyFilter( const std::string& propName, const CMirrorPropFilter& filter )
+{
+	if ( getPropertyIndex( propName ) == INVALID_PROPERTY_INDEX )
+	{
+		nlwarning( "MIRROR: Cannot set the filter of property %s, not in dataset %s", propName.c_str(), name().c_str() );
+		return;
+	}
+
+	CMessage msgout( "SPF" );
+	msgout.serial( const_cast<std::string&>(propName) );
+	msgout.serial( const_cast<CMirrorPropFilter&>(filter) );
+	CUnifiedNetwork::getInstance()->send( localMSId(), msgout );
 }
 
 
@@ -141,6 +141,29 @@ public:
 										 TPropSubscribingOptions options,
 										 const std::string notifyGroupByPropName="" );
 
+	/**
+	 * Filter the changes of a property previously declared, that are notified to this service.
+	 * Only the changes of the rows accepted by the filter (see CMirrorPropFilter), for instance
+	 * the entities in the area handled by the service, will be notified. The values of the
+	 * other rows changed on the same machine are still updated in the mirror.
+	 * Call it after declareProperty(), a filter accepting all the rows removes the filtering.
+	 *
+	 * The filtering is done by the mirror service when it applies the changes received from
+	 * the other machines. The changes made by the services on the same machine are always
+	 * notified. When the filter has an area, the properties X and Y (sint32) of the dataset
+	 * must be allocated on the machine (i.e. declared by a service on the machine). A change
+	 * of X or Y is notified if the row was or is in the area, so a service that needs to know
+	 * when a row leaves its area must declare X and Y with the same filter.
+	 *
+	 * The MS forwards the filters of its services to the other MS, which then send only the
+	 * changes of the rows accepted by one of the services reading the property on the machine
+	 * (all of them if one service has no filter). Thus the values of the rows rejected are not
+	 * kept up to date on the machine: they are sent again when a row enters the area.
+	 * The config variable MirrorFilterArea sets an area filter on all the properties declared
+	 * by the service (except the write-only ones).
+	 */
+	void				setPropertyFilter( const std::string& propName, const CMirrorPropFilter& filter );
+
 	//--- ENTITY ADDITION ----------------------------------------------------------------------------------
 
 	/**
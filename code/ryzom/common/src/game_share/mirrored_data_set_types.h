@@ -209,6 +209,87 @@ bool operator== ( const TDeclaredEntityRange& r1, const TDeclaredEntityRange& r2
 */
 
 
+/**
+ * Filter of the changes of a property notified to a service (see CMirroredDataSet::setPropertyFilter()).
+ * A row is accepted if it is in one of the row ranges (if there are some) and if its position,
+ * given by the properties X and Y of the dataset, is in the area (if there is one).
+ */
+class CMirrorPropFilter
+{
+public:
+
+	/// Constructor (accepting all the rows)
+	CMirrorPropFilter() : _HasArea(false), _MinX(0), _MinY(0), _MaxX(0), _MaxY(0) {}
+
+	/// Accept the rows from first to last (inclusive)
+	void				addRowRange( TDataSetIndex first, TDataSetIndex last )
+	{
+		_RowRanges.push_back( first );
+		_RowRanges.push_back( last );
+	}
+
+	/// Accept only the rows whose position (in millimeters, bounds inclusive) is in the rectangle
+	void				setArea( sint32 minX, sint32 minY, sint32 maxX, sint32 maxY )
+	{
+		_HasArea = true;
+		_MinX = minX; _MinY = minY;
+		_MaxX = maxX; _MaxY = maxY;
+	}
+
+	/// Accept all the rows
+	void				clear()
+	{
+		_RowRanges.clear();
+		_HasArea = false;
+	}
+
+	/// Return true if the filter accepts all the rows
+	bool				acceptsAll() const { return _RowRanges.empty() && (! _HasArea); }
+
+	/// Return true if the filter has an area
+	bool				hasArea() const { return _HasArea; }
+
+	/// Return true if the row is in one of the ranges, or if there is no range
+	bool				acceptsRow( TDataSetIndex entityIndex ) const
+	{
+		if ( _RowRanges.empty() )
+			return true;
+		for ( uint i=0; i!=_RowRanges.size(); i+=2 )
+		{
+			if ( (entityIndex >= _RowRanges[i]) && (entityIndex <= _RowRanges[i+1]) )
+				return true;
+		}
+		return false;
+	}
+
+	/// Return true if the position is in the area, or if there is no area
+	bool				acceptsPos( sint32 x, sint32 y ) const
+	{
+		return (! _HasArea) || ((x >= _MinX) && (x <= _MaxX) && (y >= _MinY) && (y <= _MaxY));
+	}
+
+	/// Serial
+	void				serial( NLMISC::IStream& s )
+	{
+		s.serialCont( _RowRanges );
+		s.serial( _HasArea );
+		s.serial( _MinX, _MinY );
+		s.serial( _MaxX, _MaxY );
+	}
+
+private:
+
+	/// First and last row of each range
+	std::vector<TDataSetIndex>	_RowRanges;
+
+	/// True if the rows must be in the area
+	bool						_HasArea;
+
+	/// Area
+	sint32						_MinX, _MinY, _MaxX, _MaxY;
+};
+
+
 //typedef std::hash_map< uint8, TEntityRange, std::hash<uint> > TEntityRangeOfType;
 typedef std::map< uint8, TEntityRange > TEntityRangeOfType;
 #define GET_ENTITY_TYPE_RANGE(it) ((*it).second)
@@ -47,13 +47,6 @@ using namespace std;
 CPdrTokenRegistry *CPdrTokenRegistry::_Instance = NULL;
 
 
-//-------------------------------------------------------------------------
-// globals
-//-------------------------------------------------------------------------
-
-CPersistentDataRecord::CArg CPersistentDataRecord::TempArg;
-
-
 //-------------------------------------------------------------------------
 // basics...
 //-------------------------------------------------------------------------
@@ -63,6 +56,7 @@ CPersistentDataRecord::CPersistentDataRecord(const std::string& tokenFamily)
 {
 	// setup the token family
 	_TokenFamily=tokenFamily;
+	_View= NULL;
 
 	// clear write data/ properties
 	clear();
@@ -82,6 +76,7 @@ void CPersistentDataRecord::clear()
 	// clear persistent data buffers
 	_ArgTable.clear();
 	_TokenTable.clear();
+	_View= NULL;
 
 	// setup the string table from the token faimly's string table
 	_StringTable= CPdrTokenRegistry::getInstance()->getStringTable(_TokenFamily);
@@ -107,6 +102,24 @@ uint16 CPersistentDataRecord::addString(const string& name)
 	//Disabled to allow >=256 char strings.
 	//DROP_IF(len>=256,"Attempt to add a string of > 256 characters to the string table",return 0);
 
+	// when reading from a view the string table of the file is searched in place
+	// and the strings that aren't in the file are appended after the ones of the view
+	if (_View!=NULL)
+	{
+		uint32 nbViewStrings= _View->getNbStrings();
+		uint32 result= _View->findString(name.c_str(),len);
+		if (result<nbViewStrings)
+			return (uint16)result;
+		for (uint32 i=nbViewStrings;i<_StringTable.size();++i)
+		{
+			if (_StringTable[i]==name)
+				return (uint16)i;
+		}
+		BOMB_IF(_StringTable.size()>=std::numeric_limits<uint16>::max(),"No more room in string table!!!",return 0);
+		_StringTable.push_back(name);
+		return (uint16)(_StringTable.size()-1);
+	}
+
 	// depending on the string length choose a well suited algorithm for performing a fast search of the string table
 	switch(len)
 	{
@@ -286,6 +299,11 @@ const NLMISC::CSString& CPersistentDataRecord::lookupString(uint32 idx) const
 {
 	// note that the string table size is never less than 1 as entry 0 is pre-set with the 'invalid string' value
 	BOMB_IF(idx>=_StringTable.size(),"Attempting to access past end of string table",return lookupString(0));
+
+	// the strings of a view are only extracted the first time they are looked up
+	if (_View!=NULL && idx<_View->getNbStrings() && _StringTable[idx].empty())
+		_StringTable[idx].assign(_View->getString(idx),_View->getStringLength(idx));
+
 	return _StringTable[idx];
 }
 
@@ -316,6 +334,15 @@ void CPersistentDataRecord::skipData()
 {
 	H_AUTO(CPersistentDataRecordSkipData);
 
+	// a view knows where each struct ends
+	if (_View!=NULL && isStartOfStruct())
+	{
+		uint32 tokenOffset= _TokenOffset;
+		_TokenOffset= _View->getStructEndToken(tokenOffset);
+		_ArgOffset= _View->getStructEndArg(tokenOffset);
+		return;
+	}
+
 	// if this is a structure then skip the whole thing
 	std::vector<uint16> stack;
 	stack.reserve(16);
@@ -456,14 +483,14 @@ NLMISC::CSString CPersistentDataRecord::getInfo() const
 {
 	H_AUTO(CPersistentDataRecordGetInfo);
 	return NLMISC::toString("TotalSize=%u TokenCount=%u DataCount=%u StringCount=%u StringSize=%u ValueCount=%u",
-		totalDataSize(),_TokenTable.size(),_ArgTable.size(),_StringTable.size(),stringDataSize(),getNumValues());
+		totalDataSize(),getNbTokens(),getNbArgs(),_StringTable.size(),stringDataSize(),getNumValues());
 }
 
 NLMISC::CSString CPersistentDataRecord::getInfoAsCSV() const
 {
 	H_AUTO(CPersistentDataRecordGetInfoAsCSV);
 	return NLMISC::toString("%u,%u,%u,%u,%u,%u",
-		totalDataSize(),_TokenTable.size(),_ArgTable.size(),_StringTable.size(),stringDataSize(),getNumValues());
+		totalDataSize(),getNbTokens(),getNbArgs(),_StringTable.size(),stringDataSize(),getNumValues());
 }
 
 const NLMISC::CSString& CPersistentDataRecord::getCSVHeaderLine()
@@ -537,6 +564,9 @@ uint32 CPersistentDataRecord::getNumValues() const
 // return the buffer size required to store this record
 uint32 CPersistentDataRecord::totalDataSize() const
 {
+	if (_View!=NULL)
+		return _View->getSize();
+
 	uint32 result=0;
 	result+= sizeof(uint32);						// sizeof 'version number' variable
 	result+= sizeof(uint32);						// sizeof 'data buffer size' variable
@@ -554,6 +584,9 @@ uint32 CPersistentDataRecord::totalDataSize() const
 // return the buffer size required to store this record
 uint32 CPersistentDataRecord::stringDataSize() const
 {
+	if (_View!=NULL)
+		return _View->getStringsSize();
+
 	uint32 result=0;
 	for (uint32 i=0;i<_StringTable.size();++i)
 		result+=(uint32)_StringTable[i].size()+1;			// the data size for the strings in the string table
@@ -564,6 +597,8 @@ bool CPersistentDataRecord::toStream(NLMISC::IStream& dest)
 {
 	H_AUTO(CPersistentDataRecordWriteToStream);
 
+	DROP_IF(_View!=NULL,"Attempt to write a pdr that is read from a view",return false);
+
 	#define WRITE(type,what) { type v= (type)(what); dest.serial(v); }
 	#define WRITE_BUFF(type,what) dest.serialBuffer( (uint8*)&what[0], sizeof(type) * (uint)what.size() )
 
@@ -607,6 +642,8 @@ bool CPersistentDataRecord::toBuffer(char *dest,uint32 bufferSize)
 {
 	H_AUTO(CPersistentDataRecordWriteToBuffer);
 
+	DROP_IF(_View!=NULL,"Attempt to write a pdr that is read from a view",return false);
+
 	BOMB_IF(bufferSize<totalDataSize(),"Buffer too small to write data to",return false);
 
 	uint32 offset=0;
@@ -1091,6 +1128,27 @@ bool CPersistentDataRecord::fromStream(NLMISC::IStream& stream, uint32 size)
 	return fromString(buff);
 }
 
+bool CPersistentDataRecord::fromView(const CPersistentDataView& view)
+{
+	H_AUTO(CPersistentDataRecordFromView);
+
+	DROP_IF(!view.isOpen(),"Attempt to read a pdr from a view that isn't open",return false);
+
+	// clear the record as clear() does, but without setting up a string table that would be replaced
+	_ArgTable.clear();
+	_TokenTable.clear();
+	_WritingStructStack.clear();
+	_LookupTbls.clear();
+	rewind();
+
+	// the string table gets one empty entry per string of the view, filled by lookupString()
+	_StringTable.clear();
+	_StringTable.resize(view.getNbStrings());
+
+	_View= &view;
+	return true;
+}
+
 // read from a CMemStream (maybe either binary or text data)
 bool CPersistentDataRecord::fromBuffer(NLMISC::IStream& stream)
 {
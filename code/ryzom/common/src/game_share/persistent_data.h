@@ -39,6 +39,7 @@
 #include "nel/misc/sstring.h"
 #include "nel/misc/common.h"
 #include "utils.h"
+#include "persistent_data_view.h"
 
 #include <vector>
 #include <map>
@@ -455,19 +456,34 @@ public:
 	// content - then behave like readFromBinFile() or readFromTxtFile()
 	bool readFromFile(const std::string &fileName);
 
+	// read in place from a view of a binary file: nothing is copied, the strings are only
+	// extracted when they are looked up and skipStruct() jumps directly to the end of the struct
+	// note: the record is read-only until the next clear() and the view must remain open while it is read
+	bool fromView(const CPersistentDataView& view);
+
 
 private:
 
 	bool	fromStream(NLMISC::IStream& stream, uint32 size);
 
+	// read accessors for the token and arg tables, that may be in a view
+	TToken getToken(uint32 idx) const;
+	uint32 getArg(uint32 idx) const;
+	uint32 getNbTokens() const;
+	uint32 getNbArgs() const;
+
 	//-------------------------------------------------------------------------
 	// private persistent data
 	//-------------------------------------------------------------------------
 
-	TStringTable _StringTable;
+	// note: the string table is filled on demand by lookupString() when reading from a view
+	mutable TStringTable _StringTable;
 	std::vector<uint32> _ArgTable;
 	std::vector<TToken> _TokenTable;
 
+	// the view that the data is read from (in place of the tables above) or NULL
+	const CPersistentDataView *_View;
+
 
 	//-------------------------------------------------------------------------
 	// private work data - for writing
@@ -490,11 +506,8 @@ private:
 	typedef std::vector< NLMISC::CSmartPtr<CPDRLookupTbl> > TLookupTbls;
 	TLookupTbls _LookupTbls;
 
-
-	//-------------------------------------------------------------------------
-	// globals
-	//-------------------------------------------------------------------------
-	static CArg TempArg;
+	// the arg returned by peekNextArg() and popNextArg() (one per record so that different records can be read by different threads)
+	mutable CArg TempArg;
 };
 
 
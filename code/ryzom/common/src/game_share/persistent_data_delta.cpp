@@ -0,0 +1,498 @@
+// Ryzom - MMORPG Framework <http://dev.ryzom.com/projects/ryzom/>
+// Copyright (C) 2010  Winch Gate Property Limited
+//
+// This program is free software: you can redistribute it and/or modify
+// it under the terms of the GNU Affero General Public License as
+// published by the Free Software Foundation, either version 3 of the
+// License, or (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU Affero General Public License for more details.
+//
+// You should have received a copy of the GNU Affero General Public License
+// along with this program.  If not, see <http://www.gnu.org/licenses/>.
+
+/*
+
+  NOTE: Format of a delta record (all values are native uint32 or uint64, like in the binary pdr files)
+
+	uint32	magic ('PDRD')
+	uint32	record size, including this header
+	uint32	size of the file the record applies to
+	uint32	size of the resulting file
+	uint64	hash of the file the record applies to
+	uint64	hash of the resulting file
+	then, up to the end of the record, a list of operations:
+	uint32	length | INSERT_FLAG, followed by 'length' bytes to insert
+	uint32	length, uint32 offset: copy 'length' bytes of the previous file from 'offset'
+
+  The operations produce the new file in order: header, tokens, args, then string table.
+
+*/
+
+//-----------------------------------------------------------------------------
+// Includes
+//-----------------------------------------------------------------------------
+
+#include "stdpch.h"
+#include "persistent_data_delta.h"
+
+#include <algorithm>
+
+
+//-----------------------------------------------------------------------------
+// namespaces
+//-----------------------------------------------------------------------------
+
+using namespace NLMISC;
+using namespace std;
+
+
+//-----------------------------------------------------------------------------
+// local constants, types and routines
+//-----------------------------------------------------------------------------
+
+namespace
+{
+	const uint32 DELTA_MAGIC= 0x44524450;			// 'PDRD'
+	const uint32 DELTA_HEADER_SIZE= 4*sizeof(uint32)+2*sizeof(uint64);
+	const uint32 INSERT_FLAG= 0x80000000;
+
+	const uint32 PDR_HEADER_SIZE= 6*sizeof(uint32);
+
+	// token types of CPersistentDataRecord (3 low bits of the tokens) that don't have an arg
+	const uint32 BEGIN_TOKEN= 0;
+	const uint32 END_TOKEN= 1;
+	const uint32 FLAG_TOKEN= 6;
+
+	typedef uint16 TToken;
+
+	// FNV-1a
+	const uint64 HASH_SEED= UINT64_CONSTANT(0xcbf29ce484222325);
+
+	inline uint64 hashBytes(const uint8 *data, uint32 size, uint64 hash)
+	{
+		for (uint32 i=0;i<size;++i)
+		{
+			hash^= data[i];
+			hash*= UINT64_CONSTANT(0x100000001b3);
+		}
+		return hash;
+	}
+
+	template <class T> inline T readValue(const uint8 *data)
+	{
+		T value;
+		memcpy(&value,data,sizeof(T));
+		return value;
+	}
+
+	template <class T> inline void appendValue(std::vector<uint8>& dest, T value)
+	{
+		uint32 offset= (uint32)dest.size();
+		dest.resize(offset+sizeof(T));
+		memcpy(&dest[offset],&value,sizeof(T));
+	}
+
+	// position of the tables in a binary pdr buffer
+	struct CLayout
+	{
+		uint32 NbTokens;
+		uint32 NbArgs;
+		uint32 NbStrings;
+		uint32 TokenOffset;
+		uint32 ArgOffset;
+		uint32 StringOffset;
+
+		// read the header, with the same checks as CPersistentDataRecord::fromBuffer()
+		bool read(const uint8 *buffer, uint32 size)
+		{
+			if (size<PDR_HEADER_SIZE)
+				return false;
+			uint32 version=		readValue<uint32>(buffer);
+			uint32 totalSize=	readValue<uint32>(buffer+4);
+			NbTokens=			readValue<uint32>(buffer+8);
+			NbArgs=				readValue<uint32>(buffer+12);
+			NbStrings=			readValue<uint32>(buffer+16);
+			uint32 stringsSize=	readValue<uint32>(buffer+20);
+			if (version!=0 || totalSize!=size)
+				return false;
+			TokenOffset= PDR_HEADER_SIZE;
+			ArgOffset= TokenOffset+NbTokens*sizeof(TToken);
+			StringOffset= ArgOffset+NbArgs*sizeof(uint32);
+			return (uint64)PDR_HEADER_SIZE+(uint64)NbTokens*sizeof(TToken)+(uint64)NbArgs*sizeof(uint32)+stringsSize==size;
+		}
+	};
+}
+
+
+//-----------------------------------------------------------------------------
+// methods CPDRDeltaReference
+//-----------------------------------------------------------------------------
+
+CPDRDeltaReference::CPDRDeltaReference()
+{
+	clear();
+}
+
+void CPDRDeltaReference::clear()
+{
+	_Blocks.clear();
+	_Strings.clear();
+	_StringOffset= 0;
+	_Size= 0;
+	_Hash= 0;
+}
+
+bool CPDRDeltaReference::build(const uint8 *buffer, uint32 size)
+{
+	H_AUTO(CPDRDeltaReferenceBuild);
+
+	clear();
+
+	CLayout layout;
+	if (!layout.read(buffer,size) || !listBlocks(buffer,layout.TokenOffset,layout.NbTokens,layout.ArgOffset,layout.NbArgs,_Blocks))
+	{
+		clear();
+		return false;
+	}
+	std::sort(_Blocks.begin(),_Blocks.end());
+
+	// hash the strings one by one, so that a common prefix of the string tables can be copied
+	_Strings.reserve(layout.NbStrings);
+	uint32 start= layout.StringOffset;
+	for (uint32 i=start;i<size;++i)
+	{
+		if (buffer[i]!=0)
+			continue;
+		CStringEntry entry;
+		entry.Hash= (uint32)hashBytes(buffer+start,i+1-start,HASH_SEED);
+		entry.End= i+1;
+		_Strings.push_back(entry);
+		start= i+1;
+	}
+	if (_Strings.size()!=layout.NbStrings || start!=size)
+	{
+		clear();
+		return false;
+	}
+
+	_StringOffset= layout.StringOffset;
+	_Size= size;
+	_Hash= CPDRDelta::hash(buffer,size);
+	return true;
+}
+
+uint32 CPDRDeltaReference::getMemoryUsage() const
+{
+	return (uint32)(sizeof(*this)+_Blocks.capacity()*sizeof(CBlock)+_Strings.capacity()*sizeof(CStringEntry));
+}
+
+const CPDRDeltaReference::CBlock* CPDRDeltaReference::findBlock(const CBlock& block) const
+{
+	std::vector<CBlock>::const_iterator it= std::lower_bound(_Blocks.begin(),_Blocks.end(),block);
+	for (;it!=_Blocks.end() && (*it).Hash==block.Hash;++it)
+	{
+		if ((*it).TokenCount==block.TokenCount && (*it).ArgCount==block.ArgCount)
+			return &*it;
+	}
+	return NULL;
+}
+
+bool CPDRDeltaReference::listBlocks(const uint8 *buffer, uint32 tokenOffset, uint32 nbTokens, uint32 argOffset, uint32 nbArgs, std::vector<CBlock>& blocks)
+{
+	// begin token index and arg index of the structs being read
+	std::vector<std::pair<uint32,uint32> > stack;
+	uint32 arg= 0;
+
+	for (uint32 t=0;t<nbTokens;++t)
+	{
+		uint32 tokenType= readValue<TToken>(buffer+tokenOffset+t*sizeof(TToken)) & 7;
+		switch (tokenType)
+		{
+		case BEGIN_TOKEN:
+			stack.push_back(std::make_pair(t,arg));
+			break;
+
+		case END_TOKEN:
+			{
+				if (stack.empty())
+					return false;
+				CBlock block;
+				block.TokenOffset= tokenOffset+stack.back().first*sizeof(TToken);
+				block.TokenCount= t+1-stack.back().first;
+				block.ArgOffset= argOffset+stack.back().second*sizeof(uint32);
+				block.ArgCount= arg-stack.back().second;
+				stack.pop_back();
+				uint32 tokenSize= block.TokenCount*sizeof(TToken);
+				uint32 argSize= block.ArgCount*sizeof(uint32);
+				if (tokenSize+argSize>=CPDRDelta::MIN_BLOCK_SIZE)
+				{
+					block.Hash= hashBytes(buffer+block.TokenOffset,tokenSize,HASH_SEED);
+					block.Hash= hashBytes(buffer+block.ArgOffset,argSize,block.Hash);
+					blocks.push_back(block);
+				}
+			}
+			break;
+
+		case FLAG_TOKEN:
+			break;
+
+		default:
+			if (arg==nbArgs)
+				return false;
+			++arg;
+		}
+	}
+
+	return stack.empty() && arg==nbArgs;
+}
+
+
+//-----------------------------------------------------------------------------
+// methods CPDRDelta
+//-----------------------------------------------------------------------------
+
+namespace
+{
+	// list of operations of a delta, merging the contiguous ones
+	class COpList
+	{
+	public:
+		struct COp
+		{
+			bool	Insert;
+			uint32	Offset;		// in the previous file for a copy, in the new file for an insertion
+			uint32	Length;
+		};
+
+		void copy(uint32 offset, uint32 length)		{ add(false,offset,length); }
+		void insert(uint32 offset, uint32 length)	{ add(true,offset,length); }
+
+		// append the operations to a delta record
+		void write(const uint8 *buffer, std::vector<uint8>& delta) const
+		{
+			for (uint32 i=0;i<_Ops.size();++i)
+			{
+				const COp& op= _Ops[i];
+				if (op.Insert)
+				{
+					appendValue<uint32>(delta,op.Length|INSERT_FLAG);
+					delta.insert(delta.end(),buffer+op.Offset,buffer+op.Offset+op.Length);
+				}
+				else
+				{
+					appendValue<uint32>(delta,op.Length);
+					appendValue<uint32>(delta,op.Offset);
+				}
+			}
+		}
+
+	private:
+		void add(bool insert, uint32 offset, uint32 length)
+		{
+			if (length==0)
+				return;
+			if (!_Ops.empty())
+			{
+				COp& last= _Ops.back();
+				if (last.Insert==insert && last.Offset+last.Length==offset)
+				{
+					last.Length+= length;
+					return;
+				}
+			}
+			COp op;
+			op.Insert= insert;
+			op.Offset= offset;
+			op.Length= length;
+			_Ops.push_back(op);
+		}
+
+		std::vector<COp> _Ops;
+	};
+
+	// sort the blocks by position in the file
+	struct CBlockOffsetPred
+	{
+		template <class T> bool operator () (const T& a, const T& b) const	{ return a.TokenOffset<b.TokenOffset; }
+	};
+}
+
+bool CPDRDelta::encode(const CPDRDeltaReference& reference, const uint8 *buffer, uint32 size, std::vector<uint8>& delta)
+{
+	H_AUTO(CPDRDeltaEncode);
+
+	CLayout layout;
+	std::vector<CPDRDeltaReference::CBlock> blocks;
+	if (!layout.read(buffer,size) || !CPDRDeltaReference::listBlocks(buffer,layout.TokenOffset,layout.NbTokens,layout.ArgOffset,layout.NbArgs,blocks))
+		return false;
+	std::sort(blocks.begin(),blocks.end(),CBlockOffsetPred());
+
+	// the token and arg tables are built in parallel, then written one after the other
+	COpList tokenOps, argOps;
+	uint32 arg= 0;
+	uint32 nextBlock= 0;
+	for (uint32 t=0;t<layout.NbTokens;)
+	{
+		uint32 tokenOffset= layout.TokenOffset+t*sizeof(TToken);
+
+		// skip the blocks nested in a copied block
+		while (nextBlock<blocks.size() && blocks[nextBlock].TokenOffset<tokenOffset)
+			++nextBlock;
+
+		// copy the whole struct if it is unchanged
+		if (nextBlock<blocks.size() && blocks[nextBlock].TokenOffset==tokenOffset)
+		{
+			const CPDRDeltaReference::CBlock& block= blocks[nextBlock];
+			const CPDRDeltaReference::CBlock *previous= reference.findBlock(block);
+			if (previous!=NULL)
+			{
+				tokenOps.copy(previous->TokenOffset,previous->TokenCount*sizeof(TToken));
+				argOps.copy(previous->ArgOffset,previous->ArgCount*sizeof(uint32));
+				t+= block.TokenCount;
+				arg+= block.ArgCount;
+				continue;
+			}
+		}
+
+		// insert the token, and its arg if it has one
+		tokenOps.insert(tokenOffset,sizeof(TToken));
+		uint32 tokenType= readValue<TToken>(buffer+tokenOffset) & 7;
+		if (tokenType!=BEGIN_TOKEN && tokenType!=END_TOKEN && tokenType!=FLAG_TOKEN)
+		{
+			argOps.insert(layout.ArgOffset+arg*sizeof(uint32),sizeof(uint32));
+			++arg;
+		}
+		++t;
+	}
+
+	// copy the strings the two string tables start with, insert the others
+	COpList stringOps;
+	uint32 start= layout.StringOffset;
+	uint32 nbCommonStrings= 0;
+	for (uint32 i=start;i<size && nbCommonStrings<reference._Strings.size();++i)
+	{
+		if (buffer[i]!=0)
+			continue;
+		const CPDRDeltaReference::CStringEntry& previous= reference._Strings[nbCommonStrings];
+		uint32 previousStart= (nbCommonStrings==0)? reference._StringOffset: reference._Strings[nbCommonStrings-1].End;
+		if (previous.End-previousStart!=i+1-start || previous.Hash!=(uint32)hashBytes(buffer+start,i+1-start,HASH_SEED))
+			break;
+		++nbCommonStrings;
+		start= i+1;
+	}
+	if (nbCommonStrings!=0)
+		stringOps.copy(reference._StringOffset,reference._Strings[nbCommonStrings-1].End-reference._StringOffset);
+	stringOps.insert(start,size-start);
+
+	// write the record
+	uint32 recordStart= (uint32)delta.size();
+	appendValue<uint32>(delta,DELTA_MAGIC);
+	appendValue<uint32>(delta,0);
+	appendValue<uint32>(delta,reference.getSize());
+	appendValue<uint32>(delta,size);
+	appendValue<uint64>(delta,reference.getHash());
+	appendValue<uint64>(delta,hash(buffer,size));
+
+	COpList headerOps;
+	headerOps.insert(0,PDR_HEADER_SIZE);
+	headerOps.write(buffer,delta);
+	tokenOps.write(buffer,delta);
+	argOps.write(buffer,delta);
+	stringOps.write(buffer,delta);
+
+	uint32 recordSize= (uint32)delta.size()-recordStart;
+	memcpy(&delta[recordStart+sizeof(uint32)],&recordSize,sizeof(uint32));
+	return true;
+}
+
+bool CPDRDelta::apply(const std::vector<uint8>& base, const uint8 *journal, uint32 journalSize, uint32& offset, std::vector<uint8>& result, std::string& error)
+{
+	H_AUTO(CPDRDeltaApply);
+
+	if (offset>journalSize || journalSize-offset<DELTA_HEADER_SIZE)
+	{
+		error= NLMISC::toString("truncated delta record at offset %u", offset);
+		return false;
+	}
+	const uint8 *record= journal+offset;
+	uint32 magic=		readValue<uint32>(record);
+	uint32 recordSize=	readValue<uint32>(record+4);
+	uint32 baseSize=	readValue<uint32>(record+8);
+	uint32 resultSize=	readValue<uint32>(record+12);
+	uint64 baseHash=	readValue<uint64>(record+16);
+	uint64 resultHash=	readValue<uint64>(record+24);
+	if (magic!=DELTA_MAGIC || recordSize<DELTA_HEADER_SIZE || recordSize>journalSize-offset)
+	{
+		error= NLMISC::toString("invalid delta record at offset %u", offset);
+		return false;
+	}
+	if (baseSize!=base.size() || baseHash!=hash(base.empty()? NULL: &base[0],(uint32)base.size()))
+	{
+		error= NLMISC::toString("the delta record at offset %u doesn't apply to this version of the file (%u bytes expected, %u found)", offset, baseSize, (uint32)base.size());
+		return false;
+	}
+
+	result.clear();
+	result.reserve(resultSize);
+	uint32 pos= DELTA_HEADER_SIZE;
+	while (pos<recordSize)
+	{
+		if (recordSize-pos<sizeof(uint32))
+			break;
+		uint32 code= readValue<uint32>(record+pos);
+		uint32 length= code & ~INSERT_FLAG;
+		pos+= sizeof(uint32);
+		if (code & INSERT_FLAG)
+		{
+			if (length>recordSize-pos)
+				break;
+			result.insert(result.end(),record+pos,record+pos+length);
+			pos+= length;
+		}
+		else
+		{
+			if (recordSize-pos<sizeof(uint32))
+				break;
+			uint32 from= readValue<uint32>(record+pos);
+			pos+= sizeof(uint32);
+			if (from>base.size() || length>base.size()-from)
+				break;
+			result.insert(result.end(),base.begin()+from,base.begin()+from+length);
+		}
+	}
+
+	if (pos!=recordSize || result.size()!=resultSize || hash(result.empty()? NULL: &result[0],(uint32)result.size())!=resultHash)
+	{
+		error= NLMISC::toString("corrupted delta record at offset %u", offset);
+		return false;
+	}
+
+	offset+= recordSize;
+	return true;
+}
+
+uint32 CPDRDelta::applyJournal(std::vector<uint8>& file, const uint8 *journal, uint32 journalSize, std::string& error)
+{
+	error.clear();
+
+	uint32 nbApplied= 0;
+	uint32 offset= 0;
+	std::vector<uint8> result;
+	while (offset<journalSize)
+	{
+		if (!apply(file,journal,journalSize,offset,result,error))
+			break;
+		file.swap(result);
+		++nbApplied;
+	}
+	return nbApplied;
+}
+
+uint64 CPDRDelta::hash(const uint8 *buffer, uint32 size)
+{
+	return hashBytes(buffer,size,HASH_SEED);
+}
@@ -0,0 +1,141 @@
+// Ryzom - MMORPG Framework <http://dev.ryzom.com/projects/ryzom/>
+// Copyright (C) 2010  Winch Gate Property Limited
+//
+// This program is free software: you can redistribute it and/or modify
+// it under the terms of the GNU Affero General Public License as
+// published by the Free Software Foundation, either version 3 of the
+// License, or (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU Affero General Public License for more details.
+//
+// You should have received a copy of the GNU Affero General Public License
+// along with this program.  If not, see <http://www.gnu.org/licenses/>.
+
+/**
+  *  This file contains the delta encoding of the binary 'persistent data record' files
+  *  (the format written by CPersistentDataRecord::toBuffer())
+  *
+  *  A delta record rebuilds the new version of a file from the previous one with a list of
+  *  operations: copy a range of the previous file or insert new bytes.
+  *
+  *  The encoder does not need the previous file, only a summary of it (CPDRDeltaReference):
+  *  the hash and position of the struct blocks of its token stream and the hash of the strings
+  *  of its string table. A struct of the new file that is found in the reference is copied,
+  *  otherwise its begin token is inserted and its contents are looked up in turn, so a change
+  *  deep in a big struct only costs the tokens of the structs that contain it.
+  *
+  *  Applying a delta does not require any knowledge of the pdr format. Each record holds the
+  *  size and hash of the file it applies to and of the file it produces, so that a record
+  *  applied to the wrong version of the file is detected instead of producing garbage.
+  *
+  **/
+
+#ifndef PERSISTENT_DATA_DELTA_H
+#define	PERSISTENT_DATA_DELTA_H
+
+//-----------------------------------------------------------------------------
+// Includes
+//-----------------------------------------------------------------------------
+
+#include "nel/misc/types_nl.h"
+
+#include <string>
+#include <vector>
+
+
+//-----------------------------------------------------------------------------
+// class CPDRDeltaReference
+//-----------------------------------------------------------------------------
+
+class CPDRDeltaReference
+{
+public:
+	// ctor
+	CPDRDeltaReference();
+
+	// forget the previous file
+	void clear();
+
+	// summarize a binary pdr buffer
+	// returns false (and clears the reference) if the buffer isn't a valid binary pdr
+	bool build(const uint8 *buffer, uint32 size);
+
+	// accessors
+	bool empty() const			{ return _Size==0; }
+	uint32 getSize() const		{ return _Size; }
+	uint64 getHash() const		{ return _Hash; }
+
+	// approximate memory used by the reference
+	uint32 getMemoryUsage() const;
+
+private:
+	friend class CPDRDelta;
+
+	struct CBlock
+	{
+		uint64	Hash;
+		uint32	TokenOffset;	// offset of the first token in the file
+		uint32	TokenCount;
+		uint32	ArgOffset;		// offset of the first arg in the file
+		uint32	ArgCount;
+
+		bool operator < (const CBlock& other) const	{ return Hash<other.Hash; }
+	};
+
+	struct CStringEntry
+	{
+		uint32	Hash;
+		uint32	End;			// offset in the file of the end of the string (after the terminal 0)
+	};
+
+	// find a block with the same contents as the given one, or NULL
+	const CBlock* findBlock(const CBlock& block) const;
+
+	// list the struct blocks of at least CPDRDelta::MIN_BLOCK_SIZE bytes of a token stream, in the order of their end
+	// returns false if the structs aren't balanced or the args don't match the tokens
+	static bool listBlocks(const uint8 *buffer, uint32 tokenOffset, uint32 nbTokens, uint32 argOffset, uint32 nbArgs, std::vector<CBlock>& blocks);
+
+	std::vector<CBlock>			_Blocks;		// sorted by hash
+	std::vector<CStringEntry>	_Strings;
+	uint32						_StringOffset;	// offset of the string table in the file
+	uint32						_Size;
+	uint64						_Hash;
+};
+
+
+//-----------------------------------------------------------------------------
+// class CPDRDelta
+//-----------------------------------------------------------------------------
+
+class CPDRDelta
+{
+public:
+	// struct blocks smaller than this (in bytes of tokens and args) are not referenced,
+	// they are inserted along with their parent
+	enum { MIN_BLOCK_SIZE= 64 };
+
+	// append to 'delta' the record that rebuilds 'buffer' from the file summarized by 'reference'
+	// returns false if the buffer isn't a valid binary pdr
+	static bool encode(const CPDRDeltaReference& reference, const uint8 *buffer, uint32 size, std::vector<uint8>& delta);
+
+	// apply the record read at journal[offset] to 'base', offset is moved past the record
+	// returns false (with the reason in 'error') if the record is corrupted or doesn't apply to 'base'
+	static bool apply(const std::vector<uint8>& base, const uint8 *journal, uint32 journalSize, uint32& offset, std::vector<uint8>& result, std::string& error);
+
+	// apply the records of a journal one after the other to 'file', stopping at the first one that fails
+	// returns the number of records applied, 'error' is empty if they all were
+	static uint32 applyJournal(std::vector<uint8>& file, const uint8 *journal, uint32 journalSize, std::string& error);
+
+	// hash of a file as recorded in the delta records
+	static uint64 hash(const uint8 *buffer, uint32 size);
+
+	// name of the file holding the journal of the deltas of a file
+	static std::string getJournalFileName(const std::string& fileName)	{ return fileName+".delta"; }
+};
+
+
+//-----------------------------------------------------------------------------
+#endif
@@ -21,7 +21,12 @@
 inline void CPersistentDataRecord::addString(const std::string& name,uint16 &result)
 {
 	// check whether the value of 'result' is already correct
-	if (result<_StringTable.size())
+	if (_View!=NULL)
+	{
+		if (result<_View->getNbStrings() && _View->isString(result,name.c_str(),(uint32)name.size()))
+			return;
+	}
+	else if (result<_StringTable.size())
 		if (_StringTable[result]==name)
 			return;
 
@@ -32,7 +37,12 @@ inline void CPersistentDataRecord::addString(const std::string& name,uint16 &res
 inline void CPersistentDataRecord::addString(const char* name,uint16 &result)
 {
 	// check whether the value of 'result' is already correct
-	if (result<_StringTable.size())
+	if (_View!=NULL)
+	{
+		if (result<_View->getNbStrings() && _View->isString(result,name,(uint32)strlen(name)))
+			return;
+	}
+	else if (result<_StringTable.size())
 		if (strcmp(_StringTable[result].c_str(),name)==0)
 			return;
 
@@ -274,11 +284,32 @@ inline void CPersistentDataRecord::pushStructEnd(TToken token)
 // set of accessors for retrieving data from a CPersistentDataRecord
 //-------------------------------------------------------------------------
 
+inline CPersistentDataRecord::TToken CPersistentDataRecord::getToken(uint32 idx) const
+{
+	return (_View==NULL)? _TokenTable[idx]: _View->getToken(idx);
+}
+
+inline uint32 CPersistentDataRecord::getArg(uint32 idx) const
+{
+	return (_View==NULL)? _ArgTable[idx]: _View->getArg(idx);
+}
+
+inline uint32 CPersistentDataRecord::getNbTokens() const
+{
+	return (_View==NULL)? (uint32)_TokenTable.size(): _View->getNbTokens();
+}
+
+inline uint32 CPersistentDataRecord::getNbArgs() const
+{
+	return (_View==NULL)? (uint32)_ArgTable.size(): _View->getNbArgs();
+}
+
 inline bool CPersistentDataRecord::isEndOfData() const
 {
-	DROP_IF( (_TokenOffset==_TokenTable.size()) && !(_ArgOffset==_ArgTable.size()),"Argument table and token table sizes don't match", return true);
-	DROP_IF( _TokenOffset>_TokenTable.size(),"Attempt to access beyond end of data...", return true);
-	return _TokenOffset==_TokenTable.size();
+	uint32 nbTokens= getNbTokens();
+	DROP_IF( (_TokenOffset==nbTokens) && !(_ArgOffset==getNbArgs()),"Argument table and token table sizes don't match", return true);
+	DROP_IF( _TokenOffset>nbTokens,"Attempt to access beyond end of data...", return true);
+	return _TokenOffset==nbTokens;
 }
 
 inline bool CPersistentDataRecord::isEndOfStruct() const
@@ -309,25 +340,25 @@ inline CPersistentDataRecord::TToken CPersistentDataRecord::peekNextToken() cons
 {
 	DROP_IF(isEndOfData(),"Attempt to read past end of input data",return 0);
 	// the 3 low bits contain arg type information - uninteresting here
-	return _TokenTable[_TokenOffset]>>3;
+	return getToken(_TokenOffset)>>3;
 }
 
 inline const NLMISC::CSString& CPersistentDataRecord::peekNextTokenName() const
 {
 	TToken t= peekNextToken();
-	return _StringTable[t];
+	return (_View==NULL)? _StringTable[t]: lookupString(t);
 }
 
 inline CPersistentDataRecord::CArg::TType CPersistentDataRecord::peekNextTokenType() const
 {
 	DROP_IF(isEndOfData(),"Attempt to read past end of input data",return CArg::TType(0));
-	uint32 tokenType= _TokenTable[_TokenOffset]&7;
+	uint32 tokenType= getToken(_TokenOffset)&7;
 	if (tokenType==CArg::EXTEND_TOKEN)
 	{
-		DROP_IF(_TokenOffset+1>=_TokenTable.size(),"Attempt to read past end of input data",return CArg::TType(0));
-		return CArg::token2Type(_TokenTable[_TokenOffset+1]&7,true);
+		DROP_IF(_TokenOffset+1>=getNbTokens(),"Attempt to read past end of input data",return CArg::TType(0));
+		return CArg::token2Type(getToken(_TokenOffset+1)&7,true);
 	}
-	return CArg::token2Type(_TokenTable[_TokenOffset]&7,false);
+	return CArg::token2Type(tokenType,false);
 }
 
 inline const CPersistentDataRecord::CArg& CPersistentDataRecord::peekNextArg() const
@@ -341,10 +372,10 @@ inline void CPersistentDataRecord::peekNextArg(CPersistentDataRecord::CArg& resu
 	result.setType(peekNextTokenType());
 	if (result.isExtended())
 	{
-		BOMB_IF(_ArgOffset+1>=_ArgTable.size(),"Attempt to overrun end of input data",return);
-		DROP_IF((_TokenTable[_TokenOffset+0]&~7)!=(_TokenTable[_TokenOffset+1]&~7),"2 dwords of 64 bit have non-matching identifiers",return);
-		result._Value.i32_1 = _ArgTable[_ArgOffset+0];
-		result._Value.i32_2 = _ArgTable[_ArgOffset+1];
+		BOMB_IF(_ArgOffset+1>=getNbArgs(),"Attempt to overrun end of input data",return);
+		DROP_IF((getToken(_TokenOffset+0)&~7)!=(getToken(_TokenOffset+1)&~7),"2 dwords of 64 bit have non-matching identifiers",return);
+		result._Value.i32_1 = getArg(_ArgOffset+0);
+		result._Value.i32_2 = getArg(_ArgOffset+1);
 		nlassert(result._Value.ExType == result._Value.i32_1);
 		nlassert(result._Value.i32_2 == result._Value.ex32_1);
 		nlassert(result._Value.ExData32 == result._Value.ex32_1);
@@ -352,16 +383,16 @@ inline void CPersistentDataRecord::peekNextArg(CPersistentDataRecord::CArg& resu
 		if (result._Type == CArg::EXTEND_TYPE && result._Value.ExType >= CArg::ET_64_BIT_EXTENDED_TYPES)
 		{
 			// this is a 96 bit extended type, read one more value
-			BOMB_IF(_ArgOffset+2>=_ArgTable.size(),"Attempt to overrun end of input data",return);
-			BOMB_IF((_TokenTable[_TokenOffset+0]&~7)!=(_TokenTable[_TokenOffset+2]&~7),"3 dwords of 96 bit have non-matching identifiers",return);
-			result._Value.ex32_2 = _ArgTable[_ArgOffset+2];
+			BOMB_IF(_ArgOffset+2>=getNbArgs(),"Attempt to overrun end of input data",return);
+			BOMB_IF((getToken(_TokenOffset+0)&~7)!=(getToken(_TokenOffset+2)&~7),"3 dwords of 96 bit have non-matching identifiers",return);
+			result._Value.ex32_2 = getArg(_ArgOffset+2);
 
 			nlassert((uint64(result._Value.ex32_2)<<32|result._Value.ex32_1) == result._Value.ExData64);
 		}
 	}
 	else if (!result.isFlag())
 	{
-		result._Value.i32_1 = _ArgTable[_ArgOffset];
+		result._Value.i32_1 = getArg(_ArgOffset);
 	}
 	if (result._Type==CArg::STRING)
 	{
@@ -120,6 +120,7 @@
 */
 
 #include <limits>
+#include "nel/misc/atomic.h"
 
 #ifndef PERSISTENT_CLASS
 #error PERSISTENT_CLASS not defined
@@ -473,19 +474,24 @@ void PERSISTENT_CLASS::apply(CPersistentDataRecord &pdr _PERSISTENT_APPLY_ARGS)
 	#endif
 
 	// define the set of tokens - this makes sure that the tokens exist in the map and that we only look them up the once
-	static uint16 __Tok__MapKey = std::numeric_limits<uint16>::max(); pdr.addString("__Key__",__Tok__MapKey);
-	static uint16 __Tok__MapVal = std::numeric_limits<uint16>::max(); pdr.addString("__Val__",__Tok__MapVal);
-	#define _PROP(token,name,type,logic,get,set)							static uint16 token = std::numeric_limits<uint16>::max(); pdr.addString(name,token);
-	#define _STRUCT(token,name,logic,write,read)							static uint16 token = std::numeric_limits<uint16>::max(); pdr.addString(name,token);
-	#define _PROP_MAP(token,name,keyType,valType,logic,getKey,getVal,set)	static uint16 token = std::numeric_limits<uint16>::max(); pdr.addString(name,token);
-	#define _STRUCT_MAP(token,name,keyType,logic,getKey,valWrite,read)		static uint16 token = std::numeric_limits<uint16>::max(); pdr.addString(name,token);
-	#define _FLAG(token,name,logic,code)									static uint16 token = std::numeric_limits<uint16>::max(); pdr.addString(name,token);
+	// the static value is only a hint for addString(): the token is a local, as different records (possibly applied by
+	// different threads at the same time) have different string tables. The hint is shared by these threads, so it is
+	// accessed atomically (relaxed: any value is a valid hint)
+	#define _APPLY_TOKEN(token,name)	static volatile uint16 token##_Hint = std::numeric_limits<uint16>::max(); uint16 token = NLMISC::atomicLoadRelaxed(&token##_Hint); pdr.addString(name,token); NLMISC::atomicStoreRelaxed(&token##_Hint, token);
+	_APPLY_TOKEN(__Tok__MapKey,"__Key__")
+	_APPLY_TOKEN(__Tok__MapVal,"__Val__")
+	#define _PROP(token,name,type,logic,get,set)							_APPLY_TOKEN(token,name)
+	#define _STRUCT(token,name,logic,write,read)							_APPLY_TOKEN(token,name)
+	#define _PROP_MAP(token,name,keyType,valType,logic,getKey,getVal,set)	_APPLY_TOKEN(token,name)
+	#define _STRUCT_MAP(token,name,keyType,logic,getKey,valWrite,read)		_APPLY_TOKEN(token,name)
+	#define _FLAG(token,name,logic,code)									_APPLY_TOKEN(token,name)
 	PERSISTENT_DATA
 	#undef _PROP
 	#undef _STRUCT
 	#undef _PROP_MAP
 	#undef _STRUCT_MAP
 	#undef _FLAG
+	#undef _APPLY_TOKEN
 
 
 	// Add user-defined code at the start of the method
@@ -526,29 +532,9 @@ void PERSISTENT_CLASS::apply(CPersistentDataRecord &pdr _PERSISTENT_APPLY_ARGS)
 		PERSISTENT_DATA
 //		nlwarning("Skipping unrecognised token: %s",pdr.peekNextTokenName().c_str());
 
-		// if this is a structure then skip the whole thing
-		std::vector<uint16> stack;
-		do
-		{
-			H_AUTO(SkipUnknownStuff);
-
-			if (pdr.isStartOfStruct())
-			{
-				stack.push_back(pdr.peekNextToken());
-				pdr.popStructBegin(stack.back());
-			}
-			else if (pdr.isEndOfStruct())
-			{
-				pdr.popStructEnd(stack.back());
-				if (!stack.empty())
-					stack.pop_back();
-			}
-			else
-			{
-				pdr.popNextArg(pdr.peekNextToken());
-			}
-		}
-		while (!stack.empty() && !pdr.isEndOfData());
+		// skip the unrecognised token - if this is a structure then skip the whole thing
+		// (when reading from a view this jumps directly to the end of the structure)
+		pdr.skipData();
 	}
 
 	#undef _PROP
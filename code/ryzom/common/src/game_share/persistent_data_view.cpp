@@ -0,0 +1,230 @@
+// Ryzom - MMORPG Framework <http://dev.ryzom.com/projects/ryzom/>
+// Copyright (C) 2010  Winch Gate Property Limited
+//
+// This program is free software: you can redistribute it and/or modify
+// it under the terms of the GNU Affero General Public License as
+// published by the Free Software Foundation, either version 3 of the
+// License, or (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU Affero General Public License for more details.
+//
+// You should have received a copy of the GNU Affero General Public License
+// along with this program.  If not, see <http://www.gnu.org/licenses/>.
+
+//-----------------------------------------------------------------------------
+// Includes
+//-----------------------------------------------------------------------------
+
+#include "stdpch.h"
+#include "persistent_data_view.h"
+
+#include "nel/misc/file.h"
+
+
+//-----------------------------------------------------------------------------
+// namespaces
+//-----------------------------------------------------------------------------
+
+using namespace NLMISC;
+using namespace std;
+
+
+//-----------------------------------------------------------------------------
+// constants
+//-----------------------------------------------------------------------------
+
+// size of the header of a binary pdr (6 uint32: version, total size, token count, arg count, string count, strings size)
+static const uint32 HeaderSize= 6*sizeof(uint32);
+
+// token types (the 3 low bits of a token) with no arg
+static const uint32 BeginToken= 0;
+static const uint32 EndToken= 1;
+static const uint32 FlagToken= 6;
+
+
+//-----------------------------------------------------------------------------
+// methods CPersistentDataView
+//-----------------------------------------------------------------------------
+
+CPersistentDataView::CPersistentDataView()
+{
+	_Data= NULL;
+	_Size= 0;
+	_Tokens= NULL;
+	_NbTokens= 0;
+	_Args= NULL;
+	_NbArgs= 0;
+	_StringOffsets.resize(1,0);
+}
+
+CPersistentDataView::~CPersistentDataView()
+{
+	close();
+}
+
+bool CPersistentDataView::open(const std::string& fileName)
+{
+	close();
+
+	// files that are too small to be binary pdrs are not worth mapping
+	uint32 size= CFile::getFileSize(fileName);
+	if (size<=HeaderSize)
+		return false;
+
+	// the file is read once from start to end
+	if (!_File.open(fileName,true) || _File.size()!=size)
+	{
+		close();
+		return false;
+	}
+	_Data= (const char*)_File.data();
+	_Size= size;
+
+	// the second dword of a bin file contains the file length: if it doesn't match then this is
+	// a text file (not an error but the caller has to read it with a CPersistentDataRecord)
+	uint32 sizeInHeader;
+	memcpy(&sizeInHeader,_Data+sizeof(uint32),sizeof(uint32));
+	if (sizeInHeader!=size)
+	{
+		close();
+		return false;
+	}
+
+	if (!parse())
+	{
+		nlwarning("Failed to parse binary pdr file: %s",fileName.c_str());
+		close();
+		return false;
+	}
+	return true;
+}
+
+bool CPersistentDataView::open(const char *buffer, uint32 size)
+{
+	close();
+
+	_Data= buffer;
+	_Size= size;
+
+	if (!parse())
+	{
+		close();
+		return false;
+	}
+	return true;
+}
+
+void CPersistentDataView::close()
+{
+	_File.close();
+
+	_Data= NULL;
+	_Size= 0;
+	_Tokens= NULL;
+	_NbTokens= 0;
+	_Args= NULL;
+	_NbArgs= 0;
+	_StringOffsets.resize(1);
+	_StringOffsets[0]= 0;
+}
+
+uint32 CPersistentDataView::findString(const char *s,uint32 len) const
+{
+	uint32 nbStrings= getNbStrings();
+	for (uint32 i=0;i<nbStrings;++i)
+	{
+		if (isString(i,s,len))
+			return i;
+	}
+	return nbStrings;
+}
+
+bool CPersistentDataView::parse()
+{
+	// the header is checked the same way as in CPersistentDataRecord::fromBuffer()
+	if (_Size<=HeaderSize)
+		return false;
+	uint32 header[6];
+	memcpy(header,_Data,HeaderSize);
+	uint32 version= header[0];
+	uint32 totalSize= header[1];
+	uint32 nbTokens= header[2];
+	uint32 nbArgs= header[3];
+	uint32 nbStrings= header[4];
+	uint32 stringsSize= header[5];
+
+	if (version>0 || totalSize!=_Size)
+		return false;
+	if ((uint64)HeaderSize+(uint64)nbTokens*sizeof(uint16)+(uint64)nbArgs*sizeof(uint32)+stringsSize!=totalSize)
+		return false;
+	if ((stringsSize==0) != (nbStrings==0))
+		return false;
+
+	_Tokens= _Data+HeaderSize;
+	_NbTokens= nbTokens;
+	_Args= _Tokens+nbTokens*sizeof(uint16);
+	_NbArgs= nbArgs;
+
+	// locate the strings
+	uint32 stringStart= HeaderSize+nbTokens*sizeof(uint16)+nbArgs*sizeof(uint32);
+	if (stringsSize!=0 && _Data[totalSize-1]!=0)
+		return false;
+	_StringOffsets.resize(nbStrings+1);
+	uint32 offset= stringStart;
+	for (uint32 i=0;i<nbStrings;++i)
+	{
+		if (offset>=totalSize)
+			return false;
+		_StringOffsets[i]= offset;
+		offset+= (uint32)strlen(_Data+offset)+1;
+	}
+	if (offset!=totalSize)
+		return false;
+	_StringOffsets[nbStrings]= offset;
+
+	// walk the tokens, checking that the structs are balanced and that each token has its arg,
+	// and record where each struct ends
+	if (_StructEnds.size()<nbTokens)
+		_StructEnds.resize(nbTokens);
+	_Stack.clear();
+	uint32 argOffset= 0;
+	for (uint32 i=0;i<nbTokens;++i)
+	{
+		uint16 token= getToken(i);
+		if ((uint32)(token>>3)>=nbStrings)
+			return false;
+		switch (token&7)
+		{
+		case BeginToken:
+			_Stack.push_back(i);
+			break;
+
+		case EndToken:
+			{
+				if (_Stack.empty())
+					return false;
+				uint32 begin= _Stack.back();
+				_Stack.pop_back();
+				if ((getToken(begin)>>3)!=(token>>3))
+					return false;
+				_StructEnds[begin].TokenOffset= i+1;
+				_StructEnds[begin].ArgOffset= argOffset;
+			}
+			break;
+
+		case FlagToken:
+			break;
+
+		default:
+			++argOffset;
+			break;
+		}
+	}
+	if (!_Stack.empty() || argOffset!=nbArgs)
+		return false;
+
+	return true;
+}
@@ -0,0 +1,136 @@
+// Ryzom - MMORPG Framework <http://dev.ryzom.com/projects/ryzom/>
+// Copyright (C) 2010  Winch Gate Property Limited
+//
+// This program is free software: you can redistribute it and/or modify
+// it under the terms of the GNU Affero General Public License as
+// published by the Free Software Foundation, either version 3 of the
+// License, or (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU Affero General Public License for more details.
+//
+// You should have received a copy of the GNU Affero General Public License
+// along with this program.  If not, see <http://www.gnu.org/licenses/>.
+
+/**
+  *  This file contains a read-only view of a binary 'persistent data record' file
+  *  (the format written by CPersistentDataRecord::toBuffer())
+  *
+  *  The file is memory mapped (or read in a buffer that is reused from one file to the next
+  *  where mapping isn't available) and its tables are used in place: nothing is allocated per
+  *  token, per arg or per string. Opening a file validates it and computes, for each struct,
+  *  the position following its end, so that a struct can be skipped without walking its contents.
+  *
+  *  A view is read through a CPersistentDataRecord (see CPersistentDataRecord::fromView()),
+  *  so the usual apply() methods can read it.
+  *
+  *  Usage:
+  *		static CPersistentDataView view;
+  *		static CPersistentDataRecord pdr;
+  *		if (view.open(fileName) && pdr.fromView(view))
+  *			myObject.apply(pdr);
+  *
+  **/
+
+#ifndef PERSISTENT_DATA_VIEW_H
+#define	PERSISTENT_DATA_VIEW_H
+
+//-----------------------------------------------------------------------------
+// Includes
+//-----------------------------------------------------------------------------
+
+#include "nel/misc/types_nl.h"
+#include "nel/misc/mapped_file.h"
+
+#include <string.h>
+#include <string>
+#include <vector>
+
+
+//-----------------------------------------------------------------------------
+// class CPersistentDataView
+//-----------------------------------------------------------------------------
+
+class CPersistentDataView
+{
+public:
+	// ctor & dtor
+	CPersistentDataView();
+	~CPersistentDataView();
+
+	// map a binary pdr file, closing the previous one
+	// returns false if the file can't be read or isn't a valid binary pdr (text files included)
+	bool open(const std::string& fileName);
+
+	// view a binary pdr buffer that belongs to the caller and must remain valid while the view is used
+	bool open(const char *buffer, uint32 size);
+
+	// release the file
+	void close();
+
+	// accessors
+	bool isOpen() const						{ return _Data!=NULL; }
+	uint32 getSize() const					{ return _Size; }
+	bool isMapped() const					{ return _File.isMapped(); }
+
+	// the token table
+	uint32 getNbTokens() const				{ return _NbTokens; }
+	uint16 getToken(uint32 idx) const		{ uint16 result; memcpy(&result,_Tokens+idx*sizeof(uint16),sizeof(uint16)); return result; }
+
+	// the arg table (the args aren't 32 bit aligned in the file if the number of tokens is odd)
+	uint32 getNbArgs() const				{ return _NbArgs; }
+	uint32 getArg(uint32 idx) const			{ uint32 result; memcpy(&result,_Args+idx*sizeof(uint32),sizeof(uint32)); return result; }
+
+	// the string table
+	uint32 getNbStrings() const				{ return (uint32)_StringOffsets.size()-1; }
+	uint32 getStringsSize() const			{ return _StringOffsets.back()-_StringOffsets.front(); }
+	const char *getString(uint32 idx) const	{ return _Data+_StringOffsets[idx]; }
+	uint32 getStringLength(uint32 idx) const{ return _StringOffsets[idx+1]-_StringOffsets[idx]-1; }
+	bool isString(uint32 idx,const char *s,uint32 len) const	{ return getStringLength(idx)==len && memcmp(getString(idx),s,len)==0; }
+
+	// index of a string in the string table, or getNbStrings() if it isn't there
+	uint32 findString(const char *s,uint32 len) const;
+
+	// position of the token and of the arg following the end of the struct that begins at token 'tokenIdx'
+	// (only valid for a struct begin token)
+	uint32 getStructEndToken(uint32 tokenIdx) const	{ return _StructEnds[tokenIdx].TokenOffset; }
+	uint32 getStructEndArg(uint32 tokenIdx) const	{ return _StructEnds[tokenIdx].ArgOffset; }
+
+private:
+	// validate the data and setup the tables
+	bool parse();
+
+	struct CStructEnd
+	{
+		uint32	TokenOffset;
+		uint32	ArgOffset;
+	};
+
+	// the data being viewed
+	const char	*_Data;
+	uint32		_Size;
+
+	// the tables in the data
+	const char	*_Tokens;
+	uint32		_NbTokens;
+	const char	*_Args;
+	uint32		_NbArgs;
+
+	// offsets of the strings in the data, followed by the offset of the end of the string table
+	std::vector<uint32>		_StringOffsets;
+
+	// end of the structs, indexed by the token that begins them (the other entries are unused)
+	std::vector<CStructEnd>	_StructEnds;
+
+	// work stack for parse()
+	std::vector<uint32>		_Stack;
+
+	// the file being viewed (not open when viewing a buffer of the caller)
+	NLMISC::CMappedFile		_File;
+};
+
+
+//-----------------------------------------------------------------------------
+#endif
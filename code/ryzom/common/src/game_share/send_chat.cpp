@@ -122,7 +122,7 @@ void forwardToDss(const TDataSetRow &senderId, CChatGroup::TGroupType groupType,
 	msgout.serialEnum(groupType);
 	msgout.serial(sentenceId);
 	msgout.serial(scenarioId);
-	NLNET::CUnifiedNetwork::getInstance()->send("DSS",msgout);
+	sendMessageDirect("DSS",msgout);
 }
 
 /**
@@ -144,7 +144,7 @@ void forwardToDssArg(const TDataSetRow &senderId, CChatGroup::TGroupType groupTy
 	{
 		msgout.serial(argValues[i]);
 	}
-	NLNET::CUnifiedNetwork::getInstance()->send("DSS",msgout);
+	sendMessageDirect("DSS",msgout);
 }
 
 /**
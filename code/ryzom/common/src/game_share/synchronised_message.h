@@ -26,6 +26,66 @@ void	sendMessageViaMirror( const std::string& destServiceName, NLNET::CMessage&
 void	sendMessageViaMirror( NLNET::TServiceId destServiceId, NLNET::CMessage& msgout );
 void	sendMessageViaMirrorToAll( NLNET::CMessage& msgout );
 
+/// Send a message directly (not synchronised with the mirror), or buffer it if the thread has a message buffer
+void	sendMessageDirect( const std::string& destServiceName, NLNET::CMessage& msgout );
+void	sendMessageDirect( NLNET::TServiceId destServiceId, NLNET::CMessage& msgout );
+
+
+/**
+ * Messages sent by a thread that has a message buffer (see setThreadMessageBuffer()) are
+ * stored in the buffer instead of being sent, because the network layer must only be used by
+ * the main thread. The main thread sends them later with flush(), in the order they were sent,
+ * so that a service can update independent parts of its world in worker threads and still
+ * send their messages in a deterministic order.
+ */
+class CSynchronisedMessageBuffer
+{
+public:
+
+	enum TSendMode { ViaMirrorByName, ViaMirrorById, ViaMirrorToAll, Direct, DirectById };
+
+	/// Store a copy of a message
+	void	add( TSendMode mode, const std::string& serviceName, NLNET::TServiceId serviceId, const NLNET::CMessage& msgout );
+
+	/// Send the buffered messages then clear the buffer (main thread only)
+	void	flush();
+
+	void	clear()				{ _Messages.clear(); }
+	bool	empty() const		{ return _Messages.empty(); }
+	uint	size() const		{ return (uint)_Messages.size(); }
+
+private:
+
+	struct TBufferedMessage
+	{
+		TSendMode			Mode;
+		std::string			ServiceName;
+		NLNET::TServiceId	ServiceId;
+		NLNET::CMessage		Msg;
+	};
+
+	std::vector<TBufferedMessage>	_Messages;
+};
+
+/// Set the message buffer of the calling thread (NULL to send the messages immediately)
+void	setThreadMessageBuffer( CSynchronisedMessageBuffer *buffer );
+
+/// Return the message buffer of the calling thread, or NULL
+CSynchronisedMessageBuffer	*getThreadMessageBuffer();
+
+
+/** Send a transport class with a send mode of CSynchronisedMessageBuffer.
+ * The transport classes are written in a message shared by all of them, so the threads that
+ * have a message buffer write them one at a time.
+ */
+void	sendTransportClass( CSynchronisedMessageBuffer::TSendMode mode, NLNET::CTransportClass& transportClass, const std::string& destServiceName, NLNET::TServiceId destServiceId );
+
+/// Send a transport class directly (not synchronised with the mirror), or buffer it if the thread has a message buffer
+inline void	sendTransportClassDirect( NLNET::CTransportClass& transportClass, const std::string& destServiceName )
+{
+	sendTransportClass( CSynchronisedMessageBuffer::Direct, transportClass, destServiceName, NLNET::TServiceId::InvalidId );
+}
+
 
 /**
  * Transport class synchronised with the mirror system
@@ -37,14 +97,14 @@ public:
 	/// Send the transport class to a specified service using the service id
 	void send( NLNET::TServiceId sid )
 	{
-		sendMessageViaMirror( sid, write() );
+		sendTransportClass( CSynchronisedMessageBuffer::ViaMirrorById, *this, std::string(), sid );
 		//nldebug( "%u: Sending MTC to service %hu", CTickEventHandler::getGameCycle(), (uint16)sid );
 	}
 
 	/// Send the transport class to a specified service using the service name
 	void send( const std::string &serviceName )
 	{
-		sendMessageViaMirror( serviceName, write() );
+		sendTransportClass( CSynchronisedMessageBuffer::ViaMirrorByName, *this, serviceName, NLNET::TServiceId::InvalidId );
 		//nldebug( "%u: Sending MTC to %s", CTickEventHandler::getGameCycle(), serviceName.c_str() );
 	}
 
@@ -0,0 +1,338 @@
+// Ryzom - MMORPG Framework <http://dev.ryzom.com/projects/ryzom/>
+// Copyright (C) 2010  Winch Gate Property Limited
+//
+// This program is free software: you can redistribute it and/or modify
+// it under the terms of the GNU Affero General Public License as
+// published by the Free Software Foundation, either version 3 of the
+// License, or (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU Affero General Public License for more details.
+//
+// You should have received a copy of the GNU Affero General Public License
+// along with this program.  If not, see <http://www.gnu.org/licenses/>.
+
+#include "stdpch.h"
+
+#include "nel/misc/shared_memory.h"
+#include "nel/misc/atomic.h"
+#include "nel/net/unified_network.h"
+
+#include "tick_channel.h"
+#include "tick_event_handler.h"
+
+#ifdef HAVE_TICK_CHANNEL
+#	include <unistd.h>
+#	include <limits.h>
+#	include <time.h>
+#	include <sys/syscall.h>
+#	include <linux/futex.h>
+#endif
+
+using namespace std;
+using namespace NLMISC;
+using namespace NLNET;
+
+
+NLMISC::CVariable<bool> UseTickChannel( "tick", "UseTickChannel", "Use the shared memory tick channel between the MS and its client services (if available), see tick_channel.h", false, 0, true );
+
+/// Max time (in ms) of a futex wait, to check if the waiting thread must stop
+static const uint32 TickChannelWaitTimeout = 100;
+
+
+#ifdef HAVE_TICK_CHANNEL
+
+/// Wait until *address is not expectedValue anymore (or the timeout or a signal occurs)
+static void futexWait( volatile uint32 *address, uint32 expectedValue, uint32 timeoutMs )
+{
+	timespec timeout;
+	timeout.tv_sec = timeoutMs / 1000;
+	timeout.tv_nsec = (timeoutMs % 1000) * 1000000;
+	// Not FUTEX_PRIVATE_FLAG, the waiters are in other processes
+	syscall( SYS_futex, (uint32*)address, FUTEX_WAIT, expectedValue, &timeout, NULL, 0 );
+}
+
+/// Wake up all the threads waiting on the address
+static void futexWakeAll( volatile uint32 *address )
+{
+	syscall( SYS_futex, (uint32*)address, FUTEX_WAKE, INT_MAX, NULL, NULL, 0 );
+}
+
+#endif
+
+
+/*
+ * Create the shared memory segment
+ */
+bool CTickChannelServer::create( sint32 smid, uint32 nbSlots, bool destroyGhostSegment )
+{
+#ifdef HAVE_TICK_CHANNEL
+	uint32 segmentSize = sizeof(TTickChannelHeader) + nbSlots*sizeof(TTickChannelSlot);
+	void *segment = CSharedMemory::createSharedMemory( toSharedMemId(smid), segmentSize );
+	if ( (segment == NULL) && destroyGhostSegment )
+	{
+		// The segment may not have been destroyed if the MS crashed
+		CSharedMemory::destroySharedMemory( toSharedMemId(smid), true );
+		nlinfo( "SHDMEM: Destroyed shared memory segment, smid %d", smid );
+		segment = CSharedMemory::createSharedMemory( toSharedMemId(smid), segmentSize );
+	}
+	if ( segment == NULL )
+	{
+		nlwarning( "SHDMEM: Can't create the tick channel (smid %d)", smid );
+		return false;
+	}
+
+	memset( segment, 0, segmentSize );
+	_SMId = smid;
+	_Header = (TTickChannelHeader*)segment;
+	_Header->NbSlots = nbSlots;
+	_Slots = (TTickChannelSlot*)(_Header + 1);
+	nlinfo( "SHDMEM: Tick channel created (smid %d, %u slots)", smid, nbSlots );
+	return true;
+#else
+	return false;
+#endif
+}
+
+
+/*
+ * Destroy the shared memory segment
+ */
+void CTickChannelServer::release()
+{
+	if ( ! _Header )
+		return;
+
+	CSharedMemory::closeSharedMemory( _Header );
+	CSharedMemory::destroySharedMemory( toSharedMemId(_SMId) );
+	_Header = NULL;
+	_Slots = NULL;
+}
+
+
+/*
+ * Allocate a slot
+ */
+uint32 CTickChannelServer::allocateSlot()
+{
+	if ( ! _Header )
+		return ~0;
+
+	for ( uint32 i=0; i!=_Header->NbSlots; ++i )
+	{
+		if ( _Slots[i].State == TTickChannelSlot::Free )
+		{
+			_Slots[i].NbTicksPosted = 0;
+			_Slots[i].NbUMMSent = 0;
+			_Slots[i].State = TTickChannelSlot::Allocated;
+			return i;
+		}
+	}
+	return ~0;
+}
+
+
+/*
+ * Free a slot
+ */
+void CTickChannelServer::freeSlot( uint32 slot )
+{
+	_Slots[slot].State = TTickChannelSlot::Free;
+}
+
+
+/*
+ * Start posting the ticks in a slot
+ */
+void CTickChannelServer::activateSlot( uint32 slot )
+{
+	_Slots[slot].State = TTickChannelSlot::Active;
+}
+
+
+/*
+ * Post a tick in all the active slots
+ */
+void CTickChannelServer::postTick()
+{
+#ifdef HAVE_TICK_CHANNEL
+	for ( uint32 i=0; i!=_Header->NbSlots; ++i )
+	{
+		if ( _Slots[i].State == TTickChannelSlot::Active )
+			atomicStoreRelease( &_Slots[i].NbTicksPosted, _Slots[i].NbTicksPosted + 1 );
+	}
+
+	// The waiters increment NbWaiters before checking TickSequence in futexWait(), and
+	// we check NbWaiters after changing TickSequence, so no wake-up can be missed
+	// (NbWaiters is read with a read-modify-write, so that it is not read before the change)
+	atomicFetchAdd( &_Header->TickSequence, (uint32)1 );
+	if ( atomicFetchAdd( &_Header->NbWaiters, (sint32)0 ) > 0 )
+		futexWakeAll( &_Header->TickSequence );
+#endif
+}
+
+
+/*
+ * Constructor
+ */
+CTickChannelClient::CTickChannelClient() :
+	_SMId(-1),
+	_SlotIndex(0),
+	_Segment(NULL),
+	_Header(NULL),
+	_Slot(NULL),
+	_NbTicksProcessed(0),
+	_NbUMMReceived(0),
+	_Thread(NULL),
+	_StopThread(false)
+{
+}
+
+
+/*
+ * Destructor
+ */
+CTickChannelClient::~CTickChannelClient()
+{
+	detach();
+}
+
+
+/*
+ * Access the channel of the MS
+ */
+bool CTickChannelClient::attach( TServiceId msId, sint32 smid, uint32 slot )
+{
+#ifdef HAVE_TICK_CHANNEL
+	// Already attached (the MS has sent its game cycle again)
+	if ( _Slot && (msId == _MSId) && (smid == _SMId) && (slot == _SlotIndex) )
+		return true;
+
+	detach();
+	_Segment = CSharedMemory::accessSharedMemory( toSharedMemId(smid) );
+	if ( ! _Segment )
+	{
+		nlwarning( "SHDMEM: Can't access the tick channel (smid %d), using tick messages", smid );
+		return false;
+	}
+	_Header = (TTickChannelHeader*)_Segment;
+	if ( slot >= _Header->NbSlots )
+	{
+		nlwarning( "Invalid tick channel slot %u, using tick messages", slot );
+		CSharedMemory::closeSharedMemory( _Segment );
+		_Segment = NULL;
+		_Header = NULL;
+		return false;
+	}
+	_MSId = msId;
+	_SMId = smid;
+	_SlotIndex = slot;
+	_Slot = ((TTickChannelSlot*)(_Header + 1)) + slot;
+	_NbTicksProcessed = 0;
+	_NbUMMReceived = 0;
+
+	_StopThread = false;
+	_Thread = IThread::create( this );
+	_Thread->start();
+
+	// Tell the MS to post the next ticks in the slot
+	CMessage msgout( "TICK_CHANNEL" );
+	msgout.serial( slot );
+	CUnifiedNetwork::getInstance()->send( msId, msgout );
+	nlinfo( "Receiving the ticks by the tick channel (smid %d, slot %u)", smid, slot );
+	return true;
+#else
+	return false;
+#endif
+}
+
+
+/*
+ * Stop using the channel
+ */
+void CTickChannelClient::detach()
+{
+	if ( _Thread )
+	{
+		atomicStoreRelease( &_StopThread, true );
+		_Thread->wait();
+		delete _Thread;
+		_Thread = NULL;
+	}
+	if ( _Segment )
+	{
+		CSharedMemory::closeSharedMemory( _Segment );
+		_Segment = NULL;
+	}
+	_Header = NULL;
+	_Slot = NULL;
+}
+
+
+/*
+ * Return true if a tick is posted and the UMM messages sent before it have been processed
+ */
+bool CTickChannelClient::isTickReady() const
+{
+#ifdef HAVE_TICK_CHANNEL
+	return (atomicLoadAcquire( &_Slot->NbTicksPosted ) != _NbTicksProcessed) && (_NbUMMReceived == atomicLoadAcquire( &_Slot->NbUMMSent ));
+#else
+	return false;
+#endif
+}
+
+
+/*
+ * To call when receiving an UMM message
+ */
+void CTickChannelClient::onUMMReceived()
+{
+	if ( ! _Slot )
+		return;
+
+	++_NbUMMReceived;
+
+	// If the tick was waiting for this UMM, process it as soon as possible
+	if ( isTickReady() )
+		CUnifiedNetwork::getInstance()->wakeUp();
+}
+
+
+/*
+ * Process the tick posted, if any
+ */
+void CTickChannelClient::serviceLoopUpdate()
+{
+	if ( (! _Slot) || (! isTickReady()) )
+		return;
+
+	++_NbTicksProcessed;
+	CTickEventHandler::tickUpdate( _MSId );
+}
+
+
+/*
+ * Waiting thread: wake up the main thread when a tick is posted
+ */
+void CTickChannelClient::run()
+{
+#ifdef HAVE_TICK_CHANNEL
+	uint32 lastSequence = atomicLoadAcquire( &_Header->TickSequence );
+	while ( ! atomicLoadAcquire( &_StopThread ) )
+	{
+		uint32 sequence = atomicLoadAcquire( &_Header->TickSequence );
+		if ( sequence != lastSequence )
+		{
+			lastSequence = sequence;
+			CUnifiedNetwork::getInstance()->wakeUp();
+			continue;
+		}
+
+		atomicFetchAdd( &_Header->NbWaiters, (sint32)1 );
+		futexWait( &_Header->TickSequence, sequence, TickChannelWaitTimeout );
+		atomicFetchSub( &_Header->NbWaiters, (sint32)1 );
+	}
+#endif
+}
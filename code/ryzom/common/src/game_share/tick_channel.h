@@ -0,0 +1,190 @@
+// Ryzom - MMORPG Framework <http://dev.ryzom.com/projects/ryzom/>
+// Copyright (C) 2010  Winch Gate Property Limited
+//
+// This program is free software: you can redistribute it and/or modify
+// it under the terms of the GNU Affero General Public License as
+// published by the Free Software Foundation, either version 3 of the
+// License, or (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU Affero General Public License for more details.
+//
+// You should have received a copy of the GNU Affero General Public License
+// along with this program.  If not, see <http://www.gnu.org/licenses/>.
+
+#ifndef RY_TICK_CHANNEL_H
+#define RY_TICK_CHANNEL_H
+
+#include "nel/misc/types_nl.h"
+#include "nel/misc/variable.h"
+#include "nel/misc/thread.h"
+#include "nel/net/service.h"
+
+/*
+ * The tick channel is a shared memory segment created by a mirror service, through which
+ * it posts the ticks to its client services instead of sending TICK messages. The client
+ * services wait for the ticks with a futex, so it is only available under Linux.
+ *
+ * A client service asks for the channel when registering to the tick system of its MS. If
+ * the MS has a free slot for it, the REGISTERED message gives the channel and the slot,
+ * otherwise (or if the service doesn't ask) the ticks are sent by messages. When the
+ * service has accessed the channel, it sends TICK_CHANNEL to the MS, that posts the next
+ * ticks in the slot instead of sending TICK messages.
+ *
+ * The tocks are still sent by messages, because they must be received by the MS after the
+ * messages sent by the service during the tick.
+ */
+#if defined(NL_OS_UNIX) && !defined(NL_OS_MAC)
+#	define HAVE_TICK_CHANNEL
+#endif
+
+/** If false (default), the client services don't ask for the tick channel and the MS doesn't create it.
+ * With the channel, only the UMM messages sent by the MS before a tick are guaranteed to be
+ * processed before it (the other messages of the MS, such as BIDG_CNTR, may arrive after it).
+ */
+extern NLMISC::CVariable<bool> UseTickChannel;
+
+
+/**
+ * Slot of a client service in the tick channel
+ */
+struct TTickChannelSlot
+{
+	enum TState { Free, Allocated, Active };
+
+	/// Number of ticks posted since the slot was activated (written by the MS)
+	volatile uint32		NbTicksPosted;
+
+	/// Number of UMM messages sent by the MS since the slot was allocated. The service
+	/// must have processed them all before processing a tick, as with the messages.
+	volatile uint32		NbUMMSent;
+
+	/// TState (only accessed by the MS)
+	uint32				State;
+
+	uint32				Padding;
+};
+
+
+/**
+ * Header of the tick channel segment, followed by the slots
+ */
+struct TTickChannelHeader
+{
+	/// Incremented at each tick posted (the client services wait for it to change)
+	volatile uint32		TickSequence;
+
+	/// Number of client services waiting for TickSequence to change
+	volatile sint32		NbWaiters;
+
+	/// Number of slots following the header
+	uint32				NbSlots;
+
+	uint32				Padding;
+};
+
+
+/**
+ * Tick channel, MS side (see CTickProxy)
+ */
+class CTickChannelServer
+{
+public:
+
+	/// Constructor
+	CTickChannelServer() : _SMId(-1), _Header(NULL), _Slots(NULL) {}
+
+	/// Create the shared memory segment. Return false if it can't be created.
+	bool				create( sint32 smid, uint32 nbSlots, bool destroyGhostSegment );
+
+	/// Destroy the shared memory segment
+	void				release();
+
+	/// Return true if the channel is created
+	bool				isCreated() const { return _Header != NULL; }
+
+	/// Return the shared memory id of the channel
+	sint32				smid() const { return _SMId; }
+
+	/// Allocate a slot, or return ~0 if there is no free slot
+	uint32				allocateSlot();
+
+	/// Free a slot
+	void				freeSlot( uint32 slot );
+
+	/// Start posting the ticks in a slot (when its service has accessed the channel)
+	void				activateSlot( uint32 slot );
+
+	/// Return true if the ticks are posted in the slot
+	bool				isSlotActive( uint32 slot ) const { return _Slots[slot].State == TTickChannelSlot::Active; }
+
+	/// Post a tick in all the active slots and wake up the services waiting for it
+	void				postTick();
+
+	/// To call after sending an UMM message to the service of a slot
+	void				onUMMSent( uint32 slot ) { ++_Slots[slot].NbUMMSent; }
+
+private:
+
+	sint32				_SMId;
+	TTickChannelHeader	*_Header;
+	TTickChannelSlot	*_Slots;
+};
+
+
+/**
+ * Tick channel, client service side (see CTickEventHandler).
+ * A thread waits for the ticks and wakes up the main thread, that processes them
+ * in serviceLoopUpdate().
+ */
+class CTickChannelClient : public NLNET::IServiceUpdatable, public NLMISC::IRunnable
+{
+public:
+
+	/// Constructor
+	CTickChannelClient();
+
+	/// Destructor
+	virtual ~CTickChannelClient();
+
+	/// Access the channel of the MS and tell it. Return false if it can't be accessed.
+	bool				attach( NLNET::TServiceId msId, sint32 smid, uint32 slot );
+
+	/// Stop using the channel
+	void				detach();
+
+	/// Return true if the ticks are received by the channel
+	bool				isAttached() const { return _Slot != NULL; }
+
+	/// To call when receiving an UMM message
+	void				onUMMReceived();
+
+	/// Process the tick posted, if any
+	virtual void		serviceLoopUpdate();
+
+	/// Waiting thread
+	virtual void		run();
+
+	virtual void		getName( std::string &result ) const { result = "TickChannel"; }
+
+private:
+
+	/// Return true if a tick is posted and can be processed
+	bool				isTickReady() const;
+
+	NLNET::TServiceId	_MSId;
+	sint32				_SMId;
+	uint32				_SlotIndex;
+	void				*_Segment;
+	TTickChannelHeader	*_Header;
+	TTickChannelSlot	*_Slot;
+	uint32				_NbTicksProcessed;
+	uint32				_NbUMMReceived;
+	NLMISC::IThread		*_Thread;
+	volatile bool		_StopThread; // set by detach(), read by the waiting thread (atomic accesses)
+};
+
+
+#endif // RY_TICK_CHANNEL_H
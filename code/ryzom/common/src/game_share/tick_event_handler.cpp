@@ -28,6 +28,7 @@
 #include "tick_event_handler.h"
 #include "time_weather_season/time_and_season.h"
 #include "tick_proxy_time_measure.h"
+#include "tick_channel.h"
 #include "timer.h"
 
 using namespace std;
@@ -71,6 +72,9 @@ CVariable<sint16> ReceiveMessagesViaMirrorSpeed("tick", "ReceiveMessagesViaMirro
 
 TAccurateTime TimeBeforeTickUpdate = 0;
 
+// Tick channel of the local MS (created when the MS gives a slot)
+static CTickChannelClient *TickChannel = NULL;
+
 
 //-----------------------------------------------
 //	cbRegistered
@@ -90,6 +94,19 @@ static void cbRegistered(CMessage& msgin, const std::string &serviceName, TServi
 	msgin.serial( gameCycle );
 	CTickEventHandler::setGameCycle( gameCycle );
 
+	// Tick channel slot given by the MS (see CTickProxy::sendSyncToClient()), the ticks
+	// are sent by messages until we tell the MS that we have accessed the channel
+	if ( (uint32)msgin.getPos() < msgin.length() )
+	{
+		sint32 smid;
+		uint32 slot;
+		msgin.serial( smid );
+		msgin.serial( slot );
+		if ( ! TickChannel )
+			TickChannel = new CTickChannelClient();
+		TickChannel->attach( serviceId, smid, slot );
+	}
+
 	// user callback
 	if( userCbSync )
 	{
@@ -246,6 +263,12 @@ void cbTicksUp(const std::string &serviceName, TServiceId id, void *arg)
 		nlinfo("This service %s and has a threshold of %d",(tocking?"tocks":"doesn't tock"), threshold);
 		msgout.serial( tocking );
 		msgout.serial( threshold );
+#ifdef HAVE_TICK_CHANNEL
+		bool wantsTickChannel = UseTickChannel.get();
+#else
+		bool wantsTickChannel = false;
+#endif
+		msgout.serial( wantsTickChannel );
 		CUnifiedNetwork::getInstance()->send( id, msgout );
 	}
 
@@ -256,6 +279,33 @@ void cbTicksDown(const std::string &serviceName, TServiceId id, void *arg)
 	if ( CUnifiedNetwork::getInstance()->isServiceLocal( id ) )
 	{
 		TickSpeedLoop = -1;
+		if ( TickChannel )
+			TickChannel->detach();
+	}
+}
+
+//-----------------------------------------------
+//	onUMMReceived
+//
+//-----------------------------------------------
+void CTickEventHandler::onUMMReceived()
+{
+	if ( TickChannel )
+		TickChannel->onUMMReceived();
+}
+
+//-----------------------------------------------
+//	release
+//
+//-----------------------------------------------
+void CTickEventHandler::release()
+{
+	// stop the waiter thread of the channel, it must not outlive the network
+	if ( TickChannel )
+	{
+		TickChannel->detach();
+		delete TickChannel;
+		TickChannel = NULL;
 	}
 }
 
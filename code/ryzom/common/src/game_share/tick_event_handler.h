@@ -96,6 +96,12 @@ public :
 
 	static bool getTockAtBeginOfTickUpdate() { return _TockAtBeginOfTickUpdate; }
 
+	/// To call when receiving an UMM message from the MS (a tick received by the tick channel waits for it)
+	static void onUMMReceived();
+
+	/// Stop the tick channel (call it in the release of the service, before the network is released)
+	static void release();
+
 private :
 
 	/// Time according to the game (used for determining day, night...) (double in seconds)
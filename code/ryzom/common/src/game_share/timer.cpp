@@ -27,36 +27,119 @@
 
 NLMISC::CVariable<uint32> NbProcessedEventsInTimerManagerUpdate("egs", "NbProcessedEventInTimerManagerUpdate", "", 0);
 NLMISC::CVariable<uint32> NbEventsToProcessInTimerManagerUpdate("egs", "NbEventsToProcessInTimerManagerUpdate", "", 0);
+NLMISC::CVariable<uint32> NbTimerEvents("egs", "NbTimerEvents", "Number of timer events scheduled", 0);
 
 NL_INSTANCE_COUNTER_IMPL(CTimerEvent);
 
 //-------------------------------------------------------------------------------------------------
-//	syncTick()
+//	insertEvent()
 //-------------------------------------------------------------------------------------------------
-void CTimerManager::syncTick()
+void CTimerManager::insertEvent(CTimerEvent* event)
 {
-	uint32 delta= CTickEventHandler::getGameCycle()-_LastTick;
+	// the events due before the next tick are processed at the next tick
+	NLMISC::TGameCycle time= event->_Time;
+	if (time<_NextTick)
+		time= _NextTick;
+
+	// the level is given by the highest bits differing from the next tick
+	uint32 diff= time^_NextTick;
+	uint32 level=0;
+	while (level<NbLevels-1 && (diff>>(NbSlotBits*(level+1)))!=0)
+		++level;
+
+	_Wheel[level][(time>>(NbSlotBits*level))&(NbSlots-1)].pushBack(event);
+}
 
-	// update the time values
-	for (NLMISC::TGameCycle i=0;i<256;++i)
+//-------------------------------------------------------------------------------------------------
+//	cascade()
+//-------------------------------------------------------------------------------------------------
+void CTimerManager::cascade(uint32 level, uint32 slot)
+{
+	CTimerEventList& list= _Wheel[level][slot];
+	while (list.First!=NULL)
 	{
-		TEventVector& vect= getEventVector(i);
-		for (uint32 j=0;j<vect.size();++j)
-			vect[j]->_Time+= delta;
+		NLMISC::CSmartPtr<CTimerEvent> event= list.First;
+		list.remove(event);
+		insertEvent(event);
 	}
+}
 
-	// re-locate the event vectors to line them back up with the time values that they represent
-	for (NLMISC::TGameCycle i=0;i<256;++i)
+//-------------------------------------------------------------------------------------------------
+//	processNextTick()
+//-------------------------------------------------------------------------------------------------
+void CTimerManager::processNextTick(uint32& nbEventsToProcess, uint32& nbProcessedEvents)
+{
+	// take the events of the tick out of the wheel, so that the events set by the callbacks
+	// go to the next ticks
+	CTimerEventList batch;
+	CTimerEventList& slot= _Wheel[0][_NextTick&(NbSlots-1)];
+	while (slot.First!=NULL)
 	{
-		TEventVector& vect= _EventVectors[i];
-		while (!vect.empty() && ((uint8)vect[0]->_Time)!=i)
+		NLMISC::CSmartPtr<CTimerEvent> event= slot.First;
+		slot.remove(event);
+		batch.pushBack(event);
+	}
+	++_NextTick;
+
+	// move down the events of the upper level slots that the next tick enters
+	for (uint32 level=NbLevels-1;level>0;--level)
+	{
+		if ((_NextTick&((1<<(NbSlotBits*level))-1))==0)
+			cascade(level,(_NextTick>>(NbSlotBits*level))&(NbSlots-1));
+	}
+
+	// process the events (a callback may cancel the next events of the batch)
+	nbEventsToProcess+= batch.Size;
+	while (batch.First!=NULL)
+	{
+		NLMISC::CSmartPtr<CTimerEvent> eventPtr= batch.First;
+		removeEvent(eventPtr);
+		eventPtr->processEvent();
+		++nbProcessedEvents;
+	}
+}
+
+//-------------------------------------------------------------------------------------------------
+//	rescheduleAll()
+//-------------------------------------------------------------------------------------------------
+void CTimerManager::rescheduleAll(uint32 delta, NLMISC::TGameCycle nextTick)
+{
+	// take all the events out of the wheel, in the order of their slots
+	std::vector<NLMISC::CSmartPtr<CTimerEvent> > events;
+	events.reserve(_NbEvents);
+	for (uint32 level=0;level<NbLevels;++level)
+	{
+		for (uint32 i=0;i<NbSlots;++i)
 		{
-			uint8 swapPos= (uint8)_EventVectors[i][0]->_Time;
-			std::swap(_EventVectors[i],_EventVectors[swapPos]);
+			CTimerEventList& list= _Wheel[level][i];
+			while (list.First!=NULL)
+			{
+				events.push_back(list.First);
+				list.remove(events.back());
+			}
 		}
 	}
 
+	// update the time values and re-insert the events
+	_NextTick= nextTick;
+	for (uint32 i=0;i<events.size();++i)
+	{
+		CTimerEvent* event= events[i];
+		--_NbEventsByTime[uint8(event->_Time&0xff)];
+		event->_Time+= delta;
+		++_NbEventsByTime[uint8(event->_Time&0xff)];
+		insertEvent(event);
+	}
+}
+
+//-------------------------------------------------------------------------------------------------
+//	syncTick()
+//-------------------------------------------------------------------------------------------------
+void CTimerManager::syncTick()
+{
+	uint32 delta= CTickEventHandler::getGameCycle()-_LastTick;
 	_LastTick= CTickEventHandler::getGameCycle();
+	rescheduleAll(delta,_LastTick);
 }
 
 //-------------------------------------------------------------------------------------------------
@@ -66,41 +149,23 @@ void CTimerManager::tickUpdate()
 {
 	H_AUTO(CTimerManagerUpdate);
 
-	// select this game cycle's phrase event vector
+	// the ticks up to this game cycle are processed
 	NLMISC::TGameCycle time= CTickEventHandler::getGameCycle();
-	TEventVector &vect= getInstance()->getEventVector(time);
-
-	// iterate through the vector processing its events
-	uint32 nextFreeSlot=0;
-	uint32 size=(uint32)vect.size();
-	for (uint32 i=0;i<size;++i)
+	if ((sint32)(time-_NextTick)<0)
+		return;
+
+	// after a long interruption, the events are processed in a single tick
+	if (time-_NextTick>=MaxTicksToCatchUp)
+		rescheduleAll(0,time);
+
+	uint32 nbEventsToProcess=0;
+	uint32 nbProcessedEvents=0;
+	for (uint32 nbTicks=time-_NextTick+1;nbTicks!=0;--nbTicks)
+		processNextTick(nbEventsToProcess,nbProcessedEvents);
+	if (nbEventsToProcess!=0)
 	{
-		NLMISC::CSmartPtr<CTimerEvent> eventPtr=vect[i];
-
-		// if the event is no longer valid then just skip it
-		if (eventPtr->getOwner()==NULL)
-			continue;
-
-		// if the event isn't valid yet then keep it for later
-		// BUG when event time is too high, like 0xffffffff which is used in special cases, so change the test
-		//if ((sint32)(eventPtr->getTime()-time)>0)
-		if (eventPtr->getTime() > time)
-		{
-			vect[nextFreeSlot]=eventPtr;
-			++nextFreeSlot;
-			continue;
-		}
-
-		// process the event
-		eventPtr->processEvent();
+		NbEventsToProcessInTimerManagerUpdate = nbEventsToProcess;
+		NbProcessedEventsInTimerManagerUpdate = nbProcessedEvents;
 	}
-	if (!vect.empty())
-	{
-		//nlinfo("TimerManagerUpdate: Processed %d of %d events",vect.size()-nextFreeSlot, vect.size());
-		NbEventsToProcessInTimerManagerUpdate = (uint32)vect.size();
-		NbProcessedEventsInTimerManagerUpdate = NbEventsToProcessInTimerManagerUpdate.get() - nextFreeSlot;
-	}
-	// resize the vector back down to keep only the events that we haven't dealt with yet
-	vect.resize(nextFreeSlot);
+	NbTimerEvents = _NbEvents;
 }
-
@@ -123,6 +123,7 @@
 
 class CTimer;
 class CTimerEvent;
+class CTimerEventList;
 class CTimerManager;
 
 
@@ -246,6 +247,37 @@ private:
 
 	// a pointer to the owner object - is NULL if owner object has been deleted or this event has been invalidated
 	CTimer* _Owner;
+
+	friend class CTimerEventList;
+
+	// the timer wheel slot holding the event (NULL if the event is not scheduled) and the links in its list
+	// (the list keeps a reference to each event through the forward links)
+	CTimerEventList* _List;
+	CTimerEvent* _Prev;
+	NLMISC::CSmartPtr<CTimerEvent> _Next;
+};
+
+
+//-------------------------------------------------------------------------------------------------
+// class CTimerEventList
+//-------------------------------------------------------------------------------------------------
+// list of the events of a timer wheel slot, linked through the events themselves
+// the list holds a smart pointer to each of its events
+
+class CTimerEventList
+{
+public:
+	CTimerEventList(): Last(NULL), Size(0) {}
+
+	// append an event at the end of the list
+	void pushBack(CTimerEvent* event);
+
+	// remove an event from the list - the caller must hold a reference to the event, as the list releases its own
+	void remove(CTimerEvent* event);
+
+	NLMISC::CSmartPtr<CTimerEvent> First;
+	CTimerEvent* Last;
+	uint32 Size;
 };
 
 
@@ -253,12 +285,17 @@ private:
 // class CTimerManager
 //-------------------------------------------------------------------------------------------------
 // singleton timer manager
+// The events are scheduled in a hierarchical timing wheel: the level 0 has a slot per game cycle
+// for the next 256 game cycles, each slot of the level 1 holds the events of 256 game cycles,
+// and so on up to the level 3 that covers the whole game cycle range. When the game cycle enters
+// the range of a slot of an upper level, its events are moved down to the lower levels. Setting
+// and cancelling an event are O(1), and each tick only processes the events due in that tick.
 
 class CTimerManager: public IServiceSingleton
 {
 public:
 	// update called each tick in service update
-	// updates events and cleans out event vectors
+	// processes the events due since the last update
 	virtual void tickUpdate();
 
 	// get the singleton instance...
@@ -267,22 +304,48 @@ public:
 	// callback called when the tick service connects - used to ajust time values of event objects
 	void syncTick();
 
+	// get the number of events scheduled
+	uint32 getNbEvents() const;
+
 private:
 	// this is a singleton so prohibit construction
 	CTimerManager();
 
-	// the type of the event vector for a given time hash
-	typedef std::vector<NLMISC::CSmartPtr<CTimerEvent> > TEventVector;
-
-	// the event vector is filled directly by CTimerEvent objects
+	// the events are scheduled directly by CTimerEvent objects
 	friend class CTimerEvent;
 
-	// singleton encapsulation of event vector set
-	TEventVector& getEventVector(NLMISC::TGameCycle time);
+	// schedule an event at its time (or at the next tick if its time is past) - the wheel keeps a reference to the event
+	void addEvent(CTimerEvent* event);
+
+	// unschedule an event - the wheel releases its reference, so the caller must hold one
+	void removeEvent(CTimerEvent* event);
+
+	// get the number of events scheduled at a given time, modulo 256 (used to spread the events with a variation)
+	uint32 getNbEventsAtTime(NLMISC::TGameCycle time) const;
+
+	// put an event in the wheel slot matching its time
+	void insertEvent(CTimerEvent* event);
+
+	// process the events of the next tick, then move to the following one
+	void processNextTick(uint32& nbEventsToProcess, uint32& nbProcessedEvents);
+
+	// move the events of a slot of an upper level down to the lower levels
+	void cascade(uint32 level, uint32 slot);
+
+	// re-insert all the events, after shifting their time by delta
+	void rescheduleAll(uint32 delta, NLMISC::TGameCycle nextTick);
+
+	enum { NbLevels= 4, NbSlotBits= 8, NbSlots= 1<<NbSlotBits };
+
+	// above this number of ticks to catch up, all the events are rescheduled instead of processing the ticks one by one
+	enum { MaxTicksToCatchUp= 1<<16 };
 
 	// data
 	NLMISC::TGameCycle _LastTick;
-	TEventVector _EventVectors[256];
+	NLMISC::TGameCycle _NextTick;
+	CTimerEventList _Wheel[NbLevels][NbSlots];
+	uint32 _NbEventsByTime[NbSlots];
+	uint32 _NbEvents;
 };
 
 
@@ -385,6 +448,9 @@ inline CTimerEvent::CTimerEvent()
 {
 	_Owner	= NULL;
 	_Time	= 0;
+	_List	= NULL;
+	_Prev	= NULL;
+	_Next	= NULL;
 }
 
 inline CTimerEvent::~CTimerEvent()
@@ -395,14 +461,17 @@ inline void CTimerEvent::set(CTimer* owner,NLMISC::TGameCycle time)
 {
 	BOMB_IF(owner==NULL,"Impossible to set a timer with a NULL owner",return);
 	BOMB_IF(_Owner!=NULL && _Owner!=owner,"Attempt to change owner of an active event",return);
+	CTimerManager* mgr=CTimerManager::getInstance();
+	if (_List!=NULL)
+		mgr->removeEvent(this);
 	_Owner	= owner;
 	_Time	= time;
-	CTimerManager::getInstance()->getEventVector(time).push_back(this);
+	mgr->addEvent(this);
 }
 
 inline void CTimerEvent::set(CTimer* owner,NLMISC::TGameCycle time,uint32 variation)
 {
-	BOMB_IF(variation==0,"shouldn't call this method with variation value of 0", set(owner,time));
+	BOMB_IF(variation==0,"shouldn't call this method with variation value of 0", set(owner,time); return);
 	BOMB_IF(variation>256,"shouldn't call this method with variation value of >256", variation=256);
 
 	BOMB_IF(owner==NULL,"Impossible to set a timer with a NULL owner", return);
@@ -410,22 +479,21 @@ inline void CTimerEvent::set(CTimer* owner,NLMISC::TGameCycle time,uint32 variat
 	_Owner	= owner;
 
 	CTimerManager* mgr=CTimerManager::getInstance();
-	CTimerManager::TEventVector *best=NULL;
+	if (_List!=NULL)
+		mgr->removeEvent(this);
 	uint32 bestLength=~0u;
 
+	// choose the least loaded game cycle
 	for (uint32 i=0;i<variation;++i)
 	{
-		CTimerManager::TEventVector& vect= mgr->getEventVector(time+i);
-		uint32 length=(uint32)vect.size();
+		uint32 length= mgr->getNbEventsAtTime(time+i);
 		if (length<=bestLength)
 		{
 			bestLength= length;
-			best=&vect;
 			_Time = time + i;
 		}
 	}
-	BOMB_IF(best==NULL,"BUG: This can never happen!",return)
-	best->push_back(this);
+	mgr->addEvent(this);
 }
 
 inline NLMISC::TGameCycle CTimerEvent::getTime() const
@@ -446,6 +514,9 @@ inline bool CTimerEvent::isActive() const
 inline void CTimerEvent::clear()
 {
 	_Owner=NULL;
+	// cancel the event now, the wheel's reference is released but the owner still holds one
+	if (_List!=NULL)
+		CTimerManager::getInstance()->removeEvent(this);
 }
 
 
@@ -463,6 +534,41 @@ inline void CTimerEvent::processEvent()
 }
 
 
+//-------------------------------------------------------------------------------------------------
+// inlines CTimerEventList
+//-------------------------------------------------------------------------------------------------
+
+inline void CTimerEventList::pushBack(CTimerEvent* event)
+{
+	event->_List= this;
+	event->_Prev= Last;
+	event->_Next= NULL;
+	if (Last!=NULL)
+		Last->_Next= event;
+	else
+		First= event;
+	Last= event;
+	++Size;
+}
+
+inline void CTimerEventList::remove(CTimerEvent* event)
+{
+	NLMISC::CSmartPtr<CTimerEvent> next= event->_Next;
+	event->_Next= NULL;
+	if (next!=NULL)
+		next->_Prev= event->_Prev;
+	else
+		Last= event->_Prev;
+	if (event->_Prev!=NULL)
+		event->_Prev->_Next= next;
+	else
+		First= next;
+	event->_List= NULL;
+	event->_Prev= NULL;
+	--Size;
+}
+
+
 //-------------------------------------------------------------------------------------------------
 // inlines CTimerManager
 //-------------------------------------------------------------------------------------------------
@@ -470,6 +576,10 @@ inline void CTimerEvent::processEvent()
 inline CTimerManager::CTimerManager()
 {
 	_LastTick= CTickEventHandler::getGameCycle();
+	_NextTick= _LastTick;
+	_NbEvents= 0;
+	for (uint32 i=0;i<NbSlots;++i)
+		_NbEventsByTime[i]= 0;
 }
 
 inline CTimerManager* CTimerManager::getInstance()
@@ -482,9 +592,28 @@ inline CTimerManager* CTimerManager::getInstance()
 	return instance;
 }
 
-inline CTimerManager::TEventVector& CTimerManager::getEventVector(NLMISC::TGameCycle time)
+inline uint32 CTimerManager::getNbEvents() const
+{
+	return _NbEvents;
+}
+
+inline uint32 CTimerManager::getNbEventsAtTime(NLMISC::TGameCycle time) const
+{
+	return _NbEventsByTime[uint8(time&0xff)];
+}
+
+inline void CTimerManager::addEvent(CTimerEvent* event)
+{
+	insertEvent(event);
+	++_NbEventsByTime[uint8(event->_Time&0xff)];
+	++_NbEvents;
+}
+
+inline void CTimerManager::removeEvent(CTimerEvent* event)
 {
-	return _EventVectors[uint8(time&0xff)];
+	event->_List->remove(event);
+	--_NbEventsByTime[uint8(event->_Time&0xff)];
+	--_NbEvents;
 }
 
 
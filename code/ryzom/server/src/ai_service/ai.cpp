@@ -63,6 +63,9 @@ using namespace NLGEORGES;
 CAIS		*CAIS::_Instance = NULL;
 
 CRandom										CAIS::_random;
+bool										CAIS::_ParallelUpdate = false;
+CTDS										CAIS::_UpdateContextTDS;
+CMutex										CAIS::_SharedDataMutex;
 
 const	std::string	disengageString("DISENGAGE");
 const	std::string	egsString("EGS");
@@ -124,6 +127,14 @@ CVariable<uint32>	TotalMaxFx("ai", "NbFxLimit", "Security absolute limit to the
 
 CVariable<string>	BotRepopFx("ai", "BotRepopFx", "Fx sheet to use when changing the sheet of a bot",			string(),				0, true );
 
+void setNbUpdateWorkersCallBack(IVariable &var)
+{
+	if (CAIS::instanceCreated())
+		CAIS::instance().setNbUpdateWorkers(AIUpdateWorkers.get());
+}
+
+CVariable<uint32>	AIUpdateWorkers("ai", "AIUpdateWorkers", "Number of threads updating the AI instances (1 = main thread only)", 1, 0, true, setNbUpdateWorkersCallBack );
+
 //--------------------------------------------------------------------------
 // DATA TABLES FOR ENTITY MATRIX
 //--------------------------------------------------------------------------
@@ -267,6 +278,8 @@ void	CAIS::initAI()
 
 	// init the client message callbacks
 	CAIClientMessages::init();
+
+	setNbUpdateWorkers(AIUpdateWorkers.get());
 }
 
 
@@ -307,6 +320,7 @@ void	CAIS::destroyAIInstance(uint32 instanceNumber, bool displayWarningIfInstanc
 		return;
 	}
 	aii->despawn();
+	_UpdatedInstances.clear();
 	_AIInstances.removeChildByIndex(aii->getChildIndex());
 	nlassert(aii == NULL);
 
@@ -329,6 +343,13 @@ void CAIS::release ()
 	//	erase all ai instance.
 	AIList().clear();
 
+	// stop the update workers
+	_UpdateWorkers.release();
+	for (uint i=0; i<_UpdateContexts.size(); ++i)
+		delete _UpdateContexts[i];
+	_UpdateContexts.clear();
+	_UpdatedInstances.clear();
+
 	CAIUserModelManager::getInstance()->destroyInstance();
 	// release the client message callbacks
 	CAIClientMessages::release();
@@ -401,8 +422,16 @@ void	CAIS::update()
 	execNamedEntityChanges();
 
 	// Update AI instances
-	FOREACH(it, CCont<CAIInstance>, CAIS::instance().AIList())
-		(*it)->CAIInstance::update();
+	// (the hierarchical timers are not thread safe, so the update is serial while they are benching)
+	if (_UpdateWorkers.nbWorkers() > 1 && !CHTimer::benching())
+	{
+		updateInstancesInParallel();
+	}
+	else
+	{
+		FOREACH(it, CCont<CAIInstance>, CAIS::instance().AIList())
+			(*it)->CAIInstance::update();
+	}
 
 	// Send systematic messages to EGS
 	if (EGSHasMirrorReady)
@@ -447,6 +476,120 @@ void	CAIS::update()
 	AISStat::countersEnd();
 }
 
+/*
+ * Jobs of a parallel update : the update of each instance, with its context set
+ * as the context of the thread
+ */
+class CAIInstanceUpdateJobs : public IWorkerJobs
+{
+public:
+	CAIInstanceUpdateJobs(const std::vector<CAIInstance*> &instances, const std::vector<CAIS::CUpdateContext*> &contexts, CTDS &contextTDS)
+		:	_Instances(instances),
+			_Contexts(contexts),
+			_ContextTDS(contextTDS)
+	{
+	}
+
+	virtual void runJob(uint jobIndex, uint workerIndex)
+	{
+		CAIInstance	*aii = _Instances[jobIndex];
+		CAIS::CUpdateContext	*context = _Contexts[aii->getChildIndex()];
+
+		_ContextTDS.setPointer(context);
+		setThreadMessageBuffer(&context->Messages);
+
+		TTicks	startTime = CTime::getPerformanceTime();
+		aii->CAIInstance::update();
+		context->LastUpdateTicks = CTime::getPerformanceTime() - startTime;
+
+		setThreadMessageBuffer(NULL);
+		_ContextTDS.setPointer(NULL);
+	}
+
+private:
+	const std::vector<CAIInstance*>				&_Instances;
+	const std::vector<CAIS::CUpdateContext*>	&_Contexts;
+	CTDS										&_ContextTDS;
+};
+
+void	CAIS::updateInstancesInParallel()
+{
+	H_AUTO(AIUpdateInstancesInParallel);
+
+	_UpdatedInstances.clear();
+	FOREACH(it, CCont<CAIInstance>, _AIInstances)
+	{
+		CAIInstance	*aii = *it;
+		uint32	index = aii->getChildIndex();
+		if (index >= _UpdateContexts.size())
+			_UpdateContexts.resize(index+1, NULL);
+		if (_UpdateContexts[index] == NULL)
+		{
+			_UpdateContexts[index] = new CUpdateContext();
+			_UpdateContexts[index]->Random.srand((sint32)_random.rand());
+		}
+		_UpdatedInstances.push_back(aii);
+	}
+
+	// update the instances, the messages they send are kept in their context
+	_ParallelUpdate = true;
+	CAIInstanceUpdateJobs	jobs(_UpdatedInstances, _UpdateContexts, _UpdateContextTDS);
+	_UpdateWorkers.run(jobs, (uint)_UpdatedInstances.size());
+	_ParallelUpdate = false;
+
+	// then send them in the order of the instances, as if the instances were updated one after the other
+	for (uint i=0; i<_UpdatedInstances.size(); ++i)
+	{
+		CUpdateContext	&context = *_UpdateContexts[_UpdatedInstances[i]->getChildIndex()];
+		context.Messages.flush();
+
+		_FaunaDescriptionList.Bots.insert(_FaunaDescriptionList.Bots.end(), context.FaunaDescriptionList.Bots.begin(), context.FaunaDescriptionList.Bots.end());
+		_FaunaDescriptionList.GrpAlias.insert(_FaunaDescriptionList.GrpAlias.end(), context.FaunaDescriptionList.GrpAlias.begin(), context.FaunaDescriptionList.GrpAlias.end());
+		context.FaunaDescriptionList.Bots.clear();
+		context.FaunaDescriptionList.GrpAlias.clear();
+
+		_CreatureChangeHPList.Entities.insert(_CreatureChangeHPList.Entities.end(), context.CreatureChangeHPList.Entities.begin(), context.CreatureChangeHPList.Entities.end());
+		_CreatureChangeHPList.DeltaHp.insert(_CreatureChangeHPList.DeltaHp.end(), context.CreatureChangeHPList.DeltaHp.begin(), context.CreatureChangeHPList.DeltaHp.end());
+		context.CreatureChangeHPList.Entities.clear();
+		context.CreatureChangeHPList.DeltaHp.clear();
+
+		_CreatureChangeMaxHPList.Entities.insert(_CreatureChangeMaxHPList.Entities.end(), context.CreatureChangeMaxHPList.Entities.begin(), context.CreatureChangeMaxHPList.Entities.end());
+		_CreatureChangeMaxHPList.MaxHp.insert(_CreatureChangeMaxHPList.MaxHp.end(), context.CreatureChangeMaxHPList.MaxHp.begin(), context.CreatureChangeMaxHPList.MaxHp.end());
+		_CreatureChangeMaxHPList.SetFull.insert(_CreatureChangeMaxHPList.SetFull.end(), context.CreatureChangeMaxHPList.SetFull.begin(), context.CreatureChangeMaxHPList.SetFull.end());
+		context.CreatureChangeMaxHPList.Entities.clear();
+		context.CreatureChangeMaxHPList.MaxHp.clear();
+		context.CreatureChangeMaxHPList.SetFull.clear();
+	}
+}
+
+void	CAIS::setNbUpdateWorkers(uint nbWorkers)
+{
+	nbWorkers = std::max(nbWorkers, (uint)1);
+	if (nbWorkers == _UpdateWorkers.nbWorkers())
+		return;
+
+	_UpdateWorkers.init(nbWorkers);
+	nlinfo("AI instances updated by %u threads", nbWorkers);
+}
+
+void	CAIS::displayUpdateWorkers(CLog &log) const
+{
+	if (_UpdateWorkers.nbWorkers() <= 1)
+	{
+		log.displayNL("The AI instances are updated by the main thread");
+		return;
+	}
+
+	log.displayNL("Last parallel update of %u AI instances by %u threads:", _UpdatedInstances.size(), _UpdateWorkers.nbWorkers());
+	for (uint i=0; i<_UpdateWorkers.nbWorkers(); ++i)
+		log.displayNL("  worker %u: %u instances, %.3f ms", i, _UpdateWorkers.lastRunNbJobs(i), CTime::ticksToSecond(_UpdateWorkers.lastRunTicks(i))*1000.0);
+	for (uint i=0; i<_UpdatedInstances.size(); ++i)
+	{
+		const CAIInstance	*aii = _UpdatedInstances[i];
+		log.displayNL("  instance %u (%s): %.3f ms", aii->getInstanceNumber(), aii->getContinentName().c_str(), CTime::ticksToSecond(_UpdateContexts[aii->getChildIndex()]->LastUpdateTicks)*1000.0);
+	}
+}
+
 // provoke a general 'save to backup' across the whole service
 void CAIS::save()
 {
@@ -751,6 +894,7 @@ tryWithEntityId:
 
 CAIEntityPhysical	*CAIS::getEntityPhysical(const TDataSetRow&	row)
 {
+	CSharedDataLock	lock;
 	CHashMap<int,NLMISC::CDbgPtr<CAIEntityPhysical> >::iterator	it(_CAIEntityByDataSetRow.find(row.getIndex()));
 
 	if	(it!=_CAIEntityByDataSetRow.end())
@@ -24,6 +24,10 @@
 #include "server_share/msg_ai_service.h"
 #include "nel/misc/random.h"
 #include "nel/misc/variable.h"
+#include "nel/misc/mutex.h"
+#include "nel/misc/tds.h"
+#include "nel/misc/worker_pool.h"
+#include "game_share/synchronised_message.h"
 #include "ai_entity_matrix.h"
 #include "service_dependencies.h"
 #include "game_share/task_list.h"
@@ -50,6 +54,7 @@ extern	NLMISC::CVariable<uint32>	TotalMaxNpc;
 extern	NLMISC::CVariable<uint32>	TotalMaxFx;
 
 extern	NLMISC::CVariable<std::string>	BotRepopFx;
+extern	NLMISC::CVariable<uint32>	AIUpdateWorkers;
 
 
 template	<class	T>	class CAIEntityMatrix;
@@ -215,17 +220,71 @@ public:
 	
 	CFaunaBotDescription	&getFaunaDescription()
 	{
-		return _FaunaDescriptionList;
+		CUpdateContext	*context = getUpdateContext();
+		return context ? context->FaunaDescriptionList : _FaunaDescriptionList;
 	}
 	CChangeCreatureHPMsg	&getCreatureChangeHP()
 	{
-		return _CreatureChangeHPList;
+		CUpdateContext	*context = getUpdateContext();
+		return context ? context->CreatureChangeHPList : _CreatureChangeHPList;
 	}
 
 	CChangeCreatureMaxHPMsg &getCreatureChangeMaxHP()
 	{
-		return _CreatureChangeMaxHPList;
+		CUpdateContext	*context = getUpdateContext();
+		return context ? context->CreatureChangeMaxHPList : _CreatureChangeMaxHPList;
 	}
+
+	//-------------------------------------------------------------------
+	// Parallel update of the AI instances (see AIUpdateWorkers)
+
+	/** What an AI instance produces while it is updated by a worker thread: the messages
+	 *	it sends and its part of the systematic messages to EGS. They are sent by the main
+	 *	thread after the update, in the order of the instances, as in a serial update.
+	 *	The instance also has its own random number generator, so that its behaviour doesn't
+	 *	depend on the other instances updated at the same time.
+	 */
+	class CUpdateContext
+	{
+	public:
+		CSynchronisedMessageBuffer	Messages;
+		CFaunaBotDescription		FaunaDescriptionList;
+		CChangeCreatureHPMsg		CreatureChangeHPList;
+		CChangeCreatureMaxHPMsg		CreatureChangeMaxHPList;
+		NLMISC::CRandom				Random;
+		/// Duration of the last update of the instance
+		NLMISC::TTicks				LastUpdateTicks;
+
+		CUpdateContext() : LastUpdateTicks(0) {}
+	};
+
+	/// Return the context of the instance updated by the calling thread, NULL outside of a parallel update
+	static CUpdateContext	*getUpdateContext()
+	{
+		return _ParallelUpdate ? (CUpdateContext*)_UpdateContextTDS.getPointer() : NULL;
+	}
+
+	/// Return true while the AI instances are updated by several threads
+	static bool	isParallelUpdate()	{ return _ParallelUpdate; }
+
+	/** Lock of the data that are shared by all the AI instances (the entity maps, the bot
+	 *	counters, the ticked tasks and the mirror rows). It is only taken during a parallel
+	 *	update, so it costs nothing to the serial update.
+	 */
+	class CSharedDataLock
+	{
+	public:
+		CSharedDataLock() : _Locked(_ParallelUpdate)	{ if (_Locked) _SharedDataMutex.enter(); }
+		~CSharedDataLock()								{ if (_Locked) _SharedDataMutex.leave(); }
+	private:
+		bool	_Locked;
+	};
+
+	/// Set the number of threads updating the AI instances
+	void	setNbUpdateWorkers(uint nbWorkers);
+
+	/// Display the time spent by each worker and each instance in the last parallel update
+	void	displayUpdateWorkers(NLMISC::CLog &log) const;
 	
 	enum	TSearchType
 	{
@@ -248,8 +307,8 @@ public:
 		virtual ~CCounter()
 		{}
 		void	setMax(const uint32 max)	{	_Max=max;		}
-		void	inc()		{	_Total++;	}
-		void	dec()		{	_Total--;	}
+		void	inc()		{	CSharedDataLock lock; _Total++;	}
+		void	dec()		{	CSharedDataLock lock; _Total--;	}
 		uint32	getTotal()	const	{	return _Total;	}
 		bool	remainToMax	(uint32 nbMore=1)	const	{ return (_Total+nbMore)<_Max; }
 	protected:
@@ -265,7 +324,7 @@ public:
 	// message from EGS about bad aiinstance 
 	void warnBadInstanceMsgImp(const std::string &serviceName, NLNET::TServiceId serviceId, CWarnBadInstanceMsgImp &msg);
 
-	void addTickedTask(uint32 tick, CTask<uint32>* task) { _TickedTaskList.addTaskAt(tick, task); }
+	void addTickedTask(uint32 tick, CTask<uint32>* task) { CSharedDataLock lock; _TickedTaskList.addTaskAt(tick, task); }
 	
 
 private:
@@ -285,6 +344,8 @@ private:
 	
 	// the random number generator
 	static	NLMISC::CRandom	_random;
+	// the random number generator of the instance being updated by the calling thread
+	static inline NLMISC::CRandom &random();
 
 	CAIEntityMatrixIteratorTblRandom			_matrixIterator2x2;
 	CAIEntityMatrixIteratorTblRandom			_matrixIterator3x3;
@@ -302,6 +363,20 @@ private:
 	uint32	_TotalBotsSpawned;
 	bool	_ClientCreatureDebug;
 	CTaskList<uint32> _TickedTaskList;
+
+	// update the AI instances with the update workers
+	void	updateInstancesInParallel();
+
+	// the threads updating the AI instances
+	NLMISC::CWorkerPool				_UpdateWorkers;
+	// the update contexts, indexed by the child index of the instances
+	std::vector<CUpdateContext*>	_UpdateContexts;
+	// the instances updated by the last parallel update
+	std::vector<CAIInstance*>		_UpdatedInstances;
+
+	static	bool					_ParallelUpdate;
+	static	NLMISC::CTDS			_UpdateContextTDS;
+	static	NLMISC::CMutex			_SharedDataMutex;
 };
 
 
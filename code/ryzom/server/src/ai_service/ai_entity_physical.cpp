@@ -64,6 +64,7 @@ CAIEntityPhysicalLocator* CAIEntityPhysicalLocator::getInstance()
 
 CAIEntityPhysical* CAIEntityPhysicalLocator::getEntity(TDataSetRow const& row) const
 {
+	CAIS::CSharedDataLock lock;
 	std::map<TDataSetRow, CAIEntityPhysical*>::const_iterator it = _EntitiesByRow.find(row);
 	if (it!=_EntitiesByRow.end())
 		return it->second;
@@ -73,6 +74,7 @@ CAIEntityPhysical* CAIEntityPhysicalLocator::getEntity(TDataSetRow const& row) c
 
 CAIEntityPhysical* CAIEntityPhysicalLocator::getEntity(NLMISC::CEntityId const& id) const
 {
+	CAIS::CSharedDataLock lock;
 	std::map<NLMISC::CEntityId, CAIEntityPhysical*>::const_iterator it = _EntitiesById.find(id);
 	if (it!=_EntitiesById.end())
 		return it->second;
@@ -82,12 +84,14 @@ CAIEntityPhysical* CAIEntityPhysicalLocator::getEntity(NLMISC::CEntityId const&
 
 void CAIEntityPhysicalLocator::addEntity(TDataSetRow const& row, NLMISC::CEntityId const& id, CAIEntityPhysical* entity)
 {
+	CAIS::CSharedDataLock lock;
 	_EntitiesByRow.insert(std::make_pair(row, entity));
 	_EntitiesById.insert(std::make_pair(id, entity));
 }
 
 void CAIEntityPhysicalLocator::delEntity(TDataSetRow const& row, NLMISC::CEntityId const& id, CAIEntityPhysical* entity)
 {
+	CAIS::CSharedDataLock lock;
 	_EntitiesById.erase(id);
 	_EntitiesByRow.erase(row);
 }
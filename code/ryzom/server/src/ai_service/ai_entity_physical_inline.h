@@ -70,6 +70,7 @@ CAIEntityPhysical::CAIEntityPhysical(CPersistentOfPhysical& owner, TDataSetRow c
 	_InOutpostAlias.init	(*CMirrors::DataSet, entityIndex, DSPropertyIN_OUTPOST_ZONE_ALIAS);
 	_InOutpostSide.init		(*CMirrors::DataSet, entityIndex, DSPropertyIN_OUTPOST_ZONE_SIDE);
 
+	CAIS::CSharedDataLock	lock;
 #ifdef NL_DEBUG
 	const NLMISC::CDbgRefCount<CAIEntityPhysical>	&ref=*(static_cast<NLMISC::CDbgRefCount<CAIEntityPhysical> * const>(this));
 	NLMISC::CDbgPtr<CAIEntityPhysical>	dummyPtr;
@@ -106,7 +107,10 @@ CAIEntityPhysical::~CAIEntityPhysical()
 	}
 	
 	detachFromTargeting();
-	CAIS::instance()._CAIEntityByDataSetRow.erase(dataSetRow().getIndex());
+	{
+		CAIS::CSharedDataLock	lock;
+		CAIS::instance()._CAIEntityByDataSetRow.erase(dataSetRow().getIndex());
+	}
 
 #ifdef NL_DEBUG
 	nlassert(ref.getDbgRef(dummyPtr)==0);
@@ -31,13 +31,20 @@
 */
 //-------------------------------------------------------------------
 // Interface to the random number generator
-inline sint32 CAIS::randPlusMinus(uint16 mod)	{ return _random.randPlusMinus(mod); }
-inline float CAIS::frand(double mod)			{ return _random.frand(mod); }
-inline float CAIS::frandPlusMinus(double mod)	{ return _random.frandPlusMinus(mod); }
+inline NLMISC::CRandom &CAIS::random()
+{
+	CUpdateContext	*context = getUpdateContext();
+	return context ? context->Random : _random;
+}
+
+inline sint32 CAIS::randPlusMinus(uint16 mod)	{ return random().randPlusMinus(mod); }
+inline float CAIS::frand(double mod)			{ return random().frand(mod); }
+inline float CAIS::frandPlusMinus(double mod)	{ return random().frandPlusMinus(mod); }
 
 inline uint32 CAIS::rand32()
 { 
-	return ((uint32(_random.rand()))<<16)+uint32(_random.rand());
+	NLMISC::CRandom	&rnd = random();
+	return ((uint32(rnd.rand()))<<16)+uint32(rnd.rand());
 }
 inline uint32 CAIS::rand32(uint32 mod)
 { 
@@ -49,7 +56,7 @@ inline uint32 CAIS::rand16(uint32 mod)
 { 
 	if (mod==0)
 		return	0;
-	return _random.rand()%mod;
+	return random().rand()%mod;
 }
 
 //-------------------------------------------------------------------
@@ -19,6 +19,7 @@
 #include "stdpch.h"
 #include "aids_interface.h"
 #include "ai_share/aids_messages.h"
+#include "game_share/synchronised_message.h"
 
 using namespace NLMISC;
 using namespace NLNET;
@@ -60,18 +61,21 @@ void CAIDSInterface::release()
 void CAIDSInterface::info(const std::string &s)
 {
 	string str = string("AIS: %3d: INF: ")+s;
-	CMsgAIFeedback(str).send("AIDS");
+	CMsgAIFeedback msg(str);
+	sendTransportClassDirect(msg, "AIDS");
 }
 
 void CAIDSInterface::debug(const std::string &s)
 {
 	string str = string("AIS: %3d: DBG: ")+s;
-	CMsgAIFeedback(str).send("AIDS");
+	CMsgAIFeedback msg(str);
+	sendTransportClassDirect(msg, "AIDS");
 }
 
 void CAIDSInterface::warning(const std::string &s)
 {
 	string str = string("AIS: %3d: WRN: ")+s;
-	CMsgAIFeedback(str).send("AIDS");
+	CMsgAIFeedback msg(str);
+	sendTransportClassDirect(msg, "AIDS");
 }
 
@@ -43,6 +43,7 @@
 #include "ais_user_models.h"
 
 extern bool GrpHistoryRecordLog;
+extern NLMISC::CVariable<bool> AIScriptOptimize;
 extern NLLIGO::CLigoConfig LigoConfig;
 
 using namespace NLMISC;
@@ -1710,6 +1711,83 @@ NLMISC_COMMAND(script2,"execute a script for groups containing a bot matching th
 	return true;
 }
 
+NLMISC_COMMAND(benchAIScript,"run a script file many times for the first group matching the given filter, without and with the byte code optimizer, and display the time per run and the opcode rate (the variables of the group are modified)","<groupFilter> <nbRuns> [<scriptFile>(default bench_ai_script.txt)]")
+{
+	if (args.size()<2 || args.size()>3)
+		return false;
+	
+	uint32 nbRuns;
+	NLMISC::fromString(args[1], nbRuns);
+	if (nbRuns==0)
+		return false;
+	string const fileName = (args.size()>2)?args[2]:string("bench_ai_script.txt");
+	
+	vector<CGroup*> grps;
+	buildFilteredGroupList(grps, args[0]);
+	CPersistentStateInstance* stateInstance = NULL;
+	for (size_t i=0; i<grps.size() && stateInstance==NULL; ++i)
+		stateInstance = grps[i]->getPersistentStateInstance();
+	if (stateInstance==NULL)
+	{
+		log.displayNL("No group correspond to name %s", args[0].c_str());
+		return true;
+	}
+	
+	string const path = CPath::lookup(fileName, false);
+	if (path.empty())
+	{
+		log.displayNL("Script file %s not found", fileName.c_str());
+		return true;
+	}
+	vector<string> lines;
+	{
+		CIFile file(path);
+		while (!file.eof())
+		{
+			const size_t bufferSize = 4*1024;
+			char buffer[bufferSize];
+			file.getline(buffer, bufferSize);
+			lines.push_back(buffer);
+		}
+	}
+	// compile the script without the optimizer, then optimize it
+	bool const optimize = AIScriptOptimize;
+	AIScriptOptimize = false;
+	CSmartPtr<const CByteCode> codePtr = CCompiler::getInstance().compileCode(lines, fileName);
+	AIScriptOptimize = optimize;
+	if (codePtr==NULL)
+	{
+		log.displayNL("Failed to compile %s", fileName.c_str());
+		return true;
+	}
+	CSmartPtr<const CByteCode> const optimizedCodePtr = CCompiler::getInstance().optimizeByteCode(codePtr);
+	
+	log.displayNL("%u runs of %s for group %s:", nbRuns, fileName.c_str(), stateInstance->getContextName().c_str());
+	for (uint pass=0; pass<2; ++pass)
+	{
+		CSmartPtr<const CByteCode> const& code = (pass==0)?codePtr:optimizedCodePtr;
+		TTicks const start = CTime::getPerformanceTime();
+		for (uint32 i=0; i<nbRuns; ++i)
+			stateInstance->interpretCode(NULL, code);
+		double const time = CTime::ticksToSecond(CTime::getPerformanceTime()-start);
+		
+		// count the opcodes of the same runs with the counting interpreter, out of the timing
+		CScriptVM* const vm = CScriptVM::getInstance();
+		uint64 const startOpcodes = vm->getNbInterpretedOpcodes();
+		vm->setCountOpcodes(true);
+		for (uint32 i=0; i<nbRuns; ++i)
+			stateInstance->interpretCode(NULL, code);
+		vm->setCountOpcodes(false);
+		uint64 const nbOpcodes = vm->getNbInterpretedOpcodes()-startOpcodes;
+		
+		// NB : the optimized code runs fewer (fused) opcodes, compare the time per run rather than the opcode rates
+		log.displayNL("  %s: %u words, %.3f ms, %.3f us per run, %.1f opcodes per run, %.2f M opcodes/s",
+			(pass==0)?"original ":"optimized", (uint32)code->_opcodes.size(), time*1000., time*1000000./nbRuns,
+			(double)nbOpcodes/nbRuns, (time>0.)?(double)nbOpcodes/time/1000000.:0.);
+	}
+	return true;
+}
+
 static std::string scriptHex_decode(std::string str)
 {
 	std::string output;
@@ -3235,5 +3313,14 @@ NLMISC_COMMAND(deletePersistentVar, "deletes an AI script persistent var", "")
 	return false;
 }
 
+NLMISC_COMMAND(displayAIUpdateWorkers, "display the time spent by each thread and each AI instance in the last parallel update", "")
+{
+	if (args.size() != 0)
+		return false;
+
+	CAIS::instance().displayUpdateWorkers(log);
+	return true;
+}
+
 
 //----------------------------------------------------------------------------
@@ -18,6 +18,7 @@
 #define RYAI_EVENT_REACTION_CONTAINER_H
 
 #include "event_manager.h"
+#include "script_vm.h"
 
 class CPersistentStateInstance;
 
@@ -27,7 +28,7 @@ class CStateMachine
 #endif
 {
 public:
-	CStateMachine() { }
+	CStateMachine() : _LogicVarLayout(new AIVM::CLogicVarLayout) { }
 	virtual ~CStateMachine()
 	{
 		clearEventContainerContent ();
@@ -171,10 +172,14 @@ public:
 	CAliasCont<CAIState>& states() { return _states; }
 	CAliasCont<CAIState> const& cstStates() const { return _states; }
 	
+	/// Position of the logic variables in the groups of the state machine
+	AIVM::CLogicVarLayout* getLogicVarLayout() { return _LogicVarLayout; }
+	
 protected:
 	CAliasCont<CAIState> _states;
 	CAliasCont<CAIEventReaction> _eventReactions;
 	std::map<std::string,NLMISC::CDbgPtr<CAIEvent> > _eventNameMap;
+	NLMISC::CSmartPtr<AIVM::CLogicVarLayout> _LogicVarLayout;
 };
 
 #endif
@@ -1912,7 +1912,7 @@ public:
 				bh.Data = (uint16)(CTimeInterface::gameCycle());
 				msgout.serial(bh);
 
-				NLNET::CUnifiedNetwork::getInstance()->send( "EGS", msgout );
+				sendMessageDirect( "EGS", msgout );
 			}
 
 		}
@@ -3065,7 +3065,7 @@ void CAILogicActionDssStartActHelper::dssStartAct(TSessionId sessionId, uint32 a
 	NLNET::CMessage	msgout("DSS_START_ACT");		
 	msgout.serial(sessionId);
 	msgout.serial(actId);
-	NLNET::CUnifiedNetwork::getInstance()->send("DSS",msgout);
+	sendMessageDirect("DSS",msgout);
 }
 
 //----------------------------------------------------------------------
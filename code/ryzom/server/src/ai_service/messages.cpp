@@ -193,7 +193,7 @@ void CMessages::notifyBotDespawn(NLNET::TServiceId serviceId, uint32 botAlias, c
 	CMessage msgout("BOT_DESPAWN_NOTIFICATION");
 	msgout.serial(botAlias);
 	msgout.serial(const_cast<NLMISC::CEntityId&>(botId));
-	CUnifiedNetwork::getInstance()->send(serviceId, msgout);
+	sendMessageDirect(serviceId, msgout);
 }
 
 
@@ -202,7 +202,7 @@ void CMessages::notifyBotDeath(NLNET::TServiceId serviceId, uint32 botAlias, con
 	CMessage msgout("BOT_DEATH_NOTIFICATION");
 	msgout.serial(botAlias);
 	msgout.serial(const_cast<NLMISC::CEntityId&>(botId));
-	CUnifiedNetwork::getInstance()->send(serviceId, msgout);
+	sendMessageDirect(serviceId, msgout);
 }
 
 void CMessages::notifyBotStopNpcControl(NLNET::TServiceId serviceId, uint32 botAlias, const NLMISC::CEntityId& botId)
@@ -210,7 +210,7 @@ void CMessages::notifyBotStopNpcControl(NLNET::TServiceId serviceId, uint32 botA
 	CMessage msgout("BOT_STOPCCONTROL_NOTIFICATION");
 	msgout.serial(botAlias);
 	msgout.serial(const_cast<NLMISC::CEntityId&>(botId));
-	CUnifiedNetwork::getInstance()->send(serviceId, msgout);
+	sendMessageDirect(serviceId, msgout);
 }
 
 //--------------------------------------------------------------------------
@@ -457,6 +457,7 @@ bool CMirrors::mirrorIsReady()
 
 TDataSetRow	CMirrors::createEntity( CEntityId& entityId )
 {
+	CAIS::CSharedDataLock lock;
 	// in ais, we always use entityId auto asigment by mirror
 	if	(Mirror.createEntity( entityId , true))
 		return	DataSet->getDataSetRow( entityId );
@@ -467,12 +468,14 @@ TDataSetRow	CMirrors::createEntity( CEntityId& entityId )
 
 void CMirrors::declareEntity( const TDataSetRow& entityIndex )
 {
+	CAIS::CSharedDataLock lock;
 	DataSet->declareEntity( entityIndex ); // only in the main dataset
 }
 
 
 void CMirrors::removeEntity( const CEntityId& entityId )
 {
+	CAIS::CSharedDataLock lock;
 	Mirror.removeEntity( entityId );
 }
 
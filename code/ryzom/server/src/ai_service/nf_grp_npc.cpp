@@ -2497,7 +2497,7 @@ void emote_css_(CStateInstance* entity, CScriptStack& stack)
 	bh.Data = (uint16)(CTimeInterface::gameCycle());
 	msgout.serial(bh);
 
-	NLNET::CUnifiedNetwork::getInstance()->send( "EGS", msgout );
+	sendMessageDirect( "EGS", msgout );
 }
 
 
@@ -2528,7 +2528,7 @@ void emote_ss_(CStateInstance* entity, CScriptStack& stack)
 	bh.Data = (uint16)(CTimeInterface::gameCycle());
 	msgout.serial(bh);
 
-	NLNET::CUnifiedNetwork::getInstance()->send( "EGS", msgout );
+	sendMessageDirect( "EGS", msgout );
 }
 
 
@@ -2568,7 +2568,7 @@ void emote_s_(CStateInstance* entity, CScriptStack& stack)
 						bh.Data = (uint16)(CTimeInterface::gameCycle());
 						msgout.serial(bh);
 
-						NLNET::CUnifiedNetwork::getInstance()->send( "EGS", msgout );
+						sendMessageDirect( "EGS", msgout );
 					}
 				}
 			}
@@ -39,6 +39,8 @@ static std::string const s_kw_case         = "case";
 using namespace std;
 using namespace NLMISC;
 
+extern NLMISC::CVariable<bool> AIScriptOptimize;
+
 //////////////////////////////////////////////////////////////////////////
 // A Small Custom Compiler For AI.
 // (Token and Grammar are Upgradable, Error returns have to be upgraded).
@@ -58,7 +60,8 @@ namespace AICOMP
 //////////////////////////////////////////////////////////////////////////////
 
 CScriptNativeFuncParams::CScriptNativeFuncParams(const std::string &str, FScrptNativeFunc func)
-	: _func(func)
+	: _signature(str)
+	, _func(func)
 	, _va(false)
 {
 	const size_t lastPartIndex2=str.find_last_of("_", string::npos);
@@ -1006,6 +1009,7 @@ CCompiler::CCompiler()
 	REGISTER_OPCODE(ASSIGN_FUNC_FROM);
 	
 	REGISTER_OPCODE(NATIVE_CALL);
+	REGISTER_OPCODE(NATIVE_CALL_DIRECT);
 	REGISTER_OPCODE(RAND);
 	REGISTER_OPCODE(RANDEND);
 	
@@ -1127,6 +1131,9 @@ CSmartPtr<const AIVM::CByteCode> CCompiler::compileCode (const string &sourceCod
 		CSmartPtr<const AIVM::CByteCode> oldbyteCode = compileCodeOld (sourceCode, fullName, debug);
 	}
 
+	if (AIScriptOptimize)
+		byteCode = optimizeByteCode (byteCode);
+
 	return byteCode;
 }
 
@@ -1890,6 +1897,35 @@ void CSubRuleTracer::getSignature(string &signature, bool inOtherWiseOut) const
 		(*childIt)->getSignature(signature,inOtherWiseOut);
 }
 
+// Kind of the logic variable whose name is the operand of an opcode (NbKinds if it isn't a variable)
+static AIVM::CLogicVarSlots::TKind getVarOperandKind(AIVM::CScriptVM::EOpcode op)
+{
+	using namespace AIVM;
+	
+	switch (op)
+	{
+	case CScriptVM::SET_VAR_VAL:
+	case CScriptVM::PUSH_VAR_VAL:
+	case CScriptVM::SET_CONTEXT_VAR_VAL:
+	case CScriptVM::PUSH_CONTEXT_VAR_VAL:
+	case CScriptVM::PUSH_PRINT_VAR:
+		return CLogicVarSlots::Float;
+	case CScriptVM::SET_STR_VAR_VAL:
+	case CScriptVM::PUSH_STR_VAR_VAL:
+	case CScriptVM::SET_CONTEXT_STR_VAR_VAL:
+	case CScriptVM::PUSH_CONTEXT_STR_VAR_VAL:
+	case CScriptVM::PUSH_PRINT_STR_VAR:
+		return CLogicVarSlots::String;
+	case CScriptVM::SET_CTX_VAR_VAL:
+	case CScriptVM::PUSH_CTX_VAR_VAL:
+	case CScriptVM::SET_CONTEXT_CTX_VAR_VAL:
+	case CScriptVM::PUSH_CONTEXT_CTX_VAR_VAL:
+		return CLogicVarSlots::Context;
+	default:
+		return CLogicVarSlots::NbKinds;
+	}
+}
+
 void CSubRuleTracer::generateCode(CSmartPtr<AIVM::CByteCode> &cByteCode) const
 {
 	using namespace AIVM;
@@ -1919,11 +1955,16 @@ void CSubRuleTracer::generateCode(CSmartPtr<AIVM::CByteCode> &cByteCode) const
 	if (!_subRule.isNull())
 	{
 
+		// the variables are accessed by slot, so the name following a variable opcode is replaced by its slot
+		CLogicVarSlots::TKind varKind=CLogicVarSlots::NbKinds;
+		
 		FOREACHC(instrIt, vector<string>, _subRule->_ExecOpCodes)
 		{
 			const string str=*instrIt;
 			string param;
 			const CScriptVM::EOpcode op=CCompiler::getOpcodeAndValue(str, param);
+			const CLogicVarSlots::TKind operandKind=varKind;
+			varKind=(op!=CScriptVM::INVALID_OPCODE)?getVarOperandKind(op):CLogicVarSlots::NbKinds;
 
 			if (op!=CScriptVM::INVALID_OPCODE) // it could something else than an instruction.
 			{
@@ -1974,7 +2015,10 @@ void CSubRuleTracer::generateCode(CSmartPtr<AIVM::CByteCode> &cByteCode) const
 						strId=CStringMapper::map(strRef.substr(1,strRef.size()-2));
 					else
 						strId=CStringMapper::map(strRef);
-					byteCode.push_back(*((size_t*)&strId));
+					if (operandKind!=CLogicVarSlots::NbKinds)
+						byteCode.push_back(CLogicVarSlots::getSlot(operandKind, strId));
+					else
+						byteCode.push_back(*((size_t*)&strId));
 					jumpTable.newCodeBlock();
 					break;
 				}
@@ -2069,11 +2113,22 @@ void CSubRuleTracer::generateCode(CSmartPtr<AIVM::CByteCode> &cByteCode) const
 					if (funcParam->_va)
 						mode |= 1; // :KLUDGE: Hardcoded 1 :TODO: replace with a named constant
 					
-					byteCode.push_back(CScriptVM::NATIVE_CALL);
-				//	byteCode.push_back(*((size_t*)&funcParam));
+					// The function is linked now: the VM calls it directly instead of looking it
+					// up by name on each call (the functions are registered once for all at
+					// startup, so the pointer remains valid). The deprecated functions have no
+					// implementation and still go through the lookup.
 					TStringId strId;
-					strId = CStringMapper::map(funcName);
-					byteCode.push_back(*((size_t*)&strId));
+					if (funcParam->_func!=NULL)
+					{
+						byteCode.push_back(CScriptVM::NATIVE_CALL_DIRECT);
+						byteCode.push_back((size_t)funcParam);
+					}
+					else
+					{
+						byteCode.push_back(CScriptVM::NATIVE_CALL);
+						strId = CStringMapper::map(funcName);
+						byteCode.push_back(*((size_t*)&strId));
+					}
 					byteCode.push_back(mode);
 					strId = CStringMapper::map(inParamsSig);
 					byteCode.push_back(*((size_t*)&strId));
@@ -50,6 +50,7 @@ class CScriptNativeFuncParams : public NLMISC::CRefCount
 public:
 	CScriptNativeFuncParams(const std::string &str, FScrptNativeFunc func);
 	virtual ~CScriptNativeFuncParams() { }
+	std::string _signature;
 	size_t _nbInParams;
 	size_t _nbOutParams;
 	bool _va;
@@ -280,6 +281,9 @@ public:
 	// New compiler using lex & yacc
 	NLMISC::CSmartPtr<AIVM::CByteCode const> compileCodeYacc(std::string const& sourceCode, std::string const& fullName, bool dump, bool win32report) const;
 	
+	// Peephole optimizer of the byte code (constant folding and superinstructions), return byteCode if it can't be optimized
+	NLMISC::CSmartPtr<AIVM::CByteCode const> optimizeByteCode(NLMISC::CSmartPtr<AIVM::CByteCode const> const& byteCode) const;
+	
 	// Old compiler
 	NLMISC::CSmartPtr<AIVM::CByteCode const> compileCodeOld(std::string const& sourceCode, std::string const& fullName, bool dump) const;
 	
@@ -0,0 +1,428 @@
+// Ryzom - MMORPG Framework <http://dev.ryzom.com/projects/ryzom/>
+// Copyright (C) 2010  Winch Gate Property Limited
+//
+// This program is free software: you can redistribute it and/or modify
+// it under the terms of the GNU Affero General Public License as
+// published by the Free Software Foundation, either version 3 of the
+// License, or (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU Affero General Public License for more details.
+//
+// You should have received a copy of the GNU Affero General Public License
+// along with this program.  If not, see <http://www.gnu.org/licenses/>.
+
+#include "stdpch.h"
+
+#include "script_vm.h"
+#include "script_compiler.h"
+
+using namespace std;
+using namespace NLMISC;
+using namespace AIVM;
+using namespace AICOMP;
+
+CVariable<bool>	AIScriptOptimize("aiscript", "AIScriptOptimize", "Optimize the byte code of the scripts when they are compiled.", true, 0, true);
+
+/*
+ * The optimizer works on the instructions of the byte code, rewriting some
+ * sequences in fewer instructions: the constant expressions are folded and the
+ * most frequent accesses to the float variables are fused in superinstructions
+ * that don't use the stack.
+ * A sequence is only rewritten if no jump lands inside it, then all the jump
+ * offsets are relocated. The byte code is not modified if it contains an opcode
+ * or a jump that the optimizer doesn't understand.
+ */
+
+namespace
+{
+
+typedef CScriptVM	VM;
+
+/// Maximum number of optimization passes (a pass can make new sequences appear)
+const uint	MaxPasses = 8;
+
+// Number of words (opcode and operands) of the instruction at index, 0 if the opcode is unknown
+size_t getInstructionSize(vector<size_t> const& opcodes, size_t index)
+{
+	switch (opcodes[index])
+	{
+	case VM::EOP:
+	case VM::EQ:
+	case VM::NEQ:
+	case VM::INF:
+	case VM::INFEQ:
+	case VM::SUP:
+	case VM::SUPEQ:
+	case VM::ADD:
+	case VM::SUB:
+	case VM::MUL:
+	case VM::DIV:
+	case VM::AND:
+	case VM::OR:
+	case VM::NOT:
+	case VM::POP:
+	case VM::PRINT_STRING:
+	case VM::LOG_STRING:
+	case VM::PUSH_THIS:
+	case VM::ASSIGN_FUNC_FROM:
+	case VM::RANDEND:
+	case VM::RET:
+	case VM::ONCHILDREN:
+	case VM::INCR:
+	case VM::DECR:
+	case VM::CONCAT:
+	case VM::FTOS:
+		return 1;
+	case VM::PUSH_ON_STACK:
+	case VM::SET_VAR_VAL:
+	case VM::SET_STR_VAR_VAL:
+	case VM::SET_CTX_VAR_VAL:
+	case VM::PUSH_VAR_VAL:
+	case VM::PUSH_STR_VAR_VAL:
+	case VM::PUSH_CTX_VAR_VAL:
+	case VM::SET_CONTEXT_VAR_VAL:
+	case VM::SET_CONTEXT_STR_VAR_VAL:
+	case VM::SET_CONTEXT_CTX_VAR_VAL:
+	case VM::PUSH_CONTEXT_VAR_VAL:
+	case VM::PUSH_CONTEXT_STR_VAR_VAL:
+	case VM::PUSH_CONTEXT_CTX_VAR_VAL:
+	case VM::JUMP:
+	case VM::JE:
+	case VM::JNE:
+	case VM::PUSH_PRINT_STRING:
+	case VM::PUSH_PRINT_VAR:
+	case VM::PUSH_PRINT_STR_VAR:
+	case VM::FUNCTION:
+	case VM::CALL:
+	case VM::PUSH_GROUP:
+	case VM::PUSH_STRING:
+	case VM::RAND:
+	case VM::INCR_VAR:
+	case VM::DECR_VAR:
+	case VM::SET_PUSH_VAR_VAL:
+		return 2;
+	case VM::SET_VAR_CONST:
+	case VM::COPY_VAR_VAL:
+		return 3;
+	case VM::VAR_OP_CONST:
+		return 4;
+	case VM::NATIVE_CALL:
+	case VM::NATIVE_CALL_DIRECT:
+	case VM::JE_VAR_OP_CONST:
+		return 5;
+	case VM::SWITCH:
+		// SWITCH, case count, return offset then a key and an offset for each case
+		if (index+1<opcodes.size() && opcodes[index+1]<opcodes.size())
+			return 3+2*opcodes[index+1];
+		return 0;
+	default:
+		return 0;
+	}
+}
+
+// Add the positions of the jump offsets of the instruction at index (an offset at pos jumps to pos+opcodes[pos])
+void getJumpOffsets(vector<size_t> const& opcodes, size_t index, vector<size_t>& offsets)
+{
+	switch (opcodes[index])
+	{
+	case VM::JUMP:
+	case VM::JE:
+	case VM::JNE:
+		offsets.push_back(index+1);
+		break;
+	case VM::JE_VAR_OP_CONST:
+		offsets.push_back(index+4);
+		break;
+	case VM::SWITCH:
+		offsets.push_back(index+2);
+		for (size_t i=0; i<opcodes[index+1]; ++i)
+			offsets.push_back(index+4+2*i);
+		break;
+	default:
+		break;
+	}
+}
+
+bool isFloatOp(size_t opcode)
+{
+	return opcode>=VM::EQ && opcode<=VM::OR;
+}
+
+// The float constants are stored in the first bytes of the opcode word (see the lexer)
+float wordToFloat(size_t word)
+{
+	float f;
+	memcpy(&f, &word, sizeof(f));
+	return f;
+}
+
+size_t floatToWord(float f)
+{
+	size_t word = 0;
+	memcpy(&word, &f, sizeof(f));
+	return word;
+}
+
+/// One optimization pass over the byte code
+class COptimizerPass
+{
+public:
+	COptimizerPass(vector<size_t> const& code) : _Code(code) { }
+
+	/// Decode the instructions and the jumps, return false if the code can't be optimized
+	bool decode();
+	/// Write the rewritten code in result, return false if nothing was rewritten
+	bool rewrite(vector<size_t>& result);
+
+private:
+	size_t opcode(size_t instr) const { return instr<_Starts.size()?_Code[_Starts[instr]]:(size_t)VM::INVALID_OPCODE; }
+	size_t operand(size_t instr, size_t n) const { return _Code[_Starts[instr]+n]; }
+	size_t jumpTarget(size_t pos) const { return pos+_Code[pos]; }
+	/// True if the nb instructions from instr exist and nothing jumps after the first one
+	bool isSequence(size_t instr, size_t nb) const;
+	/// Try to rewrite the instructions at instr, return the number of replaced instructions
+	size_t rewriteSequence(size_t instr);
+	void emitJump(size_t opcode, size_t target);
+
+	vector<size_t> const&	_Code;
+	/// Index of each instruction in the code
+	vector<size_t>			_Starts;
+	/// For each index of the code (and its end), true if an instruction starts there
+	vector<bool>			_IsStart;
+	/// For each index of the code (and its end), true if a jump or an entry point lands there
+	vector<bool>			_IsTarget;
+
+	/// Rewritten code, with the new index of each old index and the jump offsets to relocate
+	vector<size_t>*			_Result;
+	vector<size_t>			_NewIndex;
+	vector<pair<size_t, size_t> >	_Relocations;
+};
+
+bool COptimizerPass::decode()
+{
+	size_t const size = _Code.size();
+	_IsStart.assign(size+1, false);
+	_IsTarget.assign(size+1, false);
+	_IsStart[size] = true;
+	for (size_t index=0; index<size; )
+	{
+		size_t const instrSize = getInstructionSize(_Code, index);
+		if (instrSize==0 || instrSize>size-index)
+			return false;
+		_Starts.push_back(index);
+		_IsStart[index] = true;
+		index += instrSize;
+	}
+
+	vector<size_t> offsets;
+	vector<size_t> targets;
+	for (size_t i=0; i<_Starts.size(); ++i)
+	{
+		size_t const index = _Starts[i];
+		getJumpOffsets(_Code, index, offsets);
+		// the functions and the onchildren blocks are entered after their initial jump
+		if (_Code[index]==VM::FUNCTION)
+			targets.push_back(index+4);
+		else if (_Code[index]==VM::ONCHILDREN)
+			targets.push_back(index+3);
+	}
+	for (size_t i=0; i<offsets.size(); ++i)
+		targets.push_back(jumpTarget(offsets[i]));
+	for (size_t i=0; i<targets.size(); ++i)
+	{
+		if (targets[i]>size || !_IsStart[targets[i]])
+			return false;
+		_IsTarget[targets[i]] = true;
+	}
+	return true;
+}
+
+bool COptimizerPass::isSequence(size_t instr, size_t nb) const
+{
+	if (instr+nb>_Starts.size())
+		return false;
+	for (size_t i=1; i<nb; ++i)
+	{
+		if (_IsTarget[_Starts[instr+i]])
+			return false;
+	}
+	return true;
+}
+
+void COptimizerPass::emitJump(size_t opcode, size_t target)
+{
+	_Result->push_back(opcode);
+	_Relocations.push_back(make_pair(_Result->size(), target));
+	_Result->push_back(0);
+}
+
+size_t COptimizerPass::rewriteSequence(size_t instr)
+{
+	vector<size_t>& result = *_Result;
+	size_t const op0 = opcode(instr);
+	size_t const op1 = opcode(instr+1);
+	size_t const op2 = opcode(instr+2);
+
+	if (op0==VM::PUSH_ON_STACK)
+	{
+		float const value = wordToFloat(operand(instr, 1));
+		// constant expressions
+		if (op1==VM::PUSH_ON_STACK && isFloatOp(op2) && isSequence(instr, 3))
+		{
+			result.push_back(VM::PUSH_ON_STACK);
+			result.push_back(floatToWord(VM::applyFloatOp(op2, value, wordToFloat(operand(instr+1, 1)))));
+			return 3;
+		}
+		if ((op1==VM::NOT || op1==VM::INCR || op1==VM::DECR) && isSequence(instr, 2))
+		{
+			result.push_back(VM::PUSH_ON_STACK);
+			result.push_back(floatToWord(op1==VM::NOT?(value==0.f?1.f:0.f):(op1==VM::INCR?value+1.f:value-1.f)));
+			return 2;
+		}
+		// constant conditions (while (1) for example)
+		if ((op1==VM::JE || op1==VM::JNE) && isSequence(instr, 2))
+		{
+			if ((value==0.f) == (op1==VM::JE))
+				emitJump(VM::JUMP, jumpTarget(_Starts[instr+1]+1));
+			return 2;
+		}
+		if (op1==VM::SET_VAR_VAL && isSequence(instr, 2))
+		{
+			result.push_back(VM::SET_VAR_CONST);
+			result.push_back(operand(instr+1, 1));
+			result.push_back(operand(instr, 1));
+			return 2;
+		}
+	}
+	else if (op0==VM::PUSH_VAR_VAL)
+	{
+		size_t const slot = operand(instr, 1);
+		// var++, var--
+		if ((op1==VM::INCR || op1==VM::DECR) && op2==VM::SET_VAR_VAL && operand(instr+2, 1)==slot && isSequence(instr, 3))
+		{
+			result.push_back(op1==VM::INCR?VM::INCR_VAR:VM::DECR_VAR);
+			result.push_back(slot);
+			return 3;
+		}
+		if (op1==VM::PUSH_ON_STACK && isFloatOp(op2) && isSequence(instr, 3))
+		{
+			result.push_back(VM::VAR_OP_CONST);
+			result.push_back(slot);
+			result.push_back(operand(instr+1, 1));
+			result.push_back(op2);
+			return 3;
+		}
+		if (op1==VM::SET_VAR_VAL && isSequence(instr, 2))
+		{
+			result.push_back(VM::COPY_VAR_VAL);
+			result.push_back(slot);
+			result.push_back(operand(instr+1, 1));
+			return 2;
+		}
+	}
+	else if (op0==VM::VAR_OP_CONST)
+	{
+		// conditions of the if and while statements
+		if (op1==VM::JE && isSequence(instr, 2))
+		{
+			result.push_back(VM::JE_VAR_OP_CONST);
+			result.push_back(operand(instr, 1));
+			result.push_back(operand(instr, 2));
+			result.push_back(operand(instr, 3));
+			_Relocations.push_back(make_pair(result.size(), jumpTarget(_Starts[instr+1]+1)));
+			result.push_back(0);
+			return 2;
+		}
+	}
+	else if (op0==VM::SET_VAR_VAL)
+	{
+		// a variable read just after it's written
+		if (op1==VM::PUSH_VAR_VAL && operand(instr+1, 1)==operand(instr, 1) && isSequence(instr, 2))
+		{
+			result.push_back(VM::SET_PUSH_VAR_VAL);
+			result.push_back(operand(instr, 1));
+			return 2;
+		}
+	}
+	return 0;
+}
+
+bool COptimizerPass::rewrite(vector<size_t>& result)
+{
+	_Result = &result;
+	result.clear();
+	result.reserve(_Code.size());
+	_NewIndex.assign(_Code.size()+1, 0);
+	_Relocations.clear();
+
+	bool rewritten = false;
+	vector<size_t> offsets;
+	for (size_t instr=0; instr<_Starts.size(); )
+	{
+		size_t const index = _Starts[instr];
+		size_t const newIndex = result.size();
+		size_t const nbReplaced = rewriteSequence(instr);
+		if (nbReplaced!=0)
+		{
+			// nothing jumps inside the sequence, all its instructions map on the rewritten one
+			for (size_t i=0; i<nbReplaced; ++i)
+				_NewIndex[_Starts[instr+i]] = newIndex;
+			instr += nbReplaced;
+			rewritten = true;
+			continue;
+		}
+
+		// copy the instruction, its jumps are relocated below
+		size_t const nextIndex = (instr+1<_Starts.size())?_Starts[instr+1]:_Code.size();
+		_NewIndex[index] = newIndex;
+		result.insert(result.end(), _Code.begin()+index, _Code.begin()+nextIndex);
+		offsets.clear();
+		getJumpOffsets(_Code, index, offsets);
+		for (size_t i=0; i<offsets.size(); ++i)
+			_Relocations.push_back(make_pair(newIndex+offsets[i]-index, jumpTarget(offsets[i])));
+		++instr;
+	}
+	_NewIndex[_Code.size()] = result.size();
+
+	for (size_t i=0; i<_Relocations.size(); ++i)
+	{
+		size_t const pos = _Relocations[i].first;
+		result[pos] = _NewIndex[_Relocations[i].second]-pos;
+	}
+	return rewritten;
+}
+
+}
+
+CSmartPtr<const AIVM::CByteCode> CCompiler::optimizeByteCode(CSmartPtr<const AIVM::CByteCode> const& byteCode) const
+{
+	if (byteCode.isNull())
+		return byteCode;
+
+	vector<size_t> code = byteCode->_opcodes;
+	vector<size_t> optimizedCode;
+	bool optimized = false;
+	for (uint i=0; i<MaxPasses; ++i)
+	{
+		COptimizerPass pass(code);
+		if (!pass.decode())
+		{
+			if (optimized)
+				nlwarning("Failed to decode the optimized byte code of %s, keeping the original code", byteCode->_sourceName.c_str());
+			return byteCode;
+		}
+		if (!pass.rewrite(optimizedCode))
+			break;
+		code.swap(optimizedCode);
+		optimized = true;
+	}
+	if (!optimized)
+		return byteCode;
+
+	CSmartPtr<AIVM::CByteCode> optimizedByteCode = new AIVM::CByteCode(byteCode->_sourceName);
+	optimizedByteCode->_opcodes.swap(code);
+	return &(*optimizedByteCode);
+}
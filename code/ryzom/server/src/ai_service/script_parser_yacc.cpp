@@ -408,15 +408,39 @@ void nativeFunc (CByteCodeYacc &dest, size_t name, const char *in, const char *o
 		inStrId = CStringMapper::map(inParamsSig);
 		outStrId = CStringMapper::map(outParamsSig);
 		
-		// Add the node
-		addNode (dest, CScriptVM::NATIVE_CALL);
-		addNode (dest, name);
+		// Add the node, linked to the function unless it is a deprecated one (see CSubRuleTracer::generateCode())
+		if (funcParam->_func!=NULL)
+		{
+			addNode (dest, CScriptVM::NATIVE_CALL_DIRECT);
+			addNode (dest, (size_t)funcParam);
+		}
+		else
+		{
+			addNode (dest, CScriptVM::NATIVE_CALL);
+			addNode (dest, name);
+		}
 		addNode (dest, mode);
 		addNode (dest, *((size_t*)&inStrId));
 		addNode (dest, *((size_t*)&outStrId));
 	}
 }
 
+// Slot of a logic variable, written in the byte code in place of its name (see CLogicVarSlots)
+size_t floatVar (const AICOMP::COpcodeYacc &name)
+{
+	return CLogicVarSlots::getSlot (CLogicVarSlots::Float, (TStringId)name.Opcode);
+}
+
+size_t strVar (const AICOMP::COpcodeYacc &name)
+{
+	return CLogicVarSlots::getSlot (CLogicVarSlots::String, (TStringId)name.Opcode);
+}
+
+size_t ctxVar (const AICOMP::COpcodeYacc &name)
+{
+	return CLogicVarSlots::getSlot (CLogicVarSlots::Context, (TStringId)name.Opcode);
+}
+
 #define NODE0(dest) createNode (dest);
 #define NODE1(dest,a) createNode (dest); addNode (dest, a);
 #define NODE2(dest,a,b) createNode (dest); addNode (dest, a); addNode (dest, b);
@@ -1685,7 +1709,7 @@ yyreduce:
 
   case 14:
 #line 405 "ai_service/script_parser.yacc"
-    { NODE2 (yyval.ByteCode, CScriptVM::PUSH_CTX_VAR_VAL, yyvsp[-1].Opcode); ;}
+    { NODE2 (yyval.ByteCode, CScriptVM::PUSH_CTX_VAR_VAL, ctxVar (yyvsp[-1].Opcode)); ;}
     break;
 
   case 15:
@@ -1806,7 +1830,7 @@ yyreduce:
   case 36:
 #line 465 "ai_service/script_parser.yacc"
     { 
-					NODE2 (yyval.ByteCode, CScriptVM::PUSH_VAR_VAL, yyvsp[0].Opcode);
+					NODE2 (yyval.ByteCode, CScriptVM::PUSH_VAR_VAL, floatVar (yyvsp[0].Opcode));
 					TYPEF (yyval.ByteCode);
 				;}
     break;
@@ -1814,7 +1838,7 @@ yyreduce:
   case 37:
 #line 475 "ai_service/script_parser.yacc"
     {
-					NODE3 (yyval.ByteCode, yyvsp[-1].ByteCode, CScriptVM::PUSH_CONTEXT_VAR_VAL, yyvsp[0].Opcode);
+					NODE3 (yyval.ByteCode, yyvsp[-1].ByteCode, CScriptVM::PUSH_CONTEXT_VAR_VAL, floatVar (yyvsp[0].Opcode));
 					TYPEF (yyval.ByteCode); 
 				;}
     break;
@@ -1822,7 +1846,7 @@ yyreduce:
   case 38:
 #line 480 "ai_service/script_parser.yacc"
     { 
-					NODE2 (yyval.ByteCode, CScriptVM::PUSH_STR_VAR_VAL, yyvsp[0].Opcode);
+					NODE2 (yyval.ByteCode, CScriptVM::PUSH_STR_VAR_VAL, strVar (yyvsp[0].Opcode));
 					TYPES (yyval.ByteCode);
 				;}
     break;
@@ -1830,7 +1854,7 @@ yyreduce:
   case 39:
 #line 490 "ai_service/script_parser.yacc"
     { 
-					NODE3 (yyval.ByteCode, yyvsp[-1].ByteCode, CScriptVM::PUSH_CONTEXT_STR_VAR_VAL, yyvsp[0].Opcode);
+					NODE3 (yyval.ByteCode, yyvsp[-1].ByteCode, CScriptVM::PUSH_CONTEXT_STR_VAR_VAL, strVar (yyvsp[0].Opcode));
 					TYPES (yyval.ByteCode);
 				;}
     break;
@@ -1838,7 +1862,7 @@ yyreduce:
   case 40:
 #line 495 "ai_service/script_parser.yacc"
     { 
-					NODE2 (yyval.ByteCode, CScriptVM::PUSH_CTX_VAR_VAL, yyvsp[0].Opcode);
+					NODE2 (yyval.ByteCode, CScriptVM::PUSH_CTX_VAR_VAL, ctxVar (yyvsp[0].Opcode));
 					TYPEC (yyval.ByteCode);
 				;}
     break;
@@ -1846,7 +1870,7 @@ yyreduce:
   case 41:
 #line 505 "ai_service/script_parser.yacc"
     { 
-					NODE3 (yyval.ByteCode, yyvsp[-1].ByteCode, CScriptVM::PUSH_CONTEXT_CTX_VAR_VAL, yyvsp[0].Opcode);
+					NODE3 (yyval.ByteCode, yyvsp[-1].ByteCode, CScriptVM::PUSH_CONTEXT_CTX_VAR_VAL, ctxVar (yyvsp[0].Opcode));
 					TYPEC (yyval.ByteCode);
 				;}
     break;
@@ -1869,32 +1893,32 @@ yyreduce:
 
   case 44:
 #line 520 "ai_service/script_parser.yacc"
-    { NODE2 (yyval.ByteCode, CScriptVM::SET_VAR_VAL, yyvsp[0].Opcode); TYPEF (yyval.ByteCode); ;}
+    { NODE2 (yyval.ByteCode, CScriptVM::SET_VAR_VAL, floatVar (yyvsp[0].Opcode)); TYPEF (yyval.ByteCode); ;}
     break;
 
   case 45:
 #line 522 "ai_service/script_parser.yacc"
-    { NODE3 (yyval.ByteCode, yyvsp[-1].ByteCode, CScriptVM::SET_CONTEXT_VAR_VAL, yyvsp[0].Opcode); TYPEF (yyval.ByteCode); ;}
+    { NODE3 (yyval.ByteCode, yyvsp[-1].ByteCode, CScriptVM::SET_CONTEXT_VAR_VAL, floatVar (yyvsp[0].Opcode)); TYPEF (yyval.ByteCode); ;}
     break;
 
   case 46:
 #line 523 "ai_service/script_parser.yacc"
-    { NODE2 (yyval.ByteCode, CScriptVM::SET_STR_VAR_VAL, yyvsp[0].Opcode); TYPES (yyval.ByteCode); ;}
+    { NODE2 (yyval.ByteCode, CScriptVM::SET_STR_VAR_VAL, strVar (yyvsp[0].Opcode)); TYPES (yyval.ByteCode); ;}
     break;
 
   case 47:
 #line 525 "ai_service/script_parser.yacc"
-    { NODE3 (yyval.ByteCode, yyvsp[-1].ByteCode, CScriptVM::SET_CONTEXT_STR_VAR_VAL, yyvsp[0].Opcode); TYPES (yyval.ByteCode); ;}
+    { NODE3 (yyval.ByteCode, yyvsp[-1].ByteCode, CScriptVM::SET_CONTEXT_STR_VAR_VAL, strVar (yyvsp[0].Opcode)); TYPES (yyval.ByteCode); ;}
     break;
 
   case 48:
 #line 526 "ai_service/script_parser.yacc"
-    { NODE2 (yyval.ByteCode, CScriptVM::SET_CTX_VAR_VAL, yyvsp[0].Opcode); TYPEC (yyval.ByteCode); ;}
+    { NODE2 (yyval.ByteCode, CScriptVM::SET_CTX_VAR_VAL, ctxVar (yyvsp[0].Opcode)); TYPEC (yyval.ByteCode); ;}
     break;
 
   case 49:
 #line 528 "ai_service/script_parser.yacc"
-    { NODE3 (yyval.ByteCode, yyvsp[-1].ByteCode, CScriptVM::SET_CONTEXT_CTX_VAR_VAL, yyvsp[0].Opcode); TYPEC (yyval.ByteCode); ;}
+    { NODE3 (yyval.ByteCode, yyvsp[-1].ByteCode, CScriptVM::SET_CONTEXT_CTX_VAR_VAL, ctxVar (yyvsp[0].Opcode)); TYPEC (yyval.ByteCode); ;}
     break;
 
   case 50:
@@ -1957,22 +1981,22 @@ yyreduce:
 
   case 61:
 #line 548 "ai_service/script_parser.yacc"
-    { NODE3 (yyval.ByteCode, yyvsp[-2].ByteCode, CScriptVM::PUSH_PRINT_VAR, yyvsp[0].Opcode); ;}
+    { NODE3 (yyval.ByteCode, yyvsp[-2].ByteCode, CScriptVM::PUSH_PRINT_VAR, floatVar (yyvsp[0].Opcode)); ;}
     break;
 
   case 62:
 #line 549 "ai_service/script_parser.yacc"
-    { NODE2 (yyval.ByteCode, CScriptVM::PUSH_PRINT_VAR, yyvsp[0].Opcode); ;}
+    { NODE2 (yyval.ByteCode, CScriptVM::PUSH_PRINT_VAR, floatVar (yyvsp[0].Opcode)); ;}
     break;
 
   case 63:
 #line 550 "ai_service/script_parser.yacc"
-    { NODE3 (yyval.ByteCode, yyvsp[-2].ByteCode, CScriptVM::PUSH_PRINT_STR_VAR, yyvsp[0].Opcode); ;}
+    { NODE3 (yyval.ByteCode, yyvsp[-2].ByteCode, CScriptVM::PUSH_PRINT_STR_VAR, strVar (yyvsp[0].Opcode)); ;}
     break;
 
   case 64:
 #line 551 "ai_service/script_parser.yacc"
-    { NODE2 (yyval.ByteCode, CScriptVM::PUSH_PRINT_STR_VAR, yyvsp[0].Opcode); ;}
+    { NODE2 (yyval.ByteCode, CScriptVM::PUSH_PRINT_STR_VAR, strVar (yyvsp[0].Opcode)); ;}
     break;
 
   case 65:
@@ -2146,27 +2170,27 @@ yyreduce:
 
   case 95:
 #line 611 "ai_service/script_parser.yacc"
-    { NODE5 (yyval.ByteCode, CScriptVM::PUSH_VAR_VAL, yyvsp[-2].Opcode, yyvsp[-1].Opcode, CScriptVM::SET_VAR_VAL, yyvsp[-2].Opcode); ;}
+    { NODE5 (yyval.ByteCode, CScriptVM::PUSH_VAR_VAL, floatVar (yyvsp[-2].Opcode), yyvsp[-1].Opcode, CScriptVM::SET_VAR_VAL, floatVar (yyvsp[-2].Opcode)); ;}
     break;
 
   case 96:
 #line 612 "ai_service/script_parser.yacc"
-    { NODE5 (yyval.ByteCode, CScriptVM::PUSH_VAR_VAL, yyvsp[-1].Opcode, yyvsp[-2].Opcode, CScriptVM::SET_VAR_VAL, yyvsp[-1].Opcode); ;}
+    { NODE5 (yyval.ByteCode, CScriptVM::PUSH_VAR_VAL, floatVar (yyvsp[-1].Opcode), yyvsp[-2].Opcode, CScriptVM::SET_VAR_VAL, floatVar (yyvsp[-1].Opcode)); ;}
     break;
 
   case 97:
 #line 614 "ai_service/script_parser.yacc"
-    { NODE7 (yyval.ByteCode, yyvsp[-3].ByteCode, CScriptVM::PUSH_CONTEXT_VAR_VAL, yyvsp[-2].Opcode, yyvsp[-1].Opcode, yyvsp[-3].ByteCode, CScriptVM::SET_CONTEXT_VAR_VAL, yyvsp[-2].Opcode); ;}
+    { NODE7 (yyval.ByteCode, yyvsp[-3].ByteCode, CScriptVM::PUSH_CONTEXT_VAR_VAL, floatVar (yyvsp[-2].Opcode), yyvsp[-1].Opcode, yyvsp[-3].ByteCode, CScriptVM::SET_CONTEXT_VAR_VAL, floatVar (yyvsp[-2].Opcode)); ;}
     break;
 
   case 98:
 #line 616 "ai_service/script_parser.yacc"
-    { NODE7 (yyval.ByteCode, yyvsp[-2].ByteCode, CScriptVM::PUSH_CONTEXT_VAR_VAL, yyvsp[-1].Opcode, yyvsp[-3].Opcode, yyvsp[-2].ByteCode, CScriptVM::SET_CONTEXT_VAR_VAL, yyvsp[-1].Opcode); ;}
+    { NODE7 (yyval.ByteCode, yyvsp[-2].ByteCode, CScriptVM::PUSH_CONTEXT_VAR_VAL, floatVar (yyvsp[-1].Opcode), yyvsp[-3].Opcode, yyvsp[-2].ByteCode, CScriptVM::SET_CONTEXT_VAR_VAL, floatVar (yyvsp[-1].Opcode)); ;}
     break;
 
   case 99:
 #line 617 "ai_service/script_parser.yacc"
-    { NODE6 (yyval.ByteCode, CScriptVM::PUSH_VAR_VAL, yyvsp[-3].Opcode, yyvsp[-1].ByteCode, yyvsp[-2].Operator, CScriptVM::SET_VAR_VAL, yyvsp[-3].Opcode); ;}
+    { NODE6 (yyval.ByteCode, CScriptVM::PUSH_VAR_VAL, floatVar (yyvsp[-3].Opcode), yyvsp[-1].ByteCode, yyvsp[-2].Operator, CScriptVM::SET_VAR_VAL, floatVar (yyvsp[-3].Opcode)); ;}
     break;
 
   case 100:
@@ -2181,7 +2205,7 @@ yyreduce:
 
   case 102:
 #line 621 "ai_service/script_parser.yacc"
-    { NODE8 (yyval.ByteCode, yyvsp[-4].ByteCode, CScriptVM::PUSH_CONTEXT_VAR_VAL, yyvsp[-4].ByteCode, yyvsp[-1].ByteCode, yyvsp[-2].Operator, yyvsp[-4].ByteCode, CScriptVM::SET_CONTEXT_VAR_VAL, yyvsp[-3].Opcode); ;}
+    { NODE8 (yyval.ByteCode, yyvsp[-4].ByteCode, CScriptVM::PUSH_CONTEXT_VAR_VAL, floatVar (yyvsp[-3].Opcode), yyvsp[-1].ByteCode, yyvsp[-2].Operator, yyvsp[-4].ByteCode, CScriptVM::SET_CONTEXT_VAR_VAL, floatVar (yyvsp[-3].Opcode)); ;}
     break;
 
   case 103:
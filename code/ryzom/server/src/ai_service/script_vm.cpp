@@ -18,6 +18,7 @@
 
 #include "script_vm.h"
 #include "script_compiler.h"
+#include "ai.h"
 
 using namespace std;
 using namespace NLMISC;
@@ -82,6 +83,74 @@ void CLibrary::addLib(std::string const& name, NLMISC::CSmartPtr<CByteCode const
 	_libs.insert(std::make_pair(name, byteCode));
 }
 
+//////////////////////////////////////////////////////////////////////////////
+// Logic variables                                                          //
+//////////////////////////////////////////////////////////////////////////////
+
+CLogicVarSlots::TSlotMap CLogicVarSlots::_Slots[CLogicVarSlots::NbKinds];
+std::vector<TStringId> CLogicVarSlots::_Names[CLogicVarSlots::NbKinds];
+
+// NB : the scripts may be compiled by the AI instances updated in parallel
+uint32 CLogicVarSlots::getSlot(TKind kind, TStringId name)
+{
+	CAIS::CSharedDataLock lock;
+	TSlotMap::iterator it = _Slots[kind].find(name);
+	if (it!=_Slots[kind].end())
+		return it->second;
+	uint32 slot = (uint32)_Names[kind].size();
+	_Names[kind].push_back(name);
+	_Slots[kind].insert(std::make_pair(name, slot));
+	return slot;
+}
+
+uint32 CLogicVarSlots::findSlot(TKind kind, TStringId name)
+{
+	CAIS::CSharedDataLock lock;
+	TSlotMap::const_iterator it = _Slots[kind].find(name);
+	if (it!=_Slots[kind].end())
+		return it->second;
+	return InvalidSlot;
+}
+
+TStringId CLogicVarSlots::getName(TKind kind, uint32 slot)
+{
+	CAIS::CSharedDataLock lock;
+	nlassert(slot<_Names[kind].size());
+	return _Names[kind][slot];
+}
+
+uint32 CLogicVarSlots::getNbSlots(TKind kind)
+{
+	CAIS::CSharedDataLock lock;
+	return (uint32)_Names[kind].size();
+}
+
+uint32 CLogicVarLayout::addIndex(CLogicVarSlots::TKind kind, uint32 slot)
+{
+	std::vector<uint32>& indices = _Indices[kind];
+	if (slot>=indices.size())
+		indices.resize(slot+1, InvalidIndex);
+	nlassert(indices[slot]==InvalidIndex);
+
+	CValue value;
+	value.Name = CLogicVarSlots::getName(kind, slot);
+	value.ChangeIndex = (kind!=CLogicVarSlots::Context)?getChangeIndex(value.Name):-1;
+	indices[slot] = (uint32)_Values[kind].size();
+	_Values[kind].push_back(value);
+	return indices[slot];
+}
+
+sint32 CLogicVarLayout::getChangeIndex(TStringId name)
+{
+	if (name && name->size() == 2 && (*name)[0] == 'v')
+	{
+		sint32 index = (*name)[1] - '0';
+		if (0 <= index && index < 4)
+			return index;
+	}
+	return -1;
+}
+
 //////////////////////////////////////////////////////////////////////////////
 // Virtual machine                                                          //
 //////////////////////////////////////////////////////////////////////////////
@@ -113,11 +182,75 @@ void CScriptVM::destroyInstance()
 	}
 }
 
+// Remove the params and push default results of a native function call that can't be done
+static void rebuildNativeCallStack(string const& inParamsSig, string const& outParamsSig, CScriptStack& stack)
+{
+	for (size_t i=0; i<inParamsSig.length(); ++i)
+		stack.pop();
+	for (size_t i=0; i<outParamsSig.length(); ++i)
+	{
+		switch (outParamsSig[i])
+		{
+		case 'f': stack.push(0.f); break;
+		case 's': stack.push(string()); break;
+		case 'c': stack.push((IScriptContext*)0); break;
+		default: nlassert("Unknown parameter type in native function call while rebuilding stack");
+		}
+	}
+}
+
+uint32 CScriptVM::rand32(uint32 mod)
+{
+	if (mod==0) return 0;
+	// the instances updated in parallel each have their own random generator
+	if (CAIS::isParallelUpdate())
+		return CAIS::rand32(mod);
+	return ((((uint32)_Random.rand())<<16) + (uint32)_Random.rand()) % mod;
+}
+
+// With gcc the opcodes are dispatched with a table of label addresses: each opcode
+// ends with its own indirect jump, which is better predicted than the single jump of
+// the switch (the switch is still used to enter the loop and with the other compilers).
+#if defined(__GNUC__) && !defined(AI_SCRIPT_VM_NO_COMPUTED_GOTO)
+#	define AI_SCRIPT_VM_COMPUTED_GOTO
+#endif
+
+#ifdef AI_SCRIPT_VM_COMPUTED_GOTO
+#	define VM_CASE(op)	case op: label_##op:
+#	define VM_NEXT \
+	{ \
+		if (index>=opcodes.size()) \
+			return; \
+		if (CountOpcodes) \
+			++_NbInterpretedOpcodes; \
+		size_t const nextOpcode = opcodes[index]; \
+		goto *dispatchTable[nextOpcode<NB_OPCODES?nextOpcode:(size_t)INVALID_OPCODE]; \
+	}
+#else
+#	define VM_CASE(op)	case op:
+#	define VM_NEXT		continue
+#endif
+
 void CScriptVM::interpretCode(
 	IScriptContext* thisContext,
 	IScriptContext* parentContext,
 	IScriptContext* callerContext,
 	CByteCodeEntry const& codeScriptEntry)
+{
+	// the opcodes are counted by another instantiation of the interpreter, so that
+	// the normal one has no counter to update
+	if (_CountOpcodes && !CAIS::isParallelUpdate())
+		interpretCodeT<true>(thisContext, parentContext, callerContext, codeScriptEntry);
+	else
+		interpretCodeT<false>(thisContext, parentContext, callerContext, codeScriptEntry);
+}
+
+template <bool CountOpcodes>
+void CScriptVM::interpretCodeT(
+	IScriptContext* thisContext,
+	IScriptContext* parentContext,
+	IScriptContext* callerContext,
+	CByteCodeEntry const& codeScriptEntry)
 {
 	NLMISC::CSmartPtr<CByteCode const> const& byteCode = codeScriptEntry.code();
 	size_t startIndex = codeScriptEntry.index();
@@ -132,71 +265,96 @@ void CScriptVM::interpretCode(
 	size_t index = startIndex;
 	string currentString;
 	
+#ifdef AI_SCRIPT_VM_COMPUTED_GOTO
+	// Labels of the opcodes, in the EOpcode order
+	static void* const dispatchTable[] =
+	{
+		&&label_INVALID_OPCODE,	&&label_EOP,
+		&&label_EQ,	&&label_NEQ,	&&label_INF,	&&label_INFEQ,	&&label_SUP,	&&label_SUPEQ,
+		&&label_ADD,	&&label_SUB,	&&label_MUL,	&&label_DIV,	&&label_AND,	&&label_OR,	&&label_NOT,
+		&&label_PUSH_ON_STACK,	&&label_POP,
+		&&label_SET_VAR_VAL,	&&label_SET_STR_VAR_VAL,	&&label_SET_CTX_VAR_VAL,
+		&&label_PUSH_VAR_VAL,	&&label_PUSH_STR_VAR_VAL,	&&label_PUSH_CTX_VAR_VAL,
+		&&label_SET_CONTEXT_VAR_VAL,	&&label_SET_CONTEXT_STR_VAR_VAL,	&&label_SET_CONTEXT_CTX_VAR_VAL,
+		&&label_PUSH_CONTEXT_VAR_VAL,	&&label_PUSH_CONTEXT_STR_VAR_VAL,	&&label_PUSH_CONTEXT_CTX_VAR_VAL,
+		&&label_JUMP,	&&label_JE,	&&label_JNE,
+		&&label_PUSH_PRINT_STRING,	&&label_PUSH_PRINT_VAR,	&&label_PUSH_PRINT_STR_VAR,	&&label_PRINT_STRING,	&&label_LOG_STRING,
+		&&label_FUNCTION,	&&label_CALL,	&&label_PUSH_THIS,	&&label_PUSH_GROUP,	&&label_PUSH_STRING,	&&label_ASSIGN_FUNC_FROM,
+		&&label_NATIVE_CALL,	&&label_RAND,	&&label_INVALID_OPCODE /* RANDEND */,	&&label_RET,	&&label_ONCHILDREN,	&&label_SWITCH,
+		&&label_INCR,	&&label_DECR,	&&label_CONCAT,	&&label_FTOS,	&&label_NATIVE_CALL_DIRECT,
+		&&label_INCR_VAR,	&&label_DECR_VAR,	&&label_SET_VAR_CONST,	&&label_COPY_VAR_VAL,	&&label_SET_PUSH_VAR_VAL,
+		&&label_VAR_OP_CONST,	&&label_JE_VAR_OP_CONST,
+	};
+	nlctassert(sizeof(dispatchTable)/sizeof(dispatchTable[0])==NB_OPCODES);
+#endif
+	
 	while (index < opcodes.size())
 	{
 	#if !FINAL_VERSION
 		EOpcode	op = (EOpcode)opcodes[index];
 	#endif
+		if (CountOpcodes)
+			++_NbInterpretedOpcodes;
 		
 		switch (opcodes[index])
 		{
 		default:
-		case	INVALID_OPCODE:
+		VM_CASE(INVALID_OPCODE)
 			nlwarning("Invalid Opcode for Group '%s' with code in '%s'", thisContext->getContextName().c_str(), byteCode->_sourceName.c_str());
 			nlassert(false);
 			break;
-		case	EOP:
+		VM_CASE(EOP)
 			return;		//	End Of Program
 
-		case	EQ:		//	==		Need: Value1: Value2 After: Value1==Value2 (Boolean as float)
+		VM_CASE(EQ)		//	==		Need: Value1: Value2 After: Value1==Value2 (Boolean as float)
 			{
 				const	float	res=stack.top(1)==stack.top()?1.f:0.f;
 				stack.pop();
 				stack.top()=res;
 				++index;
 			}
-			continue;
-		case	NEQ:	//	!=		Need: Value1: Value2 After: Value1!=Value2 (Boolean as float)
+			VM_NEXT;
+		VM_CASE(NEQ)	//	!=		Need: Value1: Value2 After: Value1!=Value2 (Boolean as float)
 			{
 				const	float	res=stack.top(1)!=stack.top()?1.f:0.f;
 				stack.pop();
 				stack.top()=res;
 				index++;
 			}
-			continue;
-		case	INF:	//	<		Need: Value1: Value2 After: Value1<Value2 (Boolean as float)
+			VM_NEXT;
+		VM_CASE(INF)	//	<		Need: Value1: Value2 After: Value1<Value2 (Boolean as float)
 			{
 				const	float	res=stack.top(1)<stack.top()?1.f:0.f;
 				stack.pop();
 				stack.top()=res;
 				index++;
 			}
-			continue;
-		case	INFEQ:	//	<=		Need: Value1: Value2 After: Value1<=Value2 (Boolean as float)
+			VM_NEXT;
+		VM_CASE(INFEQ)	//	<=		Need: Value1: Value2 After: Value1<=Value2 (Boolean as float)
 			{
 				const	float	res=stack.top(1)<=stack.top()?1.f:0.f;
 				stack.pop();
 				stack.top()=res;
 				index++;
 			}
-			continue;
-		case	SUP:	//	>		Need: Value1: Value2 After: Value1>Value2 (Boolean as float)
+			VM_NEXT;
+		VM_CASE(SUP)	//	>		Need: Value1: Value2 After: Value1>Value2 (Boolean as float)
 			{
 				const	float	res=stack.top(1)>stack.top()?1.f:0.f;
 				stack.pop();
 				stack.top()=res;
 				index++;
 			}
-			continue;
-		case	SUPEQ:	//	>=		Need: Value1: Value2 After: Value1>=Value2 (Boolean as float)
+			VM_NEXT;
+		VM_CASE(SUPEQ)	//	>=		Need: Value1: Value2 After: Value1>=Value2 (Boolean as float)
 			{
 				const	float	res=stack.top(1)>=stack.top()?1.f:0.f;
 				stack.pop();
 				stack.top()=res;
 				index++;
 			}
-			continue;
-		case	ADD:	//	+		Need: Value1: Value2 After: Value1+Value2
+			VM_NEXT;
+		VM_CASE(ADD)	//	+		Need: Value1: Value2 After: Value1+Value2
 			{
 				CScriptStack::CStackEntry	&entry0=stack.top();
 				CScriptStack::CStackEntry	&entry1=stack.top(1);
@@ -230,24 +388,24 @@ void CScriptVM::interpretCode(
 				stack.pop();
 				index++;
 			}
-			continue;
-		case	SUB:	//	-		Need: Value1: Value2 After: Value1-Value2
+			VM_NEXT;
+		VM_CASE(SUB)	//	-		Need: Value1: Value2 After: Value1-Value2
 			{
 				const	float	val=stack.top();
 				stack.pop();
 				(float&)stack.top()-=val;
 				index++;
 			}
-			continue;
-		case	MUL:	//	*		Need: Value1: Value2 After: Value1/Value2
+			VM_NEXT;
+		VM_CASE(MUL)	//	*		Need: Value1: Value2 After: Value1/Value2
 			{
 				float	&res=stack.top(1);
 				res*=(float&)stack.top();
 				stack.pop();
 				index++;
 			}
-			continue;
-		case	DIV:	//	/		Need: Value1: Value2 After: Value1/Value2	!Exception Gestion.
+			VM_NEXT;
+		VM_CASE(DIV)	//	/		Need: Value1: Value2 After: Value1/Value2	!Exception Gestion.
 			{
 				float	&res=stack.top(1);
 				const	float	&divisor=stack.top();
@@ -258,8 +416,8 @@ void CScriptVM::interpretCode(
 				stack.pop();
 				index++;
 			}
-			continue;
-		case	AND:	//	&&		Need: Value1: Value2 After: Value1&&Value2
+			VM_NEXT;
+		VM_CASE(AND)	//	&&		Need: Value1: Value2 After: Value1&&Value2
 			{
 				const	bool	val1=(float&)stack.top(1)!=0.f;
 				const	bool	val2=(float&)stack.top()!=0.f;
@@ -267,8 +425,8 @@ void CScriptVM::interpretCode(
 				stack.top()=(val1&&val2)?1.f:0.f;
 				index++;
 			}
-			continue;
-		case	OR:		//	||		Need: Value1: Value2 After: Value1||Value2
+			VM_NEXT;
+		VM_CASE(OR)		//	||		Need: Value1: Value2 After: Value1||Value2
 			{
 				const	bool	val1=(float&)stack.top(1)!=0.f;
 				const	bool	val2=(float&)stack.top()!=0.f;
@@ -276,27 +434,27 @@ void CScriptVM::interpretCode(
 				stack.top()=(val1||val2)?1.f:0.f;
 				index++;
 			}
-			continue;
-		case	NOT:	//	!		Need: Value After: !Value
+			VM_NEXT;
+		VM_CASE(NOT)	//	!		Need: Value After: !Value
 			{
 				float	&val=stack.top();
 				val=(val==0.f)?1.f:0.f;
 				index++;
 			}
-			continue;
-		case	PUSH_ON_STACK:	//	Set a Value (float)						Need: - After: Value(float)
+			VM_NEXT;
+		VM_CASE(PUSH_ON_STACK)	//	Set a Value (float)						Need: - After: Value(float)
 			{
 				stack.push(*((float*)&opcodes[index+1]));
 				index+=2;
 			}
-			continue;
-		case	POP:		//	Pop										Need: ValToPop After: -
+			VM_NEXT;
+		VM_CASE(POP)		//	Pop										Need: ValToPop After: -
 			{
 				stack.pop();
 				index++;
 			}
-			continue;
-		case	SET_VAR_VAL:		//	Set a Value to a Var.				Need: VarName:	VarValue After:	-
+			VM_NEXT;
+		VM_CASE(SET_VAR_VAL)		//	Set a Value to a Var.				Need: VarName:	VarValue After:	-
 			{
 				float f = 0.0f;
 				switch	(stack.top().type())
@@ -316,73 +474,73 @@ void CScriptVM::interpretCode(
 					nlwarning("Stack top type invalid, poping top value!");
 				}
 				stack.pop();
-				thisContext->setLogicVar(*((TStringId*)&opcodes[index+1]), f);
+				thisContext->setLogicVarBySlot((uint32)opcodes[index+1], f);
 				index+=2;
 			}
-			continue;
-		case	SET_STR_VAR_VAL:		//	Set a Value to a Var.				Need: VarName:	VarValue After:	-
+			VM_NEXT;
+		VM_CASE(SET_STR_VAR_VAL)		//	Set a Value to a Var.				Need: VarName:	VarValue After:	-
 			{
 				switch (stack.top().type())
 				{
 				case CScriptStack::EString:
 					{
-						thisContext->setStrLogicVar(*((TStringId*)&opcodes[index+1]), stack.top());
+						thisContext->setStrLogicVarBySlot((uint32)opcodes[index+1], stack.top());
 					}
 					break;
 				case CScriptStack::EFloat:
 					{
 						float const& val = stack.top();
-						thisContext->setStrLogicVar(*((TStringId*)&opcodes[index+1]),NLMISC::toString("%g", val));
+						thisContext->setStrLogicVarBySlot((uint32)opcodes[index+1],NLMISC::toString("%g", val));
 					}
 					break;
 				default:
 					nlwarning("Stack top type invalid, poping top value!");
-					thisContext->setStrLogicVar(*((TStringId*)&opcodes[index+1]),std::string());
+					thisContext->setStrLogicVarBySlot((uint32)opcodes[index+1],std::string());
 				}
 				stack.pop();
 				index+=2;
 			}
-			continue;
-		case	SET_CTX_VAR_VAL:		//	Set a Value to a Var.				Need: VarName:	VarValue After:	-
+			VM_NEXT;
+		VM_CASE(SET_CTX_VAR_VAL)		//	Set a Value to a Var.				Need: VarName:	VarValue After:	-
 			{
 				switch (stack.top().type())
 				{
 				case CScriptStack::EContext:
 					{
-						thisContext->setCtxLogicVar(*((TStringId*)&opcodes[index+1]), stack.top());
+						thisContext->setCtxLogicVarBySlot((uint32)opcodes[index+1], stack.top());
 					}
 					break;
 				default:
 					nlwarning("Stack top type invalid, poping top value!");
-					thisContext->setCtxLogicVar(*((TStringId*)&opcodes[index+1]), (IScriptContext*)0);
+					thisContext->setCtxLogicVarBySlot((uint32)opcodes[index+1], (IScriptContext*)0);
 				}
 				stack.pop();
 				index+=2;
 			}
-			continue;
-		case	PUSH_VAR_VAL:	//	Push the Value of a Var.			Need: - (VarName on next IP) After:	VarValue(float)
+			VM_NEXT;
+		VM_CASE(PUSH_VAR_VAL)	//	Push the Value of a Var.			Need: - (VarName on next IP) After:	VarValue(float)
 			{
-				const	float	f=thisContext->getLogicVar(*((TStringId*)&opcodes[index+1]));
+				const	float	f=thisContext->getLogicVarBySlot((uint32)opcodes[index+1]);
 				stack.push(f);
 				index+=2;
 			}
-			continue;
-		case	PUSH_STR_VAR_VAL:	//	Push the Value of a Var.			Need: - (VarName on next IP) After:	VarValue(float)
+			VM_NEXT;
+		VM_CASE(PUSH_STR_VAR_VAL)	//	Push the Value of a Var.			Need: - (VarName on next IP) After:	VarValue(float)
 			{
-				std::string str = thisContext->getStrLogicVar(*((TStringId*)&opcodes[index+1]));
+				std::string str = thisContext->getStrLogicVarBySlot((uint32)opcodes[index+1]);
 				stack.push(str);
 				index+=2;
 			}
-			continue;
-		case	PUSH_CTX_VAR_VAL:	//	Push the Value of a Var.			Need: - (VarName on next IP) After:	VarValue(float)
+			VM_NEXT;
+		VM_CASE(PUSH_CTX_VAR_VAL)	//	Push the Value of a Var.			Need: - (VarName on next IP) After:	VarValue(float)
 			{
-				IScriptContext* ctx = thisContext->getCtxLogicVar(*((TStringId*)&opcodes[index+1]));
+				IScriptContext* ctx = thisContext->getCtxLogicVarBySlot((uint32)opcodes[index+1]);
 				stack.push(ctx);
 				index+=2;
 			}
-			continue;
+			VM_NEXT;
 		/*
-		case	SET_OTHER_VAR_VAL:
+		VM_CASE(SET_OTHER_VAR_VAL)
 			{
 				const	TStringId	strId=*((TStringId*)&opcodes[index+1]);
 				
@@ -422,8 +580,8 @@ void CScriptVM::interpretCode(
 				stack.pop();
 				index+=3;
 			}
-			continue;
-		case	SET_OTHER_STR_VAR_VAL:
+			VM_NEXT;
+		VM_CASE(SET_OTHER_STR_VAR_VAL)
 			{
 				const	TStringId	strId=*((TStringId*)&opcodes[index+1]);
 				
@@ -463,8 +621,8 @@ void CScriptVM::interpretCode(
 				stack.pop();
 				index += 3;
 			}
-			continue;
-		case	SET_OTHER_CTX_VAR_VAL:
+			VM_NEXT;
+		VM_CASE(SET_OTHER_CTX_VAR_VAL)
 			{
 				TStringId const strId = *((TStringId*)&opcodes[index+1]);
 				
@@ -498,8 +656,8 @@ void CScriptVM::interpretCode(
 				stack.pop();
 				index += 3;
 			}
-			continue;
-		case	PUSH_OTHER_VAR_VAL:
+			VM_NEXT;
+		VM_CASE(PUSH_OTHER_VAR_VAL)
 			{
 				const	TStringId	strId=*((TStringId*)&opcodes[index+1]);
 				
@@ -526,8 +684,8 @@ void CScriptVM::interpretCode(
 				stack.push(f);
 				index += 3;
 			}
-			continue;
-		case	PUSH_OTHER_STR_VAR_VAL:
+			VM_NEXT;
+		VM_CASE(PUSH_OTHER_STR_VAR_VAL)
 			{
 				const	TStringId	strId=*((TStringId*)&opcodes[index+1]);
 				
@@ -552,8 +710,8 @@ void CScriptVM::interpretCode(
 				
 				index += 3;
 			}
-			continue;
-		case	PUSH_OTHER_CTX_VAR_VAL:
+			VM_NEXT;
+		VM_CASE(PUSH_OTHER_CTX_VAR_VAL)
 			{
 				TStringId const strId = *((TStringId*)&opcodes[index+1]);
 				
@@ -578,9 +736,9 @@ void CScriptVM::interpretCode(
 				
 				index += 3;
 			}
-			continue;
+			VM_NEXT;
 		*/
-		case	SET_CONTEXT_VAR_VAL:
+		VM_CASE(SET_CONTEXT_VAR_VAL)
 			{
 				IScriptContext* otherContext = (IScriptContext*)0;
 				switch (stack.top().type())
@@ -613,12 +771,12 @@ void CScriptVM::interpretCode(
 					nlwarning("Stack top type invalid, poping top value!");
 				}
 				if (otherContext)
-					otherContext->setLogicVar(*((TStringId*)&opcodes[index+1]), f);
+					otherContext->setLogicVarBySlot((uint32)opcodes[index+1], f);
 				stack.pop();
 				index+=2;
 			}
-			continue;
-		case	SET_CONTEXT_STR_VAR_VAL:
+			VM_NEXT;
+		VM_CASE(SET_CONTEXT_STR_VAR_VAL)
 			{
 				IScriptContext* otherContext = (IScriptContext*)0;
 				switch (stack.top().type())
@@ -651,12 +809,12 @@ void CScriptVM::interpretCode(
 					nlwarning("Stack top type invalid, poping top value!");
 				}
 				if (otherContext)
-					otherContext->setStrLogicVar(*((TStringId*)&opcodes[index+1]), str);
+					otherContext->setStrLogicVarBySlot((uint32)opcodes[index+1], str);
 				stack.pop();
 				index += 2;
 			}
-			continue;
-		case	SET_CONTEXT_CTX_VAR_VAL:
+			VM_NEXT;
+		VM_CASE(SET_CONTEXT_CTX_VAR_VAL)
 			{
 				IScriptContext* otherContext = (IScriptContext*)0;
 				switch (stack.top().type())
@@ -683,12 +841,12 @@ void CScriptVM::interpretCode(
 					nlwarning("Stack top type invalid, poping top value!");
 				}
 				if (otherContext)
-					otherContext->setCtxLogicVar(*((TStringId*)&opcodes[index+1]), ctx);
+					otherContext->setCtxLogicVarBySlot((uint32)opcodes[index+1], ctx);
 				stack.pop();
 				index += 2;
 			}
-			continue;
-		case	PUSH_CONTEXT_VAR_VAL:
+			VM_NEXT;
+		VM_CASE(PUSH_CONTEXT_VAR_VAL)
 			{
 				IScriptContext* otherContext = (IScriptContext*)0;
 				switch (stack.top().type())
@@ -705,15 +863,15 @@ void CScriptVM::interpretCode(
 				
 				float f;
 				if (otherContext)
-					f = otherContext->getLogicVar(*((TStringId*)&opcodes[index+1]));
+					f = otherContext->getLogicVarBySlot((uint32)opcodes[index+1]);
 				else
 					f = 1.0f;
 				
 				stack.push(f);
 				index += 2;
 			}
-			continue;
-		case	PUSH_CONTEXT_STR_VAR_VAL:
+			VM_NEXT;
+		VM_CASE(PUSH_CONTEXT_STR_VAR_VAL)
 			{
 				IScriptContext* otherContext = (IScriptContext*)0;
 				switch (stack.top().type())
@@ -729,14 +887,14 @@ void CScriptVM::interpretCode(
 				stack.pop();
 				
 				if (otherContext)
-					stack.push(otherContext->getStrLogicVar(*((TStringId*)&opcodes[index+1])));
+					stack.push(otherContext->getStrLogicVarBySlot((uint32)opcodes[index+1]));
 				else
 					stack.push(std::string());	//	accepted coz const &
 				
 				index += 2;
 			}
-			continue;
-		case	PUSH_CONTEXT_CTX_VAR_VAL:
+			VM_NEXT;
+		VM_CASE(PUSH_CONTEXT_CTX_VAR_VAL)
 			{
 				IScriptContext* otherContext = (IScriptContext*)0;
 				switch (stack.top().type())
@@ -752,19 +910,19 @@ void CScriptVM::interpretCode(
 				stack.pop();
 				
 				if (otherContext)
-					stack.push(otherContext->getCtxLogicVar(*((TStringId*)&opcodes[index+1])));
+					stack.push(otherContext->getCtxLogicVarBySlot((uint32)opcodes[index+1]));
 				else
 					stack.push((IScriptContext*)0);
 				
 				index += 2;
 			}
-			continue;
-		case	JUMP:		//	Jump + nb size_t to jump (relative).	Need: NewJumpOffset After: -
+			VM_NEXT;
+		VM_CASE(JUMP)		//	Jump + nb size_t to jump (relative).	Need: NewJumpOffset After: -
 			{
 				index+=opcodes[index+1]+1;	//	AGI .. Not Opt
 			}
-			continue;
-		case	JE:			//	Jump if last stack value is FALSE(==0).	Need: BoolValue(float) (NewJumpOffset on  Next Ip) After: -
+			VM_NEXT;
+		VM_CASE(JE)			//	Jump if last stack value is FALSE(==0).	Need: BoolValue(float) (NewJumpOffset on  Next Ip) After: -
 			{
 				if ((float&)stack.top()==0.f)
 					index+=opcodes[index+1]+1;	//	AGI .. Not Opt
@@ -772,8 +930,8 @@ void CScriptVM::interpretCode(
 					index+=2;
 				stack.pop();
 			}
-			continue;
-		case	JNE:		//	Jump if last stack value is TRUE(!=0).	Need: BoolValue(float) (NewJumpOffset on  Next Ip) After: -
+			VM_NEXT;
+		VM_CASE(JNE)		//	Jump if last stack value is TRUE(!=0).	Need: BoolValue(float) (NewJumpOffset on  Next Ip) After: -
 			{
 				if ((float&)stack.top()!=0.f)
 					index+=opcodes[index+1]+1;	//	AGI .. Not Opt
@@ -781,28 +939,28 @@ void CScriptVM::interpretCode(
 					index+=2;
 				stack.pop();
 			}
-			continue;
-		case	PUSH_PRINT_STRING:
+			VM_NEXT;
+		VM_CASE(PUSH_PRINT_STRING)
 			{
 				currentString+=CStringMapper::unmap(*((TStringId*)&opcodes[index+1]));	//	strPt.substr(1,strPt.size()-2);
 				index+=2;
 			}
-			continue;
-		case	PUSH_PRINT_VAR:
+			VM_NEXT;
+		VM_CASE(PUSH_PRINT_VAR)
 			{
-				float const val = thisContext->getLogicVar(*((TStringId*)&opcodes[index+1]));
+				float const val = thisContext->getLogicVarBySlot((uint32)opcodes[index+1]);
 				currentString += NLMISC::toString("%g", val);
 				index += 2;
 			}
-			continue;
-		case	PUSH_PRINT_STR_VAR:
+			VM_NEXT;
+		VM_CASE(PUSH_PRINT_STR_VAR)
 			{
-				string const str = thisContext->getStrLogicVar(*((TStringId*)&opcodes[index+1]));
+				string const str = thisContext->getStrLogicVarBySlot((uint32)opcodes[index+1]);
 				currentString += str;
 				index += 2;
 			}
-			continue;
-		case	PRINT_STRING:
+			VM_NEXT;
+		VM_CASE(PRINT_STRING)
 			{
 				if (AIScriptDisplayPrint)
 				{
@@ -811,8 +969,8 @@ void CScriptVM::interpretCode(
 				currentString.resize(0);
 				++index;
 			}
-			continue;
-		case	LOG_STRING:
+			VM_NEXT;
+		VM_CASE(LOG_STRING)
 			{
 				if (AIScriptDisplayLog)
 				{
@@ -821,8 +979,8 @@ void CScriptVM::interpretCode(
 				currentString.resize(0);
 				++index;
 			}
-			continue;
-		case	FUNCTION:
+			VM_NEXT;
+		VM_CASE(FUNCTION)
 			{
 				// on_event
 				TStringId const eventName = *((TStringId*)&opcodes[index+1]);
@@ -833,8 +991,8 @@ void CScriptVM::interpretCode(
 					sc->setScriptCallBack(eventName, CByteCodeEntry(byteCode, index+4));
 				index+=2;
 			}
-			continue;
-		case	CALL:
+			VM_NEXT;
+		VM_CASE(CALL)
 			{
 				// set_event
 				const	TStringId	eventName=*((TStringId*)&opcodes[index+1]);
@@ -846,15 +1004,15 @@ void CScriptVM::interpretCode(
 				
 				index+=2;
 			}
-			continue;
-		case	PUSH_THIS:
+			VM_NEXT;
+		VM_CASE(PUSH_THIS)
 			{
 				IScriptContext* const	sc=thisContext;
 				stack.push(sc);
 				index++;
 			}
-			continue;
-		case	PUSH_GROUP:
+			VM_NEXT;
+		VM_CASE(PUSH_GROUP)
 			{
 				const	TStringId	strId=*((TStringId*)&opcodes[index+1]);
 				
@@ -877,15 +1035,15 @@ void CScriptVM::interpretCode(
 				stack.push(otherContext);
 				index+=2;
 			}
-			continue;
-		case	PUSH_STRING:
+			VM_NEXT;
+		VM_CASE(PUSH_STRING)
 			{
 				const	string &str = CStringMapper::unmap(*((TStringId*)&opcodes[index+1]));
 				stack.push(str);
 				index+=2;
 			}
-			continue;
-		case	ASSIGN_FUNC_FROM:
+			VM_NEXT;
+		VM_CASE(ASSIGN_FUNC_FROM)
 			{
 				const	TStringId	srcFunc=CStringMapper::map(stack.top());
 				stack.pop();
@@ -908,8 +1066,8 @@ void CScriptVM::interpretCode(
 				}
 				index++;
 			}
-			continue;
-		case	NATIVE_CALL:
+			VM_NEXT;
+		VM_CASE(NATIVE_CALL)
 			{
 				IScriptContext* const sc = stack.top();
 				stack.pop();
@@ -924,31 +1082,40 @@ void CScriptVM::interpretCode(
 				else
 				{
 					nlwarning("Calling a native function (%s) on a NULL group/context, rebuilding stack (this situation previously led to unknown behaviour, most of the time crashes)", funcName.c_str());
-					// If we have parameters we got to rebuild the stack
-					if (!inParamsSig.empty())
-					{
-						for (size_t i=0; i<inParamsSig.length(); ++i)
-							stack.pop();
-					}
-					if (!outParamsSig.empty())
+					rebuildNativeCallStack(inParamsSig, outParamsSig, stack);
+				}
+				
+				++index;
+			}
+			VM_NEXT;
+		VM_CASE(NATIVE_CALL_DIRECT)
+			{
+				IScriptContext* const sc = stack.top();
+				stack.pop();
+				AICOMP::CScriptNativeFuncParams const* const funcParam = (AICOMP::CScriptNativeFuncParams const*)opcodes[++index];
+				int mode = (int)opcodes[++index];
+				TStringId const inParamsSig = *((TStringId*)&opcodes[++index]);
+				TStringId const outParamsSig = *((TStringId*)&opcodes[++index]);
+				if (sc)
+				{
+					// the signatures are only needed by the var args functions
+					if (mode & 1)
 					{
-						for (size_t i=0; i<outParamsSig.length(); ++i)
-						{
-							switch (outParamsSig[i])
-							{
-							case 'f': stack.push(0.f); break;
-							case 's': stack.push(string()); break;
-							case 'c': stack.push((IScriptContext*)0); break;
-							default: nlassert("Unknown parameter type in native function call while rebuilding stack");
-							}
-						}
+						stack.push(CStringMapper::unmap(outParamsSig));
+						stack.push(CStringMapper::unmap(inParamsSig));
 					}
+					sc->callNativeFunc(funcParam, stack);
+				}
+				else
+				{
+					nlwarning("Calling a native function (%s) on a NULL group/context, rebuilding stack (this situation previously led to unknown behaviour, most of the time crashes)", funcParam->_signature.c_str());
+					rebuildNativeCallStack(CStringMapper::unmap(inParamsSig), CStringMapper::unmap(outParamsSig), stack);
 				}
 				
 				++index;
 			}
-			continue;
-		case	RAND:
+			VM_NEXT;
+		VM_CASE(RAND)
 			{
 				const	size_t	randIndex=rand32((uint32)opcodes[index+1]); // rand(RANDCOUNT)
 				index+=3;	//	pass RAND + RANDCOUNT + 1
@@ -958,14 +1125,14 @@ void CScriptVM::interpretCode(
 				index+=(randIndex+1)*2;
 				index+=opcodes[index];	//	we jump at the random sequence.
 			}
-			continue;
-		case	RET:
+			VM_NEXT;
+		VM_CASE(RET)
 			{
 				index=(int&)stack.top();
 				stack.pop();
 			}
-			continue;
-		case	ONCHILDREN:
+			VM_NEXT;
+		VM_CASE(ONCHILDREN)
 			{
 				if (thisContext)
 				{
@@ -973,8 +1140,8 @@ void CScriptVM::interpretCode(
 				}
 				index++;	//	let's go to jump ..
 			}
-			continue;
-		case	SWITCH:
+			VM_NEXT;
+		VM_CASE(SWITCH)
 			{
 			//	!!!!!
 				size_t	compValue=0;
@@ -1025,35 +1192,106 @@ void CScriptVM::interpretCode(
 				}
 
 			}
-			continue;
-		case	INCR:		//	Increment top of stack.
+			VM_NEXT;
+		VM_CASE(INCR)		//	Increment top of stack.
 			{
 				float &f = stack.top();
 				++f;
 				++index;
 			}
-			continue;
-		case	DECR:		//	Decrement top of stack.
+			VM_NEXT;
+		VM_CASE(DECR)		//	Decrement top of stack.
 			{
 				float &f = stack.top();
 				--f;
 				++index;
 			}
-			continue;
-		case	CONCAT:		//	Concatenates 2 strings
+			VM_NEXT;
+		VM_CASE(CONCAT)		//	Concatenates 2 strings
 			{
 				(string&)stack.top(1) += (string&)stack.top();
 				stack.pop();
+				++index;
 			}
-			continue;
-		case	FTOS:		//	Convert a float to a string
+			VM_NEXT;
+		VM_CASE(FTOS)		//	Convert a float to a string
 			{
 				stack.top()=NLMISC::toString("%g", (float&)stack.top());
+				++index;
+			}
+			VM_NEXT;
+		VM_CASE(INCR_VAR)	//	Increment a float variable.
+			{
+				uint32 const slot = (uint32)opcodes[index+1];
+				thisContext->setLogicVarBySlot(slot, thisContext->getLogicVarBySlot(slot)+1.f);
+				index+=2;
 			}
-			continue;
+			VM_NEXT;
+		VM_CASE(DECR_VAR)	//	Decrement a float variable.
+			{
+				uint32 const slot = (uint32)opcodes[index+1];
+				thisContext->setLogicVarBySlot(slot, thisContext->getLogicVarBySlot(slot)-1.f);
+				index+=2;
+			}
+			VM_NEXT;
+		VM_CASE(SET_VAR_CONST)	//	Set a constant to a float variable.
+			{
+				thisContext->setLogicVarBySlot((uint32)opcodes[index+1], *((float*)&opcodes[index+2]));
+				index+=3;
+			}
+			VM_NEXT;
+		VM_CASE(COPY_VAR_VAL)	//	Copy a float variable in another one.
+			{
+				thisContext->setLogicVarBySlot((uint32)opcodes[index+2], thisContext->getLogicVarBySlot((uint32)opcodes[index+1]));
+				index+=3;
+			}
+			VM_NEXT;
+		VM_CASE(SET_PUSH_VAR_VAL)	//	Set a float variable and keep its value on the stack.
+			{
+				float f = 0.0f;
+				switch	(stack.top().type())
+				{
+				case CScriptStack::EString:
+					{
+						string	&str=stack.top();
+						NLMISC::fromString(str, f);
+					}
+					break;
+				case CScriptStack::EFloat:
+					{
+						f = (float&)stack.top();
+					}
+					break;
+				default:
+					nlwarning("Stack top type invalid, replacing top value!");
+				}
+				stack.top() = f;
+				thisContext->setLogicVarBySlot((uint32)opcodes[index+1], f);
+				index+=2;
+			}
+			VM_NEXT;
+		VM_CASE(VAR_OP_CONST)	//	Binary operator on a float variable and a constant.
+			{
+				const	float	f=thisContext->getLogicVarBySlot((uint32)opcodes[index+1]);
+				stack.push(applyFloatOp(opcodes[index+3], f, *((float*)&opcodes[index+2])));
+				index+=4;
+			}
+			VM_NEXT;
+		VM_CASE(JE_VAR_OP_CONST)	//	Jump if (var op constant) is FALSE(==0).
+			{
+				const	float	f=thisContext->getLogicVarBySlot((uint32)opcodes[index+1]);
+				if (applyFloatOp(opcodes[index+3], f, *((float*)&opcodes[index+2]))==0.f)
+					index+=opcodes[index+4]+4;
+				else
+					index+=5;
+			}
+			VM_NEXT;
 		}
 		nlassert(false);	//	must use continue !!	Not implemented.
 	}
 }
 
+#undef VM_CASE
+#undef VM_NEXT
+
 }
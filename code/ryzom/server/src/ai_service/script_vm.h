@@ -22,6 +22,11 @@
 
 #include <limits>
 
+namespace AICOMP
+{
+class CScriptNativeFuncParams;
+}
+
 namespace AIVM
 {
 
@@ -170,6 +175,70 @@ public:
 
 //////////////////////////////////////////////////////////////////////////////
 
+/// Slots of the logic variables.
+/** The script compiler gives a slot to each logic variable name it reads,
+ * and writes the slot in the byte code in place of the name, so that the VM
+ * can access the variable without looking for its name.
+ * The slots are global (the byte code is shared by all the groups that run it),
+ * see CLogicVarLayout for the storage of the values.
+ */
+class CLogicVarSlots
+{
+public:
+	enum TKind { Float, String, Context, NbKinds };
+	enum { InvalidSlot = 0xffffffff };
+
+	/// Return the slot of a variable, giving it one if it has none yet (used by the compiler)
+	static uint32 getSlot(TKind kind, NLMISC::TStringId name);
+	/// Return the slot of a variable, or InvalidSlot if no compiled script uses it
+	static uint32 findSlot(TKind kind, NLMISC::TStringId name);
+	static NLMISC::TStringId getName(TKind kind, uint32 slot);
+	static uint32 getNbSlots(TKind kind);
+
+private:
+	typedef std::map<NLMISC::TStringId, uint32> TSlotMap;
+	static TSlotMap _Slots[NbKinds];
+	static std::vector<NLMISC::TStringId> _Names[NbKinds];
+};
+
+/// Position of the logic variables in the values of the script contexts.
+/** A layout maps the global slots to a compact index in the values of the
+ * contexts that share it (all the groups of a state machine), so that each
+ * group only stores the variables its scripts actually use.
+ * A layout must only be used by the thread that updates its contexts.
+ */
+class CLogicVarLayout
+: public NLMISC::CRefCount
+{
+public:
+	enum { InvalidIndex = 0xffffffff };
+
+	/// Return the index of the value of a slot, adding it to the layout if needed
+	uint32 getIndex(CLogicVarSlots::TKind kind, uint32 slot);
+	uint32 getNbValues(CLogicVarSlots::TKind kind) const { return (uint32)_Values[kind].size(); }
+	NLMISC::TStringId getName(CLogicVarSlots::TKind kind, uint32 index) const { return _Values[kind][index].Name; }
+	/// Return the number of the 'vN' variable (0 to 3) whose change is notified, or -1
+	sint32 getChangeIndex(CLogicVarSlots::TKind kind, uint32 index) const { return _Values[kind][index].ChangeIndex; }
+
+	/// Same as above, from the name of the variable
+	static sint32 getChangeIndex(NLMISC::TStringId name);
+
+private:
+	uint32 addIndex(CLogicVarSlots::TKind kind, uint32 slot);
+
+	struct CValue
+	{
+		NLMISC::TStringId	Name;
+		sint32				ChangeIndex;
+	};
+	/// Index of each slot (InvalidIndex if the slot is not used)
+	std::vector<uint32> _Indices[CLogicVarSlots::NbKinds];
+	/// Description of each value
+	std::vector<CValue> _Values[CLogicVarSlots::NbKinds];
+};
+
+//////////////////////////////////////////////////////////////////////////////
+
 class IScriptContext
 {
 public:
@@ -183,12 +252,22 @@ public:
 	virtual IScriptContext* getCtxLogicVar(NLMISC::TStringId varId) = 0;
 	virtual void setCtxLogicVar(NLMISC::TStringId varId, IScriptContext* value) = 0;
 	
+	/// Access to the logic variables by the slot the compiler gave them (see CLogicVarSlots)
+	virtual float getLogicVarBySlot(uint32 slot) = 0;
+	virtual void setLogicVarBySlot(uint32 slot, float value) = 0;
+	virtual std::string const& getStrLogicVarBySlot(uint32 slot) = 0;
+	virtual void setStrLogicVarBySlot(uint32 slot, std::string const& value) = 0;
+	virtual IScriptContext* getCtxLogicVarBySlot(uint32 slot) = 0;
+	virtual void setCtxLogicVarBySlot(uint32 slot, IScriptContext* value) = 0;
+	
 	virtual IScriptContext* findContext(NLMISC::TStringId const strId) = 0;
 	
 	virtual void setScriptCallBack(NLMISC::TStringId const& eventName, CByteCodeEntry const& codeScriptEntry) = 0;
 	virtual CByteCodeEntry const* getScriptCallBackPtr(NLMISC::TStringId const& eventName) const = 0;
 	virtual void callScriptCallBack(IScriptContext* caller, NLMISC::TStringId const& funcName, int mode = 0, std::string const& inParamsSig = "", std::string const& outParamsSig = "", CScriptStack* stack = NULL) = 0;
 	virtual void callNativeCallBack(IScriptContext* caller, std::string const&       funcName, int mode = 0, std::string const& inParamsSig = "", std::string const& outParamsSig = "", CScriptStack* stack = NULL) = 0;
+	/// Call a native function that was resolved when the code was compiled (its var args signatures are already on the stack)
+	virtual void callNativeFunc(AICOMP::CScriptNativeFuncParams const* funcParam, CScriptStack& stack) = 0;
 };
 
 class CScriptVM
@@ -216,24 +295,24 @@ public:
 /*0e*/		NOT,						// !																				StackBef: Value				StackAft: !Value
 /*0f*/		PUSH_ON_STACK,				// Set a Value (Float,TStringId .. etc)												StackBef: -					StackAft: Value
 /*10*/		POP,						// Pop																				StackBef: Value				StackAft: -
-/*11*/		SET_VAR_VAL,				// Set a value to a float variable.							Code: VarName			StackBef: VarValue			StackAft: -
-/*12*/		SET_STR_VAR_VAL,			// Set a value to a string variable.						Code: VarName			StackBef: VarValue			StackAft: -
-/*13*/		SET_CTX_VAR_VAL,			// Set a value to a context variable.						Code: VarName			StackBef: VarValue			StackAft: -
-/*14*/		PUSH_VAR_VAL,				// Push the value of a float variable.						Code: VarName			StackBef: -					StackAft: VarValue
-/*15*/		PUSH_STR_VAR_VAL,			// Push the value of a string variable.						Code: VarName			StackBef: -					StackAft: VarValue
-/*16*/		PUSH_CTX_VAR_VAL,			// Push the value of a context variable.					Code: VarName			StackBef: -					StackAft: VarValue
+/*11*/		SET_VAR_VAL,				// Set a value to a float variable.							Code: VarSlot			StackBef: VarValue			StackAft: -
+/*12*/		SET_STR_VAR_VAL,			// Set a value to a string variable.						Code: VarSlot			StackBef: VarValue			StackAft: -
+/*13*/		SET_CTX_VAR_VAL,			// Set a value to a context variable.						Code: VarSlot			StackBef: VarValue			StackAft: -
+/*14*/		PUSH_VAR_VAL,				// Push the value of a float variable.						Code: VarSlot			StackBef: -					StackAft: VarValue
+/*15*/		PUSH_STR_VAR_VAL,			// Push the value of a string variable.						Code: VarSlot			StackBef: -					StackAft: VarValue
+/*16*/		PUSH_CTX_VAR_VAL,			// Push the value of a context variable.					Code: VarSlot			StackBef: -					StackAft: VarValue
 /*17*/	//	SET_OTHER_VAR_VAL,			// Set a value to a float variable in another group.		Code: GroupName,VarName	StackBef: VarValue			StackAft: -
 /*18*/	//	SET_OTHER_STR_VAR_VAL,		// Set a value to a string variable in another group.		Code: GroupName,VarName	StackBef: VarValue			StackAft: -
 /*19*/	//	SET_OTHER_CTX_VAR_VAL,		// Set a value to a context variable in another group.		Code: GroupName,VarName	StackBef: VarValue			StackAft: -
 /*1a*/	//	PUSH_OTHER_VAR_VAL,			// Push the value of a float variable of another group.		Code: GroupName,VarName	StackBef: -					StackAft: VarValue
 /*1b*/	//	PUSH_OTHER_STR_VAR_VAL,		// Push the value of a string variable of another group.	Code: GroupName,VarName	StackBef: -					StackAft: VarValue
 /*1c*/	//	PUSH_OTHER_CTX_VAR_VAL,		// Push the value of a context variable of another group.	Code: GroupName,VarName	StackBef: -					StackAft: VarValue
-/*1d*/		SET_CONTEXT_VAR_VAL,		// Set a value to a float variable in another group.		Code: VarName			StackBef: VarValue,Group	StackAft: -
-/*1e*/		SET_CONTEXT_STR_VAR_VAL,	// Set a value to a float variable in another group.		Code: VarName			StackBef: VarValue,Group	StackAft: -
-/*1f*/		SET_CONTEXT_CTX_VAR_VAL,	// Set a value to a float variable in another group.		Code: VarName			StackBef: VarValue,Group	StackAft: -
-/*20*/		PUSH_CONTEXT_VAR_VAL,		// Push the value of a float variable of another group.		Code: VarName			StackBef: Group				StackAft: VarValue
-/*21*/		PUSH_CONTEXT_STR_VAR_VAL,	// Push the value of a float variable of another group.		Code: VarName			StackBef: Group				StackAft: VarValue
-/*22*/		PUSH_CONTEXT_CTX_VAR_VAL,	// Push the value of a float variable of another group.		Code: VarName			StackBef: Group				StackAft: VarValue
+/*1d*/		SET_CONTEXT_VAR_VAL,		// Set a value to a float variable in another group.		Code: VarSlot			StackBef: VarValue,Group	StackAft: -
+/*1e*/		SET_CONTEXT_STR_VAR_VAL,	// Set a value to a float variable in another group.		Code: VarSlot			StackBef: VarValue,Group	StackAft: -
+/*1f*/		SET_CONTEXT_CTX_VAR_VAL,	// Set a value to a float variable in another group.		Code: VarSlot			StackBef: VarValue,Group	StackAft: -
+/*20*/		PUSH_CONTEXT_VAR_VAL,		// Push the value of a float variable of another group.		Code: VarSlot			StackBef: Group				StackAft: VarValue
+/*21*/		PUSH_CONTEXT_STR_VAR_VAL,	// Push the value of a float variable of another group.		Code: VarSlot			StackBef: Group				StackAft: VarValue
+/*22*/		PUSH_CONTEXT_CTX_VAR_VAL,	// Push the value of a float variable of another group.		Code: VarSlot			StackBef: Group				StackAft: VarValue
 /*23*/		JUMP,						// Jump + nb size_t to jump (relative).						Code: JumpOffset		StackBef: -					StackAft: -			//< May be innaccurate
 /*24*/		JE,							// Jump if last stack value is FALSE(==0).					Code: JumpOffset		StackBef: Bool(float)		StackAft: -			//< May be innaccurate
 /*25*/		JNE,						// Jump if last stack value is TRUE(==1).					Code: JumpOffset		StackBef: Bool(float)		StackAft: -			//< May be innaccurate
@@ -258,24 +337,46 @@ public:
 /*38*/		DECR,
 /*39*/		CONCAT,
 /*3a*/		FTOS,
+/*3b*/		NATIVE_CALL_DIRECT,			// Call a native function linked at compile time.			Code: Func,Mode,InSig,OutSig	StackBef: Params,Context	StackAft: Results
+		// Superinstructions, only generated by the byte code optimizer (see CCompiler::optimizeByteCode)
+/*3c*/		INCR_VAR,					// Increment a float variable.								Code: VarSlot			StackBef: -					StackAft: -
+/*3d*/		DECR_VAR,					// Decrement a float variable.								Code: VarSlot			StackBef: -					StackAft: -
+/*3e*/		SET_VAR_CONST,				// Set a constant to a float variable.						Code: VarSlot,Value		StackBef: -					StackAft: -
+/*3f*/		COPY_VAR_VAL,				// Copy a float variable in another one.					Code: SrcSlot,DestSlot	StackBef: -					StackAft: -
+/*40*/		SET_PUSH_VAR_VAL,			// Set a float variable and keep its value on the stack.	Code: VarSlot			StackBef: VarValue			StackAft: VarValue
+/*41*/		VAR_OP_CONST,				// Binary operator (EQ to OR) on a float var and a constant.	Code: VarSlot,Value,Op	StackBef: -					StackAft: Var op Value
+/*42*/		JE_VAR_OP_CONST,			// Jump if (var op constant) is FALSE(==0).					Code: VarSlot,Value,Op,JumpOffset	StackBef: -		StackAft: -
+		NB_OPCODES
 	};
 	
+	/// Apply a binary operator (EQ to OR) to 2 floats, the same way the operator opcodes do
+	static float applyFloatOp(size_t op, float value1, float value2);
+	
 public:
 	void interpretCode(
 		IScriptContext* thisContext,
 		IScriptContext* parentContext,
 		IScriptContext* callerContext,
 		CByteCodeEntry const& codeScriptEntry);
+	/// Count the interpreted opcodes (used by the benchmarks, the code outside of the parallel updates is run by a counting copy of the interpreter)
+	void setCountOpcodes(bool countOpcodes) { _CountOpcodes = countOpcodes; }
+	/// Number of opcodes interpreted while counting (see setCountOpcodes())
+	uint64 getNbInterpretedOpcodes() const { return _NbInterpretedOpcodes; }
 	static CScriptVM* getInstance();
 	static void destroyInstance();
 private:
-	uint32 rand32(uint32 mod)
-	{ 
-		if (mod==0) return 0;
-		return ((((uint32)_Random.rand())<<16) + (uint32)_Random.rand()) % mod;
-	}
+	CScriptVM() : _CountOpcodes(false), _NbInterpretedOpcodes(0) { }
+	template <bool CountOpcodes>
+	void interpretCodeT(
+		IScriptContext* thisContext,
+		IScriptContext* parentContext,
+		IScriptContext* callerContext,
+		CByteCodeEntry const& codeScriptEntry);
+	uint32 rand32(uint32 mod);
 	static CScriptVM* _Instance;
 	NLMISC::CRandom _Random;
+	bool _CountOpcodes;
+	uint64 _NbInterpretedOpcodes;
 };
 
 //////////////////////////////////////////////////////////////////////////////
@@ -310,6 +411,38 @@ CByteCode::CByteCode(std::string const& sourceName)
 {
 }
 
+inline
+float CScriptVM::applyFloatOp(size_t op, float value1, float value2)
+{
+	switch (op)
+	{
+	case EQ:	return value1==value2?1.f:0.f;
+	case NEQ:	return value1!=value2?1.f:0.f;
+	case INF:	return value1<value2?1.f:0.f;
+	case INFEQ:	return value1<=value2?1.f:0.f;
+	case SUP:	return value1>value2?1.f:0.f;
+	case SUPEQ:	return value1>=value2?1.f:0.f;
+	case ADD:	return value1+value2;
+	case SUB:	return value1-value2;
+	case MUL:	return value1*value2;
+	case DIV:	return value2==0.f?1.f:value1/value2;
+	case AND:	return (value1!=0.f && value2!=0.f)?1.f:0.f;
+	case OR:	return (value1!=0.f || value2!=0.f)?1.f:0.f;
+	default:
+		nlassert(false);
+		return 0.f;
+	}
+}
+
+inline
+uint32 CLogicVarLayout::getIndex(CLogicVarSlots::TKind kind, uint32 slot)
+{
+	std::vector<uint32> const& indices = _Indices[kind];
+	if (slot<indices.size() && indices[slot]!=InvalidIndex)
+		return indices[slot];
+	return addIndex(kind, slot);
+}
+
 inline
 CLibrary& CLibrary::getInstance()
 {
@@ -148,17 +148,63 @@ void CStateInstance::callNativeCallBack(IScriptContext* caller, std::string cons
 	}
 }
 
+void CStateInstance::callNativeFunc(CScriptNativeFuncParams const* funcParam, AIVM::CScriptStack& stack)
+{
+	funcParam->_func(this, stack);
+}
+
+// Add the values of the new variables of a layout, taking the value of the
+// variables that were set before a script using them was compiled
+template <class T>
+static void growLogicVarValues(CLogicVarLayout const& layout, CLogicVarSlots::TKind kind, std::vector<T>& values, std::map<TStringId, T>& fallback, T const& defaultValue)
+{
+	uint32 first = (uint32)values.size();
+	uint32 last = layout.getNbValues(kind);
+	values.resize(last, defaultValue);
+	for (uint32 i=first; i<last && !fallback.empty(); ++i)
+	{
+		typename std::map<TStringId, T>::iterator it = fallback.find(layout.getName(kind, i));
+		if (it!=fallback.end())
+		{
+			values[i] = it->second;
+			fallback.erase(it);
+		}
+	}
+}
+
+void CStateInstance::growLogicVars(CLogicVarSlots::TKind kind)
+{
+	switch (kind)
+	{
+	case CLogicVarSlots::Float:
+		growLogicVarValues(*_LogicVarLayout, kind, _LogicVarValues, _LogicVar, 0.f);
+		break;
+	case CLogicVarSlots::String:
+		growLogicVarValues(*_LogicVarLayout, kind, _StrLogicVarValues, _StrLogicVar, std::string());
+		break;
+	default:
+		growLogicVarValues(*_LogicVarLayout, kind, _CtxLogicVarValues, _CtxLogicVar, (IScriptContext*)NULL);
+		break;
+	}
+}
+
 void CStateInstance::dumpVarsAndFunctions(CStringWriter& sw) const
 {
 	sw.append("float variables:");
+	for (uint32 i=0; i<_LogicVarValues.size(); ++i)
+		sw.append(" "+CStringMapper::unmap(_LogicVarLayout->getName(CLogicVarSlots::Float, i))+" = "+NLMISC::toString(_LogicVarValues[i]));
 	FOREACHC(varIt, TLogicVarList, _LogicVar)
 		sw.append(" "+CStringMapper::unmap(varIt->first)+" = "+NLMISC::toString(varIt->second));
 	
 	sw.append("string variables:");
+	for (uint32 i=0; i<_StrLogicVarValues.size(); ++i)
+		sw.append(" "+CStringMapper::unmap(_LogicVarLayout->getName(CLogicVarSlots::String, i))+" = "+_StrLogicVarValues[i]);
 	FOREACHC(varIt, TStrLogicVarList, _StrLogicVar)
 		sw.append(" "+CStringMapper::unmap(varIt->first)+" = "+varIt->second);
 	
 	sw.append("context variables:");
+	for (uint32 i=0; i<_CtxLogicVarValues.size(); ++i)
+		sw.append(" "+CStringMapper::unmap(_LogicVarLayout->getName(CLogicVarSlots::Context, i))+" = "+NLMISC::toStringPtr(_CtxLogicVarValues[i]));
 	FOREACHC(varIt, TCtxLogicVarList, _CtxLogicVar)
 		sw.append(" "+CStringMapper::unmap(varIt->first)+" = "+NLMISC::toStringPtr(varIt->second));
 	
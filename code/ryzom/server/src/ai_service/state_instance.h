@@ -43,7 +43,7 @@ class CStateInstance
 {
 public:
 	inline
-	CStateInstance(CAIState* startState);
+	CStateInstance(CAIState* startState, AIVM::CLogicVarLayout* logicVarLayout = NULL);
 
 	void init(CAIState* startState);
 
@@ -139,6 +139,12 @@ public:
 	void setStrLogicVar(NLMISC::TStringId varId, std::string const& value);
 	AIVM::IScriptContext* getCtxLogicVar(NLMISC::TStringId varId);
 	void setCtxLogicVar(NLMISC::TStringId varId, AIVM::IScriptContext* value);
+	float getLogicVarBySlot(uint32 slot);
+	void setLogicVarBySlot(uint32 slot, float value);
+	std::string const& getStrLogicVarBySlot(uint32 slot);
+	void setStrLogicVarBySlot(uint32 slot, std::string const& value);
+	AIVM::IScriptContext* getCtxLogicVarBySlot(uint32 slot);
+	void setCtxLogicVarBySlot(uint32 slot, AIVM::IScriptContext* value);
 	void setFirstBotSpawned();
 
 	virtual AIVM::IScriptContext* findContext(NLMISC::TStringId const strId);
@@ -147,6 +153,7 @@ public:
 	virtual AIVM::CByteCodeEntry const* getScriptCallBackPtr(NLMISC::TStringId const& eventName) const;
 	virtual void callScriptCallBack(AIVM::IScriptContext* caller, NLMISC::TStringId const& funcName, int mode = 0, std::string const& inParamsSig = "", std::string const& outParamsSig = "", AIVM::CScriptStack* stack = NULL);
 	virtual void callNativeCallBack(AIVM::IScriptContext* caller, std::string const&       funcName, int mode = 0, std::string const& inParamsSig = "", std::string const& outParamsSig = "", AIVM::CScriptStack* stack = NULL);
+	virtual void callNativeFunc(AICOMP::CScriptNativeFuncParams const* funcParam, AIVM::CScriptStack& stack);
 
 	void blockUserEvent(uint32 eventId);
 	void unblockUserEvent(uint32 eventId);
@@ -154,7 +161,19 @@ public:
 	//@}
 
 protected:
-	/// Logic variables
+	/// Return the index of the value of a logic variable slot, adding the value if needed
+	uint32 getLogicVarIndex(AIVM::CLogicVarSlots::TKind kind, uint32 slot);
+	/// Add the values of the variables added to the layout since the last call
+	void growLogicVars(AIVM::CLogicVarSlots::TKind kind);
+
+	/// Logic variables that have a slot, indexed by their position in the layout
+	NLMISC::CSmartPtr<AIVM::CLogicVarLayout> _LogicVarLayout;
+	std::vector<float>                 _LogicVarValues;
+	std::vector<std::string>           _StrLogicVarValues;
+	std::vector<AIVM::IScriptContext*> _CtxLogicVarValues;
+
+	/// Logic variables that no compiled script uses (set by native functions), they
+	/// move to the values above when a script using them is compiled
 	typedef	std::map<NLMISC::TStringId, float>           TLogicVarList;
 	typedef	std::map<NLMISC::TStringId, std::string>     TStrLogicVarList;
 	typedef std::map<NLMISC::TStringId, uint32>		 TLogicVarIndex;
@@ -258,10 +277,11 @@ private:
 //////////////////////////////////////////////////////////////////////////////
 
 inline
-CStateInstance::CStateInstance(CAIState* startState)
+CStateInstance::CStateInstance(CAIState* startState, AIVM::CLogicVarLayout* logicVarLayout)
 {
 	_UserEventBlocked = 0;
-	_CtxLogicVar[NLMISC::CStringMapper::map("@this")] = this;
+	_LogicVarLayout = logicVarLayout ? logicVarLayout : new AIVM::CLogicVarLayout;
+	setCtxLogicVar(NLMISC::CStringMapper::map("@this"), this);
 	init(startState);
 }
 
@@ -300,13 +320,82 @@ CAITimerExtended& CStateInstance::timerUser(uint idx)
 inline
 void CStateInstance::logicVarsToString(std::string& str) const
 {
+	for (uint32 i=0; i<_LogicVarValues.size(); ++i)
+		str+=*_LogicVarLayout->getName(AIVM::CLogicVarSlots::Float, i)+"="+NLMISC::toString(_LogicVarValues[i])+" ";
 	for	(TLogicVarList::const_iterator it=_LogicVar.begin(), itEnd=_LogicVar.end();it!=itEnd;++it)
 		str+=*(it->first)+"="+NLMISC::toString(it->second)+" ";
 }
 
+inline
+uint32 CStateInstance::getLogicVarIndex(AIVM::CLogicVarSlots::TKind kind, uint32 slot)
+{
+	uint32 index = _LogicVarLayout->getIndex(kind, slot);
+	uint32 size;
+	switch (kind)
+	{
+	case AIVM::CLogicVarSlots::Float:	size = (uint32)_LogicVarValues.size(); break;
+	case AIVM::CLogicVarSlots::String:	size = (uint32)_StrLogicVarValues.size(); break;
+	default:							size = (uint32)_CtxLogicVarValues.size(); break;
+	}
+	if (index>=size)
+		growLogicVars(kind);
+	return index;
+}
+
+inline
+float CStateInstance::getLogicVarBySlot(uint32 slot)
+{
+	return _LogicVarValues[getLogicVarIndex(AIVM::CLogicVarSlots::Float, slot)];
+}
+
+inline
+void CStateInstance::setLogicVarBySlot(uint32 slot, float value)
+{
+	uint32 index = getLogicVarIndex(AIVM::CLogicVarSlots::Float, slot);
+	_LogicVarValues[index] = value;
+	_LogicVarChanged = true;
+	sint32 changeIndex = _LogicVarLayout->getChangeIndex(AIVM::CLogicVarSlots::Float, index);
+	if (changeIndex>=0)
+		_LogicVarChangedList[changeIndex] = true;
+}
+
+inline
+std::string const& CStateInstance::getStrLogicVarBySlot(uint32 slot)
+{
+	return _StrLogicVarValues[getLogicVarIndex(AIVM::CLogicVarSlots::String, slot)];
+}
+
+inline
+void CStateInstance::setStrLogicVarBySlot(uint32 slot, std::string const& value)
+{
+	uint32 index = getLogicVarIndex(AIVM::CLogicVarSlots::String, slot);
+	_StrLogicVarValues[index] = value;
+	_LogicVarChanged = true;
+	sint32 changeIndex = _LogicVarLayout->getChangeIndex(AIVM::CLogicVarSlots::String, index);
+	if (changeIndex>=0)
+		_LogicVarChangedList[changeIndex] = true;
+}
+
+inline
+AIVM::IScriptContext* CStateInstance::getCtxLogicVarBySlot(uint32 slot)
+{
+	return _CtxLogicVarValues[getLogicVarIndex(AIVM::CLogicVarSlots::Context, slot)];
+}
+
+inline
+void CStateInstance::setCtxLogicVarBySlot(uint32 slot, AIVM::IScriptContext* value)
+{
+	_CtxLogicVarValues[getLogicVarIndex(AIVM::CLogicVarSlots::Context, slot)] = value;
+	_LogicVarChanged = true;
+}
+
 inline
 float CStateInstance::getLogicVar(NLMISC::TStringId	varId)
 {
+	uint32 slot = AIVM::CLogicVarSlots::findSlot(AIVM::CLogicVarSlots::Float, varId);
+	if (slot!=AIVM::CLogicVarSlots::InvalidSlot)
+		return getLogicVarBySlot(slot);
+
 	TLogicVarList::iterator		it=_LogicVar.find(varId);
 	if (it==_LogicVar.end())
 	{
@@ -319,55 +408,67 @@ float CStateInstance::getLogicVar(NLMISC::TStringId	varId)
 inline
 void CStateInstance::setLogicVar(NLMISC::TStringId varId, float value)
 {
-	_LogicVar[varId] = value;
-	_LogicVarChanged = true;
-
-	if (varId && varId->size() == 2 && (*varId)[0] == 'v')
+	uint32 slot = AIVM::CLogicVarSlots::findSlot(AIVM::CLogicVarSlots::Float, varId);
+	if (slot!=AIVM::CLogicVarSlots::InvalidSlot)
 	{
-		sint32 index = (*varId)[1] - '0';
-		if (0 <= index && index < 4)
-		{
-			//_VarIndex[varId]
-			_LogicVarChangedList[static_cast<uint32>(index)] = true;
-		}
-
+		setLogicVarBySlot(slot, value);
+		return;
 	}
 
+	_LogicVar[varId] = value;
+	_LogicVarChanged = true;
+	sint32 changeIndex = AIVM::CLogicVarLayout::getChangeIndex(varId);
+	if (changeIndex>=0)
+		_LogicVarChangedList[changeIndex] = true;
 }
 
 inline
 std::string CStateInstance::getStrLogicVar(NLMISC::TStringId varId)
 {
+	uint32 slot = AIVM::CLogicVarSlots::findSlot(AIVM::CLogicVarSlots::String, varId);
+	if (slot!=AIVM::CLogicVarSlots::InvalidSlot)
+		return getStrLogicVarBySlot(slot);
+
 	return _StrLogicVar[varId];
 }
 
 inline
 void CStateInstance::setStrLogicVar(NLMISC::TStringId varId, std::string const& value)
 {
-	_StrLogicVar[varId] = value;
-	_LogicVarChanged = true;
-	if (varId && varId->size() == 2 && (*varId)[0] == 'v')
+	uint32 slot = AIVM::CLogicVarSlots::findSlot(AIVM::CLogicVarSlots::String, varId);
+	if (slot!=AIVM::CLogicVarSlots::InvalidSlot)
 	{
-		sint32 index = (*varId)[1] - '0';
-		if (0 <= index && index < 4)
-		{
-			//_VarIndex[varId]
-			_LogicVarChangedList[static_cast<uint32>(index)] = true;
-		}
-
+		setStrLogicVarBySlot(slot, value);
+		return;
 	}
-	//_LogicVarChangedList[_VarIndex[varId]] = true;
+
+	_StrLogicVar[varId] = value;
+	_LogicVarChanged = true;
+	sint32 changeIndex = AIVM::CLogicVarLayout::getChangeIndex(varId);
+	if (changeIndex>=0)
+		_LogicVarChangedList[changeIndex] = true;
 }
 
 inline
 AIVM::IScriptContext* CStateInstance::getCtxLogicVar(NLMISC::TStringId varId)
 {
+	uint32 slot = AIVM::CLogicVarSlots::findSlot(AIVM::CLogicVarSlots::Context, varId);
+	if (slot!=AIVM::CLogicVarSlots::InvalidSlot)
+		return getCtxLogicVarBySlot(slot);
+
 	return _CtxLogicVar[varId];
 }
 
 inline
 void CStateInstance::setCtxLogicVar(NLMISC::TStringId varId, AIVM::IScriptContext* value)
 {
+	uint32 slot = AIVM::CLogicVarSlots::findSlot(AIVM::CLogicVarSlots::Context, varId);
+	if (slot!=AIVM::CLogicVarSlots::InvalidSlot)
+	{
+		setCtxLogicVarBySlot(slot, value);
+		return;
+	}
+
 	_CtxLogicVar[varId] = value;
 	_LogicVarChanged = true;
 }
@@ -581,7 +682,7 @@ void CStateInstance::setNextPunctualState(CAIState* state)
 inline
 CPersistentStateInstance::CPersistentStateInstance(CStateMachine& reactionContainer)
 : CKeyWordOwner()
-, CStateInstance(NULL)
+, CStateInstance(NULL, reactionContainer.getLogicVarLayout())
 , _StartState()
 , _Container(reactionContainer)
 {
@@ -22,6 +22,7 @@
 #include "nel/net/service.h"
 
 #include "game_share/backup_service_messages.h"
+#include "game_share/persistent_data_delta.h"
 #include "server_share/backup_service_itf.h"
 
 #include "backup_service.h"
@@ -35,6 +36,7 @@ NLMISC::CVariable<std::string>	BSFileSubst("backup", "BSFileSubst", "file read/w
 */
 NLMISC::CVariable<bool>	VerboseLog("backup", "VerboseLog", "Activate verbose logging of BS activity", false);
 NLMISC::CVariable<bool>	UseTempFile("backup", "UseTempFile", "Flag the use of temporary file for safe write or append operation", true, true);
+NLMISC::CVariable<float>	DeltaJournalCompactRatio("backup", "DeltaJournalCompactRatio", "Apply the delta journal of a file to the file when the journal gets bigger than this ratio of the file size", 0.5f, 0, true);
 
 extern NLMISC::CVariable<std::string> SaveShardRootGameShare;
 
@@ -61,6 +63,96 @@ std::string	getBackupFileName(const std::string& filename)
 }
 
 
+static bool	readWholeFile(const std::string& path, std::vector<uint8>& data)
+{
+	data.clear();
+
+	NLMISC::CIFile	f;
+	if (!f.open(path))
+		return false;
+
+	try
+	{
+		data.resize(f.getFileSize());
+		if (!data.empty())
+			f.serialBuffer(&(data[0]), (uint)data.size());
+		f.close();
+	}
+	catch(const NLMISC::Exception &)
+	{
+		return false;
+	}
+
+	return true;
+}
+
+bool	compactDeltaJournal(const std::string& path, std::string& failureReason, bool *recordsDiscarded)
+{
+	std::string	journalPath = CPDRDelta::getJournalFileName(path);
+	if (!NLMISC::CFile::fileExists(journalPath))
+		return true;
+
+	H_AUTO(CompactDeltaJournal);
+
+	std::vector<uint8>	file, journal;
+	if (!readWholeFile(journalPath, journal) || (NLMISC::CFile::fileExists(path) && !readWholeFile(path, file)))
+	{
+		failureReason = NLMISC::toString("MAJOR_FAILURE:DELTA: can't read file '%s' or its delta journal", path.c_str());
+		return false;
+	}
+
+	std::string	error;
+	uint32		nbApplied = CPDRDelta::applyJournal(file, journal.empty() ? NULL : &(journal[0]), (uint32)journal.size(), error);
+
+	if (nbApplied != 0)
+	{
+		NLMISC::COFile	f;
+		bool			fileSaved = false;
+		if (f.open(path, false, false, UseTempFile))
+		{
+			try
+			{
+				f.serialBuffer(&(file[0]), (uint)file.size());
+				f.close();
+				fileSaved = true;
+			}
+			catch(const NLMISC::Exception &)
+			{
+			}
+		}
+
+		if (!fileSaved)
+		{
+			failureReason = NLMISC::toString("MAJOR_FAILURE:DELTA: can't write file '%s'", path.c_str());
+			return false;
+		}
+	}
+
+	if (!error.empty())
+	{
+		// keep the records that can't be applied for investigation, the file stays as the last record applied left it
+		nlwarning("DELTA: %u record(s) of the delta journal of '%s' applied, discarding the others: %s", nbApplied, path.c_str(), error.c_str());
+		if (recordsDiscarded != NULL)
+			*recordsDiscarded = true;
+		std::string	badPath = journalPath+".bad";
+		if (NLMISC::CFile::fileExists(badPath))
+			NLMISC::CFile::deleteFile(badPath);
+		if (!NLMISC::CFile::moveFile(badPath, journalPath))
+			NLMISC::CFile::deleteFile(journalPath);
+	}
+	else if (!NLMISC::CFile::deleteFile(journalPath))
+	{
+		// the records will fail to apply to the compacted file and be discarded next time
+		nlwarning("DELTA: can't delete the delta journal of '%s'", path.c_str());
+	}
+
+	if (VerboseLog)
+		nlinfo("Compacted %u delta(s) into file '%s'", nbApplied, path.c_str());
+
+	return true;
+}
+
+
 // Init File manager
 void	CFileAccessManager::init()
 {
@@ -189,6 +281,10 @@ void	CFileAccessManager::removeFileAccess(IFileAccess* access)
 
 IFileAccess::TReturnCode	CLoadFile::execute(CFileAccessManager& manager)
 {
+	// readers only know full files
+	if (!compactDeltaJournal(getBackupFileName(Filename), FailureReason))
+		return MajorFailure;
+
 	bool	fileExists = NLMISC::CFile::fileExists(getBackupFileName(Filename));
 
 	if (!fileExists && checkFailureMode(MajorFailureIfFileNotExists))
@@ -425,6 +521,14 @@ IFileAccess::TReturnCode	CWriteFile::execute(CFileAccessManager& manager)
 
 	f.close();
 
+	// the deltas appended to the previous version of the file don't apply to this one
+	if (fileSaved && !Append)
+	{
+		std::string	journalPath = CPDRDelta::getJournalFileName(getBackupFileName(Filename));
+		if (NLMISC::CFile::fileExists(journalPath) && !NLMISC::CFile::deleteFile(journalPath))
+			nlwarning("DELTA: can't delete the delta journal of '%s'", Filename.c_str());
+	}
+
 	if (!fileBackuped)
 	{
 		FailureReason = NLMISC::toString("MINOR_FAILURE:WRITE: can't backup file '%s'", Filename.c_str());
@@ -444,8 +548,87 @@ IFileAccess::TReturnCode	CWriteFile::execute(CFileAccessManager& manager)
 }
 
 
+CAppendDeltaFile::CAppendDeltaFile(const std::string& filename, const TRequester &requester, uint32 requestid, NLMISC::CMemStream& data)
+	: IFileAccess(filename, requester, requestid)
+{
+	uint32 startPos = (uint32)data.getPos();
+	uint32 actualLen = data.length()-startPos;
+	Data.resize(actualLen);
+	if (actualLen != 0)
+		memcpy(&(Data[0]), data.buffer()+startPos, actualLen);
+}
+
+IFileAccess::TReturnCode	CAppendDeltaFile::execute(CFileAccessManager& manager)
+{
+	// a record is never empty (it has a header), the message was truncated
+	if (Data.empty())
+	{
+		sendStatus(false);
+		FailureReason = NLMISC::toString("MINOR_FAILURE:DELTA: empty delta record for file '%s'", Filename.c_str());
+		return MinorFailure;
+	}
+
+	std::string	path = getBackupFileName(Filename);
+	std::string	journalPath = CPDRDelta::getJournalFileName(path);
+
+	NLMISC::COFile	f;
+	bool	fileSaved = false;
+	if (f.open(journalPath, true, false, UseTempFile))
+	{
+		try
+		{
+			f.serialBuffer(&(Data[0]), (uint)Data.size());
+			f.close();
+			fileSaved = true;
+
+			if (VerboseLog)
+				nlinfo("Append delta of %u octets to file '%s'", Data.size(), Filename.c_str());
+		}
+		catch(const NLMISC::Exception &)
+		{
+		}
+	}
+
+	if (!fileSaved)
+	{
+		// the requester will send the next save in full
+		sendStatus(false);
+		FailureReason = NLMISC::toString("MINOR_FAILURE:DELTA: can't append to the delta journal of file '%s'", Filename.c_str());
+		return MinorFailure;
+	}
+
+	// the record is stored: a failed compaction must not make the access run again and append it twice,
+	// the journal will be compacted by the next read or append
+	bool	recordsDiscarded = false;
+	if (NLMISC::CFile::getFileSize(journalPath) >= DeltaJournalCompactRatio.get() * NLMISC::CFile::getFileSize(path) &&
+		!compactDeltaJournal(path, FailureReason, &recordsDiscarded))
+	{
+		sendStatus(true);
+		return MinorFailure;
+	}
+
+	// if records were discarded, the file is not the version the requester bases its deltas on
+	sendStatus(!recordsDiscarded);
+	return Success;
+}
+
+void	CAppendDeltaFile::sendStatus(bool success)
+{
+	if (Requester.RequesterType != TRequester::rt_service)
+		return;
+
+	NLNET::CMessage	msgOut("bs_delta_status");
+	msgOut.serial(Filename, success);
+	NLNET::CUnifiedNetwork::getInstance()->send(Requester.ServiceId, msgOut);
+}
+
+
 IFileAccess::TReturnCode	CDeleteFile::execute(CFileAccessManager& manager)
 {
+	// the backup of the file must include its deltas
+	if (!compactDeltaJournal(getBackupFileName(Filename), FailureReason))
+		return MajorFailure;
+
 	bool	fileExists = NLMISC::CFile::fileExists(getBackupFileName(Filename));
 
 	if (!fileExists)
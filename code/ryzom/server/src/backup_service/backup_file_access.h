@@ -43,6 +43,15 @@ extern NLMISC::CVariable<std::string>	BSFilePrefix;
 
 std::string	getBackupFileName(const std::string& filename);
 
+/**
+ * Apply the delta journal of a file (if it has one) to the file, then delete the journal.
+ * path is the full path of the file (see getBackupFileName()).
+ * Returns false if the journal can't be read or the file can't be written, the journal is kept then.
+ * Records that can't be applied are not an error: they are moved to a '.bad' file and reported
+ * (recordsDiscarded is set to true then).
+ */
+bool		compactDeltaJournal(const std::string& path, std::string& failureReason, bool *recordsDiscarded = NULL);
+
 
 struct TRequester
 {
@@ -278,6 +287,27 @@ public:
 };
 
 
+class CAppendDeltaFile : public IFileAccess
+{
+public:
+
+	CAppendDeltaFile(const std::string& filename, const TRequester &requester, uint32 requestid, NLMISC::CMemStream& data);
+
+	/// The delta record
+	std::vector<uint8>		Data;
+
+	/// Execute delta appending, compacting the journal when it gets too big
+	virtual TReturnCode		execute(CFileAccessManager& manager);
+
+private:
+
+	/** Tell the requester if the record is stored in a journal that applies to the file.
+	 * Message "bs_delta_status": the file name and a bool.
+	 */
+	void					sendStatus(bool success);
+};
+
+
 class CDeleteFile : public IFileAccess
 {
 public:
@@ -229,6 +229,30 @@ static void cbAppendFileCheck( CMessage& msgin, const std::string &serviceName,
 }
 
 
+//-----------------------------------------------------------------------------
+// cbAppendDelta
+//
+// message format:
+// - std::string: fileName
+// - remaining of the stream: a CPDRDelta record for the file
+// reply: "bs_delta_status" (see CAppendDeltaFile)
+//
+static void cbAppendDelta( CMessage& msgin, const std::string &serviceName, NLNET::TServiceId serviceId )
+{
+	try
+	{
+		CBackupMsgSaveFileRecv msg( msgin );
+
+		CAppendDeltaFile*	access = new CAppendDeltaFile(msg.FileName, serviceId, 0, msgin);
+
+		CBackupService::getInstance()->FileManager.stackFileAccess(access);
+	}
+	catch (...)
+	{
+		nlwarning("WARNING: caught exception in cbAppendDelta()");
+	}
+}
+
 
 //-----------------------------------------------------------------------------
 // cbLoadFile
@@ -485,9 +509,17 @@ static CMessage getFileClassImp( CMessage& msgin)
 
 		for (uint i=0; i<files.size(); ++i)
 		{
-			uint32		fstamp = CFile::getFileModificationDate(files[i]);
 			std::string	fname = NLMISC::CFile::getFilename(files[i]);
 
+			// the delta journals are private to the BS, the stamp of a file must include its deltas
+			if (NLMISC::testWildCard(fname, "*.delta") || NLMISC::testWildCard(fname, "*.delta.bad"))
+				continue;
+			std::string	failureReason;
+			if (!compactDeltaJournal(files[i], failureReason))
+				nlwarning("%s", failureReason.c_str());
+
+			uint32		fstamp = CFile::getFileModificationDate(files[i]);
+
 			for (uint j=0; j<inMsg.Classes.size(); ++j)
 			{
 				const CBackupFileClass&	fclass = inMsg.Classes[j];
@@ -520,6 +552,9 @@ static CMessage getFileClassImp( CMessage& msgin)
 			{
 				string	file = CPath::standardizePath(inMsg.Directory)+fclass.Patterns[k]; // relative filename
 				string	rfile = getBackupFileName(file); // full filename
+				std::string	failureReason;
+				if (!compactDeltaJournal(rfile, failureReason))
+					nlwarning("%s", failureReason.c_str());
 				if (CFile::isExists(rfile))
 					classes[j].push_back(CClassResult(file, CFile::getFileModificationDate(rfile)));
 			}
@@ -671,6 +706,7 @@ TUnifiedCallbackItem CbArray[]=
 	{ "load_file",			cbLoadFile },
 	{ "append_file",		cbAppendFile },
 	{ "append_file_check",	cbAppendFileCheck },
+	{ "append_delta",		cbAppendDelta },
 
 	{ "SAVE_CHECK_FILE",	cbSaveCheckFile },
 	{ "DELETE_FILE",		cbDeleteFile },
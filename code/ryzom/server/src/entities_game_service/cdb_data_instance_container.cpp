@@ -53,35 +53,33 @@ void			CCDBDataInstanceContainer::init( TCDBDataIndex size, bool usePermanentTra
 }*/
 
 
+/*
+ * Init
+ */
+void			CCDBChangeTracker::init( TCDBDataIndex size )
+{
+	_Size = (uint)size;
+	uint nbWords = (_Size + WordBits - 1) >> WordShift;
+	_ChangedBits.resize( nbWords, 0 );
+	_NonEmptyWords.resize( (nbWords + WordBits - 1) >> WordShift, 0 );
+	_ChangedInAtomBits.resize( nbWords, 0 );
+}
+
+
 /*
  * Record a change (push)
  */
 inline void		CCDBChangeTracker::recordChange( TCDBDataIndex index )
 {
-	// Note: could be shorter to link backwards but we need to link forward
-	// to read the changes in order (for partial sending)
-
-	// Test if the entity is already or not flagged as changed
-	if ( _TrackVec[index] == CDB_INVALID_DATA_INDEX )
+	// Test if the index is already or not flagged as changed
+	uint word = (uint)index >> WordShift;
+	uint64& bits = _ChangedBits[word];
+	uint64 bit = ((uint64)1) << (index & (WordBits-1));
+	if ( (bits & bit) == 0 )
 	{
-		// Set the entityIndex as changed, and last one
-		_TrackVec[index] = CDB_LAST_CHANGED;
-
-		if ( _LastChanged != CDB_INVALID_DATA_INDEX )
-		{
-			// Link the previous last one to the new last one
-			//nlassertex( _LastChanged != index, ( "Looping at %u", entityIndex ) );
-			_TrackVec[_LastChanged] = index;
-		}
-		else
-		{
-			// Set the first one if not set
-			_FirstChanged = index;
-			//nldebug( "_ChangeTracker._TrackVec[%d] = %d", index, _ChangeTracker._TrackVec[index] );
-		}
-
-		// Set the new last one
-		_LastChanged = index;
+		if ( bits == 0 )
+			_NonEmptyWords[word >> WordShift] |= ((uint64)1) << (word & (WordBits-1));
+		bits |= bit;
 
 		// Increment the counter
 		++_ChangedCount;
@@ -90,21 +88,45 @@ inline void		CCDBChangeTracker::recordChange( TCDBDataIndex index )
 
 
 /*
- * Record a change (push) in the backward-linnked-list which entry-point is subtrackerLast
+ * Record a change of a leaf of the atom group atomGroupIndex (push)
  */
-inline void		CCDBChangeTracker::recordChangeSublist( TCDBDataIndex& subtrackerLast, TCDBDataIndex index )
+inline void		CCDBChangeTracker::recordChangeInAtom( TCDBDataIndex atomGroupIndex, TCDBDataIndex index )
 {
-	// Test if the entity is already or not flagged as changed
-	if ( _TrackVec[index] == CDB_INVALID_DATA_INDEX )
-	{
-		// Set the index as changed, and link it to the previous one (the first time, it's CDB_LAST_CHANGED)
-		_TrackVec[index] = subtrackerLast;
+	// Record the change of the atom group, and of the particular leaf
+	recordChange( atomGroupIndex );
+	_ChangedInAtomBits[(uint)index >> WordShift] |= ((uint64)1) << (index & (WordBits-1));
+}
+
 
-		// Make the list entry point (last item) pointing to the new entry
-		subtrackerLast = index;
+/*
+ * Return the first index >= from marked in _ChangedBits, or CDB_LAST_CHANGED
+ */
+TCDBDataIndex	CCDBChangeTracker::findChanged( uint from ) const
+{
+	if ( from >= _Size )
+		return CDB_LAST_CHANGED;
+
+	// In the word of 'from'
+	uint word = from >> WordShift;
+	uint64 bits = _ChangedBits[word] & ((~(uint64)0) << (from & (WordBits-1)));
+	if ( bits != 0 )
+		return (TCDBDataIndex)((word << WordShift) + getLowestBit( bits ));
+
+	// In the next non-null words, found with the summary
+	uint nbWords = (uint)_ChangedBits.size();
+	for ( uint nextWord=word+1; nextWord<nbWords; nextWord=(nextWord|(WordBits-1))+1 )
+	{
+		uint64 summary = _NonEmptyWords[nextWord >> WordShift] & ((~(uint64)0) << (nextWord & (WordBits-1)));
+		if ( summary != 0 )
+		{
+			word = ((nextWord >> WordShift) << WordShift) + getLowestBit( summary );
+			return (TCDBDataIndex)((word << WordShift) + getLowestBit( _ChangedBits[word] ));
+		}
 	}
+	return CDB_LAST_CHANGED;
 }
 
+
 /*
  * Set the value of the property (no bound check, sets change flag if value different than previous).
  */
@@ -133,17 +155,10 @@ bool			CCDBDataInstanceContainer::setValue64InAtom( TCDBDataIndex index, sint64
 	{
 		_DataArray[index] = value;
 
-		// Record the change of the atom in the main tracker
-		_ChangeTracker.recordChange( atomGroupIndex );	
-
-		// Record the change of the particular value in the atom subtracker
-		_ChangeTracker.recordChangeSublist( (TCDBDataIndex&)(_DataArray[atomGroupIndex]), index );
-
+		// Record the change of the atom and of the particular value
+		_ChangeTracker.recordChangeInAtom( atomGroupIndex, index );
 		if ( _UsePermanentTracker )
-		{
-			_PermanentTracker.recordChange( atomGroupIndex );	
-			_PermanentTracker.recordChangeSublist( (TCDBDataIndex&)(_DataArray[atomGroupIndex]), index );
-		}
+			_PermanentTracker.recordChangeInAtom( atomGroupIndex, index );
 
 		return true;
 	}
@@ -153,20 +168,62 @@ bool			CCDBDataInstanceContainer::setValue64InAtom( TCDBDataIndex index, sint64
 
 
 /*
- * Debug
+ * Benchmark of the change tracking of the databases
  */
-void		CCDBDataInstanceContainer::displayAtomChanges( TCDBDataIndex atomGroupIndex )
+NLMISC_COMMAND( benchCDBChangeTracker, "Measure the recording and popping of the database changes (time per database per cycle)", "[<nbDatabases>=2000 [<nbIndices>=20000 [<nbChangesPerCycle>=20 [<nbCycles>=100]]]]" )
 {
-	nlinfo( "List of changes for AtomGroupIndex %hd", atomGroupIndex );
-	TCDBDataIndex index = (TCDBDataIndex)_DataArray[atomGroupIndex];
-	if ( index == CDB_LAST_CHANGED )
-	{
-		nlinfo( "<None>" );
-	}
-	else do
+	uint nbDatabases = 2000, nbIndices = 20000, nbChanges = 20, nbCycles = 100;
+	if ( args.size() > 0 )
+		NLMISC::fromString( args[0], nbDatabases );
+	if ( args.size() > 1 )
+		NLMISC::fromString( args[1], nbIndices );
+	if ( args.size() > 2 )
+		NLMISC::fromString( args[2], nbChanges );
+	if ( args.size() > 3 )
+		NLMISC::fromString( args[3], nbCycles );
+	nbDatabases = std::max( nbDatabases, 1u );
+	nbIndices = std::max( nbIndices, 1u );
+
+	std::vector<CCDBDataInstanceContainer> databases( nbDatabases );
+	for ( uint db=0; db!=nbDatabases; ++db )
+		databases[db].init( (TCDBDataIndex)nbIndices, false );
+
+	// Most of the changes are in one inventory page (a range of 256 indices), the others anywhere
+	const uint pageSize = std::min( 256u, nbIndices );
+	NLMISC::CRandom random;
+	NLMISC::TTicks totalTime = 0;
+	uint nbPopped = 0;
+	std::vector<TCDBDataIndex> changes( nbChanges );
+	for ( uint cycle=0; cycle!=nbCycles; ++cycle )
 	{
-		nlinfo( "> %hd", index );
-		index = _ChangeTracker._TrackVec[index];
+		for ( uint db=0; db!=nbDatabases; ++db )
+		{
+			// Choose the changes before measuring
+			uint pageStart = (uint)random.rand( 0x7fff ) * (nbIndices - pageSize) / 0x7fff;
+			for ( uint i=0; i!=nbChanges; ++i )
+			{
+				uint r = (uint)random.rand( 0x7fff );
+				changes[i] = (TCDBDataIndex)(((i & 3) != 0) ? (pageStart + r % pageSize) : (((r << 15) | (uint)random.rand( 0x7fff )) % nbIndices));
+			}
+
+			CCDBDataInstanceContainer& database = databases[db];
+			NLMISC::TTicks before = NLMISC::CTime::getPerformanceTime();
+			for ( uint i=0; i!=nbChanges; ++i )
+				database.setValue64( changes[i], (sint64)cycle, true );
+			TCDBDataIndex index = database.getFirstChanged();
+			while ( index != CDB_LAST_CHANGED )
+			{
+				database.popChanged( index );
+				++nbPopped;
+				index = database.getFirstChanged();
+			}
+			totalTime += NLMISC::CTime::getPerformanceTime() - before;
+		}
 	}
-	while ( index != CDB_LAST_CHANGED );
+
+	double duration = NLMISC::CTime::ticksToSecond( totalTime );
+	log.displayNL( "%u databases x %u indices, %u changes per cycle (%u popped), %u cycles: %.3f s, %.3f us per database per cycle",
+		nbDatabases, nbIndices, nbChanges, nbPopped, nbCycles, duration,
+		duration * 1000000.0 / ((double)nbDatabases * (double)nbCycles) );
+	return true;
 }
@@ -22,9 +22,14 @@
 #include "server_share/fixed_size_int_vector.h"
 #include "cdb_struct_banks.h"
 
+#include <vector>
+
 
 /**
- *
+ * Set of changed properties, as a bitmap indexed by TCDBDataIndex, with a summary bitmap
+ * (one bit per non-null word) to skip the unchanged ranges when looking for the changes.
+ * The properties that are leaves of an atom group have their own flat bitmap, because they
+ * are never searched for: they are read when browsing the leaves of the atom group.
  */
 class CCDBChangeTracker
 {
@@ -32,106 +37,124 @@ protected:
 
 	friend class CCDBDataInstanceContainer;
 
+	/// Number of properties per word of the bitmaps
+	enum { WordBits = 64, WordShift = 6 };
+
 	/// Constructor
-	CCDBChangeTracker() : _FirstChanged(CDB_LAST_CHANGED), _LastChanged( CDB_INVALID_DATA_INDEX), _ChangedCount(0) {}
+	CCDBChangeTracker() : _Size(0), _ChangedCount(0), _NextToPop(0) {}
 
 	/// Init
-	void	init( TCDBDataIndex size ) { _TrackVec.init( size, CDB_INVALID_DATA_INDEX ); }
+	void			init( TCDBDataIndex size );
 
 	/// Record a change (push)
 	inline void		recordChange( TCDBDataIndex index );
 
-	/// Record a change (push) in the backward-linnked-list which entry-point is subtrackerLast
-	inline void		recordChangeSublist( TCDBDataIndex& subtrackerLast, TCDBDataIndex index );
-	
-	/// Get the entity index of the first changed. Returns CDB_LAST_CHANGED if there is no change.
-	TCDBDataIndex	getFirstChanged() const { return _FirstChanged; }
+	/// Record a change of a leaf of the atom group atomGroupIndex (push)
+	inline void		recordChangeInAtom( TCDBDataIndex atomGroupIndex, TCDBDataIndex index );
 
-	/// Get the entity index of the next changed (assumes dataIndex is valid). Returns LAST_CHANGED if there is no more change.
-	TCDBDataIndex	getNextChanged( TCDBDataIndex index ) const { return _TrackVec[index]; }
+	/**
+	 * Get the index of the first change to pop. Returns CDB_LAST_CHANGED if there is no change.
+	 * The changes are popped by increasing index, resuming after the last one popped, so that
+	 * all the changes are sent even if a writing is limited in size.
+	 */
+	TCDBDataIndex	getFirstChanged() const
+	{
+		if ( _ChangedCount == 0 )
+			return CDB_LAST_CHANGED;
+		TCDBDataIndex index = findChanged( _NextToPop );
+		return (index != CDB_LAST_CHANGED) ? index : findChanged( 0 );
+	}
+
+	/// Get the index of the first change after index in the bitmap. Returns CDB_LAST_CHANGED if there is no more change.
+	TCDBDataIndex	getNextChanged( TCDBDataIndex index ) const { return findChanged( (uint)index + 1 ); }
 
-	/// Pop the first change out of the tracker. Do not call if getFirstChanged() returned CDB_LAST_CHANGED.
-	void			popFirstChanged()
+	/// Pop a change out of the tracker (the one returned by getFirstChanged())
+	void			popChanged( TCDBDataIndex index )
 	{
 #ifdef NL_DEBUG
-		nlassert( _FirstChanged != CDB_LAST_CHANGED );
+		nlassert( isChangedEntry( index ) );
 #endif
-		TCDBDataIndex *queueFront = &(_TrackVec[_FirstChanged]);
-		_FirstChanged = *queueFront;
-		*queueFront = CDB_INVALID_DATA_INDEX;
-
+		uint word = (uint)index >> WordShift;
+		uint64& bits = _ChangedBits[word];
+		bits &= ~(((uint64)1) << (index & (WordBits-1)));
+		if ( bits == 0 )
+			_NonEmptyWords[word >> WordShift] &= ~(((uint64)1) << (word & (WordBits-1)));
 		--_ChangedCount;
+		_NextToPop = (uint)index + 1;
 	}
 
-	/// Pop the last change out of the subtracker, or return CDB_INVALID_DATA_INDEX if no more changes
-	TCDBDataIndex	popChangedIndexInAtomSubstrackerLast( TCDBDataIndex& subtrackerLast )
-	{ 
-		if ( subtrackerLast == CDB_LAST_CHANGED )
-		{
-			return subtrackerLast;
-		}
-		else
-		{
-			TCDBDataIndex lastChange = subtrackerLast;
-			subtrackerLast = _TrackVec[lastChange]; // set the new queue end to the previous of 'last'
-			_TrackVec[lastChange] = CDB_INVALID_DATA_INDEX;
-			return lastChange;
-		}
-	}
-
-	/// Finish cleaning the change tracker to allow adding new changes when all changes have been popped by popFirstChanged()
-	void			quickCleanChanges()
+	/// Pop the change of a leaf of an atom group, return false if it was not marked as changed
+	bool			popChangeInAtom( TCDBDataIndex index )
 	{
-		if ( _FirstChanged == CDB_LAST_CHANGED )
-		{
-			_LastChanged = CDB_INVALID_DATA_INDEX;
-		}
+		uint64& bits = _ChangedInAtomBits[(uint)index >> WordShift];
+		uint64 bit = ((uint64)1) << (index & (WordBits-1));
+		if ( (bits & bit) == 0 )
+			return false;
+		bits &= ~bit;
+		return true;
 	}
 
 	/// Return true if the specified property is marked as changed (no bound check)
-	bool			isChanged( TCDBDataIndex index ) const { return (_TrackVec[index] != CDB_INVALID_DATA_INDEX); }
+	bool			isChanged( TCDBDataIndex index ) const
+	{
+		uint word = (uint)index >> WordShift;
+		uint64 bit = ((uint64)1) << (index & (WordBits-1));
+		return ((_ChangedBits[word] | _ChangedInAtomBits[word]) & bit) != 0;
+	}
 
-	/// Return the number of changes
+	/// Return the number of changes (an atom group counts for one change)
 	uint			getChangedPropertyCount() const { return _ChangedCount; }
 
 private:
 
-	/**
-	 * Storage for the main tracker and all subtrackers, which are
-	 * single-linked list implemented by this array of the same size as _DataArray.
-	 *
-	 * For the main tracker (forward-linking):
-	 * Each changed item either points to the next changed or is the value CDB_LAST_CHANGED.
-	 * If the item state is 'unchanged', the value is CDB_INVALID_DATA_INDEX.
-	 *
-	 * For a subtracker (backward-linking):
-	 * Each changed item either points to the previous changed or is the value CDB_INVALID_DATA_INDEX.
-	 * If the item state is 'unchanged', the value is CDB_INVALID_DATA_INDEX.
-	 */
-	CFixedSizeIntVector<TCDBDataIndex>	_TrackVec;
+	/// Return true if the property or atom group is marked as changed in the searchable bitmap
+	bool			isChangedEntry( TCDBDataIndex index ) const { return (_ChangedBits[(uint)index >> WordShift] & (((uint64)1) << (index & (WordBits-1)))) != 0; }
 
-	/** First changed item (useful to read the changed from the beginning).
-	 * When there is no change to read, First equals CDB_LAST_CHANGED.
-	 */
-	TCDBDataIndex				_FirstChanged;
+	/// Return the first index >= from marked in _ChangedBits, or CDB_LAST_CHANGED
+	TCDBDataIndex	findChanged( uint from ) const;
 
-	/** Last changed item (useful to link the last changed to a newly changed item).
-	 * When there is no change yet, Last equals CDB_INVALID_DATA_INDEX.
-	 */
-	TCDBDataIndex				_LastChanged;
+	/// Bit index of the lowest bit set in a non-null word
+	static uint		getLowestBit( uint64 word )
+	{
+#if defined(__GNUC__)
+		return (uint)__builtin_ctzll( word );
+#else
+		uint bit = 0;
+		while ( (word & 1) == 0 )
+		{
+			word >>= 1;
+			++bit;
+		}
+		return bit;
+#endif
+	}
+
+	/// Changed properties and atom groups (one bit per TCDBDataIndex)
+	std::vector<uint64>			_ChangedBits;
+
+	/// Summary of _ChangedBits: one bit per word, set if the word is not null
+	std::vector<uint64>			_NonEmptyWords;
+
+	/// Changed leaves of atom groups (one bit per TCDBDataIndex)
+	std::vector<uint64>			_ChangedInAtomBits;
+
+	/// Number of indices
+	uint						_Size;
 
 	/// Number of changes still to pop
 	sint						_ChangedCount;
+
+	/// Index from which getFirstChanged() looks for a change
+	uint						_NextToPop;
 };
 
 
 /**
- * There are two levels of trackers. The main tracker is accessed with getFirstChanged(),
- * popFirstChanged(). It is a forward-linked-list, to ensure the changes are popped in
- * the same order as they were recorded.
- * You can have several subtrackers (one for each atom group), they are backward-linked-lists
- * (because all changes in them are always popped in one shot for atomic sending). The last
- * recorded index is stored in the data array at the position of the atom group index.
+ * Values of the properties of a database, and trackers of their changes.
+ * The main tracker is accessed with getFirstChanged(), popChanged(). It records the leaves
+ * changed and the atom groups containing a changed leaf (the leaves of an atom group are
+ * all popped in one shot for atomic sending, with popChangeInAtom()).
+ * The permanent tracker (optional) records the same changes but is never popped.
  *
  * \author Olivier Cado
  * \author Nevrax France
@@ -144,9 +167,6 @@ public:
 	/// Initialization
 	void			init( TCDBDataIndex size, bool usePermanentTracker  );
 
-	/// Init/reset the atom group subtracker at index (must be called for every index which corresponding node is an atom branch)
-	void			resetSubTracker( TCDBDataIndex index ) { _DataArray[index] = CDB_LAST_CHANGED; }
-
 	/// Get the value of the property (no bound check)
 	inline sint64	getValue64( TCDBDataIndex index ) const { return _DataArray[index]; }
 
@@ -159,11 +179,14 @@ public:
 	/// Set the value of the property (no bound check, set the change flag in an atom group if value different than previous or forceSending is true)
 	bool			setValue64InAtom( TCDBDataIndex index, sint64 value, TCDBDataIndex atomGroupIndex, bool forceSending );
 
-	/// Copy the current value to the last sent value of the property (no bound check)
-	//void			archiveCurrentValue( TCDBDataIndex index ) { _LastSentDataArray[index] = _DataArray[index]; }
+	/// Allocate the last sent values (all 0), needed for the packed deltas (see CCDBSynchronised::usePackedDeltas())
+	void			initLastSentValues() { if ( _LastSentDataArray.size() == 0 ) _LastSentDataArray.init( _DataArray.size(), 0 ); }
 
-	/// Get the difference (delta) between the last sent value and the current one (no bound check)
-	//sint64		getDeltaFromArchive( TCDBDataIndex index ) { return _DataArray[index] - _LastSentDataArray[index]; }
+	/// Get the last sent value of the property (no bound check, initLastSentValues() must have been called)
+	sint64			getLastSentValue64( TCDBDataIndex index ) const { return _LastSentDataArray[index]; }
+
+	/// Set the last sent value of the property (no bound check, initLastSentValues() must have been called)
+	void			setLastSentValue64( TCDBDataIndex index, sint64 value ) { _LastSentDataArray[index] = value; }
 
 	/// Set the value of the property (no bound check, does NOT modify the change flag).
 	/*inline sint32	getValue32( TCDBDataIndex index ) const { return *((sint32*)&(_DataArray[index])); }
@@ -178,27 +201,14 @@ public:
 	/// Return true if the specified index is valid in the container
 	bool			checkIndex( TCDBDataIndex index ) const { return (index >= 0) && (index < (TCDBDataIndex)_DataArray.size()); }
 
-	/// Get the entity index of the first changed. Returns CDB_LAST_CHANGED if there is no change.
+	/// Get the index of the next change to pop (leaf or atom group). Returns CDB_LAST_CHANGED if there is no change.
 	TCDBDataIndex	getFirstChanged() const { return _ChangeTracker.getFirstChanged(); }
 
-	/// Get the entity index of the next changed (assumes dataIndex is valid). Returns LAST_CHANGED if there is no more change.
-	TCDBDataIndex	getNextChanged( TCDBDataIndex index ) const { return _ChangeTracker.getNextChanged( index ); }
-
-	/// Pop the first change out of the tracker. Do not call if getFirstChanged() returned CDB_LAST_CHANGED.
-	void			popFirstChanged() { _ChangeTracker.popFirstChanged(); }
-	
-	/// Pop the last change out of the subtracker referenced at the specified index in the data array, or return CDB_INVALID_DATA_INDEX if no more changes
-	TCDBDataIndex	popChangedIndexInAtom( TCDBDataIndex atomGroupIndex )
-	{
-		TCDBDataIndex& subtrackerLast = (TCDBDataIndex&)(_DataArray[atomGroupIndex]);
-		return _ChangeTracker.popChangedIndexInAtomSubstrackerLast( subtrackerLast );
-	}
-
-	/// Debug
-	void			displayAtomChanges( TCDBDataIndex atomGroupIndex );
+	/// Pop a change returned by getFirstChanged() out of the tracker
+	void			popChanged( TCDBDataIndex index ) { _ChangeTracker.popChanged( index ); }
 
-	/// Finish cleaning the change tracker to allow adding new changes when all changes have been popped by popFirstChanged()
-	void			quickCleanChanges() { _ChangeTracker.quickCleanChanges(); }
+	/// Pop the change of a leaf of an atom group out of the tracker, return false if the leaf was not changed
+	bool			popChangeInAtom( TCDBDataIndex index ) { return _ChangeTracker.popChangeInAtom( index ); }
 
 	/// Return true if the specified property is marked as changed (no bound check)
 	bool			isChanged( TCDBDataIndex index ) const { return _ChangeTracker.isChanged( index ); }
@@ -207,7 +217,7 @@ public:
 	uint			getChangedPropertyCount() const { return _ChangeTracker.getChangedPropertyCount(); }
 
 	/// Get the entity index of the first changed. Returns CDB_LAST_CHANGED if there is no change.
-	TCDBDataIndex	getPermanentFirstChanged() const { return _PermanentTracker.getFirstChanged(); }
+	TCDBDataIndex	getPermanentFirstChanged() const { return _PermanentTracker.findChanged( 0 ); }
 
 	/// Get the entity index of the next changed (assumes dataIndex is valid). Returns LAST_CHANGED if there is no more change.
 	TCDBDataIndex	getPermanentNextChanged( TCDBDataIndex index ) const { return _PermanentTracker.getNextChanged( index ); }
@@ -223,8 +233,8 @@ private:
 	/// Array of property values, indexed by TCDBDataIndex
 	CFixedSizeIntVector<sint64>	_DataArray;
 
-	/// Array of the last sent property values, indexed by TCDBDataIndex
-	//std::vector<sint64>		_LastSentDataArray;
+	/// Array of the last sent property values, indexed by TCDBDataIndex (empty if not used)
+	CFixedSizeIntVector<sint64>	_LastSentDataArray;
 
 	/// Regular change tracker
 	CCDBChangeTracker			_ChangeTracker;
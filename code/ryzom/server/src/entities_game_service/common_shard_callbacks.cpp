@@ -21,6 +21,7 @@
 #include "player_manager/player_manager.h"
 #include "player_manager/player.h"
 #include "nel/net/unified_network.h"
+#include "game_share/backup_service_interface.h"
 
 using namespace std;
 using namespace NLMISC;
@@ -105,6 +106,23 @@ void	cbStallMode( NLNET::CMessage& msgin, const std::string &serviceName, NLNET:
 
 
 
+// received the status of a delta save from the backup service (see PDRDeltaSave)
+void	cbPDRDeltaStatus( NLNET::CMessage& msgin, const std::string &serviceName, NLNET::TServiceId serviceId )
+{
+	std::string	fileName;
+	bool		success;
+	msgin.serial(fileName, success);
+
+	// remove the remote path added by the backup service interface
+	const std::string& remotePath = BsiGlobal.getRemotePath();
+	if (fileName.compare(0, remotePath.size(), remotePath) == 0)
+		fileName = fileName.substr(remotePath.size());
+
+	PlayerManager.onPDRDeltaStatus( fileName, success );
+}
+
+
+
 void CCommonShardCallbacks::init()
 {
 /*	/// the array of callbacks
@@ -122,6 +140,7 @@ void CCommonShardCallbacks::init()
 	TUnifiedCallbackItem array[]=
 	{
 		{ "STALL_MODE",								cbStallMode			},
+		{ "bs_delta_status",						cbPDRDeltaStatus	},
 	}; 
 	// setup the callback array
 	CUnifiedNetwork::getInstance()->addCallbackArray( array, sizeof(array)/sizeof(array[0]) );
@@ -500,6 +500,9 @@ NLMISC::CVariable<bool> XMLSave("loadSave","XMLSave", "boolean : if true players
 NLMISC::CVariable<bool> PDRSave("loadSave","PDRSave", "boolean : if true players are saved in PDR format", true, 0, true );
 NLMISC::CVariable<bool> PDRLoad("loadSave","PDRLoad", "boolean : if true players are loaded from PDR format", false, 0, true );
 NLMISC::CVariable<bool> SerialSave("loadSave","SerialSave", "boolean : if true players are saved in serial format", false, 0, true );
+NLMISC::CVariable<bool> PDRDeltaSave("loadSave","PDRDeltaSave", "boolean : if true binary pdr saves of players only send the changes since the previous save to the BS, which appends them to a journal", false, 0, true );
+NLMISC::CVariable<float> PDRDeltaMaxRatio("loadSave","PDRDeltaMaxRatio", "a full pdr save is sent instead of a delta bigger than this ratio of the file size", 0.5f, 0, true );
+NLMISC::CVariable<uint32> PDRDeltaMaxCount("loadSave","PDRDeltaMaxCount", "a full pdr save is sent after this number of delta saves of a character", 20, 0, true );
 
 CVariable<float> ItemPriceCoeff0("egs","ItemPriceCoeff0", "polynom coeff of degree 0 in the price formula", 1.0f, 0, true );
 CVariable<float> ItemPriceCoeff1("egs","ItemPriceCoeff1", "polynom coeff of degree 1 in the price formula", 1.0f, 0, true );
@@ -356,6 +356,9 @@ extern NLMISC::CVariable<bool>					XMLSave;
 extern NLMISC::CVariable<bool>					PDRSave;
 extern NLMISC::CVariable<bool>					PDRLoad;
 extern NLMISC::CVariable<bool>					SerialSave;
+extern NLMISC::CVariable<bool>					PDRDeltaSave;
+extern NLMISC::CVariable<float>					PDRDeltaMaxRatio;
+extern NLMISC::CVariable<uint32>				PDRDeltaMaxCount;
 
 /// TRADE 
 extern NLMISC::CVariable<float>					ItemPriceCoeff0;
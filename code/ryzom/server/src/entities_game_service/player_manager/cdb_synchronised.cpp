@@ -38,6 +38,7 @@
 #include "nel/misc/bit_set.h"
 #include "nel/misc/command.h"
 #include "nel/misc/bit_mem_stream.h"
+#include "nel/misc/variable.h"
 
 
 //#include "nel/net/unified_network.h"
@@ -55,6 +56,8 @@
 
 bool VerboseDatabase = false;
 
+NLMISC::CVariable<bool> PackedDatabaseDeltas( "egs", "PackedDatabaseDeltas", "Send the player database changes in the packed format (needs a client supporting it)", false, 0, true );
+
 
 ////////////////
 // Namespaces //
@@ -68,7 +71,7 @@ using namespace std;
 //	CCDBSynchronised
 //
 //-----------------------------------------------
-CCDBSynchronised::CCDBSynchronised() : _DataStructRoot(NULL), _Bank(INVALID_CDB_BANK), NbDatabaseChanges(0), _NotSentYet(true)
+CCDBSynchronised::CCDBSynchronised() : _DataStructRoot(NULL), _Bank(INVALID_CDB_BANK), NbDatabaseChanges(0), _NotSentYet(true), _PackedDeltas(false), _PackedDeltaSequence(0)
 {
 }
 
@@ -78,17 +81,6 @@ CCDBSynchronised::~CCDBSynchronised()
 	CDBStringUpdater::getInstance().onClientDatabaseDeleted(this);
 }
 
-/*
- * Helper callback for init()
- */
-void cbAtomBranchResetSubTracker( void *dataContainer, TCDBDataIndex index )
-{
-	// if ( VerboseDatabase )
-	//nldebug( "CDB: Resetting sub tracker at index %d", index );
-	((CCDBDataInstanceContainer*)dataContainer)->resetSubTracker( index );
-}
-
-
 //-----------------------------------------------
 //	init (the singleton of CCDBStructBanks must have been initialized before)
 //
@@ -103,8 +95,6 @@ void CCDBSynchronised::init( TCDBBank bank, bool usePermanentTracker )
 	_DataContainer.init( CCDBStructBanks::instance()->nbIndices( bank ), usePermanentTracker );
 	_DataStructRoot = CCDBStructBanks::instance()->getStructRoot( bank );
 	nlassert( _DataStructRoot );
-
-	_DataStructRoot->foreachAtomBranchCall( cbAtomBranchResetSubTracker, &_DataContainer );
 }
 
 
@@ -169,6 +159,21 @@ void CCDBSynchronised::read( const string& fileName )
 } // read //
 
 
+//-----------------------------------------------
+//	usePackedDeltas
+//
+//-----------------------------------------------
+void CCDBSynchronised::usePackedDeltas()
+{
+	nlassert( _DataStructRoot );
+	nlassert( _NotSentYet );
+
+	_DataContainer.initLastSentValues();
+	_PackedDeltas = true;
+	_PackedDeltaSequence = 0;
+}
+
+
 struct TWriteCallbackArg
 {
 	FILE						*F;
@@ -235,11 +240,14 @@ void cbPushDeltaOfLeafInAtomIfChangedPermanent( void* arg, CCDBStructNodeLeaf *n
  */
 void CCDBSynchronised::pushDeltaOfLeafInAtomIfChanged( TPushAtomChangeStruct *arg, CCDBStructNodeLeaf *node, uint indexInAtom )
 {
-	if ( _DataContainer.isChanged( node->getDataIndex() ) )
+	if ( _DataContainer.popChangeInAtom( node->getDataIndex() ) )
 	{
 		if ( VerboseDatabase )
 			nldebug( "CDB/ATOM: Pushing changed property[%u]", indexInAtom );
-		pushDelta( *arg->S, node, *arg->BitSize );
+		if ( _PackedDeltas )
+			pushPackedDelta( *arg->S, node, *arg->BitSize );
+		else
+			pushDelta( *arg->S, node, *arg->BitSize );
 		arg->AtomBitfield.set( indexInAtom, true );
 	}
 }
@@ -275,6 +283,37 @@ inline sint ICDBStructNode::CBinId::writeToBitMemStream( NLMISC::CBitMemStream&
 }
 
 
+/*
+ * Write the id to a bit stream as the id of a packed delta change following the change of prevId,
+ * and return the size of data written (must match CCDBNodeBranch::readAndMapPackedDelta() in the client)
+ */
+static uint32 writePackedBinId( CBitMemStream& s, const ICDBStructNode::CBinId& id, const ICDBStructNode::CBinId& prevId )
+{
+	uint nbLevels = (uint)id.Ids.size();
+	uint nbCommonLevels = 0;
+	while ( (nbCommonLevels < nbLevels) && (nbCommonLevels < prevId.Ids.size()) && (id.Ids[nbCommonLevels].first == prevId.Ids[nbCommonLevels].first) )
+		++nbCommonLevels;
+
+	// Next sibling of the previous node: 1 bit
+	bool isNextSibling = (nbLevels == prevId.Ids.size()) && (nbCommonLevels == nbLevels-1) && (id.Ids.back().first == prevId.Ids.back().first + 1);
+	s.serialBitAndLog( isNextSibling );
+	if ( isNextSibling )
+		return 1;
+
+	// Otherwise, the number of levels shared with the previous id, then the other levels (at least the last one)
+	uint32 nbCommonLevelsWritten = std::min( nbCommonLevels, std::min( nbLevels-1, (uint)((1 << CDBPackedDeltaCommonLevelsBitSize) - 1) ) );
+	s.serialAndLog2( nbCommonLevelsWritten, CDBPackedDeltaCommonLevelsBitSize );
+	uint32 bitsize = 1 + CDBPackedDeltaCommonLevelsBitSize;
+	for ( uint i=nbCommonLevelsWritten; i<nbLevels; ++i )
+	{
+		uint32 nodeIndex = id.Ids[i].first;
+		s.serialAndLog2( nodeIndex, id.Ids[i].second );
+		bitsize += id.Ids[i].second;
+	}
+	return bitsize;
+}
+
+
 /*
  * Fill the bitstream with the property changes that were pushed using setPropIntoClientonlyDB().
  * Empty the list of pending property changes.
@@ -323,12 +362,23 @@ bool CCDBSynchronised::writeDelta( CBitMemStream& s, uint32 maxBitSize )
 	uint origChangedPropertyCount = getChangedPropertyCount();
 	if ( origChangedPropertyCount == 0 )
 		return false;
+	uint32 bitsize = 0;
+	if ( _PackedDeltas )
+	{
+		// Packed format: marker and sequence number before the number of changes
+		uint32 marker = CDBPackedDeltaMarker;
+		s.serial( marker, CDBChangedPropertyCountBitSize );
+		uint32 sequence = _PackedDeltaSequence++;
+		s.serial( sequence, CDBPackedDeltaSequenceBitSize );
+		bitsize += CDBChangedPropertyCountBitSize + CDBPackedDeltaSequenceBitSize;
+	}
 	uint bitposOfNbChanges = s.getPosInBit();
 	uint32 dummy = 0;
 	s.serial( dummy, CDBChangedPropertyCountBitSize ); // optimising s.reserveBits( CDBChangedPropertyCountBitSize )
 
 	// Browse changes and write them
-	uint32 bitsize = CDBChangedPropertyCountBitSize; // initialize with the size of the reserved bits for the number of changes
+	bitsize += CDBChangedPropertyCountBitSize; // add the size of the reserved bits for the number of changes
+	ICDBStructNode::CBinId prevBinId; // id of the previous change (packed format)
 	TCDBDataIndex dataIndex;
 	while ( ((dataIndex = _DataContainer.getFirstChanged()) != CDB_LAST_CHANGED)
 			&& (bitsize < maxBitSize) )
@@ -345,9 +395,16 @@ bool CCDBSynchronised::writeDelta( CBitMemStream& s, uint32 maxBitSize )
 			// Build and push the binary atom id
 			ICDBStructNode::CBinId binId;
 			(static_cast<CCDBStructNodeBranch*>(node))->buildBinIdFromLeaf( binId );
-			bitsize += binId.writeToBitMemStream( s );
+			if ( _PackedDeltas )
+			{
+				bitsize += writePackedBinId( s, binId, prevBinId );
+				prevBinId.Ids.swap( binId.Ids );
+			}
+			else
+			{
+				bitsize += binId.writeToBitMemStream( s );
+			}
 			//nlinfo( "CDB/ATOM: Written bin id %s", binId.toString().c_str() );
-			//_DataContainer.displayAtomChanges( node->getDataIndex() );
 
 			// Make room to store the atom bitfield
 			uint bitposOfAtomBitfield = s.getPosInBit();
@@ -358,7 +415,7 @@ bool CCDBSynchronised::writeDelta( CBitMemStream& s, uint32 maxBitSize )
 			bitsize += nbAtomElements;
 			//nlinfo( "CDB/ATOM: Reserved %u bits (%d)", nbAtomElements, s.getPosInBit()-bitposOfAtomBitfield );
 
-			// Browse the siblings of the atom node, and push the deltas for the properties marked as changes, updating the bitfield
+			// Browse the siblings of the atom node, and push the deltas for the properties marked as changes (popping them), updating the bitfield
 			TPushAtomChangeStruct arg;
 			arg.CdbSync = this;
 			arg.BitSize = &bitsize;
@@ -373,11 +430,6 @@ bool CCDBSynchronised::writeDelta( CBitMemStream& s, uint32 maxBitSize )
 			{
 				nldebug( "CDB/ATOM: Bitfield: %s", arg.AtomBitfield.toString().c_str() );
 			}
-
-			// Pop the changes out of the tracker
-			TCDBDataIndex atomGroupIndex = node->getDataIndex();
-			TCDBDataIndex leafDataIndex;
-			while ( (leafDataIndex = _DataContainer.popChangedIndexInAtom( atomGroupIndex )) != CDB_LAST_CHANGED );
 		}
 		else
 		{
@@ -385,14 +437,25 @@ bool CCDBSynchronised::writeDelta( CBitMemStream& s, uint32 maxBitSize )
 			nlassert( dynamic_cast<CCDBStructNodeLeaf*>(node) );
 #endif
 
-			// Push the binary property id
-			bitsize += static_cast<CCDBStructNodeLeaf*>(node)->binLeafId().writeToBitMemStream( s );
+			CCDBStructNodeLeaf *leaf = static_cast<CCDBStructNodeLeaf*>(node);
+			if ( _PackedDeltas )
+			{
+				// Push the packed property id and value
+				bitsize += writePackedBinId( s, leaf->binLeafId(), prevBinId );
+				prevBinId = leaf->binLeafId();
+				pushPackedDelta( s, leaf, bitsize );
+			}
+			else
+			{
+				// Push the binary property id
+				bitsize += leaf->binLeafId().writeToBitMemStream( s );
 
-			// Push the value
-			pushDelta( s, static_cast<CCDBStructNodeLeaf*>(node), bitsize );
+				// Push the value
+				pushDelta( s, leaf, bitsize );
+			}
 		}
 
-		_DataContainer.popFirstChanged();
+		_DataContainer.popChanged( dataIndex );
 	}
 
 	// Fill the placeholder with the number of changes
@@ -401,9 +464,6 @@ bool CCDBSynchronised::writeDelta( CBitMemStream& s, uint32 maxBitSize )
 	//s.displayStream( "writeDelta" );
 	NbDatabaseChanges += nbChanges;
 
-	// Check if all has been popped
-	_DataContainer.quickCleanChanges();
-
 	_NotSentYet = false;
 
 #ifdef TRACE_SET_VALUE
@@ -457,7 +517,6 @@ bool	CCDBSynchronised::writePermanentDelta( NLMISC::CBitMemStream& s )
 			(static_cast<CCDBStructNodeBranch*>(node))->buildBinIdFromLeaf( binId );
 			bitsize += binId.writeToBitMemStream( s );
 			//nlinfo( "CDB/ATOM: Written bin id %s", binId.toString().c_str() );
-			//_DataContainer.displayAtomChanges( node->getDataIndex() );
 
 			// Make room to store the atom bitfield
 			uint bitposOfAtomBitfield = s.getPosInBit();
@@ -552,6 +611,74 @@ void	CCDBSynchronised::pushDelta( CBitMemStream& s, CCDBStructNodeLeaf *node, ui
 }
 
 
+/*
+ * Push one change to the stream (packed mode).
+ * A numeric value may be sent as the difference with the last value sent (on the same number
+ * of bits), if shorter: 1 bit for the choice, then the number of 4-bit groups and the
+ * zigzag-coded difference (0, -1, 1, -2... -> 0, 1, 2, 3...), or the value.
+ */
+void	CCDBSynchronised::pushPackedDelta( CBitMemStream& s, CCDBStructNodeLeaf *node, uint32& bitsize )
+{
+	TCDBDataIndex index = node->getDataIndex();
+
+	// Test if the property type is valid.
+	if ( node->type() > ICDBStructNode::UNKNOWN && node->type() < ICDBStructNode::Nb_Prop_Type )
+	{
+		uint64 value = (uint64)_DataContainer.getValue64( index );
+		if ( node->type() == ICDBStructNode::TEXT )
+		{
+			s.serialAndLog2( value, 32 );
+			bitsize += 32;
+			if ( VerboseDatabase )
+				nldebug( "CDB: Pushing packed value %" NL_I64 "d (TEXT-32) for index %d prop %s", (sint64)value, index, node->buildTextId().toString().c_str() );
+		}
+		else
+		{
+			// The client computes the values modulo 2^nbBits
+			uint nbBits = (uint)node->type();
+			uint64 mask = (nbBits < 64) ? ((((uint64)1) << nbBits) - 1) : ~(uint64)0;
+			value &= mask;
+
+			bool isDifference = false;
+			if ( nbBits >= CDBPackedDeltaMinValueBitSize )
+			{
+				// Sign-extend the difference from nbBits, then zigzag it
+				uint64 difference = (value - (uint64)_DataContainer.getLastSentValue64( index )) & mask;
+				if ( (difference >> (nbBits-1)) != 0 )
+					difference |= ~mask;
+				uint64 zigzag = (difference << 1) ^ (uint64)(((sint64)difference) >> 63);
+				uint32 nbNibbles = 1;
+				while ( (nbNibbles < 16) && ((zigzag >> (nbNibbles*4)) != 0) )
+					++nbNibbles;
+
+				isDifference = (nbNibbles <= (1 << CDBPackedDeltaNibbleCountBitSize)) && (CDBPackedDeltaNibbleCountBitSize + nbNibbles*4 < nbBits);
+				s.serialBitAndLog( isDifference );
+				++bitsize;
+				if ( isDifference )
+				{
+					uint32 nbNibblesWritten = nbNibbles - 1;
+					s.serialAndLog2( nbNibblesWritten, CDBPackedDeltaNibbleCountBitSize );
+					s.serialAndLog2( zigzag, nbNibbles*4 );
+					bitsize += CDBPackedDeltaNibbleCountBitSize + nbNibbles*4;
+					if ( VerboseDatabase )
+						nldebug( "CDB: Pushing packed difference %" NL_I64 "d (%u bits) for index %d prop %s", (sint64)difference, nbNibbles*4, index, node->buildTextId().toString().c_str() );
+				}
+			}
+			if ( ! isDifference )
+			{
+				s.serialAndLog2( value, nbBits );
+				bitsize += nbBits;
+				if ( VerboseDatabase )
+					nldebug( "CDB: Pushing packed value %" NL_I64 "d (%u bits) for index %d prop %s", (sint64)value, nbBits, index, node->buildTextId().toString().c_str() );
+			}
+			_DataContainer.setLastSentValue64( index, (sint64)value );
+		}
+	}
+	else
+		nlwarning("CCDBStructNodeLeaf::writePackedDelta : Property Type Unknown ('%d') -> not serialized.", (uint)node->type());
+}
+
+
 /*
  * Push one change to the stream (permanent mode)
  */
@@ -810,7 +937,6 @@ bool CCDBSynchronised::x_setProp( ICDBStructNode * node, sint64 value, bool forc
 				}
 			}
 #endif
-			//_DataContainer.displayAtomChanges( groupNodeFinder->getDataIndex() );
 		}
 		else
 		{
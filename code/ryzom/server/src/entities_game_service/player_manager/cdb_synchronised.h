@@ -36,6 +36,15 @@ struct TPushAtomChangeStruct;
 
 const uint CDBChangedPropertyCountBitSize = 16;
 
+/** Packed deltas (see CCDBSynchronised::usePackedDeltas()).
+ * Must match ICDBNode::PackedDelta* in the client (nel/misc/cdb.h).
+ */
+const uint32 CDBPackedDeltaMarker = 0xFFFF;					// written instead of the changed property count
+const uint CDBPackedDeltaSequenceBitSize = 16;
+const uint CDBPackedDeltaCommonLevelsBitSize = 4;			// number of levels of the id shared with the previous one
+const uint CDBPackedDeltaNibbleCountBitSize = 3;			// number of nibbles of a difference, minus 1
+const uint CDBPackedDeltaMinValueBitSize = 9;				// smaller values are never coded as a difference
+
 
 /**
  * Class to manage a database of properties
@@ -103,6 +112,16 @@ public:
 	 */
 	bool writeDelta( NLMISC::CBitMemStream& s, uint32 maxBitSize );
 
+	/**
+	 * Make writeDelta() use the packed format: the ids of consecutive changes share their
+	 * common levels (a change of the next sibling takes 1 bit), and the numeric values may be
+	 * sent as the difference with the last value sent. The messages are numbered, so that
+	 * the client can apply them in order (the differences depend on the previous ones).
+	 * The last values sent are stored in addition to the current ones. Call after init(),
+	 * before the first writeDelta(). Not for the databases sent with writePermanentDelta().
+	 */
+	void usePackedDeltas();
+
 	/**
 	 * Build the bitstream with all changes since the beginning to send to the recipient.
 	 * Precondition: the CCDBSynchronised object must have been init with usePermanentTracker=true.
@@ -271,6 +290,9 @@ protected:
 	/// Push one change to the stream
 	void	pushDelta( NLMISC::CBitMemStream& s, CCDBStructNodeLeaf *node, uint32& bitsize );
 
+	/// Push one change to the stream (packed mode)
+	void	pushPackedDelta( NLMISC::CBitMemStream& s, CCDBStructNodeLeaf *node, uint32& bitsize );
+
 	/// Push one change to the stream (permanent mode)
 	void	pushDeltaPermanent( NLMISC::CBitMemStream& s, CCDBStructNodeLeaf *node, uint32& bitsize );
 
@@ -299,6 +321,12 @@ private:
 
 	/// Becomes false at the first time writeDelta() is called
 	bool						_NotSentYet;
+
+	/// True if writeDelta() uses the packed format
+	bool						_PackedDeltas;
+
+	/// Number of the next packed delta
+	uint16						_PackedDeltaSequence;
 };
 
 
@@ -203,6 +203,7 @@ extern CVariable<string>	NoActionAllowedPriv;
 extern CVariable<string>	NoValueCheckingPriv;
 extern CVariable<uint32>	OutpostJoinPvpTimer;
 extern CVariable<uint32>	DefaultWeightHands;
+extern CVariable<bool>		PackedDatabaseDeltas;
 
 extern vector<CMainlandSummary>		Mainlands;
 
@@ -4073,6 +4074,8 @@ void CCharacter::initDatabase()
 	// Load the database, and prepare database outbox
 //	_PropertyDatabase.init( CDBPlayer );
 	_PropertyDatabase.init( );
+	if ( PackedDatabaseDeltas.get() )
+		_PropertyDatabase.usePackedDeltas();
 
 	// Target
 //	_PropertyDatabase.setProp( _DataIndexReminder->TARGET.UID, CLFECOMMON::INVALID_CLIENT_DATASET_INDEX );
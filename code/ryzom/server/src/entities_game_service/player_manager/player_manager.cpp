@@ -767,27 +767,29 @@ void CPlayerManager::savePlayerCharRecurs( uint32 userId, sint32 idx, std::set<C
 					(*itPlayer).second.Player->storeCharacter(pdr,idx);
 				}
 				CBackupMsgSaveFile msg( pdrFileName, CBackupMsgSaveFile::SaveFile, BsiGlobal );
-				{					
-					if (XMLSave)
+				if (XMLSave)
+				{
 					{
 						H_AUTO(SavePlayerPDRMakeTxtMsgBS);
 						std::string s;
 						pdr.toString(s);
 						msg.DataMsg.serialBuffer((uint8*)&s[0], (uint)s.size());
 					}
-					else
 					{
-						H_AUTO(SavePlayerPDRMakeBinMsgBS);					
+						H_AUTO(SavePlayerSendMessageBS);
+						BsiGlobal.sendFile( msg );
+					}
+				}
+				else
+				{
+					vector<char> buffer;
+					{
+						H_AUTO(SavePlayerPDRMakeBinMsgBS);
 						uint32 bufSize= pdr.totalDataSize();
-						vector<char> buffer;
 						buffer.resize(bufSize);
 						pdr.toBuffer(&buffer[0],bufSize);
-						msg.DataMsg.serialBuffer((uint8*)&buffer[0], bufSize);
 					}
-				}
-				{
-					H_AUTO(SavePlayerSendMessageBS);
-					BsiGlobal.sendFile( msg );
+					sendPDRSave( userId, msg, (const uint8*)&buffer[0], (uint32)buffer.size() );
 				}
 			}
 			catch(const Exception &)
@@ -888,6 +890,168 @@ void CPlayerManager::savePlayerCharRecurs( uint32 userId, sint32 idx, std::set<C
 }
 
 
+//---------------------------------------------------
+// Ack of a full pdr save by the BS (a delta save has its own status, see onPDRDeltaStatus())
+//---------------------------------------------------
+class CPDRSaveAckCallback : public IBackupGenericAckCallback
+{
+public:
+	CPDRSaveAckCallback( uint32 userId ) : _UserId(userId) {}
+
+	virtual void callback( const std::string& fileName )
+	{
+		PlayerManager.onPDRSaveAcknowledged( _UserId, fileName );
+	}
+
+private:
+	uint32	_UserId;
+};
+
+
+//---------------------------------------------------
+// sendPDRSave :
+//
+//---------------------------------------------------
+void CPlayerManager::sendPDRSave( uint32 userId, CBackupMsgSaveFile& msg, const uint8 *buffer, uint32 size )
+{
+	if (!PDRDeltaSave)
+	{
+		msg.DataMsg.serialBuffer(const_cast<uint8*>(buffer), size);
+		H_AUTO(SavePlayerSendMessageBS);
+		BsiGlobal.sendFile( msg );
+		return;
+	}
+
+	H_AUTO(SavePlayerPDRDeltaBS);
+
+	CPDRDeltaSaveState& state= _PDRDeltaSaveStates[userId][msg.FileName];
+
+	// A delta applies to the version of the file the BS has: it can only be sent if the previous
+	// save has been acknowledged (else it may have been lost). The BS sends an explicit status
+	// for a delta, and a failed one makes the next save full (see onPDRDeltaStatus()). A full
+	// file is sent from time to time anyway, to restart the journal of the BS from scratch.
+	vector<uint8> delta;
+	bool sendDelta= !state.Reference.empty() && state.NbSavesNotAcknowledged==0 && state.NbDeltas<PDRDeltaMaxCount.get()
+		&& CPDRDelta::encode(state.Reference, buffer, size, delta) && delta.size()<=PDRDeltaMaxRatio.get()*size;
+
+	// the next delta will apply to this save (a buffer that can't be summarized will be sent in full next time)
+	state.Reference.build(buffer, size);
+	++state.NbSavesNotAcknowledged;
+	_PDRSavesFileBytes+= size;
+
+	if (sendDelta)
+	{
+		++state.NbDeltas;
+		++_NbPDRDeltaSaves;
+		_PDRSavesSentBytes+= delta.size();
+
+		CBackupMsgSaveFile deltaMsg( msg.FileName, CBackupMsgSaveFile::AppendDelta, BsiGlobal );
+		deltaMsg.DataMsg.serialBuffer(&delta[0], (uint)delta.size());
+		H_AUTO(SavePlayerSendMessageBS);
+		BsiGlobal.append( deltaMsg );
+	}
+	else
+	{
+		state.NbDeltas= 0;
+		++_NbPDRFullSaves;
+		_PDRSavesSentBytes+= size;
+
+		msg.DataMsg.serialBuffer(const_cast<uint8*>(buffer), size);
+		H_AUTO(SavePlayerSendMessageBS);
+		BsiGlobal.sendFile( msg, new CPDRSaveAckCallback(userId) );
+	}
+}
+
+
+//---------------------------------------------------
+// onPDRSaveAcknowledged :
+//
+//---------------------------------------------------
+void CPlayerManager::onPDRSaveAcknowledged( uint32 userId, const std::string& fileName )
+{
+	// the user may have disconnected since the save
+	std::map<uint32, TPDRDeltaSaveStates>::iterator itUser= _PDRDeltaSaveStates.find( userId );
+	if (itUser == _PDRDeltaSaveStates.end())
+		return;
+
+	TPDRDeltaSaveStates::iterator it= (*itUser).second.find( fileName );
+	if (it != (*itUser).second.end() && (*it).second.NbSavesNotAcknowledged != 0)
+		--(*it).second.NbSavesNotAcknowledged;
+}
+
+
+//---------------------------------------------------
+// onPDRDeltaStatus :
+//
+//---------------------------------------------------
+void CPlayerManager::onPDRDeltaStatus( const std::string& fileName, bool success )
+{
+	// the file name is "characters/<nnn>/account_<userId>_<charIndex>_pdr.bin"
+	uint32 userId;
+	if (sscanf( CFile::getFilename(fileName).c_str(), "account_%u_", &userId ) != 1)
+	{
+		nlwarning( "PDRDELTA: Invalid file name '%s' in delta status", fileName.c_str() );
+		return;
+	}
+
+	// the user may have disconnected since the save
+	std::map<uint32, TPDRDeltaSaveStates>::iterator itUser= _PDRDeltaSaveStates.find( userId );
+	if (itUser == _PDRDeltaSaveStates.end())
+		return;
+
+	TPDRDeltaSaveStates::iterator it= (*itUser).second.find( fileName );
+	if (it == (*itUser).second.end())
+		return;
+
+	CPDRDeltaSaveState& state= (*it).second;
+	if (state.NbSavesNotAcknowledged != 0)
+		--state.NbSavesNotAcknowledged;
+
+	if (!success)
+	{
+		// the BS does not have the file the next delta would be based on: send it in full
+		nlwarning( "PDRDELTA: The BS failed to store a delta of '%s', the next save will be full", fileName.c_str() );
+		state.Reference.clear();
+		state.NbDeltas= 0;
+		++_NbPDRDeltaFailures;
+	}
+}
+
+
+//---------------------------------------------------
+// displayPDRDeltaSaveStats :
+//
+//---------------------------------------------------
+void CPlayerManager::displayPDRDeltaSaveStats( NLMISC::CLog& log ) const
+{
+	uint32 nbStates= 0, memory= 0;
+	std::map<uint32, TPDRDeltaSaveStates>::const_iterator itUser;
+	for (itUser= _PDRDeltaSaveStates.begin(); itUser != _PDRDeltaSaveStates.end(); ++itUser)
+	{
+		TPDRDeltaSaveStates::const_iterator it;
+		for (it= (*itUser).second.begin(); it != (*itUser).second.end(); ++it)
+		{
+			++nbStates;
+			memory+= (*it).second.Reference.getMemoryUsage();
+		}
+	}
+
+	log.displayNL( "PDRDeltaSave %s: %u full saves, %u delta saves (%u failed)", PDRDeltaSave.get() ? "ON" : "OFF", _NbPDRFullSaves, _NbPDRDeltaSaves, _NbPDRDeltaFailures );
+	log.displayNL( "Sent %" NL_I64 "u bytes for %" NL_I64 "u bytes of files (%.1f%%)", _PDRSavesSentBytes, _PDRSavesFileBytes,
+		(_PDRSavesFileBytes == 0) ? 100.0 : 100.0 * (double)_PDRSavesSentBytes / (double)_PDRSavesFileBytes );
+	log.displayNL( "%u files referenced, using %u KB", nbStates, memory / 1024 );
+}
+
+NLMISC_COMMAND(displayPDRDeltaSaveStats, "display the amount of data sent by the pdr saves of the players (see PDRDeltaSave)", "")
+{
+	if (args.size() != 0)
+		return false;
+
+	PlayerManager.displayPDRDeltaSaveStats( log );
+	return true;
+}
+
+
 //-----------------------------------------------
 // savePlayerChar
 //-----------------------------------------------
@@ -1095,6 +1259,9 @@ void CPlayerManager::deleteCharacter( uint32 userId, uint32 characterIndex )
 	if( itPlayer != _Players.end() )
 	{
 		(*itPlayer).second.Player->deleteCharacter( characterIndex );
+
+		// the next save in this slot is a new file
+		_PDRDeltaSaveStates.erase( userId );
 	}
 	else
 	{
@@ -1407,6 +1574,7 @@ void CPlayerManager::disconnectPlayer( uint32 userId )
 
 		// remove from map
 		_Players.erase( itPlayer );
+		_PDRDeltaSaveStates.erase( userId );
 
 		// update for the unified entity locator
 		if (IShardUnifierEvent::getInstance() != NULL)
@@ -1768,6 +1936,7 @@ void CPlayerManager::tickUpdate()
 			(*itPlayer).second.Player->clearActivePlayerPointer();
 			delete (*itPlayer).second.Player;
 			_Players.erase( itPlayer );
+			_PDRDeltaSaveStates.erase( *it );
 
 			// update for the unified entity locator
 			if (IShardUnifierEvent::getInstance() != NULL)
@@ -27,6 +27,7 @@
 #include "game_share/ryzom_entity_id.h"
 #include "game_share/starting_point.h"
 #include "game_share/generic_xml_msg_mngr.h"
+#include "game_share/persistent_data_delta.h"
 
 #include "entity_manager/entity_manager.h"
 
@@ -36,6 +37,7 @@
 class CCharacter;
 class CPlayer;
 class CAsyncPlayerLoad;
+struct CBackupMsgSaveFile;
 
 namespace NLNET
 {
@@ -133,6 +135,27 @@ private:
 	/// Loading players
 	TAsyncLoadMap				_LoadingPlayers;
 
+	/// Last binary pdr save sent for a character file, to send only the changes in the next one (see PDRDeltaSave)
+	struct CPDRDeltaSaveState
+	{
+		CPDRDeltaSaveState() : NbSavesNotAcknowledged(0), NbDeltas(0) {}
+
+		CPDRDeltaReference	Reference;
+		uint32				NbSavesNotAcknowledged;
+		uint32				NbDeltas;		// since the last full save
+	};
+	typedef std::map<std::string, CPDRDeltaSaveState>	TPDRDeltaSaveStates;
+
+	/// Delta save states of the online users, by user id then by file name
+	std::map<uint32, TPDRDeltaSaveStates>	_PDRDeltaSaveStates;
+
+	/// Stats of the pdr saves
+	uint32						_NbPDRFullSaves;
+	uint32						_NbPDRDeltaSaves;
+	uint32						_NbPDRDeltaFailures;
+	uint64						_PDRSavesFileBytes;
+	uint64						_PDRSavesSentBytes;
+
 	/// users curesed by a GM
 	struct CUserCursedByGM
 	{
@@ -162,7 +185,7 @@ private:
 
 public :
 	// Default constructor
-	CPlayerManager() { _CharacterCreateLevel = 1; }
+	CPlayerManager() : _NbPDRFullSaves(0), _NbPDRDeltaSaves(0), _NbPDRDeltaFailures(0), _PDRSavesFileBytes(0), _PDRSavesSentBytes(0) { _CharacterCreateLevel = 1; }
 
 	/// exception thrown when player is unknown
 	struct EPlayer : public NLMISC::Exception
@@ -246,6 +269,15 @@ public :
 	/// Save the player active char. 
 	void savePlayerActiveChar( uint32 userId, const std::string *filename = 0 );
 
+	/// A full pdr save of a character file has been acknowledged by the BS (see PDRDeltaSave)
+	void onPDRSaveAcknowledged( uint32 userId, const std::string& fileName );
+
+	/// The BS has stored a delta pdr save of a character file, or failed to (see PDRDeltaSave)
+	void onPDRDeltaStatus( const std::string& fileName, bool success );
+
+	/// Display the amount of data sent by the pdr saves (see PDRDeltaSave)
+	void displayPDRDeltaSaveStats( NLMISC::CLog& log ) const;
+
 	// save all player
 	void saveAllPlayer();
 
@@ -655,6 +687,9 @@ private:
 
 	/// see savePlayerChar. Recurse because of the graph of players who made a exchange (must save the whole graph)
 	void savePlayerCharRecurs( uint32 userId, sint32 idx, std::set<CCharacter*> &charAlreadySaved, const std::string *filename = 0);
+
+	/// Send a binary pdr save to the BS, as a delta of the previous one when possible (see PDRDeltaSave)
+	void sendPDRSave( uint32 userId, CBackupMsgSaveFile& msg, const uint8 *buffer, uint32 size );
 };
 
 extern CPlayerManager PlayerManager;
@@ -0,0 +1,68 @@
+// Ryzom - MMORPG Framework <http://dev.ryzom.com/projects/ryzom/>
+// Copyright (C) 2010  Winch Gate Property Limited
+//
+// This program is free software: you can redistribute it and/or modify
+// it under the terms of the GNU Affero General Public License as
+// published by the Free Software Foundation, either version 3 of the
+// License, or (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU Affero General Public License for more details.
+//
+// You should have received a copy of the GNU Affero General Public License
+// along with this program.  If not, see <http://www.gnu.org/licenses/>.
+
+#ifndef NL_CLIENT_JOBS_H
+#define NL_CLIENT_JOBS_H
+
+#include "nel/misc/types_nl.h"
+#include "nel/misc/worker_pool.h"
+
+#include <vector>
+#include <algorithm>
+
+class CClientHost;
+
+
+/**
+ * Processing of a set of clients spread on the client workers (see CPrioSub::ClientWorkers).
+ * The clients are split in jobs of consecutive clients, picked by the first available worker.
+ *
+ * processClient() is called concurrently for different clients: it must only write the data
+ * of its client (its row in the vision array, its list of entities seen...), the data shared
+ * by the clients being read-only during the processing.
+ */
+class IClientJobs : public NLMISC::IWorkerJobs
+{
+public:
+
+	/// Number of clients processed by a job (a job is the unit of work given to a worker)
+	enum { NbClientsPerJob = 16 };
+
+	/// Process a client
+	virtual void		processClient( CClientHost *client ) = 0;
+
+	/// Process all the clients of Clients and return when they are all done
+	void				run( NLMISC::CWorkerPool& workers )
+	{
+		workers.run( *this, ((uint)Clients.size() + NbClientsPerJob - 1) / NbClientsPerJob );
+	}
+
+	virtual void		runJob( uint jobIndex, uint /* workerIndex */ )
+	{
+		uint first = jobIndex * NbClientsPerJob;
+		uint last = std::min( first + NbClientsPerJob, (uint)Clients.size() );
+		for ( uint i=first; i!=last; ++i )
+			processClient( Clients[i] );
+	}
+
+	/// Clients to process (filled by the main thread before run())
+	std::vector<CClientHost*>	Clients;
+};
+
+
+#endif // NL_CLIENT_JOBS_H
+
+/* End of client_jobs.h */
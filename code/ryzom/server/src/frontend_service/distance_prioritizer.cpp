@@ -27,7 +27,9 @@
 #include "vision_provider.h"
 
 #include <nel/misc/command.h>
+#include <nel/misc/random.h>
 #include "frontend_service.h"
+#include "client_jobs.h"
 #ifdef TEST_LOST_PACKET
 #include <nel/misc/variable.h>
 #endif
@@ -85,6 +87,20 @@ void		CDistancePrioritizer::init( CVisionArray *va, CVisionProvider *vp, CHistor
 }
 
 
+/*
+ * Update of the priorities of the entities seen by the clients, by the client workers
+ */
+class CPriorityJobs : public IClientJobs
+{
+public:
+	CPriorityJobs() : Prioritizer(NULL) {}
+	virtual void processClient( CClientHost *client ) { Prioritizer->prioritizeEntitiesSeenByClient( client->clientId() ); }
+	CDistancePrioritizer	*Prioritizer;
+};
+
+static CPriorityJobs PriorityJobs;
+
+
 /*
  * Calculate the priorities
  */
@@ -97,6 +113,8 @@ void		CDistancePrioritizer::calculatePriorities()
 		sint clientmapindex, outerBoundIndex;
 		SortSpreader.getProcessingBounds( icm, clientmapindex, outerBoundIndex );
 
+		PriorityJobs.Prioritizer = this;
+		PriorityJobs.Clients.clear();
 		while ( clientmapindex < outerBoundIndex )
 		{
 			CClientHost *clienthost = GETCLIENTA(icm);
@@ -104,17 +122,16 @@ void		CDistancePrioritizer::calculatePriorities()
 			// Prioritize only at the opposite time of sending for a particular client
 			if ( ! clienthost->whenToSend() )
 			{
-				// Update priorities
-				updatePriorityOfEntitiesSeenByClient( clienthost->clientId() );
-
-				// Sort entities by decreasing priority
-				sortEntitiesOfClient( clienthost->clientId() );
+				PriorityJobs.Clients.push_back( clienthost );
 			}
 
 			++clientmapindex;
 			++icm;
 		}
 
+		// Update the priorities and the order of the entities, on the client workers
+		PriorityJobs.run( CFrontEndService::instance()->PrioSub.ClientWorkers );
+
 		SortSpreader.endProcessing( icm );
 	}
 	SortSpreader.incCycle();
@@ -231,7 +248,7 @@ void		CDistancePrioritizer::fillOutBox( CClientHost& client, TOutBox& outbox )
 			{
 				// Exit when the size limit has been reached before all the pairs have been filled
 #ifdef NL_DEBUG
-				uint nbRemainingPairs = (uint)_PrioritizedEntitiesByClient[clientId].size() - _CurrentEntitiesToStudy[clientId];
+				uint nbRemainingPairs = _PrioritizedEntitiesByClient[clientId].nbRemainingToBrowse();
 				if ( nbRemainingPairs > 0 )
 					LOG_WHAT_IS_SENT( "%u: C%hu S%hu: %u pairs remaining", CTickEventHandler::getGameCycle(), clientId, (uint16)slot, nbRemainingPairs );
 				LOG_WHAT_IS_SENT( "C%hu: outbox full (%d bits)", clientId, currentPosInBit );
@@ -1606,3 +1623,117 @@ NLMISC_COMMAND(verbosePropertiesSent,"Turn on or off or check the state of verbo
 
 
 
+
+
+/*
+ * Benchmark of the ordering of the entities seen by the clients
+ */
+namespace {
+
+/// Decreasing priority order of the benchmark states
+struct CBenchComparePriorities
+{
+	CBenchComparePriorities( const TPairState *states ) : States(states) {}
+	bool operator() ( TCLEntityId first, TCLEntityId second ) const { return States[first].getPrio() > States[second].getPrio(); }
+	const TPairState	*States;
+};
+
+/// Set random distances (1 m to 100 m) to the entities seen by the benchmark clients, or make them move
+void benchMoveEntities( std::vector<TPairState>& states, CRandom& random, bool init )
+{
+	for ( uint i=0; i!=states.size(); ++i )
+	{
+		TCoord& distance = states[i].DistanceCE;
+		if ( init )
+			distance = 1000 + random.rand() * 3;
+		else
+			distance = std::max( (TCoord)1000, distance + (TCoord)random.randPlusMinus( 500 ) );
+	}
+}
+
+} // anonymous namespace
+
+
+NLMISC_COMMAND( benchPrioritizedEntities, "Compare the ordering of the entities seen by the clients (former full sort vs priority buckets)", "[<nbClients>=1000 [<nbSeenEntities>=255 [<nbSentEntities>=32 [<nbCycles>=100]]]]" )
+{
+	uint nbClients = 1000, nbSeen = MAX_SEEN_ENTITIES_PER_CLIENT, nbSent = 32, nbCycles = 100;
+	if ( args.size() > 0 )
+		NLMISC::fromString( args[0], nbClients );
+	if ( args.size() > 1 )
+		NLMISC::fromString( args[1], nbSeen );
+	if ( args.size() > 2 )
+		NLMISC::fromString( args[2], nbSent );
+	if ( args.size() > 3 )
+		NLMISC::fromString( args[3], nbCycles );
+	nbSeen = std::max( std::min( nbSeen, MAX_SEEN_ENTITIES_PER_CLIENT ), 1u );
+
+	// As in the FS: each cycle, the entities move, the priorities are updated, then the first
+	// entities by priority are sent and their priority is reset. Both methods get the same moves.
+	for ( uint method=0; method!=2; ++method )
+	{
+		bool buckets = (method == 1);
+		CRandom random;
+		std::vector< std::vector<TPairState> > states( nbClients, std::vector<TPairState>( nbSeen ) );
+		std::vector< std::vector<TCLEntityId> > sortedEntities( buckets ? 0 : nbClients );
+		std::vector<CPrioritizedEntities> prioritizedEntities( buckets ? nbClients : 0 );
+		for ( uint c=0; c!=nbClients; ++c )
+		{
+			benchMoveEntities( states[c], random, true );
+			for ( uint slot=0; slot!=nbSeen; ++slot )
+			{
+				if ( buckets )
+					prioritizedEntities[c].insert( (TCLEntityId)slot, 0 );
+				else
+					sortedEntities[c].push_back( (TCLEntityId)slot );
+			}
+		}
+
+		TTicks orderingTime = 0;
+		double sumOfSentPriorities = 0;
+		for ( uint cycle=0; cycle!=nbCycles; ++cycle )
+		{
+			for ( uint c=0; c!=nbClients; ++c )
+			{
+				std::vector<TPairState>& clientStates = states[c];
+				benchMoveEntities( clientStates, random, false );
+
+				TTicks before = CTime::getPerformanceTime();
+				for ( uint slot=0; slot!=nbSeen; ++slot )
+				{
+					clientStates[slot].updatePrio();
+					if ( buckets )
+						prioritizedEntities[c].update( (TCLEntityId)slot, clientStates[slot].getPrio() );
+				}
+				if ( buckets )
+				{
+					prioritizedEntities[c].initBrowsing();
+					for ( uint i=0; i!=nbSent; ++i )
+					{
+						TCLEntityId slot = prioritizedEntities[c].getNext();
+						if ( slot == INVALID_SLOT )
+							break;
+						sumOfSentPriorities += clientStates[slot].getPrio();
+						clientStates[slot].resetPrio();
+					}
+				}
+				else
+				{
+					std::sort( sortedEntities[c].begin(), sortedEntities[c].end(), CBenchComparePriorities( &clientStates[0] ) );
+					for ( uint i=0; i!=std::min( nbSent, nbSeen ); ++i )
+					{
+						TCLEntityId slot = sortedEntities[c][i];
+						sumOfSentPriorities += clientStates[slot].getPrio();
+						clientStates[slot].resetPrio();
+					}
+				}
+				orderingTime += CTime::getPerformanceTime() - before;
+			}
+		}
+
+		double duration = CTime::ticksToSecond( orderingTime );
+		log.displayNL( "%s %u clients x %u entities, %u sent, %u cycles: %.3f s, %.2f us per client per cycle, mean sent priority %.3f",
+			buckets ? "Buckets:" : "Sort:   ", nbClients, nbSeen, nbSent, nbCycles, duration,
+			duration * 1000000.0 / ((double)nbClients * (double)nbCycles), sumOfSentPriorities / ((double)nbClients * (double)nbCycles * (double)std::min( nbSent, nbSeen )) );
+	}
+	return true;
+}
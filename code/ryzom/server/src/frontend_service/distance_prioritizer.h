@@ -22,6 +22,7 @@
 #include "nel/misc/types_nl.h"
 #include "fe_types.h"
 #include "vision_array.h"
+#include "prioritized_entities.h"
 #include "processing_spreader.h"
 #include "entity_container.h"
 #include "history.h"
@@ -36,32 +37,6 @@ extern TClientId verbosePropertiesSent;
 #endif
 
 
-/**
- * Comparison functor
- * Helps sorting in decreasing order the entities seen by a client, by priority
- */
-struct TComparePairsByPriority
-{
-	//TComparePairsByPriority( CVisionArray *va, TClientId clientId ) : _VisionArray(va), _ClientId(clientId) {}	// CHANGED BEN
-	TComparePairsByPriority( CVisionArray *va, TClientId clientId )
-	{
-		_ClientStateArray = va->getClientStateArray(clientId);
-	}
-
-
-	bool	operator() ( CLFECOMMON::TCLEntityId first, CLFECOMMON::TCLEntityId second )
-	{
-		//return ( _VisionArray->getPairState( _ClientId, first ).Priority > _VisionArray->getPairState( _ClientId, second ).Priority );	// CHANGED BEN
-		return _ClientStateArray[first].getPrio() > _ClientStateArray[second].getPrio();
-	}
-
-	//CVisionArray	*_VisionArray;
-	//TClientId		_ClientId;
-
-	TPairState*		_ClientStateArray;
-};
-
-
 class CHistory;
 class CClientHost;
 class CVisionProvider;
@@ -376,13 +351,7 @@ class CDistancePrioritizer
 public:
 
 	/// Constructor
-	CDistancePrioritizer() : _VisionArray(NULL), _VisionProvider(NULL), _DistanceDeltaRatio(10)
-	{
-		for ( uint c=0; c!=MAX_NB_CLIENTS; ++c )
-		{
-			_CurrentEntitiesToStudy[c] = 0;
-		}
-	}
+	CDistancePrioritizer() : _VisionArray(NULL), _VisionProvider(NULL), _DistanceDeltaRatio(10) {}
 
 	/// Destructor
 	~CDistancePrioritizer()
@@ -399,23 +368,18 @@ public:
 	/// Called when processing the vision received from the GPMS (and when a client connects, for slot 0)
 	void		addEntitySeenByClient( TClientId clientId, CLFECOMMON::TCLEntityId slot )
 	{
-		_PrioritizedEntitiesByClient[clientId].push_back( slot );
+		TPairState& pairState = _VisionArray->getPairState( clientId, slot );
 		if ( slot == 0 )
 		{
-			_VisionArray->getPairState( clientId, slot ).setSteadyPrio( 100 );
+			pairState.setSteadyPrio( 100 );
 		}
+		_PrioritizedEntitiesByClient[clientId].insert( slot, pairState.getPrio() );
 	}
 
 	/// Called when processing the vision received from the GPMS
 	void		removeEntitySeenByClient( TClientId clientId, CLFECOMMON::TCLEntityId slot )
 	{
-		std::vector<CLFECOMMON::TCLEntityId>& vec = _PrioritizedEntitiesByClient[clientId];
-		std::vector<CLFECOMMON::TCLEntityId>::iterator is = std::find( vec.begin(), vec.end(), slot );
-		if ( is != vec.end() )
-		{
-			(*is) = vec.back(); // it breaks the sorting, nevermind
-			vec.pop_back();
-		}
+		_PrioritizedEntitiesByClient[clientId].remove( slot );
 	}
 
 	/// Called when a client leaves
@@ -427,6 +391,12 @@ public:
 	///
 	void		fillOutBox( CClientHost& client, TOutBox& outbox );
 
+	/// Update the priorities of the entities seen by a client and their order (can be called concurrently for different clients)
+	void		prioritizeEntitiesSeenByClient( TClientId clientId )
+	{
+		updatePriorityOfEntitiesSeenByClient( clientId );
+	}
+
 	/// Set/change the distance/delta ratio that triggers the sending of a position
 	void		setDistanceDeltaRatioForPos( uint32 ddratio ) { _DistanceDeltaRatio = ddratio; }
 
@@ -437,7 +407,7 @@ protected:
 	/// Begin a browsing cycle
 	void		initDispatchingCycle( TClientId clientId )
 	{
-		_CurrentEntitiesToStudy[clientId] = 0;
+		_PrioritizedEntitiesByClient[clientId].initBrowsing();
 	}
 
 	/// Browse the entities seen in order of priority; returns INVALID_SLOT if no more
@@ -454,49 +424,28 @@ protected:
 		}
 		else
 		{
-			uint& current = _CurrentEntitiesToStudy[clientId];
-			if ( current < _PrioritizedEntitiesByClient[clientId].size() )
-				return _PrioritizedEntitiesByClient[clientId][current++];
-			else
-				return CLFECOMMON::INVALID_SLOT;
+			return _PrioritizedEntitiesByClient[clientId].getNext();
 		}
 	}
 
 	///
 	void		serialSlotHeader( CClientHost& client, CEntity *sentity, TPairState& pairState, CLFECOMMON::TCLEntityId slot, TOutBox& outbox );
 	
-	/// Called by calculatePriorities()
+	/// Called by calculatePriorities(). Moves the entities whose priority bucket has changed.
 	void		updatePriorityOfEntitiesSeenByClient( TClientId clientId )
 	{
+		CPrioritizedEntities& entities = _PrioritizedEntitiesByClient[clientId];
 		CLFECOMMON::TCLEntityId slot;
 		TPairState*		states = _VisionArray->getClientStateArray(clientId) + 1;
 		for ( slot=1; slot!=MAX_SEEN_ENTITIES_PER_CLIENT; ++slot )
 		{
 			states->updatePrio();
+			entities.update( slot, states->getPrio() );
 			++states;
 			//_VisionArray->getPairState( clientId, slot ).updatePrio();	// CHANGED BEN
 		}
 	}
 
-	/// Called by calculatePriorities()
-	void		sortEntitiesOfClient( TClientId clientId )
-	{	
-		std::sort( _PrioritizedEntitiesByClient[clientId].begin(), _PrioritizedEntitiesByClient[clientId].end(), TComparePairsByPriority(_VisionArray, clientId) );
-
-/*#ifdef NL_DEBUG
-		std::string s1 = "Sorted slots:", s2 = "Distances(m):", s3 = "Priorities:";
-		std::vector<CLFECOMMON::TCLEntityId>::iterator iv;
-		for ( iv=_PrioritizedEntitiesByClient[clientId].begin(); iv!=_PrioritizedEntitiesByClient[clientId].end(); ++iv )
-		{
-			s1 += NLMISC::toString( " %hu", (uint16)(*iv) );
-			//s2 += NLMISC::toString( " %d", _VisionArray->getPairState( clientId, *iv ).DistanceCE/1000 );
-			//s3 += NLMISC::toString( " %.1f", _VisionArray->getPairState( clientId, *iv ).Priority );
-		}
-		nldebug( "%s", s1.c_str() );
-#endif*/
-
-	}
-
 	/// Test the criterion for the position of the entity 'slot' seen by 'clientId'
 	bool		positionHasChangedEnough();
 
@@ -716,12 +665,11 @@ public:
 
 private:
 
-	std::vector<CLFECOMMON::TCLEntityId>	_PrioritizedEntitiesByClient [MAX_NB_CLIENTS];
+	/// Entities seen by each client, by priority
+	CPrioritizedEntities					_PrioritizedEntitiesByClient [MAX_NB_CLIENTS];
 
 	std::list<CLFECOMMON::TCLEntityId>		_DissassociationsToResend [MAX_NB_CLIENTS];
 
-	uint						_CurrentEntitiesToStudy [MAX_NB_CLIENTS];
-
 	TVPNodeServer				*_VisualPropertyTreeRoot;
 
 	CVisionArray				*_VisionArray;
@@ -0,0 +1,217 @@
+// Ryzom - MMORPG Framework <http://dev.ryzom.com/projects/ryzom/>
+// Copyright (C) 2010  Winch Gate Property Limited
+//
+// This program is free software: you can redistribute it and/or modify
+// it under the terms of the GNU Affero General Public License as
+// published by the Free Software Foundation, either version 3 of the
+// License, or (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU Affero General Public License for more details.
+//
+// You should have received a copy of the GNU Affero General Public License
+// along with this program.  If not, see <http://www.gnu.org/licenses/>.
+
+
+
+#include "stdpch.h"
+
+#include "fe_receive_ring.h"
+
+#include "nel/misc/buf_fifo.h"
+#include "nel/misc/mutex.h"
+#include "nel/misc/thread.h"
+#include "nel/misc/time_nl.h"
+#include "nel/misc/command.h"
+
+#ifdef NL_OS_UNIX
+#	include <netinet/in.h>
+#endif
+
+
+using namespace NLMISC;
+using namespace NLNET;
+
+
+/*
+ * Init
+ */
+void CFEReceiveRing::init( uint nbSlots, uint32 datagramLength )
+{
+	uint capacity = 2;
+	while ( capacity < nbSlots )
+		capacity <<= 1;
+
+	_Slots.clear();
+	_Slots.resize( capacity );
+	for ( uint i=0; i!=capacity; ++i )
+	{
+		// Reserve the max length, so that receiving into a slot never reallocates
+		_Slots[i].resizeData( datagramLength );
+	}
+	_Mask = capacity - 1;
+	_WriteIndex = 0;
+	_ReadIndex = 0;
+	_NbDropped = 0;
+}
+
+
+/*
+ * Receive queue benchmark: a producer thread stands for the receive thread, the caller of the
+ * command stands for the main thread. Compares the former double-buffered CBufFIFO (one lock,
+ * one copy of the data and one of the address per message) with the ring (no lock, no copy).
+ */
+namespace
+{
+
+const uint32 BenchDatagramLength = 512;
+
+/// Producer of the former queue
+class CBenchFIFOProducer : public IRunnable
+{
+public:
+	CBenchFIFOProducer( uint nbMsgs, uint msgSize ) : WriteQueue( "BenchWriteQueue" ), _NbMsgs(nbMsgs), _MsgSize(msgSize) {}
+
+	virtual void run()
+	{
+		TReceivedMessage msg;
+		std::vector<uint8> vaddr( sizeof(sockaddr_in) );
+		for ( uint i=0; i!=_NbMsgs; ++i )
+		{
+			msg.resizeData( BenchDatagramLength );
+			msg.setTypeEvent( TReceivedMessage::User );
+			*(uint32*)msg.userDataW() = i;
+			msg.resizeData( _MsgSize );
+			memcpy( &vaddr[0], msg.AddrFrom.sockAddr(), sizeof(sockaddr_in) );
+			CSynchronized<CBufFIFO*>::CAccessor wq( &WriteQueue );
+			wq.value()->push( msg.data() );
+			wq.value()->push( vaddr );
+		}
+	}
+
+	CSynchronized<CBufFIFO*>	WriteQueue;
+
+private:
+	uint						_NbMsgs;
+	uint						_MsgSize;
+};
+
+/// Producer of the ring
+class CBenchRingProducer : public IRunnable
+{
+public:
+	CBenchRingProducer( CFEReceiveRing *ring, uint nbMsgs, uint msgSize ) : _Ring(ring), _NbMsgs(nbMsgs), _MsgSize(msgSize) {}
+
+	virtual void run()
+	{
+		for ( uint i=0; i!=_NbMsgs; ++i )
+		{
+			while ( _Ring->nbFreeSlots() == 0 )
+				nlSleep( 0 );
+			TReceivedMessage& msg = _Ring->slotToWrite( 0 );
+			msg.resizeData( BenchDatagramLength );
+			msg.setTypeEvent( TReceivedMessage::User );
+			*(uint32*)msg.userDataW() = i;
+			msg.resizeData( _MsgSize );
+			_Ring->publish( 1 );
+		}
+	}
+
+private:
+	CFEReceiveRing	*_Ring;
+	uint			_NbMsgs;
+	uint			_MsgSize;
+};
+
+} // anonymous namespace
+
+
+NLMISC_COMMAND( benchReceiveQueues, "Measure the throughput of the receive queue between two threads (former CBufFIFO vs ring)", "[<nbMessages>=1000000 [<messageSize>=64]]" )
+{
+	uint nbMsgs = 1000000, msgSize = 64;
+	if ( args.size() > 0 )
+		NLMISC::fromString( args[0], nbMsgs );
+	if ( args.size() > 1 )
+		NLMISC::fromString( args[1], msgSize );
+	msgSize = std::max( std::min( msgSize, (uint)BenchDatagramLength ), (uint)sizeof(uint32) );
+
+	// Former double-buffered FIFO, swapped by the reader when its queue is empty
+	{
+		CBufFIFO queue1, queue2;
+		CBenchFIFOProducer producer( nbMsgs, msgSize );
+		{
+			CSynchronized<CBufFIFO*>::CAccessor wq( &producer.WriteQueue );
+			wq.value() = &queue1;
+		}
+		CBufFIFO *readQueue = &queue2;
+		TReceivedMessage msg;
+		std::vector<uint8> vaddr;
+		uint nbRead = 0;
+		bool ok = true;
+
+		TTicks before = CTime::getPerformanceTime();
+		IThread *thread = IThread::create( &producer );
+		thread->start();
+		while ( nbRead != nbMsgs )
+		{
+			if ( readQueue->empty() )
+			{
+				CSynchronized<CBufFIFO*>::CAccessor wq( &producer.WriteQueue );
+				CBufFIFO *writeQueue = wq.value();
+				wq.value() = readQueue;
+				readQueue = writeQueue;
+				if ( readQueue->empty() )
+					nlSleep( 0 );
+				continue;
+			}
+			readQueue->front( msg.data() );
+			readQueue->pop();
+			readQueue->front( vaddr );
+			readQueue->pop();
+			msg.AddrFrom.setSockAddr( (sockaddr_in*)&vaddr[0] );
+			ok = ok && (*(const uint32*)msg.userDataR() == nbRead);
+			++nbRead;
+		}
+		thread->wait();
+		double duration = CTime::ticksToSecond( CTime::getPerformanceTime() - before );
+		delete thread;
+		log.displayNL( "CBufFIFO: %u msgs of %u bytes in %.3f s: %.0f msg/s%s", nbMsgs, msgSize, duration, (double)nbMsgs / duration, ok ? "" : " (ORDER ERROR)" );
+	}
+
+	// Ring
+	{
+		CFEReceiveRing ring;
+		ring.init( 8192, BenchDatagramLength );
+		CBenchRingProducer producer( &ring, nbMsgs, msgSize );
+		uint nbRead = 0;
+		bool ok = true;
+
+		TTicks before = CTime::getPerformanceTime();
+		IThread *thread = IThread::create( &producer );
+		thread->start();
+		while ( nbRead != nbMsgs )
+		{
+			uint32 readLimit = ring.writeIndex();
+			if ( ring.readIndex() == readLimit )
+			{
+				nlSleep( 0 );
+				continue;
+			}
+			while ( ring.readIndex() != readLimit )
+			{
+				ok = ok && (*(const uint32*)ring.front().userDataR() == nbRead);
+				ring.pop();
+				++nbRead;
+			}
+		}
+		thread->wait();
+		double duration = CTime::ticksToSecond( CTime::getPerformanceTime() - before );
+		delete thread;
+		log.displayNL( "Ring:     %u msgs of %u bytes in %.3f s: %.0f msg/s%s", nbMsgs, msgSize, duration, (double)nbMsgs / duration, ok ? "" : " (ORDER ERROR)" );
+	}
+	return true;
+}
+
+/* End of fe_receive_ring.cpp */
@@ -0,0 +1,120 @@
+// Ryzom - MMORPG Framework <http://dev.ryzom.com/projects/ryzom/>
+// Copyright (C) 2010  Winch Gate Property Limited
+//
+// This program is free software: you can redistribute it and/or modify
+// it under the terms of the GNU Affero General Public License as
+// published by the Free Software Foundation, either version 3 of the
+// License, or (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU Affero General Public License for more details.
+//
+// You should have received a copy of the GNU Affero General Public License
+// along with this program.  If not, see <http://www.gnu.org/licenses/>.
+
+
+
+#ifndef NL_FE_RECEIVE_RING_H
+#define NL_FE_RECEIVE_RING_H
+
+#include "nel/misc/types_nl.h"
+#include "nel/misc/debug.h"
+#include "nel/misc/atomic.h"
+
+#include "fe_receive_task.h"
+
+#include <vector>
+
+#ifdef NL_COMP_VC
+#	include <intrin.h>
+#endif
+
+
+/**
+ * Single-producer/single-consumer ring of preallocated received messages, shared by
+ * CFEReceiveTask (producer, receive thread) and CFeReceiveSub (consumer, main thread).
+ *
+ * The slots are allocated once by init(), with the max datagram length, then the
+ * producer writes into them in place and publishes them by advancing the write index.
+ * No lock is taken and no memory is allocated on either side.
+ *
+ * The indices are free-running uint32 counters: the number of used slots is
+ * writeIndex - readIndex, the slot of an index is index & _Mask.
+ */
+class CFEReceiveRing
+{
+public:
+
+	/// Constructor
+	CFEReceiveRing() : _Mask(0), _WriteIndex(0), _ReadIndex(0), _NbDropped(0) {}
+
+	/// Allocate the slots (nbSlots is rounded up to a power of 2). Call before the receive thread starts.
+	void				init( uint nbSlots, uint32 datagramLength );
+
+	/// Return the number of slots
+	uint				capacity() const				{ return (uint)_Slots.size(); }
+
+	/// @name Producer side (receive thread)
+	//@{
+
+	/// Return the number of slots that can be written
+	uint				nbFreeSlots() const				{ return capacity() - (_WriteIndex - NLMISC::atomicLoadAcquire( &_ReadIndex )); }
+
+	/// Access the i-th slot after the last published one (precondition: i < nbFreeSlots())
+	TReceivedMessage&	slotToWrite( uint i )			{ return _Slots[(_WriteIndex+i) & _Mask]; }
+
+	/// Make the nb first slots to write visible to the consumer
+	void				publish( uint nb )				{ NLMISC::atomicStoreRelease( &_WriteIndex, _WriteIndex + nb ); }
+
+	/// Count a datagram that could not be stored because the ring was full
+	void				addDropped()					{ ++_NbDropped; }
+
+	//@}
+
+	/// @name Consumer side (main thread)
+	//@{
+
+	/// Return the current write index, to read only up to it
+	uint32				writeIndex() const				{ return NLMISC::atomicLoadAcquire( &_WriteIndex ); }
+
+	/// Return the current read index
+	uint32				readIndex() const				{ return _ReadIndex; }
+
+	/// Access the oldest published slot (precondition: readIndex() != writeIndex())
+	TReceivedMessage&	front()							{ return _Slots[_ReadIndex & _Mask]; }
+
+	/// Release the oldest slot to the producer
+	void				pop()							{ NLMISC::atomicStoreRelease( &_ReadIndex, _ReadIndex + 1 ); }
+
+	/// Return the number of dropped datagrams since the last call (not exact, for stats only)
+	uint				nbNewDropped()					{ uint nb = _NbDropped; _NbDropped = 0; return nb; }
+
+	//@}
+
+private:
+
+	/// Preallocated slots
+	std::vector<TReceivedMessage>	_Slots;
+
+	/// Number of slots - 1
+	uint32							_Mask;
+
+	/// Index of the next slot to publish (written by the producer only)
+	volatile uint32					_WriteIndex;
+
+	/// Keep the two indices in separate cache lines
+	uint8							_Padding [64-sizeof(uint32)];
+
+	/// Index of the next slot to read (written by the consumer only)
+	volatile uint32					_ReadIndex;
+
+	/// Number of datagrams dropped because the ring was full (written by the producer only)
+	volatile uint					_NbDropped;
+};
+
+
+#endif // NL_FE_RECEIVE_RING_H
+
+/* End of fe_receive_ring.h */
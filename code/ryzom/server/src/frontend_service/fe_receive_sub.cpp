@@ -114,7 +114,7 @@ string getBadMessageString( uint32 reasons )
 /*
  * Init
  */
-void CFeReceiveSub::init( uint16 firstAcceptableFrontendPort, uint16 lastAcceptableFrontendPort, uint32 dgrammaxlength, CHistory *history, TClientIdCont *clientidcont )
+void CFeReceiveSub::init( uint16 firstAcceptableFrontendPort, uint16 lastAcceptableFrontendPort, uint32 dgrammaxlength, CHistory *history, TClientIdCont *clientidcont, uint udpBatchSize, uint receiveRingSize )
 {
 	// Preconditions
 	nlassert( firstAcceptableFrontendPort != 0 );
@@ -125,17 +125,16 @@ void CFeReceiveSub::init( uint16 firstAcceptableFrontendPort, uint16 lastAccepta
 
 	// Start external datagram socket
 	nlinfo( "FERECV: Starting external datagram socket" );
-	_ReceiveTask = new CFEReceiveTask( firstAcceptableFrontendPort, lastAcceptableFrontendPort, dgrammaxlength );
-	_CurrentReadQueue = &_Queue2;
-	_ReceiveTask->setWriteQueue( &_Queue1 );
+	_ReceiveTask = new CFEReceiveTask( firstAcceptableFrontendPort, lastAcceptableFrontendPort, dgrammaxlength, udpBatchSize );
 	nlassert( _ReceiveTask != NULL );
+	_ReceiveRing.init( receiveRingSize, dgrammaxlength );
+	_ReadLimit = _ReceiveRing.readIndex();
+	_ReceiveTask->setReceiveRing( &_ReceiveRing );
+	nlinfo( "FERECV: Receive ring of %u messages", _ReceiveRing.capacity() );
 	_ReceiveThread = IThread::create( _ReceiveTask );
 	nlassert( _ReceiveThread != NULL );
 	_ReceiveThread->start();
 
-	// Setup current message placeholder
-	_CurrentInMsg = new TReceivedMessage();
-
 	_History = history;
 
 	_ClientIdCont = clientidcont;
@@ -187,10 +186,6 @@ void CFeReceiveSub::release()
 	delete _ReceiveTask;
 	_ReceiveTask = NULL;
 	_ReceiveThread = NULL;
-
-	nlassert( _CurrentInMsg != NULL );
-	delete _CurrentInMsg;
-	_CurrentInMsg = NULL;
 }
 
 
@@ -237,20 +232,17 @@ void CFeReceiveSub::readIncomingData()
 	}
 
 	// Read queue of messages received from clients
-	while ( ! _CurrentReadQueue->empty() )
+	while ( _ReceiveRing.readIndex() != _ReadLimit )
 	{
-		//nlinfo( "Read queue size = %u", _CurrentReadQueue->size() );
-		_CurrentReadQueue->front( _CurrentInMsg->data() );
-		_CurrentReadQueue->pop();
-		nlassert( ! _CurrentReadQueue->empty() );
-		_CurrentReadQueue->front( _CurrentInMsg->VAddrFrom );
-		_CurrentReadQueue->pop();
-		_CurrentInMsg->vectorToAddress();
+		// The message is processed in place, then its slot is given back to the receive thread
+		_CurrentInMsg = &_ReceiveRing.front();
 
 #ifndef MEASURE_RECEIVE_TASK
 		handleIncomingMsg();
 #endif
+		_ReceiveRing.pop();
 	}
+	_CurrentInMsg = NULL;
 
 	// Measure and display rate evenly (at a low frequency)
 	static TTime lastdisplay = CTime::getLocalTime();
@@ -271,6 +263,13 @@ void CFeReceiveSub::readIncomingData()
 			nlinfo( "FEHACK: Rejected big messages: %u", nbrej );
 		}
 
+		// Overload detection: datagrams lost because the main thread did not read them fast enough
+		uint nbdropped = _ReceiveRing.nbNewDropped();
+		if ( nbdropped != 0 )
+		{
+			nlwarning( "FERECV: Receive ring full, dropped %u datagrams", nbdropped );
+		}
+
 		// Hacking detection: bad identification
 		if ( ! _UnidentifiedFlyingClients.empty() )
 		{
@@ -295,22 +294,12 @@ void CFeReceiveSub::readIncomingData()
 
 
 /*
- * Swap receive queues (to avoid high contention between the receive thread and the reading thread)
+ * Set the limit of the messages to read in the current cycle (the messages received during the
+ * cycle will be read in the next one, as when the receive queues were swapped)
  */
 void CFeReceiveSub::swapReadQueues()
 {
-	if ( _CurrentReadQueue == &_Queue1 )
-	{
-		_CurrentReadQueue = &_Queue2;
-		_ReceiveTask->setWriteQueue( &_Queue1 );
-		//nlinfo( "** Write1 Read2 ** Read=%p Write=%p", &_Queue2, &_Queue1 );
-	}
-	else
-	{
-		_CurrentReadQueue = &_Queue1;
-		_ReceiveTask->setWriteQueue( &_Queue2 );
-		//nlinfo( "** Read1 Write2 ** Read=%p Write=%p", &_Queue1, &_Queue2 );
-	}
+	_ReadLimit = _ReceiveRing.writeIndex();
 }
 
 
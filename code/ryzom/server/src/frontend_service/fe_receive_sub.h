@@ -20,13 +20,13 @@
 #define NL_FE_RECEIVE_SUB_H
 
 #include "nel/misc/types_nl.h"
-#include "nel/misc/buf_fifo.h"
 
 #include "nel/net/login_cookie.h"
 
 #include "fe_types.h"
 #include "client_host.h"
 #include "fe_receive_task.h"
+#include "fe_receive_ring.h"
 #include "client_id_lookup.h"
 
 #include <list>
@@ -95,10 +95,9 @@ public:
 		_ReceiveThread(NULL),
 		_ClientMap(),
 		_ClientIdCont(NULL),
-		_Queue1(),
-		_Queue2(),
-		_CurrentReadQueue(NULL),
-		_CurrentInMsg(),
+		_ReceiveRing(),
+		_ReadLimit(0),
+		_CurrentInMsg(NULL),
 		_RcvCounter(0),
 		_RcvBytes(0),
 		_PrevRcvBytes(0),
@@ -111,7 +110,7 @@ public:
 		{}
 
 	/// Init
-	void				init( uint16 firstAcceptableFrontendPort, uint16 lastAcceptableFrontendPort, uint32 dgrammaxlength, CHistory *history, TClientIdCont *clientidcont );
+	void				init( uint16 firstAcceptableFrontendPort, uint16 lastAcceptableFrontendPort, uint32 dgrammaxlength, CHistory *history, TClientIdCont *clientidcont, uint udpBatchSize=1, uint receiveRingSize=8192 );
 
 	/// Update
 	void				update();
@@ -153,7 +152,7 @@ public:
 	NLNET::CUdpSock		*dataSock()					{ return _ReceiveTask->DataSock; }
 
 
-	// Swap receive queues (to avoid high contention between the receive thread and the reading thread)
+	// Mark the messages received so far as the ones to read in this cycle (name kept from the former double-buffered queues)
 	void				swapReadQueues();
 
 	// Read incoming data from the current read queue
@@ -220,16 +219,13 @@ private:
 	/// Client map by id (belonging to the send subsystem)
 	TClientIdCont		*_ClientIdCont;
 
-	/// First queue
-	NLMISC::CBufFIFO	_Queue1;
+	/// Messages received by the receive thread
+	CFEReceiveRing		_ReceiveRing;
 
-	/// Second queue
-	NLMISC::CBufFIFO	_Queue2;
+	/// Index in the ring up to which messages are read in the current cycle (see swapReadQueues())
+	uint32				_ReadLimit;
 
-	/// Current read queue
-	NLMISC::CBufFIFO	*_CurrentReadQueue;
-
-	/// Current incoming message
+	/// Current incoming message (slot of the ring being read)
 	TReceivedMessage	*_CurrentInMsg;
 
 	/// Number of messages received (stat)
@@ -19,6 +19,7 @@
 #include "stdpch.h"
 
 #include "fe_receive_task.h"
+#include "fe_receive_ring.h"
 #include "fe_types.h"
 
 #ifdef NL_OS_WINDOWS
@@ -52,28 +53,16 @@ volatile uint32 CFEReceiveTask::LastUDPPacketReceived = 0;
 /// Constructor
 TReceivedMessage::TReceivedMessage()
 {
-	VAddrFrom.resize( sizeof(sockaddr_in) );
-}
-
-/// Return a vector containing the address info
-void	TReceivedMessage::addressToVector()
-{
-	memcpy( &*VAddrFrom.begin(), AddrFrom.sockAddr(), sizeof(sockaddr_in) );
-}
-
-/// Set address with address info from specified vector
-void	TReceivedMessage::vectorToAddress()
-{
-	AddrFrom.setSockAddr( (sockaddr_in*)&*VAddrFrom.begin() );
 }
 
 
 /*
  * Constructor (note: called from the main thread)
  */
-CFEReceiveTask::CFEReceiveTask( uint16 firstAcceptablePort, uint16 lastAcceptablePort, uint32 msgsize ) :
+CFEReceiveTask::CFEReceiveTask( uint16 firstAcceptablePort, uint16 lastAcceptablePort, uint32 msgsize, uint batchSize ) :
 	_ReceivedMessage(),
-	_WriteQueue( "WriteQueue" ), // value unspecified
+	_BatchSize( 1 ),
+	_Ring( NULL ),
 	_DatagramLength( msgsize ),
 	_ExitRequired( false ),
 	_NbRejectedDatagrams( 0 )
@@ -112,6 +101,15 @@ CFEReceiveTask::CFEReceiveTask( uint16 firstAcceptablePort, uint16 lastAcceptabl
 	if ( actualPort > lastAcceptablePort )
 		nlerror( "Could not find an available port between %hu and %hu", firstAcceptablePort, lastAcceptablePort );
 	nlinfo( "Binding all network interfaces on port %hu (%hu asked)", actualPort, firstAcceptablePort );
+
+	// The datagrams of a batch are received directly into the slots of the ring
+	_BatchSize = std::min( std::max( batchSize, (uint)1 ), (uint)CUdpSock::MaxDatagramBatch );
+	if ( _BatchSize > 1 )
+	{
+		_DatagramBatch.resize( _BatchSize );
+		nlinfo( "Receiving up to %u datagrams per system call", _BatchSize );
+	}
+	_ReceivedMessage.resizeData( _DatagramLength );
 }
 
 
@@ -131,6 +129,22 @@ CFEReceiveTask::~CFEReceiveTask()
  * Run
  */
 void CFEReceiveTask::run()
+{
+	nlassert( _Ring );
+	if ( _BatchSize == 1 )
+		runSingle();
+	else
+		runBatched();
+
+	nlinfo( "Exiting from front-end receive task" );
+}
+
+
+/*
+ * Receive loop with one datagram per system call. The datagram is received directly into the
+ * next slot of the ring, or into _ReceivedMessage and dropped if the ring is full.
+ */
+void CFEReceiveTask::runSingle()
 {
 	uint maxrecvlength = _DatagramLength;
 	while ( ! _ExitRequired )
@@ -151,57 +165,132 @@ void CFEReceiveTask::run()
 		}
 
 #endif
+		bool ringFull = (_Ring->nbFreeSlots() == 0);
+		TReceivedMessage& msg = ringFull ? _ReceivedMessage : _Ring->slotToWrite( 0 );
 		try
 		{
-			// Receive into _ReceivedMessage
+			// Receive into the slot (no reallocation: the capacity of the buffer is kept)
 			_DatagramLength = maxrecvlength;
-			_ReceivedMessage.resizeData( _DatagramLength );
-			_ReceivedMessage.setTypeEvent( TReceivedMessage::User );
-			DataSock->receivedFrom( _ReceivedMessage.userDataW(), _DatagramLength, _ReceivedMessage.AddrFrom );
+			msg.resizeData( _DatagramLength );
+			msg.setTypeEvent( TReceivedMessage::User );
+			DataSock->receivedFrom( msg.userDataW(), _DatagramLength, msg.AddrFrom );
 		}
 		catch (const ESocket&)
 		{
 			// Remove the client corresponding to the address
-			_ReceivedMessage.setTypeEvent( TReceivedMessage::RemoveClient );
+			msg.setTypeEvent( TReceivedMessage::RemoveClient );
 			_DatagramLength = 0;
 		}
 		
 		// update the last datagram receive date
 		LastUDPPacketReceived = CTime::getSecondsSince1970();
 
-		// Check the size. Consider a big size as a hacked message
-//		if ( _DatagramLength < 512 )
+		// Make the message visible to the main thread
+		if ( ringFull )
 		{
-			// Push into the write queue
-			_ReceivedMessage.addressToVector();
-			_ReceivedMessage.resizeData( _DatagramLength ); // _DatagramLength was modified by receivedFrom()
-			{
-				CSynchronized<CBufFIFO*>::CAccessor wq( &_WriteQueue );
-				wq.value()->push( _ReceivedMessage.data() );
-				wq.value()->push( _ReceivedMessage.VAddrFrom );
-			}
+			if ( msg.eventType() == TReceivedMessage::RemoveClient )
+				publishRemoveClient( msg.AddrFrom );
+			else
+				_Ring->addDropped();
+		}
+		else
+		{
+			msg.resizeData( _DatagramLength ); // _DatagramLength was modified by receivedFrom()
+			_Ring->publish( 1 );
 		}
-//		else
-//		{
-//			// Reject message
-//			++_NbRejectedDatagrams;
-//		}
 
 #else
 		nlSleep( 1000 );
 #endif
 	}
-
-	nlinfo( "Exiting from front-end receive task" );
 }
 
 
 /*
- * Set new write queue
+ * Store a RemoveClient event into the ring. Unlike a datagram, it can't be dropped when
+ * the ring is full (the client would never be removed), so wait until the main thread
+ * frees a slot.
  */
-void CFEReceiveTask::setWriteQueue( CBufFIFO *writequeue )
+void CFEReceiveTask::publishRemoveClient( const CInetAddress& addrFrom )
 {
-	CSynchronized<CBufFIFO*>::CAccessor wq( &_WriteQueue );
-	wq.value() = writequeue;
+	while ( _Ring->nbFreeSlots() == 0 )
+	{
+		if ( _ExitRequired )
+			return;
+		nlSleep( 1 );
+	}
+
+	TReceivedMessage& msg = _Ring->slotToWrite( 0 );
+	msg.resizeData( 0 );
+	msg.setTypeEvent( TReceivedMessage::RemoveClient );
+	msg.AddrFrom = addrFrom;
+	_Ring->publish( 1 );
 }
 
+
+/*
+ * Receive loop with batches of datagrams: the datagrams are received directly into the
+ * free slots of the ring, then published all at once.
+ */
+void CFEReceiveTask::runBatched()
+{
+	uint maxrecvlength = _DatagramLength;
+	while ( ! _ExitRequired )
+	{
+#ifndef SIMUL_CLIENTS
+		uint batchSize = std::min( _BatchSize, _Ring->nbFreeSlots() );
+		if ( batchSize == 0 )
+		{
+			// The ring is full: receive and drop one datagram
+			_DatagramLength = maxrecvlength;
+			try
+			{
+				DataSock->receivedFrom( _ReceivedMessage.userDataW(), _DatagramLength, _ReceivedMessage.AddrFrom );
+			}
+			catch (const ESocket&)
+			{
+				publishRemoveClient( _ReceivedMessage.AddrFrom );
+				continue;
+			}
+			_Ring->addDropped();
+			continue;
+		}
+
+		// Point the batch to the free slots (no reallocation: the capacity of the buffers is kept)
+		for ( uint i=0; i!=batchSize; ++i )
+		{
+			TReceivedMessage& msg = _Ring->slotToWrite( i );
+			msg.resizeData( maxrecvlength );
+			msg.setTypeEvent( TReceivedMessage::User );
+			_DatagramBatch[i].Buffer = msg.userDataW();
+			_DatagramBatch[i].Length = maxrecvlength;
+			_DatagramBatch[i].Addr = &msg.AddrFrom;
+		}
+
+		uint nbReceived;
+		try
+		{
+			nbReceived = DataSock->receivedFromBatch( &_DatagramBatch[0], batchSize );
+		}
+		catch (const ESocket&)
+		{
+			// Remove the client corresponding to the address
+			_Ring->slotToWrite( 0 ).setTypeEvent( TReceivedMessage::RemoveClient );
+			_DatagramBatch[0].Length = 0;
+			nbReceived = 1;
+		}
+
+		// update the last datagram receive date
+		LastUDPPacketReceived = CTime::getSecondsSince1970();
+
+		// Make the messages visible to the main thread
+		for ( uint i=0; i!=nbReceived; ++i )
+		{
+			_Ring->slotToWrite( i ).resizeData( _DatagramBatch[i].Length ); // Length was modified by receivedFromBatch()
+		}
+		_Ring->publish( nbReceived );
+#else
+		nlSleep( 1000 );
+#endif
+	}
+}
@@ -22,8 +22,6 @@
 #include "nel/misc/types_nl.h"
 #include "nel/misc/debug.h"
 #include "nel/misc/thread.h"
-#include "nel/misc/buf_fifo.h"
-#include "nel/misc/mutex.h"
 
 //#define MEASURE_RECEIVE_TASK
 
@@ -49,12 +47,6 @@ struct TReceivedMessage
 	/// Resize data
 	void				resizeData( uint32 datasize )	{ _Data.resize( MsgHeaderSize + datasize ); }
 
-	/// Return a vector containing the address info
-	void				addressToVector();
-
-	/// Set address with address info from specified vector
-	void				vectorToAddress();
-
 	/// Set "disconnection" message for the current AddrFrom
 	void				setTypeEvent( TEventType t )	{ *_Data.begin() = (uint8)t; }
 
@@ -82,12 +74,12 @@ public:
 	
 	/// Address of sender as CInetAddress
 	NLNET::CInetAddress	AddrFrom;
-
-	/// Placeholder vector for address info
-	std::vector<uint8>	VAddrFrom;
 };
 
 
+class CFEReceiveRing;
+
+
 /**
  * Front-end receive task
  * \author Olivier Cado
@@ -98,8 +90,11 @@ class CFEReceiveTask : public NLMISC::IRunnable
 {
 public:
 
-	/// Constructor
-	CFEReceiveTask( uint16 firstAcceptablePort, uint16 lastAcceptablePort, uint32 msgsize );
+	/** Constructor
+	 * If batchSize is greater than 1, up to batchSize datagrams are received per system call
+	 * (see NLNET::CUdpSock::receivedFromBatch()).
+	 */
+	CFEReceiveTask( uint16 firstAcceptablePort, uint16 lastAcceptablePort, uint32 msgsize, uint batchSize=1 );
 
 	/// Destructor
 	~CFEReceiveTask();
@@ -107,8 +102,8 @@ public:
 	/// Run
 	virtual void	run();
 
-	/// Set new write queue (thread-safe because mutexed)
-	void			setWriteQueue( NLMISC::CBufFIFO *writequeue );
+	/// Set the ring where to store the received messages (call before running the thread)
+	void			setReceiveRing( CFEReceiveRing *ring ) { _Ring = ring; }
 
 	/// Require exit (thread-safe because atomic assignment)
 	void			requireExit() { _ExitRequired = true; }
@@ -118,14 +113,29 @@ public:
 
 private:
 
+	/// Receive loop with one datagram per system call
+	void			runSingle();
+
+	/// Receive loop with batches of datagrams
+	void			runBatched();
+
+	/// Store a RemoveClient event into the ring, waiting for a free slot if it is full
+	void			publishRemoveClient( const NLNET::CInetAddress& addrFrom );
+
 	/// Datagram length
 	uint										_DatagramLength;
 
-	/// Received message
+	/// Placeholder for a datagram received when the ring is full (dropped)
 	TReceivedMessage							_ReceivedMessage;
 
-	/// Write queue access
-	NLMISC::CSynchronized<NLMISC::CBufFIFO*>	_WriteQueue;
+	/// Max number of datagrams per system call
+	uint										_BatchSize;
+
+	/// Datagram descriptions pointing to the slots of the ring (used if _BatchSize > 1)
+	std::vector<NLNET::CUdpSock::TDatagram>		_DatagramBatch;
+
+	/// Ring of received messages, read by the main thread
+	CFEReceiveRing								*_Ring;
 
 	/// Number of datagrams not copied because too big
 	volatile uint								_NbRejectedDatagrams;
@@ -52,7 +52,7 @@ extern CGenericXmlMsgHeaderManager GenericXmlMsgHeaderMngr;
 /*
  * Init
  */
-void CFeSendSub::init( NLNET::CUdpSock *datasock, THostMap *clientmap, CHistory *history, CPrioSub *priosub )
+void CFeSendSub::init( NLNET::CUdpSock *datasock, THostMap *clientmap, CHistory *history, CPrioSub *priosub, uint udpBatchSize )
 {
 	nlassert( datasock && history );
 
@@ -67,6 +67,14 @@ void CFeSendSub::init( NLNET::CUdpSock *datasock, THostMap *clientmap, CHistory
 	_CurrentFillingBuffers = &_SendBuffers1;
 	_CurrentFlushingBuffers = &_SendBuffers2;
 
+	_BatchedSend = (udpBatchSize > 1);
+	if ( _BatchedSend )
+	{
+		_DatagramBatch.reserve( MaxNbClients+1 );
+		_DatagramBatchClients.reserve( MaxNbClients+1 );
+		nlinfo( "Sending outgoing messages in batches" );
+	}
+
 	_MsgXmlMD5 = NLMISC::getMD5("msg.xml");
 	_DatabaseXmlMD5 = NLMISC::getMD5("database.xml");
 
@@ -75,6 +83,27 @@ void CFeSendSub::init( NLNET::CUdpSock *datasock, THostMap *clientmap, CHistory
 }
 
 
+/*
+ * Send the outgoing messages with several threads
+ */
+void CFeSendSub::initFlushWorkers( uint nbWorkers )
+{
+	if ( (! _BatchedSend) || (nbWorkers <= 1) )
+		return;
+
+	_FlushWorkers.init( nbWorkers );
+	_WorkerDatagramBatches.resize( nbWorkers );
+	_WorkerDatagramBatchClients.resize( nbWorkers );
+	_WorkerSendCounters.resize( nbWorkers, 0 );
+	for ( uint i=1; i<nbWorkers; ++i )
+	{
+		_WorkerDatagramBatches[i].reserve( NbSendBuffersPerFlushJob );
+		_WorkerDatagramBatchClients[i].reserve( NbSendBuffersPerFlushJob );
+	}
+	nlinfo( "Outgoing messages sent by %u threads", nbWorkers );
+}
+
+
 /*
  * Set client bandwidth per cycle in bytes
  */
@@ -364,20 +393,27 @@ void	CFeSendSub::flushMessages()
 	TTicks before = CTime::getPerformanceTime();
 #endif
 
-	TSendBuffers::iterator isb;
-	for ( isb=_CurrentFlushingBuffers->begin(); isb!=_CurrentFlushingBuffers->end(); ++isb )
+	if ( _BatchedSend )
 	{
-		if ( (*isb).SBState )
+		flushMessagesBatched();
+	}
+	else
+	{
+		TSendBuffers::iterator isb;
+		for ( isb=_CurrentFlushingBuffers->begin(); isb!=_CurrentFlushingBuffers->end(); ++isb )
 		{
-			try
+			if ( (*isb).SBState )
 			{
-				(*isb).sendOutBox( _DataSock );
-				++_SendCounter;
-				//nldebug( "%u: SENDING NOW %u bytes to %s", CTickEventHandler::getGameCycle(), (*isb).OutBox.length(), (*isb).DestAddress.asString().c_str() );
-			}
-			catch (const ESocket&)
-			{
-				nlwarning( "Could not send data to client %u", isb-_CurrentFlushingBuffers->begin() );
+				try
+				{
+					(*isb).sendOutBox( _DataSock );
+					++_SendCounter;
+					//nldebug( "%u: SENDING NOW %u bytes to %s", CTickEventHandler::getGameCycle(), (*isb).OutBox.length(), (*isb).DestAddress.asString().c_str() );
+				}
+				catch (const ESocket&)
+				{
+					nlwarning( "Could not send data to client %u", isb-_CurrentFlushingBuffers->begin() );
+				}
 			}
 		}
 	}
@@ -400,6 +436,106 @@ void	CFeSendSub::flushMessages()
 
 
 
+/*
+ * Flushing of a range of send buffers, by a flushing thread
+ */
+class CFlushJobs : public NLMISC::IWorkerJobs
+{
+public:
+
+	CFlushJobs( CFeSendSub *sendSub ) : _SendSub(sendSub) {}
+
+	virtual void	runJob( uint jobIndex, uint workerIndex )
+	{
+		uint first = jobIndex * CFeSendSub::NbSendBuffersPerFlushJob;
+		uint last = std::min( first + CFeSendSub::NbSendBuffersPerFlushJob, (uint)_SendSub->_CurrentFlushingBuffers->size() );
+		std::vector<CUdpSock::TDatagram>& datagramBatch = (workerIndex == 0) ? _SendSub->_DatagramBatch : _SendSub->_WorkerDatagramBatches[workerIndex];
+		std::vector<TClientId>& datagramBatchClients = (workerIndex == 0) ? _SendSub->_DatagramBatchClients : _SendSub->_WorkerDatagramBatchClients[workerIndex];
+		_SendSub->_WorkerSendCounters[workerIndex] += _SendSub->flushSendBuffersBatched( first, last, datagramBatch, datagramBatchClients );
+	}
+
+private:
+
+	CFeSendSub		*_SendSub;
+};
+
+
+/*
+ * Send outgoing messages in batches, with as few system calls as possible
+ * This can be executed by a background thread
+ */
+void	CFeSendSub::flushMessagesBatched()
+{
+	uint nbSendBuffers = (uint)_CurrentFlushingBuffers->size();
+	if ( _FlushWorkers.nbWorkers() > 1 )
+	{
+		// Each thread sends the datagrams of its ranges of clients. The send buffers
+		// are not modified by the main thread while they are flushed (see swapSendBuffers()).
+		// Several threads can send on the socket at the same time, its counters are updated atomically.
+		std::fill( _WorkerSendCounters.begin(), _WorkerSendCounters.end(), 0 );
+		CFlushJobs jobs( this );
+		_FlushWorkers.run( jobs, (nbSendBuffers + NbSendBuffersPerFlushJob - 1) / NbSendBuffersPerFlushJob );
+		uint32 nbFlushed = 0;
+		for ( uint i=0; i!=_WorkerSendCounters.size(); ++i )
+			nbFlushed += _WorkerSendCounters[i];
+		_SendCounter += nbFlushed;
+	}
+	else
+	{
+		_SendCounter += flushSendBuffersBatched( 0, nbSendBuffers, _DatagramBatch, _DatagramBatchClients );
+	}
+}
+
+
+/*
+ * Send the outgoing messages of a range of send buffers in batches
+ */
+uint32	CFeSendSub::flushSendBuffersBatched( uint first, uint last, std::vector<NLNET::CUdpSock::TDatagram>& datagramBatch, std::vector<TClientId>& datagramBatchClients )
+{
+	uint32 nbFlushed = 0;
+
+	// Gather the datagrams to send (no allocation, the vectors are reserved for all the clients of the range)
+	datagramBatch.clear();
+	datagramBatchClients.clear();
+	for ( uint i=first; i!=last; ++i )
+	{
+		CSendBuffer& sendBuffer = (*_CurrentFlushingBuffers)[i];
+		if ( sendBuffer.SBState )
+		{
+			if ( sendBuffer.OutBox.length() != 0 )
+			{
+				CUdpSock::TDatagram datagram;
+				datagram.Buffer = const_cast<uint8*>(sendBuffer.OutBox.buffer());
+				datagram.Length = sendBuffer.OutBox.length();
+				datagram.Addr = &sendBuffer.DestAddress;
+				datagramBatch.push_back( datagram );
+				datagramBatchClients.push_back( (TClientId)i );
+			}
+			else
+			{
+				++nbFlushed; // nothing to send
+			}
+		}
+	}
+
+	// Send them, skipping the ones that fail
+	uint nbToSend = (uint)datagramBatch.size();
+	uint nbDone = 0;
+	while ( nbDone < nbToSend )
+	{
+		uint nbSent = _DataSock->sendToBatch( &datagramBatch[nbDone], nbToSend-nbDone );
+		nbFlushed += nbSent;
+		nbDone += nbSent;
+		if ( nbDone < nbToSend )
+		{
+			nlwarning( "Could not send data to client %u", datagramBatchClients[nbDone] );
+			++nbDone;
+		}
+	}
+	return nbFlushed;
+}
+
+
 /*
  * Update
  * Deprecated: replaced by modules (see initModules() in frontend_service.cpp)
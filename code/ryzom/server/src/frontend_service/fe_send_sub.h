@@ -20,6 +20,7 @@
 #define NL_FE_SEND_SUB_H
 
 #include "nel/misc/types_nl.h"
+#include "nel/misc/worker_pool.h"
 #include <nel/misc/md5.h>
 
 #include "fe_receive_sub.h"
@@ -97,11 +98,23 @@ public:
 		//_OutputBits(0),
 		_SendCounter(0),
 		_NbActions(0),
-		_NbImpulseActions(0)
+		_NbImpulseActions(0),
+		_BatchedSend(false)
 		{}
 
-	/// Init
-	void	init( NLNET::CUdpSock *datasock, THostMap *clientmap, CHistory *history, CPrioSub *priosub );
+	/** Init
+	 * If udpBatchSize is greater than 1, the outgoing messages are sent in batches
+	 * (see NLNET::CUdpSock::sendToBatch()). In this mode, the simlag settings are not applied.
+	 */
+	void	init( NLNET::CUdpSock *datasock, THostMap *clientmap, CHistory *history, CPrioSub *priosub, uint udpBatchSize=1 );
+
+	/** Send the outgoing messages with several threads (nbWorkers includes the flushing thread).
+	 * Only used when the messages are sent in batches. Call after init() and before the first flush.
+	 */
+	void	initFlushWorkers( uint nbWorkers );
+
+	/// Stop the flushing threads (call when no flush can be in progress)
+	void	releaseFlushWorkers() { _FlushWorkers.release(); }
 
 	/// Update
 	void	update();
@@ -182,6 +195,17 @@ public:
 
 private:
 
+	friend class CFlushJobs;
+
+	/// Number of send buffers processed by a job of the flushing threads
+	enum { NbSendBuffersPerFlushJob = 64 };
+
+	/// Send outgoing messages in batches (called by flushMessages())
+	void					flushMessagesBatched();
+
+	/// Send the outgoing messages of the send buffers [first, last[ in batches, return the number of messages flushed
+	uint32					flushSendBuffersBatched( uint first, uint last, std::vector<NLNET::CUdpSock::TDatagram>& datagramBatch, std::vector<TClientId>& datagramBatchClients );
+
 	/// Socket access
 	NLNET::CUdpSock			*_DataSock;
 
@@ -226,6 +250,25 @@ private:
 	TSendBuffers			_SendBuffers1, _SendBuffers2;
 	TSendBuffers			*_CurrentFillingBuffers, *_CurrentFlushingBuffers;
 
+	/// Send several datagrams per system call
+	bool					_BatchedSend;
+
+	/// Datagrams to send in the current flush (preallocated for all clients, used only if _BatchedSend)
+	std::vector<NLNET::CUdpSock::TDatagram>	_DatagramBatch;
+
+	/// Client ids corresponding to the elements of _DatagramBatch
+	std::vector<TClientId>	_DatagramBatchClients;
+
+	/// Threads sharing the flushing of the send buffers (used only if _BatchedSend)
+	NLMISC::CWorkerPool		_FlushWorkers;
+
+	/// Datagrams to send and their client ids, by flushing thread (the worker 0 uses _DatagramBatch)
+	std::vector< std::vector<NLNET::CUdpSock::TDatagram> >	_WorkerDatagramBatches;
+	std::vector< std::vector<TClientId> >					_WorkerDatagramBatchClients;
+
+	/// Number of messages flushed in the current flush, by flushing thread
+	std::vector<uint32>		_WorkerSendCounters;
+
 	/// MD5 hash keys of msg.xml and database.xml
 	NLMISC::CHashKeyMD5		_MsgXmlMD5;
 	NLMISC::CHashKeyMD5		_DatabaseXmlMD5;
@@ -101,6 +101,9 @@ const uint32 UDP_IP_ETH_HEADER_SIZE = 42;
 CVariable<bool>		DontNeedBackend("FS", "DontNeedBackend", "Debug feature to allow client connection without backend (1=always allow connection , 0=backend must be up)", false, 0, true);
 
 CVariable<bool>		UseSendThread("FS", "UseSendThread", "Use thread for sending", false, 0, true);
+CVariable<uint32>	UDPBatchSize("FS", "UDPBatchSize", "Max number of datagrams received or sent per system call (1 = one call per datagram; if greater, simlag settings are not applied to sending)", 1, 0, true);
+CVariable<uint32>	NbClientWorkers("FS", "NbClientWorkers", "Number of threads calculating the distances and priorities of the clients and sending their messages in batches (1 = no additional thread; read at startup)", 1, 0, true);
+CVariable<uint32>	ReceiveRingSize("FS", "ReceiveRingSize", "Number of preallocated messages between the receive thread and the main thread (rounded up to a power of 2; datagrams are dropped when full)", 8192, 0, true);
 
 CVariable<bool>		UseWebPatchServer("FS", "UseWebPatchServer", "Use Web Server for patching", true, 0, true);
 CVariable<bool>		AcceptClientsAtStartup("FS", "AcceptClientsAtStartup", "Set Frontend Accept mode (1=accept clients, 0=patching mode)", false, 0, true);
@@ -1241,7 +1244,7 @@ void CFrontEndService::init()
 		_DgramLength = ConfigFile.getVar( "DatagramLength" ).asInt();
 		nlinfo( "\tDatagramLength = %u bytes", _DgramLength );
 		nlinfo( "Initializing receiving subsystem..." );
-		_ReceiveSub.init( frontendPort, lastAcceptableFrontendPort, _DgramLength, &_History, &_SendSub.clientIdCont() );
+		_ReceiveSub.init( frontendPort, lastAcceptableFrontendPort, _DgramLength, &_History, &_SendSub.clientIdCont(), UDPBatchSize.get(), ReceiveRingSize.get() );
 		frontendPort = _ReceiveSub.dataSock()->localAddr().port();
 		listenAddr.setPort( frontendPort );
 		CLoginServer::setListenAddress( PublishFSHostAsIP.get() ? listenAddr.asIPString() : (listenAddr.hostName() + ":" + NLMISC::toString( listenAddr.port() )) ); // note: asString() returns more information
@@ -1291,7 +1294,7 @@ void CFrontEndService::init()
 #else
 		nlinfo( " Full-frequency mode" );
 #endif
-		_SendSub.init( _ReceiveSub.dataSock(), &_ReceiveSub.clientMap(), &_History, &PrioSub );
+		_SendSub.init( _ReceiveSub.dataSock(), &_ReceiveSub.clientMap(), &_History, &PrioSub, UDPBatchSize.get() );
 		installConfigVar( ConfigFile, "ClientBandwidth", cfcbClientBandwidth );
 		installConfigVar( ConfigFile, "TotalBandwidth", cfcbTotalBandwidth );
 
@@ -1304,6 +1307,14 @@ void CFrontEndService::init()
 		PrioSub.init( /*&_SendSub.clientIdCont()*/ &_History, &_ReceiveSub.EntityToClient );
 		installConfigVar( ConfigFile, "PriorityMode", cfcbPriorityMode );
 
+		// Init the threads processing the clients
+		if ( NbClientWorkers.get() > 1 )
+		{
+			PrioSub.ClientWorkers.init( NbClientWorkers.get() );
+			nlinfo( "Distances and priorities calculated by %u threads", NbClientWorkers.get() );
+		}
+		_SendSub.initFlushWorkers( NbClientWorkers.get() );
+
 		// Register property nbbits
 		CActionSint64::registerNumericPropertiesRyzom();
 		CActionFactory::getInstance()->initVolatileProperties();
@@ -1405,6 +1416,9 @@ void CFrontEndService::release()
 		delete SendThread;
 		SendThread = NULL;
 	}
+
+	_SendSub.releaseFlushWorkers();
+	PrioSub.ClientWorkers.release();
 }
 
 
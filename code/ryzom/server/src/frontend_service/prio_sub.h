@@ -20,6 +20,7 @@
 #define NL_PRIO_SUB_H
 
 #include <nel/misc/types_nl.h>
+#include <nel/misc/worker_pool.h>
 #include "vision_array.h"
 #include "vision_provider.h"
 #include "distance_prioritizer.h"
@@ -83,6 +84,9 @@ public:
 	/// Priority calculation
 	CDistancePrioritizer	Prioritizer;
 
+	/// Threads sharing the per-client processing of the distances and priorities (see IClientJobs)
+	NLMISC::CWorkerPool		ClientWorkers;
+
 private:
 
 	/// Counter for adjustHPThreshold
@@ -0,0 +1,260 @@
+// Ryzom - MMORPG Framework <http://dev.ryzom.com/projects/ryzom/>
+// Copyright (C) 2010  Winch Gate Property Limited
+//
+// This program is free software: you can redistribute it and/or modify
+// it under the terms of the GNU Affero General Public License as
+// published by the Free Software Foundation, either version 3 of the
+// License, or (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU Affero General Public License for more details.
+//
+// You should have received a copy of the GNU Affero General Public License
+// along with this program.  If not, see <http://www.gnu.org/licenses/>.
+
+
+
+#ifndef NL_PRIORITIZED_ENTITIES_H
+#define NL_PRIORITIZED_ENTITIES_H
+
+#include "nel/misc/types_nl.h"
+#include "game_share/entity_types.h"
+#include "fe_types.h"
+#include "vision_array.h"
+
+#include <string.h>
+
+
+/**
+ * Entities seen by a client, ordered by priority (see CDistancePrioritizer).
+ *
+ * Instead of being sorted, the entities are stored in buckets of quantized priority: the
+ * bucket of a priority is given by its exponent and its two highest mantissa bits (i.e. four
+ * buckets per power of two). Each bucket is a list of slots, and a bitmap of the non-empty
+ * buckets allows to skip the empty ones. Thus, updating the priority of an entity only moves
+ * it if its bucket has changed, and browsing the K first entities costs O(K).
+ * The entities of a bucket are browsed in the order of their insertion in the bucket.
+ */
+class CPrioritizedEntities
+{
+public:
+
+	/// Number of buckets (0 is for the null priorities, NbBuckets-1 for the highest ones)
+	enum { NbBuckets = 128, NbBucketWords = NbBuckets / 32 };
+
+	/// Constructor
+	CPrioritizedEntities()
+	{
+		memset( _BucketOfSlot, NotQueued, sizeof(_BucketOfSlot) );
+		clearBuckets();
+	}
+
+	/// Add an entity (no effect if it is already queued)
+	void					insert( CLFECOMMON::TCLEntityId slot, TPriority prio )
+	{
+		if ( _BucketOfSlot[slot] != NotQueued )
+			return;
+		link( slot, getBucket( prio ) );
+		++_Size;
+	}
+
+	/// Remove an entity (no effect if it is not queued)
+	void					remove( CLFECOMMON::TCLEntityId slot )
+	{
+		if ( _BucketOfSlot[slot] == NotQueued )
+			return;
+		if ( slot == _BrowsedSlot )
+			_BrowsedSlot = _Next[slot];
+		unlink( slot );
+		_BucketOfSlot[slot] = NotQueued;
+		--_Size;
+	}
+
+	/// Remove all the entities
+	void					clear()
+	{
+		memset( _BucketOfSlot, NotQueued, sizeof(_BucketOfSlot) );
+		clearBuckets();
+	}
+
+	/// Move an entity to the bucket of its new priority, if it has changed. Return true if moved.
+	bool					update( CLFECOMMON::TCLEntityId slot, TPriority prio )
+	{
+		uint8 bucket = _BucketOfSlot[slot];
+		if ( bucket == NotQueued )
+			return false;
+		uint newBucket = getBucket( prio );
+		if ( newBucket == bucket )
+			return false;
+		if ( slot == _BrowsedSlot )
+			_BrowsedSlot = _Next[slot];
+		unlink( slot );
+		link( slot, newBucket );
+		return true;
+	}
+
+	/// Return true if the entity is queued
+	bool					contains( CLFECOMMON::TCLEntityId slot ) const { return _BucketOfSlot[slot] != NotQueued; }
+
+	/// Return the number of entities queued
+	uint					size() const { return _Size; }
+
+	/// Begin a browsing of the entities, by decreasing priority
+	void					initBrowsing()
+	{
+		_NbBrowsed = 0;
+		_BrowsedBucket = findNonEmptyBucketBelow( NbBuckets );
+		_BrowsedSlot = (_BrowsedBucket < 0) ? CLFECOMMON::INVALID_SLOT : _First[_BrowsedBucket];
+	}
+
+	/// Return the next entity of the browsing, or INVALID_SLOT if no more
+	CLFECOMMON::TCLEntityId	getNext()
+	{
+		while ( _BrowsedSlot == CLFECOMMON::INVALID_SLOT )
+		{
+			if ( _BrowsedBucket < 0 )
+				return CLFECOMMON::INVALID_SLOT;
+			_BrowsedBucket = findNonEmptyBucketBelow( _BrowsedBucket );
+			if ( _BrowsedBucket < 0 )
+				return CLFECOMMON::INVALID_SLOT;
+			_BrowsedSlot = _First[_BrowsedBucket];
+		}
+		CLFECOMMON::TCLEntityId slot = _BrowsedSlot;
+		_BrowsedSlot = _Next[slot];
+		++_NbBrowsed;
+		return slot;
+	}
+
+	/// Return the number of entities not browsed yet
+	uint					nbRemainingToBrowse() const { return (_NbBrowsed < _Size) ? _Size - _NbBrowsed : 0; }
+
+	/// Return the bucket of a priority
+	static uint				getBucket( TPriority prio )
+	{
+		// For a positive float, the bits compare like the values
+		if ( ! (prio > 0.0f) )
+			return 0;
+		uint32 bits;
+		memcpy( &bits, &prio, sizeof(bits) );
+		sint32 bucket = (sint32)(bits >> 21) - FirstBucketKey;
+		if ( bucket < 1 )
+			return 1;
+		if ( bucket >= (sint32)NbBuckets )
+			return NbBuckets - 1;
+		return (uint)bucket;
+	}
+
+private:
+
+	/// Value of _BucketOfSlot for an entity not queued
+	enum { NotQueued = 0xFF };
+
+	/** Key (exponent and two highest mantissa bits of the float) of the bucket 1.
+	 * The buckets 1 to 127 cover priorities from about 0.001 (unset distance) to 2^20.
+	 */
+	enum { FirstBucketKey = 116 << 2 };
+
+	/// Empty all the buckets
+	void					clearBuckets()
+	{
+		memset( _First, CLFECOMMON::INVALID_SLOT, sizeof(_First) );
+		memset( _Last, CLFECOMMON::INVALID_SLOT, sizeof(_Last) );
+		memset( _NonEmptyBuckets, 0, sizeof(_NonEmptyBuckets) );
+		_Size = 0;
+		_NbBrowsed = 0;
+		_BrowsedBucket = -1;
+		_BrowsedSlot = CLFECOMMON::INVALID_SLOT;
+	}
+
+	/// Append a slot to a bucket
+	void					link( CLFECOMMON::TCLEntityId slot, uint bucket )
+	{
+		_BucketOfSlot[slot] = (uint8)bucket;
+		_Prev[slot] = _Last[bucket];
+		_Next[slot] = CLFECOMMON::INVALID_SLOT;
+		if ( _Last[bucket] == CLFECOMMON::INVALID_SLOT )
+		{
+			_First[bucket] = slot;
+			_NonEmptyBuckets[bucket >> 5] |= (1u << (bucket & 31));
+		}
+		else
+		{
+			_Next[_Last[bucket]] = slot;
+		}
+		_Last[bucket] = slot;
+	}
+
+	/// Remove a slot from its bucket
+	void					unlink( CLFECOMMON::TCLEntityId slot )
+	{
+		uint bucket = _BucketOfSlot[slot];
+		if ( _Prev[slot] == CLFECOMMON::INVALID_SLOT )
+			_First[bucket] = _Next[slot];
+		else
+			_Next[_Prev[slot]] = _Next[slot];
+		if ( _Next[slot] == CLFECOMMON::INVALID_SLOT )
+			_Last[bucket] = _Prev[slot];
+		else
+			_Prev[_Next[slot]] = _Prev[slot];
+		if ( _First[bucket] == CLFECOMMON::INVALID_SLOT )
+			_NonEmptyBuckets[bucket >> 5] &= ~(1u << (bucket & 31));
+	}
+
+	/// Return the highest non-empty bucket lower than 'bucket', or -1 if there is none
+	sint					findNonEmptyBucketBelow( sint bucket ) const
+	{
+		while ( --bucket >= 0 )
+		{
+			uint32 word = _NonEmptyBuckets[bucket >> 5] & (0xFFFFFFFF >> (31 - (bucket & 31)));
+			if ( word != 0 )
+				return (bucket & ~31) + getHighestBit( word );
+			bucket &= ~31;
+		}
+		return -1;
+	}
+
+	/// Return the index of the highest bit set in a non-null word
+	static sint				getHighestBit( uint32 word )
+	{
+#if defined(__GNUC__)
+		return 31 - __builtin_clz( word );
+#else
+		sint bit = 0;
+		if ( word & 0xFFFF0000 ) { word >>= 16; bit += 16; }
+		if ( word & 0xFF00 ) { word >>= 8; bit += 8; }
+		if ( word & 0xF0 ) { word >>= 4; bit += 4; }
+		if ( word & 0xC ) { word >>= 2; bit += 2; }
+		if ( word & 0x2 ) { bit += 1; }
+		return bit;
+#endif
+	}
+
+	/// Bucket of each slot, or NotQueued
+	uint8						_BucketOfSlot [CLFECOMMON::INVALID_SLOT+1];
+
+	/// Links of the slots in their bucket (INVALID_SLOT at the ends)
+	CLFECOMMON::TCLEntityId		_Prev [CLFECOMMON::INVALID_SLOT+1];
+	CLFECOMMON::TCLEntityId		_Next [CLFECOMMON::INVALID_SLOT+1];
+
+	/// First and last slots of each bucket (INVALID_SLOT if empty)
+	CLFECOMMON::TCLEntityId		_First [NbBuckets];
+	CLFECOMMON::TCLEntityId		_Last [NbBuckets];
+
+	/// One bit per bucket, set if the bucket is not empty
+	uint32						_NonEmptyBuckets [NbBucketWords];
+
+	/// Number of entities queued
+	uint						_Size;
+
+	/// Browsing state: current bucket, next slot to return, number of slots returned
+	sint						_BrowsedBucket;
+	CLFECOMMON::TCLEntityId		_BrowsedSlot;
+	uint						_NbBrowsed;
+};
+
+
+#endif // NL_PRIORITIZED_ENTITIES_H
+
+/* End of prioritized_entities.h */
@@ -25,6 +25,7 @@
 #include "client_host.h"
 #include "fe_stat.h"
 #include "vision_array.h"
+#include "client_jobs.h"
 
 using namespace std;
 using namespace NLNET;
@@ -78,6 +79,20 @@ NLMISC_DYNVARIABLE( uint, NbEntitiesSeenByMonitoredClient, "NbEntitiesSeenByMoni
 }
 
 
+/*
+ * Calculation of the distances of the entities seen by the clients, by the client workers
+ */
+class CDistanceJobs : public IClientJobs
+{
+public:
+	CDistanceJobs() : VisionProvider(NULL) {}
+	virtual void processClient( CClientHost *client ) { VisionProvider->updateDistances( client ); }
+	CVisionProvider	*VisionProvider;
+};
+
+static CDistanceJobs DistanceJobs;
+
+
 /*
  * Initialization
  */
@@ -241,25 +256,16 @@ void				CVisionProvider::processVision()
 		sint clientmapindex, outerBoundIndex;
 		DistanceSpreader.getProcessingBounds( icm, clientmapindex, outerBoundIndex );
 
+		// The distances of the clients are calculated by the client workers
+		DistanceJobs.VisionProvider = this;
+		DistanceJobs.Clients.clear();
 		while ( clientmapindex < outerBoundIndex )
 		{
-			CClientHost*	client = GETCLIENTA(icm);
-			TPairState*		state = _VisionArray->getClientStateArray(client->clientId()) + 1;
-
-			// Calculate the distance for all used slots (except slot 0 which always remains at distance 0)
-			for ( sint e=1; e!=MAX_SEEN_ENTITIES_PER_CLIENT; ++e, ++state )
-			{
-				//TPairState&	state = _VisionArray->getPairState(client->clientId(), (TCLEntityId)e);
-
-				//if ( _VisionArray->getAssociationState( client, (TCLEntityId)e ) != CClientEntityIdTranslator::CEntityInfo::UnusedAssociation )	// CHANGED BEN
-				if (state->AssociationState != TPairState::UnusedAssociation )
-				{
-					state->DistanceCE = calcDistance( client, (TCLEntityId)e, state->EntityIndex );
-				}
-			}
+			DistanceJobs.Clients.push_back( GETCLIENTA(icm) );
 			++clientmapindex;
 			++icm;
 		}
+		DistanceJobs.run( CFrontEndService::instance()->PrioSub.ClientWorkers );
 		DistanceSpreader.endProcessing( icm );
 	}
 
@@ -275,6 +281,27 @@ void				CVisionProvider::processVision()
 }
 
 
+/*
+ * Calculate the distances of the entities seen by a client
+ */
+void				CVisionProvider::updateDistances( CClientHost *client )
+{
+	TPairState*		state = _VisionArray->getClientStateArray(client->clientId()) + 1;
+
+	// Calculate the distance for all used slots (except slot 0 which always remains at distance 0)
+	for ( sint e=1; e!=MAX_SEEN_ENTITIES_PER_CLIENT; ++e, ++state )
+	{
+		//TPairState&	state = _VisionArray->getPairState(client->clientId(), (TCLEntityId)e);
+
+		//if ( _VisionArray->getAssociationState( client, (TCLEntityId)e ) != CClientEntityIdTranslator::CEntityInfo::UnusedAssociation )	// CHANGED BEN
+		if (state->AssociationState != TPairState::UnusedAssociation )
+		{
+			state->DistanceCE = calcDistance( client, (TCLEntityId)e, state->EntityIndex );
+		}
+	}
+}
+
+
 /*
  * Calculate the absolute distance between a client and an entity
  */
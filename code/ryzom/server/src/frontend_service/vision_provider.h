@@ -162,6 +162,9 @@ public:
 	///
 	void					postRemovePair( TClientId clientid, CLFECOMMON::TCLEntityId slot );
 
+	/// Calculate the distances of the entities seen by a client (can be called concurrently for different clients)
+	void					updateDistances( CClientHost *client );
+
 	uint32					AssocCounter;
 	uint32					DisasCounter;
 	NLMISC::TTime			AssocStartTime;
@@ -88,6 +88,7 @@ void CServiceClass::tickUpdate()
 void CServiceClass::release()
 {
 	CSingletonRegistry::getInstance()->release();
+	CTickEventHandler::release();
 }
 
 
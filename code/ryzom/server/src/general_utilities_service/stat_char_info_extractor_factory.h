@@ -30,7 +30,7 @@
 // forward class declarations
 //-------------------------------------------------------------------------------------------------
 
-class CCharacterScanJob;
+class CCharacterScanResult;
 class CStatsScanCharacter;
 class ICharInfoExtractorBuilder;
 
@@ -45,7 +45,7 @@ public:
 	virtual ~ICharInfoExtractor() {}
 	virtual std::string toString() const=0;
 	virtual const ICharInfoExtractorBuilder* getBuilder() const=0;
-	virtual void execute(CCharacterScanJob* job,const CStatsScanCharacter* c)=0;
+	virtual void execute(CCharacterScanResult* output,const CStatsScanCharacter* c)=0;
 };
 
 
@@ -122,7 +122,7 @@ public:\
 	CInfoExtractor_##name(const std::string& rawArgs,const ICharInfoExtractorBuilder *builder) {_RawArgs=rawArgs;_Builder=builder;}\
 	virtual std::string toString() const {return std::string(#name)+" "+_RawArgs;}\
 	virtual const ICharInfoExtractorBuilder* getBuilder() const {return _Builder;}\
-	virtual void execute(CCharacterScanJob* job,const CStatsScanCharacter* c);\
+	virtual void execute(CCharacterScanResult* output,const CStatsScanCharacter* c);\
 private:\
 	NLMISC::CSString _RawArgs;\
 	const ICharInfoExtractorBuilder *_Builder;\
@@ -136,7 +136,7 @@ public:\
 	virtual ICharInfoExtractor* build(const std::string& rawArgs) const {return new CInfoExtractor_##name(rawArgs,this);}\
 };\
 CInfoExtractorRegisterer<CInfoExtractorBuilder_##name> __Registerer_CInfoExtractor_##name;\
-void CInfoExtractor_##name::execute(CCharacterScanJob* job,const CStatsScanCharacter* c)
+void CInfoExtractor_##name::execute(CCharacterScanResult* output,const CStatsScanCharacter* c)
 
 
 //-------------------------------------------------------------------------------------------------
@@ -21,8 +21,7 @@
 
 #include "nel/misc/variable.h"
 #include "nel/misc/path.h"
-
-#include "game_share/persistent_data.h"
+#include "nel/misc/hierarchical_timer.h"
 
 #include "stat_character_scan_job.h"
 #include "stat_character.h"
@@ -37,6 +36,36 @@ using namespace std;
 using namespace NLMISC;
 
 
+//-------------------------------------------------------------------------------------------------
+// variables
+//-------------------------------------------------------------------------------------------------
+
+CVariable<uint32> CharScanNbThreads("Stats", "CharScanNbThreads", "Number of threads scanning the character files (1 = main thread only)", 4, 0, true);
+CVariable<uint32> CharScanFilesPerUpdate("Stats", "CharScanFilesPerUpdate", "Number of character files scanned by each update of a character scan job", 64, 0, true);
+
+
+//-------------------------------------------------------------------------------------------------
+// methods CCharacterScanResult
+//-------------------------------------------------------------------------------------------------
+
+void CCharacterScanResult::clear()
+{
+	Accepted= false;
+	CharTblEntries.clear();
+	FreqTblEntries.clear();
+}
+
+void CCharacterScanResult::charTblSetEntry(const std::string& colName,const std::string& value)
+{
+	CharTblEntries.push_back(std::make_pair(colName,value));
+}
+
+void CCharacterScanResult::freqTblAddEntry(const std::string& tblName, const std::string& key)
+{
+	FreqTblEntries.push_back(std::make_pair(tblName,key));
+}
+
+
 //-------------------------------------------------------------------------------------------------
 // methods CCharacterScanJob
 //-------------------------------------------------------------------------------------------------
@@ -49,6 +78,9 @@ CCharacterScanJob::CCharacterScanJob()
 	_State=INIT;
 	_FileList=NULL;
 	_ListFilesOnly=false;
+	_NbFilesScanned=0;
+	_NbBytesScanned=0;
+	_ScanTicks=0;
 
 	// setup the special reserved table columns 'account' and 'accountSlot'
 	charTblAddCol("account");
@@ -88,6 +120,13 @@ CCharacterScanJob::~CCharacterScanJob()
 		// the writing is finished so close the file
 		fclose(f);
 	}
+
+	// release the scan threads and their pdr objects
+	_Workers.release();
+	for (uint32 i=0;i<_ScanContexts.size();++i)
+	{
+		delete _ScanContexts[i];
+	}
 }
 
 void CCharacterScanJob::update()
@@ -96,9 +135,46 @@ void CCharacterScanJob::update()
 	if (_NextFile>=_Files.size())
 		return;
 
-	// treat the next file in the list
-	runForFile(_Files[_NextFile].FileName);
-	++_NextFile;
+	TTicks startTime= CTime::getPerformanceTime();
+
+	// setup the scan threads (the hierarchical timers used by the pdr code are not thread safe so the files
+	// are scanned by the main thread alone while benching)
+	uint32 nbThreads= CHTimer::benching()? 1: std::max(CharScanNbThreads.get(),(uint32)1);
+	if (nbThreads!=_Workers.nbWorkers())
+	{
+		_Workers.init(nbThreads);
+		nlinfo("Character files scanned by %u threads",nbThreads);
+	}
+	while (_ScanContexts.size()<_Workers.nbWorkers())
+	{
+		_ScanContexts.push_back(new CScanContext);
+	}
+
+	// scan the next files in the list
+	uint32 nbFiles= std::min(std::max(CharScanFilesPerUpdate.get(),(uint32)1),_Files.size()-_NextFile);
+	if (_Results.size()<nbFiles)
+	{
+		_Results.resize(nbFiles);
+	}
+	CScanJobs jobs(this);
+	_Workers.run(jobs,nbFiles);
+
+	// merge the results in the order of the file list
+	for (uint32 i=0;i<nbFiles;++i)
+	{
+		const CFileDescription& file= _Files[_NextFile];
+		applyResult(file.FileName,_Results[i]);
+		++_NbFilesScanned;
+		_NbBytesScanned+= file.FileSize;
+		++_NextFile;
+	}
+
+	_ScanTicks+= CTime::getPerformanceTime()-startTime;
+}
+
+void CCharacterScanJob::CScanJobs::runJob(uint jobIndex, uint workerIndex)
+{
+	_Job->scanFile(_Job->_Files[_Job->_NextFile+jobIndex].FileName,*_Job->_ScanContexts[workerIndex],_Job->_Results[jobIndex]);
 }
 
 bool CCharacterScanJob::charTblAddCol(const std::string& name)
@@ -283,10 +359,26 @@ bool CCharacterScanJob::deleteFilesInOutputDirectory() const
 
 bool CCharacterScanJob::runForFile(const std::string& fileName)
 {
-	// load the file into a pdr record
-	static CPersistentDataRecord	pdr;
-	pdr.clear();
-	pdr.readFromFile(fileName);
+	// scan the file on the calling thread and merge the result straight away
+	static CScanContext context;
+	CCharacterScanResult result;
+	scanFile(fileName,context,result);
+	applyResult(fileName,result);
+
+	return true;
+}
+
+void CCharacterScanJob::scanFile(const std::string& fileName,CScanContext& context,CCharacterScanResult& result)
+{
+	result.clear();
+
+	// map the file and read it in place if it's a binary file, otherwise load it into the pdr record
+	CPersistentDataRecord& pdr= context.Pdr;
+	if (!context.View.open(fileName) || !pdr.fromView(context.View))
+	{
+		pdr.clear();
+		pdr.readFromFile(fileName);
+	}
 
 	// create a character representation and apply the pdr
 	CStatsScanCharacter c;
@@ -296,8 +388,21 @@ bool CCharacterScanJob::runForFile(const std::string& fileName)
 	for (uint32 i=(uint32)_Filters.size();i--;)
 	{
 		if (!_Filters[i]->evaluate(&c))
-			return true;
+			return;
 	}
+	result.Accepted= true;
+
+	// iterate over the info extractors executing their core code
+	for (uint32 i=0;i<_InfoExtractors.size();++i)
+	{
+		_InfoExtractors[i]->execute(&result,&c);
+	}
+}
+
+void CCharacterScanJob::applyResult(const std::string& fileName,const CCharacterScanResult& result)
+{
+	if (!result.Accepted)
+		return;
 
 	// we've been accepted by the filters so add this file to the file list (if there is one)
 	if (_FileList!=NULL)
@@ -305,10 +410,14 @@ bool CCharacterScanJob::runForFile(const std::string& fileName)
 		_FileList->addFile(fileName);
 	}
 
-	// iterate over the info extractors executing their core code
-	for (uint32 i=0;i<_InfoExtractors.size();++i)
+	// add the info collected by the info extractors to the tables
+	for (uint32 i=0;i<result.CharTblEntries.size();++i)
+	{
+		charTblSetEntry(result.CharTblEntries[i].first,result.CharTblEntries[i].second);
+	}
+	for (uint32 i=0;i<result.FreqTblEntries.size();++i)
 	{
-		_InfoExtractors[i]->execute(this,&c);
+		freqTblAddEntry(result.FreqTblEntries[i].first,result.FreqTblEntries[i].second);
 	}
 
 	// flush the info collected by the info extractors to the output file
@@ -318,8 +427,6 @@ bool CCharacterScanJob::runForFile(const std::string& fileName)
 	{
 		charTblFlushRow(words[0].atoi(),words[1].atoi());
 	}
-
-	return true;
 }
 
 void CCharacterScanJob::start()
@@ -361,12 +468,26 @@ bool CCharacterScanJob::finished()
 
 std::string CCharacterScanJob::getShortStatus()
 {
-	return NLMISC::toString("CharacterFiles %d/%d",_NextFile,_Files.size());
+	return NLMISC::toString("CharacterFiles %d/%d (%.1f files/s)",_NextFile,_Files.size(),getFilesPerSecond());
 }
 
 std::string CCharacterScanJob::getStatus()
 {
-	return getShortStatus();
+	return NLMISC::toString("CharacterFiles %d/%d: %.1f files/s %.2f MB/s (%.1f MB scanned by %u threads)",
+		_NextFile,_Files.size(),getFilesPerSecond(),getMegaBytesPerSecond(),float(_NbBytesScanned)/(1024.0f*1024.0f),_Workers.nbWorkers());
+}
+
+float CCharacterScanJob::getFilesPerSecond() const
+{
+	// the throughput is computed over the time spent in update(), not including the wait between two updates
+	double seconds= CTime::ticksToSecond(_ScanTicks);
+	return (seconds==0.0)? 0.0f: float(_NbFilesScanned/seconds);
+}
+
+float CCharacterScanJob::getMegaBytesPerSecond() const
+{
+	double seconds= CTime::ticksToSecond(_ScanTicks);
+	return (seconds==0.0)? 0.0f: float(double(_NbBytesScanned)/(1024.0*1024.0)/seconds);
 }
 
 void CCharacterScanJob::display(NLMISC::CLog* log)
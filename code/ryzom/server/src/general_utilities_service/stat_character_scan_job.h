@@ -23,7 +23,11 @@
 
 #include "stdio.h"
 
+#include "nel/misc/worker_pool.h"
+
 #include "game_share/file_description_container.h"
+#include "game_share/persistent_data.h"
+#include "game_share/persistent_data_view.h"
 
 #include "stat_job_manager.h"
 #include "stat_char_info_extractor_factory.h"
@@ -31,6 +35,34 @@
 #include "stat_file_list_builder_factory.h"
 
 
+//-------------------------------------------------------------------------------------------------
+// class CCharacterScanResult
+//-------------------------------------------------------------------------------------------------
+// The output of the scan of one character file: the filters and info extractors run on the scan
+// threads and write here, then the scan job merges the results in the order of the file list
+
+class CCharacterScanResult
+{
+public:
+	// clear the result before scanning a new file
+	void clear();
+
+	// interface for the InfoExtractors to use
+	void charTblSetEntry(const std::string& colName,const std::string& value);
+	void freqTblAddEntry(const std::string& tblName, const std::string& key);
+
+public:
+	typedef std::vector<std::pair<std::string,std::string> > TEntries;
+
+	// false if the character was rejected by a filter
+	bool Accepted;
+
+	// the character table entries and the frequency table entries, in the order they were added
+	TEntries CharTblEntries;
+	TEntries FreqTblEntries;
+};
+
+
 //-------------------------------------------------------------------------------------------------
 // class CCharacterScanJob
 //-------------------------------------------------------------------------------------------------
@@ -60,7 +92,7 @@ public:
 	bool setOutputName(const std::string& fileNameRoot);
 	void listFilesOnly(CFileDescriptionContainer& result);
 
-	// interface for the InfoExtractors to use
+	// interface for merging the results of the InfoExtractors
 	void charTblSetEntry(const std::string& colName,const std::string& value);
 	void charTblFlushRow(uint32 account,uint32 slot);
 	void freqTblAddEntry(const std::string& tblName, const std::string& key);
@@ -71,6 +103,34 @@ public:
 	bool deleteFilesInOutputDirectory() const;
 	bool runForFile(const std::string& fileName);
 
+private:
+	// the pdr objects used by a scan thread
+	struct CScanContext
+	{
+		CPersistentDataView		View;
+		CPersistentDataRecord	Pdr;
+	};
+
+	// the files of an update() given to the scan threads
+	class CScanJobs: public NLMISC::IWorkerJobs
+	{
+	public:
+		CScanJobs(CCharacterScanJob* job): _Job(job) {}
+		virtual void runJob(uint jobIndex, uint workerIndex);
+	private:
+		CCharacterScanJob* _Job;
+	};
+
+	// parse a file and run the filters and info extractors (called by the scan threads)
+	void scanFile(const std::string& fileName,CScanContext& context,CCharacterScanResult& result);
+
+	// merge the result of a file in the output tables
+	void applyResult(const std::string& fileName,const CCharacterScanResult& result);
+
+	// throughput of the scan
+	float getFilesPerSecond() const;
+	float getMegaBytesPerSecond() const;
+
 private:
 	typedef std::vector<NLMISC::CSmartPtr<ICharInfoExtractor> > TInfoExtractors;
 	TInfoExtractors _InfoExtractors;
@@ -102,6 +162,16 @@ private:
 	FILE* _CharTblFile;
 	uint32 _NextFile;
 
+	// the scan threads, with one context each, and the results of the files of the current update()
+	NLMISC::CWorkerPool _Workers;
+	std::vector<CScanContext*> _ScanContexts;
+	std::vector<CCharacterScanResult> _Results;
+
+	// stats for the throughput counters
+	uint32 _NbFilesScanned;
+	uint64 _NbBytesScanned;
+	NLMISC::TTicks _ScanTicks;
+
 	CFileDescriptionContainer* _FileList;
 	bool _ListFilesOnly;
 };
@@ -31,14 +31,26 @@
 // Handy utilities
 //-------------------------------------------------------------------------------------------------
 
+// the info extractors are run by several scan threads so use the reentrant version of gmtime()
+static bool getGmTime(uint32 timeValue,struct tm& result)
+{
+	time_t rawtime= timeValue;
+#ifdef NL_OS_WINDOWS
+	return gmtime_s(&result,&rawtime)==0;
+#else
+	return gmtime_r(&rawtime,&result)!=NULL;
+#endif
+}
+
 static NLMISC::CSString buildDateString(uint32 timeValue)
 {
 	const char* monthNames[]= {"Jan","Feb","Mar","Apr","May","Jun","Jul","Aug","Sep","Oct","Nov","Dev"};
 	if (timeValue==0)
 		return "";
-	time_t rawtime= timeValue;
-	struct tm * timeinfo= gmtime(&rawtime);
-	return NLMISC::toString("%u %s %u",timeinfo->tm_mday,monthNames[timeinfo->tm_mon],timeinfo->tm_year+1900);
+	struct tm timeinfo;
+	if (!getGmTime(timeValue,timeinfo))
+		return "";
+	return NLMISC::toString("%u %s %u",timeinfo.tm_mday,monthNames[timeinfo.tm_mon],timeinfo.tm_year+1900);
 }
 
 static NLMISC::CSString buildDowTimeString(uint32 timeValue)
@@ -46,9 +58,10 @@ static NLMISC::CSString buildDowTimeString(uint32 timeValue)
 	const char* dowNames[]= {"Mon","Tue","Wed","Thu","Fri","Sat","Sun"};
 	if (timeValue==0)
 		return "";
-	time_t rawtime= timeValue;
-	struct tm * timeinfo= gmtime(&rawtime);
-	return NLMISC::toString("%s %u:%u",dowNames[timeinfo->tm_wday-1],timeinfo->tm_hour,timeinfo->tm_min);
+	struct tm timeinfo;
+	if (!getGmTime(timeValue,timeinfo))
+		return "";
+	return NLMISC::toString("%s %u:%u",dowNames[timeinfo.tm_wday-1],timeinfo.tm_hour,timeinfo.tm_min);
 }
 
 static NLMISC::CSString buildDurationString(uint32 timeValue)
@@ -74,33 +87,33 @@ static NLMISC::CSString buildDurationString(uint32 timeValue)
 
 INFO_EXTRACTOR(Name,"The character name","name")
 {
-	job->charTblSetEntry("name",c->EntityBase._Name);
+	output->charTblSetEntry("name",c->EntityBase._Name);
 }
 
 INFO_EXTRACTOR(PlayTime,"The time in hours that the character has spent on-line since the 'play time' stat was added","play_hours")
 {
 	float f= float(c->_PlayedTime)/(60.0f*60.0f);
-	job->charTblSetEntry("play_hours",NLMISC::toString("%.2f",f));
+	output->charTblSetEntry("play_hours",NLMISC::toString("%.2f",f));
 }
 
 INFO_EXTRACTOR(LastActivityDate,"The last time that the player connected (time stamp)","last_date")
 {
-	job->charTblSetEntry("last_date",buildDateString(c->_LastConnectedTime));
+	output->charTblSetEntry("last_date",buildDateString(c->_LastConnectedTime));
 }
 
 INFO_EXTRACTOR(FirstActivityDate,"The first time that the player connected","start_date")
 {
-	job->charTblSetEntry("start_date",buildDateString(c->_FirstConnectedTime));
+	output->charTblSetEntry("start_date",buildDateString(c->_FirstConnectedTime));
 }
 
 INFO_EXTRACTOR(LastActivityTime,"The last time that the player connected (time stamp)","last_time")
 {
-	job->charTblSetEntry("last_time",buildDowTimeString(c->_LastConnectedTime));
+	output->charTblSetEntry("last_time",buildDowTimeString(c->_LastConnectedTime));
 }
 
 INFO_EXTRACTOR(FirstActivityTime,"The first time that the player connected","start_time")
 {
-	job->charTblSetEntry("start_time",buildDowTimeString(c->_FirstConnectedTime));
+	output->charTblSetEntry("start_time",buildDowTimeString(c->_FirstConnectedTime));
 }
 
 INFO_EXTRACTOR(ActivityDuration,"The difference in days between first time connected and last time connected","active_days")
@@ -113,7 +126,7 @@ INFO_EXTRACTOR(ActivityDuration,"The difference in days between first time conne
 		return;
 
 	uint32 days= lastDay- firstDay+1;
-	job->charTblSetEntry("active_days",NLMISC::toString(days));
+	output->charTblSetEntry("active_days",NLMISC::toString(days));
 }
 
 INFO_EXTRACTOR(RecentPlayHistory,"Recent play time stats","num_sessions,shortest_session,longest_session,average_session,ttl_session_time,session_list")
@@ -137,79 +150,79 @@ INFO_EXTRACTOR(RecentPlayHistory,"Recent play time stats","num_sessions,shortest
 		sessionList+=buildDurationString(sessionDuration);
 	}
 
-	job->charTblSetEntry("num_sessions",NLMISC::toString(numSessions));
-	job->charTblSetEntry("shortest_session",buildDurationString(shortestSession));
-	job->charTblSetEntry("longest_session",buildDurationString(longestSession));
-	job->charTblSetEntry("average_session",(numSessions==0)?"0":buildDurationString(ttlPlayTime/numSessions));
-	job->charTblSetEntry("ttl_session_time",buildDurationString(ttlPlayTime));
-	job->charTblSetEntry("session_list",sessionList);
+	output->charTblSetEntry("num_sessions",NLMISC::toString(numSessions));
+	output->charTblSetEntry("shortest_session",buildDurationString(shortestSession));
+	output->charTblSetEntry("longest_session",buildDurationString(longestSession));
+	output->charTblSetEntry("average_session",(numSessions==0)?"0":buildDurationString(ttlPlayTime/numSessions));
+	output->charTblSetEntry("ttl_session_time",buildDurationString(ttlPlayTime));
+	output->charTblSetEntry("session_list",sessionList);
 }
 
 INFO_EXTRACTOR(Race,"The character's race","race")
 {
-	job->charTblSetEntry("race",c->EntityBase._Race);
+	output->charTblSetEntry("race",c->EntityBase._Race);
 }
 
 INFO_EXTRACTOR(Gender,"The character's gender","gender")
 {
-	job->charTblSetEntry("gender",c->EntityBase._Gender==0?"Male":"Female");
+	output->charTblSetEntry("gender",c->EntityBase._Gender==0?"Male":"Female");
 }
 
 INFO_EXTRACTOR(GuildId,"The guild number","guild")
 {
-	job->charTblSetEntry("guild",NLMISC::toString(c->_GuildId));
+	output->charTblSetEntry("guild",NLMISC::toString(c->_GuildId));
 }
 
 INFO_EXTRACTOR(Money,"Cash in hand","money")
 {
-	job->charTblSetEntry("money",NLMISC::toString(c->_Money));
+	output->charTblSetEntry("money",NLMISC::toString(c->_Money));
 }
 
 INFO_EXTRACTOR(AuraEnd,"end date of the prohibited reuse time for auras","aura_end")
 {
-	job->charTblSetEntry("aura_end",NLMISC::toString(c->_ForbidAuraUseEndDate));
+	output->charTblSetEntry("aura_end",NLMISC::toString(c->_ForbidAuraUseEndDate));
 }
 
 INFO_EXTRACTOR(Position,"x y position","x,y")
 {
 	if (c->NormalPositions._Vec.empty())
 	{
-		job->charTblSetEntry("x",NLMISC::toString(c->EntityBase._EntityPosition.X/1000));
-		job->charTblSetEntry("y",NLMISC::toString(c->EntityBase._EntityPosition.Y/1000));
+		output->charTblSetEntry("x",NLMISC::toString(c->EntityBase._EntityPosition.X/1000));
+		output->charTblSetEntry("y",NLMISC::toString(c->EntityBase._EntityPosition.Y/1000));
 	}
 	else
 	{
-		job->charTblSetEntry("x",NLMISC::toString(c->NormalPositions._Vec.back().PosState.X/1000));
-		job->charTblSetEntry("y",NLMISC::toString(c->NormalPositions._Vec.back().PosState.Y/1000));
+		output->charTblSetEntry("x",NLMISC::toString(c->NormalPositions._Vec.back().PosState.X/1000));
+		output->charTblSetEntry("y",NLMISC::toString(c->NormalPositions._Vec.back().PosState.Y/1000));
 	}
 }
 
-INFO_EXTRACTOR(Sessions,"home session id and current session id","home,session")
+typedef std::map<uint32,NLMISC::CSString> TShardNames;
+
+static TShardNames buildShardNames()
 {
-	// setup a static map of session ids to shard names
-	typedef std::map<uint32,NLMISC::CSString> TShardNames;
-	static TShardNames shardNames;
-	static bool init= false;
-	if (!init)
+	TShardNames shardNames;
+
+	NLMISC::CConfigFile::CVar *sessionNames = NLNET::IService::getInstance()->ConfigFile.getVarPtr("HomeMainlandNames");
+	DROP_IF(sessionNames == NULL,"'HomeMainlandNames' not found in cfg file",return shardNames);
+
+	for (uint i=0; i<sessionNames->size()/3; ++i)
 	{
-		breakable
-		{
-			init= true;
-
-			NLMISC::CConfigFile::CVar *sessionNames = NLNET::IService::getInstance()->ConfigFile.getVarPtr("HomeMainlandNames");
-			DROP_IF(sessionNames == NULL,"'HomeMainlandNames' not found in cfg file",break);
-
-			for (uint i=0; i<sessionNames->size()/3; ++i)
-			{
-				NLMISC::CSString sessionIdString= sessionNames->asString(i*3);
-				uint32 sessionId = sessionIdString.atoui();
-				NLMISC::CSString shardName = sessionNames->asString(i*3+1);
-				DROP_IF(sessionId==0,"Invalid session id "+sessionIdString,continue);
-				nldebug("Adding shard name mappiing: %u => %s",sessionId,shardName.c_str());
-				shardNames[sessionId]= shardName;
-			}
-		}
+		NLMISC::CSString sessionIdString= sessionNames->asString(i*3);
+		uint32 sessionId = sessionIdString.atoui();
+		NLMISC::CSString shardName = sessionNames->asString(i*3+1);
+		DROP_IF(sessionId==0,"Invalid session id "+sessionIdString,continue);
+		nldebug("Adding shard name mappiing: %u => %s",sessionId,shardName.c_str());
+		shardNames[sessionId]= shardName;
 	}
+	return shardNames;
+}
+
+INFO_EXTRACTOR(Sessions,"home session id and current session id","home,session")
+{
+	// setup a static map of session ids to shard names
+	// (initialised once by the first of the scan threads to get here, the others wait for it)
+	static const TShardNames shardNames= buildShardNames();
 
 	// if this character doesn't have a position vector then the information on the home mainland is not available here
 	// the character is probably old
@@ -220,10 +233,10 @@ INFO_EXTRACTOR(Sessions,"home session id and current session id","home,session")
 
 	// lookup the player's home session in the shardNames map
 	uint32 homeSessionId= c->NormalPositions._Vec[0].SessionId;
-	TShardNames::iterator homeIt= shardNames.find(homeSessionId);
+	TShardNames::const_iterator homeIt= shardNames.find(homeSessionId);
 
 	// if the home shard is known then put in the shard name, otherwise put in a session number
-	job->charTblSetEntry("home",
+	output->charTblSetEntry("home",
 		(homeIt!=shardNames.end())?
 			homeIt->second.c_str():
 			NLMISC::toString("%u",homeSessionId));
@@ -236,10 +249,10 @@ INFO_EXTRACTOR(Sessions,"home session id and current session id","home,session")
 
 	// lookup the player's current session in the shardNames map
 	uint32 curSessionId= c->NormalPositions._Vec.back().SessionId;
-	TShardNames::iterator curIt= shardNames.find(curSessionId);
+	TShardNames::const_iterator curIt= shardNames.find(curSessionId);
 
 	// if the shard is known then put in the shard name, otherwise put in a session number
-	job->charTblSetEntry("session",
+	output->charTblSetEntry("session",
 		(curIt!=shardNames.end())?
 			curIt->second.c_str():
 			NLMISC::toString("%s%u",shardNames.empty()?"":"Ring:",curSessionId));
@@ -247,48 +260,48 @@ INFO_EXTRACTOR(Sessions,"home session id and current session id","home,session")
 
 INFO_EXTRACTOR(Characs,"constitution, strength, etc","Constitution,Metabolism,Intelligence,Wisdom,Strength,WellBalanced,Dexterity,Will")
 {
-	job->charTblSetEntry("Constitution",NLMISC::toString(c->EntityBase._PhysCharacs._PhysicalCharacteristics.find("Constitution")->second));
-	job->charTblSetEntry("Metabolism",	NLMISC::toString(c->EntityBase._PhysCharacs._PhysicalCharacteristics.find("Metabolism")->second));
-	job->charTblSetEntry("Intelligence",NLMISC::toString(c->EntityBase._PhysCharacs._PhysicalCharacteristics.find("Intelligence")->second));
-	job->charTblSetEntry("Wisdom",		NLMISC::toString(c->EntityBase._PhysCharacs._PhysicalCharacteristics.find("Wisdom")->second));
-	job->charTblSetEntry("Strength",	NLMISC::toString(c->EntityBase._PhysCharacs._PhysicalCharacteristics.find("Strength")->second));
-	job->charTblSetEntry("WellBalanced",NLMISC::toString(c->EntityBase._PhysCharacs._PhysicalCharacteristics.find("WellBalanced")->second));
-	job->charTblSetEntry("Dexterity",	NLMISC::toString(c->EntityBase._PhysCharacs._PhysicalCharacteristics.find("Dexterity")->second));
-	job->charTblSetEntry("Will",		NLMISC::toString(c->EntityBase._PhysCharacs._PhysicalCharacteristics.find("Will")->second));
+	output->charTblSetEntry("Constitution",NLMISC::toString(c->EntityBase._PhysCharacs._PhysicalCharacteristics.find("Constitution")->second));
+	output->charTblSetEntry("Metabolism",	NLMISC::toString(c->EntityBase._PhysCharacs._PhysicalCharacteristics.find("Metabolism")->second));
+	output->charTblSetEntry("Intelligence",NLMISC::toString(c->EntityBase._PhysCharacs._PhysicalCharacteristics.find("Intelligence")->second));
+	output->charTblSetEntry("Wisdom",		NLMISC::toString(c->EntityBase._PhysCharacs._PhysicalCharacteristics.find("Wisdom")->second));
+	output->charTblSetEntry("Strength",	NLMISC::toString(c->EntityBase._PhysCharacs._PhysicalCharacteristics.find("Strength")->second));
+	output->charTblSetEntry("WellBalanced",NLMISC::toString(c->EntityBase._PhysCharacs._PhysicalCharacteristics.find("WellBalanced")->second));
+	output->charTblSetEntry("Dexterity",	NLMISC::toString(c->EntityBase._PhysCharacs._PhysicalCharacteristics.find("Dexterity")->second));
+	output->charTblSetEntry("Will",		NLMISC::toString(c->EntityBase._PhysCharacs._PhysicalCharacteristics.find("Will")->second));
 }
 
 INFO_EXTRACTOR(Stats,"hp, sap, sta, focus","HP,Stamina,Sap,Focus")
 {
-	job->charTblSetEntry("HP",		NLMISC::toString(c->EntityBase._PhysScores.PhysicalScores.find("HitPoints")->second.Current));
-	job->charTblSetEntry("Stamina",	NLMISC::toString(c->EntityBase._PhysScores.PhysicalScores.find("Stamina")->second.Current));
-	job->charTblSetEntry("Sap",		NLMISC::toString(c->EntityBase._PhysScores.PhysicalScores.find("Sap")->second.Current));
-	job->charTblSetEntry("Focus",	NLMISC::toString(c->EntityBase._PhysScores.PhysicalScores.find("Focus")->second.Current));
+	output->charTblSetEntry("HP",		NLMISC::toString(c->EntityBase._PhysScores.PhysicalScores.find("HitPoints")->second.Current));
+	output->charTblSetEntry("Stamina",	NLMISC::toString(c->EntityBase._PhysScores.PhysicalScores.find("Stamina")->second.Current));
+	output->charTblSetEntry("Sap",		NLMISC::toString(c->EntityBase._PhysScores.PhysicalScores.find("Sap")->second.Current));
+	output->charTblSetEntry("Focus",	NLMISC::toString(c->EntityBase._PhysScores.PhysicalScores.find("Focus")->second.Current));
 }
 
 INFO_EXTRACTOR(Fames,"main fame scores","Fyros,Kami,Karavan,Matis,Tryker,Zorai")
 {
-	job->charTblSetEntry("Fyros",	NLMISC::toString(c->_Fames._Fame.find(NLMISC::CSheetId("fyros.faction"))->second.Fame));
-	job->charTblSetEntry("Kami",	NLMISC::toString(c->_Fames._Fame.find(NLMISC::CSheetId("kami.faction"))->second.Fame));
-	job->charTblSetEntry("Karavan",	NLMISC::toString(c->_Fames._Fame.find(NLMISC::CSheetId("karavan.faction"))->second.Fame));
-	job->charTblSetEntry("Matis",	NLMISC::toString(c->_Fames._Fame.find(NLMISC::CSheetId("matis.faction"))->second.Fame));
-	job->charTblSetEntry("Tryker",	NLMISC::toString(c->_Fames._Fame.find(NLMISC::CSheetId("tryker.faction"))->second.Fame));
-	job->charTblSetEntry("Zorai",	NLMISC::toString(c->_Fames._Fame.find(NLMISC::CSheetId("zorai.faction"))->second.Fame));
+	output->charTblSetEntry("Fyros",	NLMISC::toString(c->_Fames._Fame.find(NLMISC::CSheetId("fyros.faction"))->second.Fame));
+	output->charTblSetEntry("Kami",	NLMISC::toString(c->_Fames._Fame.find(NLMISC::CSheetId("kami.faction"))->second.Fame));
+	output->charTblSetEntry("Karavan",	NLMISC::toString(c->_Fames._Fame.find(NLMISC::CSheetId("karavan.faction"))->second.Fame));
+	output->charTblSetEntry("Matis",	NLMISC::toString(c->_Fames._Fame.find(NLMISC::CSheetId("matis.faction"))->second.Fame));
+	output->charTblSetEntry("Tryker",	NLMISC::toString(c->_Fames._Fame.find(NLMISC::CSheetId("tryker.faction"))->second.Fame));
+	output->charTblSetEntry("Zorai",	NLMISC::toString(c->_Fames._Fame.find(NLMISC::CSheetId("zorai.faction"))->second.Fame));
 }
 
 INFO_EXTRACTOR(Civ,"declared civilization","civ")
 {
-	job->charTblSetEntry("civ",	c->DeclaredCiv);
+	output->charTblSetEntry("civ",	c->DeclaredCiv);
 }
 
 INFO_EXTRACTOR(Cult,"declared cult","cult")
 {
-	job->charTblSetEntry("cult", c->DeclaredCult);
+	output->charTblSetEntry("cult", c->DeclaredCult);
 }
 
 INFO_EXTRACTOR(DeathPenalty,"death penalty stats","Penalty,Nb_Deaths")
 {
-	job->charTblSetEntry("Penalty",	NLMISC::toString(c->_DeathPenalties._DeathXPToGain));
-	job->charTblSetEntry("Nb_Deaths",	NLMISC::toString(c->_DeathPenalties._NbDeath));
+	output->charTblSetEntry("Penalty",	NLMISC::toString(c->_DeathPenalties._DeathXPToGain));
+	output->charTblSetEntry("Nb_Deaths",	NLMISC::toString(c->_DeathPenalties._NbDeath));
 }
 
 INFO_EXTRACTOR(Rites,"frequency stats regarding rites","StartedRites,FinishedRites")
@@ -300,33 +313,33 @@ INFO_EXTRACTOR(Rites,"frequency stats regarding rites","StartedRites,FinishedRit
 		c->_EncycloChar._EncyCharAlbums[i].AlbumState;
 		for (uint32 j=0;j<c->_EncycloChar._EncyCharAlbums[i].Themas.size();++j)
 		{
-			job->freqTblAddEntry("encyclopedia_themes",NLMISC::toString("Theme_%02d_%02d_State %d",i,j,c->_EncycloChar._EncyCharAlbums[i].Themas[j].ThemaState));
+			output->freqTblAddEntry("encyclopedia_themes",NLMISC::toString("Theme_%02d_%02d_State %d",i,j,c->_EncycloChar._EncyCharAlbums[i].Themas[j].ThemaState));
 			uint32 bitCount=0;
 			uint32 bitMask=c->_EncycloChar._EncyCharAlbums[i].Themas[j].RiteTaskStatePacked;
 			for (uint32 k=bitMask;k!=0;k>>=2) if (k&3) ++bitCount;
-			job->freqTblAddEntry("encyclopedia_tasks",NLMISC::toString("Theme_%02d_%02d_Tasks %d%s",i,j,bitCount,(bitMask&1)?" ALL":""));
+			output->freqTblAddEntry("encyclopedia_tasks",NLMISC::toString("Theme_%02d_%02d_Tasks %d%s",i,j,bitCount,(bitMask&1)?" ALL":""));
 
 			startedRites+= (bitCount>0)?1:0;
 			finishedRites+= (bitMask&1)?1:0;
 		}
 	}
-	job->charTblSetEntry("StartedRites",NLMISC::toString(startedRites));
-	job->charTblSetEntry("FinishedRites",NLMISC::toString(finishedRites));
-	job->freqTblAddEntry("started_rites",NLMISC::toString(startedRites));
-	job->freqTblAddEntry("finished_rites",NLMISC::toString(finishedRites));
+	output->charTblSetEntry("StartedRites",NLMISC::toString(startedRites));
+	output->charTblSetEntry("FinishedRites",NLMISC::toString(finishedRites));
+	output->freqTblAddEntry("started_rites",NLMISC::toString(startedRites));
+	output->freqTblAddEntry("finished_rites",NLMISC::toString(finishedRites));
 }
 
 INFO_EXTRACTOR(SkillPoints,"skill points and related stats","spFight,ttlSpFight,minSpFight,spMagic,ttlSpMagic,minSpMagic,spCraft,ttlSpCraft,minSpCraft,spHarvest,ttlSpHarvest,minSpHarvest")
 {
-	job->charTblSetEntry("spFight",NLMISC::toString(c->SkillPoints.find("Fight")->second));
-	job->charTblSetEntry("spMagic",NLMISC::toString(c->SkillPoints.find("Magic")->second));
-	job->charTblSetEntry("spCraft",NLMISC::toString(c->SkillPoints.find("Craft")->second));
-	job->charTblSetEntry("spHarvest",NLMISC::toString(c->SkillPoints.find("Harvest")->second));
+	output->charTblSetEntry("spFight",NLMISC::toString(c->SkillPoints.find("Fight")->second));
+	output->charTblSetEntry("spMagic",NLMISC::toString(c->SkillPoints.find("Magic")->second));
+	output->charTblSetEntry("spCraft",NLMISC::toString(c->SkillPoints.find("Craft")->second));
+	output->charTblSetEntry("spHarvest",NLMISC::toString(c->SkillPoints.find("Harvest")->second));
 
-	job->charTblSetEntry("ttlSpFight",NLMISC::toString(c->SkillPoints.find("Fight")->second+c->SpentSkillPoints.find("Fight")->second));
-	job->charTblSetEntry("ttlSpMagic",NLMISC::toString(c->SkillPoints.find("Magic")->second+c->SpentSkillPoints.find("Magic")->second));
-	job->charTblSetEntry("ttlSpCraft",NLMISC::toString(c->SkillPoints.find("Craft")->second+c->SpentSkillPoints.find("Craft")->second));
-	job->charTblSetEntry("ttlSpHarvest",NLMISC::toString(c->SkillPoints.find("Harvest")->second+c->SpentSkillPoints.find("Harvest")->second));
+	output->charTblSetEntry("ttlSpFight",NLMISC::toString(c->SkillPoints.find("Fight")->second+c->SpentSkillPoints.find("Fight")->second));
+	output->charTblSetEntry("ttlSpMagic",NLMISC::toString(c->SkillPoints.find("Magic")->second+c->SpentSkillPoints.find("Magic")->second));
+	output->charTblSetEntry("ttlSpCraft",NLMISC::toString(c->SkillPoints.find("Craft")->second+c->SpentSkillPoints.find("Craft")->second));
+	output->charTblSetEntry("ttlSpHarvest",NLMISC::toString(c->SkillPoints.find("Harvest")->second+c->SpentSkillPoints.find("Harvest")->second));
 
 	sint32 ttlF=0;
 	sint32 ttlM=0;
@@ -372,13 +385,13 @@ INFO_EXTRACTOR(SkillPoints,"skill points and related stats","spFight,ttlSpFight,
 		}
 
 		if (result!=0 && (*it).second.Xp>0)
-			job->freqTblAddEntry("usedSkills",(*it).first);
+			output->freqTblAddEntry("usedSkills",(*it).first);
 	}
 
-	job->charTblSetEntry("minSpFight",NLMISC::toString(ttlF*10));
-	job->charTblSetEntry("minSpMagic",NLMISC::toString(ttlM*10));
-	job->charTblSetEntry("minSpCraft",NLMISC::toString(ttlC*10));
-	job->charTblSetEntry("minSpHarvest",NLMISC::toString(ttlH*10));
+	output->charTblSetEntry("minSpFight",NLMISC::toString(ttlF*10));
+	output->charTblSetEntry("minSpMagic",NLMISC::toString(ttlM*10));
+	output->charTblSetEntry("minSpCraft",NLMISC::toString(ttlC*10));
+	output->charTblSetEntry("minSpHarvest",NLMISC::toString(ttlH*10));
 }
 
 INFO_EXTRACTOR(HighestSkills,"Highest skills in each main branch","skill_best,skill_sf,skill_sm,skill_sc,skill_sh")
@@ -407,29 +420,29 @@ INFO_EXTRACTOR(HighestSkills,"Highest skills in each main branch","skill_best,sk
 			case 'C': if (bestC<=(*it).second.Current) bestC=(*it).second.Current; bestCName=(*it).first; break;
 			case 'H': if (bestH<=(*it).second.Current) bestH=(*it).second.Current; bestHName=(*it).first; break;
 		}
-		job->freqTblAddEntry("all_skills",NLMISC::toString("%s,%d",(*it).first.c_str(),(*it).second.Current));
+		output->freqTblAddEntry("all_skills",NLMISC::toString("%s,%d",(*it).first.c_str(),(*it).second.Current));
 	}
 	if (bestF>= bestM && bestF>=bestH && bestF>=bestC)		{ best=bestF; bestName=bestFName; }
 	else if (bestM>= bestF && bestM>=bestH && bestM>=bestC)	{ best=bestM; bestName=bestMName; }
 	else if (bestH>= bestF && bestH>=bestM && bestH>=bestC)	{ best=bestH; bestName=bestHName; }
 	else 												   	{ best=bestC; bestName=bestCName; }
 
-	job->charTblSetEntry("skill_best",NLMISC::toString(best));	// job->charTblSetEntry("name_best",bestName);
-	job->charTblSetEntry("skill_sf",NLMISC::toString(bestF));	// job->charTblSetEntry("name_sf",bestFName);
-	job->charTblSetEntry("skill_sm",NLMISC::toString(bestM));	// job->charTblSetEntry("name_sm",bestMName);
-	job->charTblSetEntry("skill_sc",NLMISC::toString(bestC));	// job->charTblSetEntry("name_sc",bestCName);
-	job->charTblSetEntry("skill_sh",NLMISC::toString(bestH));	// job->charTblSetEntry("name_sh",bestHName);
+	output->charTblSetEntry("skill_best",NLMISC::toString(best));	// output->charTblSetEntry("name_best",bestName);
+	output->charTblSetEntry("skill_sf",NLMISC::toString(bestF));	// output->charTblSetEntry("name_sf",bestFName);
+	output->charTblSetEntry("skill_sm",NLMISC::toString(bestM));	// output->charTblSetEntry("name_sm",bestMName);
+	output->charTblSetEntry("skill_sc",NLMISC::toString(bestC));	// output->charTblSetEntry("name_sc",bestCName);
+	output->charTblSetEntry("skill_sh",NLMISC::toString(bestH));	// output->charTblSetEntry("name_sh",bestHName);
 
-	job->freqTblAddEntry("best_skill",NLMISC::toString(best));
-	job->freqTblAddEntry("best_skill_sf",NLMISC::toString(bestF));
-	job->freqTblAddEntry("best_skill_sm",NLMISC::toString(bestM));
-	job->freqTblAddEntry("best_skill_sc",NLMISC::toString(bestC));
-	job->freqTblAddEntry("best_skill_sh",NLMISC::toString(bestH));
+	output->freqTblAddEntry("best_skill",NLMISC::toString(best));
+	output->freqTblAddEntry("best_skill_sf",NLMISC::toString(bestF));
+	output->freqTblAddEntry("best_skill_sm",NLMISC::toString(bestM));
+	output->freqTblAddEntry("best_skill_sc",NLMISC::toString(bestC));
+	output->freqTblAddEntry("best_skill_sh",NLMISC::toString(bestH));
 }
 
 INFO_EXTRACTOR(PlayerRoomAndPets,"The Id of the room and number of pets owned by the character","room,petSheet0,petPos0,petState0,petSheet1,petPos1,petState1,petSheet2,petPos2,petState2,petSheet3,petPos3,petState3")
 {
-	job->charTblSetEntry("room",NLMISC::toString(c->_PlayerRoom.Building));
+	output->charTblSetEntry("room",NLMISC::toString(c->_PlayerRoom.Building));
 
 	for (uint32 i=0;i<4;++i)
 	{
@@ -438,31 +451,31 @@ INFO_EXTRACTOR(PlayerRoomAndPets,"The Id of the room and number of pets owned by
 		const CStatsScanPetAnimal& pet= c->_PlayerPets.find(i)->second;
 		if (pet.PetSheetId!=NLMISC::CSheetId::Unknown)
 		{
-			job->charTblSetEntry("petSheet"+NLMISC::toString("%u",i),pet.PetSheetId.toString());
-			job->charTblSetEntry("petPos"+NLMISC::toString("%u",i),NLMISC::toString("(%u %u %u) / %s",pet.Landscape_X,pet.Landscape_Y,pet.Landscape_Z,NLMISC::toString(pet.StableAlias).c_str()));
-			job->charTblSetEntry("petState"+NLMISC::toString("%u",i),NLMISC::toString("%u / %u",pet.PetStatus,pet.DeathTick));
+			output->charTblSetEntry("petSheet"+NLMISC::toString("%u",i),pet.PetSheetId.toString());
+			output->charTblSetEntry("petPos"+NLMISC::toString("%u",i),NLMISC::toString("(%u %u %u) / %s",pet.Landscape_X,pet.Landscape_Y,pet.Landscape_Z,NLMISC::toString(pet.StableAlias).c_str()));
+			output->charTblSetEntry("petState"+NLMISC::toString("%u",i),NLMISC::toString("%u / %u",pet.PetStatus,pet.DeathTick));
 
-			job->freqTblAddEntry("stables",NLMISC::toString(pet.StableAlias));
+			output->freqTblAddEntry("stables",NLMISC::toString(pet.StableAlias));
 		}
 	}
 }
 
 INFO_EXTRACTOR(PlayerRoomStats,"The stats of number of players who have access to each room type","")
 {
-//	job->freqTblAddEntry("room",NLMISC::toString(c->_PlayerRoom.Building));
-	job->freqTblAddEntry("room",NLMISC::CSheetId(c->_PlayerRoom.Building).toString());
+//	output->freqTblAddEntry("room",NLMISC::toString(c->_PlayerRoom.Building));
+	output->freqTblAddEntry("room",NLMISC::CSheetId(c->_PlayerRoom.Building).toString());
 }
 
 INFO_EXTRACTOR(RespawnPointCount,"Number of respawn points","respawnPointCount")
 {
-	job->charTblSetEntry("respawnPointCount",NLMISC::toString(c->RespawnPoints.RespawnPoints.size()));
+	output->charTblSetEntry("respawnPointCount",NLMISC::toString(c->RespawnPoints.RespawnPoints.size()));
 }
 
 INFO_EXTRACTOR(RespawnPointStats,"Stats on number of players who have access to each of the respawn points","")
 {
 	for (uint32 i=0;i<c->RespawnPoints.RespawnPoints.size();++i)
 	{
-		job->freqTblAddEntry("respawn_points",c->RespawnPoints.RespawnPoints[i]);
+		output->freqTblAddEntry("respawn_points",c->RespawnPoints.RespawnPoints[i]);
 	}
 }
 
@@ -470,15 +483,15 @@ INFO_EXTRACTOR(StanzaStats,"Stats on number of players who know each stanza","")
 {
 	for (uint32 i=0;i<c->_KnownBricks.size();++i)
 	{
-		job->freqTblAddEntry("stanzas",c->_KnownBricks[i].toString());
+		output->freqTblAddEntry("stanzas",c->_KnownBricks[i].toString());
 	}
 }
 
 INFO_EXTRACTOR(VisPropStats,"Stats on race and visual props","")
 {
-	job->freqTblAddEntry("race_sex",c->EntityBase._Race+(c->EntityBase._Gender==0?"_Male":"_Female"));
-	job->freqTblAddEntry("hair",c->EntityBase._Race+(c->EntityBase._Gender==0?"_Male_":"_Female_")+NLMISC::toString(c->HairType));
-	job->freqTblAddEntry("tattoo",c->EntityBase._Race+(c->EntityBase._Gender==0?"_Male_":"_Female_")+NLMISC::toString(c->Tattoo));
+	output->freqTblAddEntry("race_sex",c->EntityBase._Race+(c->EntityBase._Gender==0?"_Male":"_Female"));
+	output->freqTblAddEntry("hair",c->EntityBase._Race+(c->EntityBase._Gender==0?"_Male_":"_Female_")+NLMISC::toString(c->HairType));
+	output->freqTblAddEntry("tattoo",c->EntityBase._Race+(c->EntityBase._Gender==0?"_Male_":"_Female_")+NLMISC::toString(c->Tattoo));
 }
 
 INFO_EXTRACTOR(FactionPoints,"The character's faction points","factPts")
@@ -507,6 +520,6 @@ INFO_EXTRACTOR(FactionPoints,"The character's faction points","factPts")
 		}
 	}		
 */
-	job->charTblSetEntry("factPts", NLMISC::toString(MaxFP));
-	job->freqTblAddEntry("best_faction", BestFaction);
+	output->charTblSetEntry("factPts", NLMISC::toString(MaxFP));
+	output->freqTblAddEntry("best_faction", BestFaction);
 }
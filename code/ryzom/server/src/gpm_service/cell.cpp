@@ -19,6 +19,10 @@
 #include "stdpch.h"
 #include "cell.h"
 
+#ifdef NL_HAS_SSE2
+#	include <emmintrin.h>
+#endif
+
 using namespace std;
 using namespace NLMISC;
 using namespace NLPACS;
@@ -37,9 +41,9 @@ CBlockMemory<CCell>			CCell::_CellAllocator;
 
 
 /*
- * Adds an entity to the cell
+ * Link an entity in the lists and arrays of the cell
  */
-void	CCell::add(CWorldEntity* entity)
+void	CCell::link(CWorldEntity* entity)
 {
 	// check entity is not null
 	nlassert(entity != NULL);
@@ -53,10 +57,12 @@ void	CCell::add(CWorldEntity* entity)
 	if (entity->getType() == CWorldEntity::Object)
 	{
 		_ObjectsList.insertAtHead(entity);
+		_ObjectsArrays.add(entity, (uint32)entity->WhoSeesMe(), entity->X(), entity->Y());
 	}
 	else
 	{
 		_EntitiesList.insertAtHead(entity);
+		_EntitiesArrays.add(entity, (uint32)entity->WhoSeesMe(), entity->X(), entity->Y());
 
 		if (entity->getType() == CWorldEntity::Player && entity->PlayerInfos != NULL)
 		{
@@ -64,9 +70,8 @@ void	CCell::add(CWorldEntity* entity)
 		}
 	}
 
-	// set CellPtr and Cell id
+	// set CellPtr
 	entity->CellPtr = this;
-	entity->Cell = _CellId;
 }
 
 
@@ -86,10 +91,12 @@ void	CCell::remove(CWorldEntity* entity)
 	if (entity->getType() == CWorldEntity::Object)
 	{
 		_ObjectsList.remove(entity);
+		_ObjectsArrays.remove(entity);
 	}
 	else
 	{
 		_EntitiesList.remove(entity);
+		_EntitiesArrays.remove(entity);
 
 		if (entity->getType() == CWorldEntity::Player && entity->PlayerInfos != NULL)
 		{
@@ -104,6 +111,137 @@ void	CCell::remove(CWorldEntity* entity)
 
 
 
+/*
+ * Fill the vision from entity arrays
+ */
+CVisionEntry*	CCell::addFromArrays(const CCellEntityArrays &arrays, CVisionEntry* fillPtr, CVisionEntry* endPtr, uint32 cellMask, uint32 distance, bool indoor, CWorldEntity *player)
+{
+	if (fillPtr >= endPtr)
+		return fillPtr;
+
+	uint32	indices[MAX_SEEN_ENTITIES+1];
+	uint	maxIndices = std::min((uint)(endPtr-fillPtr), (uint)(MAX_SEEN_ENTITIES+1));
+	uint	numIndices = arrays.select(cellMask, indoor, indoor ? player->X() : 0, indoor ? player->Y() : 0, indices, maxIndices);
+
+	uint	i;
+	for (i=0; i<numIndices; ++i)
+	{
+		fillPtr->Entity = arrays.entity(indices[i]);
+		fillPtr->Mask = cellMask & arrays.whoSeesMe(indices[i]);
+		fillPtr->Distance = distance;
+		++fillPtr;
+	}
+	return fillPtr;
+}
+
+
+
+
+/****************************************************************\
+ ****************************************************************
+							CCellEntityArrays
+ ****************************************************************
+\****************************************************************/
+
+/*
+ * Remove an entity (the last entity takes its place)
+ */
+void	CCellEntityArrays::remove(CWorldEntity *entity)
+{
+	uint	i = entity->CellArraysIndex;
+	nlassert(i < size() && _Entities[i] == entity);
+
+	uint	last = size()-1;
+	if (i != last)
+	{
+		_Entities[i] = _Entities[last];
+		_WhoSeesMe[i] = _WhoSeesMe[last];
+		_X[i] = _X[last];
+		_Y[i] = _Y[last];
+		_Entities[i]->CellArraysIndex = i;
+	}
+
+	_Entities.pop_back();
+	_WhoSeesMe.pop_back();
+	_X.pop_back();
+	_Y.pop_back();
+}
+
+/*
+ * Gather the values of the entities from the mirror
+ */
+void	CCellEntityArrays::refresh()
+{
+	uint	i;
+	for (i=0; i<size(); ++i)
+	{
+		const CWorldEntity	*entity = _Entities[i];
+		_WhoSeesMe[i] = (uint32)entity->WhoSeesMe();
+		_X[i] = entity->X();
+		_Y[i] = entity->Y();
+	}
+}
+
+/*
+ * Select the visible entities, from the end of the arrays
+ */
+uint	CCellEntityArrays::select(uint32 cellMask, bool indoor, sint32 playerX, sint32 playerY, uint32 *indices, uint maxIndices) const
+{
+	uint	numIndices = 0;
+	uint	i = size();
+
+#ifdef NL_HAS_SSE2
+	if (i >= 4)
+	{
+		const __m128i	mask = _mm_set1_epi32((sint32)cellMask);
+		const __m128i	zero = _mm_setzero_si128();
+		const __m128i	px = _mm_set1_epi32(playerX);
+		const __m128i	py = _mm_set1_epi32(playerY);
+		const __m128	maxDist = _mm_set1_ps(MAX_INDOOR_VISION_SQUARED_DISTANCE);
+
+		// 4 entities per iteration, from the end of the arrays
+		while (i >= 4 && numIndices < maxIndices)
+		{
+			i -= 4;
+
+			__m128i	seen = _mm_and_si128(_mm_loadu_si128((const __m128i*)&_WhoSeesMe[i]), mask);
+			uint	bits = (~_mm_movemask_ps(_mm_castsi128_ps(_mm_cmpeq_epi32(seen, zero)))) & 0xf;
+
+			if (indoor && bits != 0)
+			{
+				// same computation as the scalar version: integer difference, then float
+				__m128	dx = _mm_cvtepi32_ps(_mm_sub_epi32(px, _mm_loadu_si128((const __m128i*)&_X[i])));
+				__m128	dy = _mm_cvtepi32_ps(_mm_sub_epi32(py, _mm_loadu_si128((const __m128i*)&_Y[i])));
+				__m128	dist = _mm_add_ps(_mm_mul_ps(dx, dx), _mm_mul_ps(dy, dy));
+				bits &= ~_mm_movemask_ps(_mm_cmpgt_ps(dist, maxDist));
+			}
+
+			while (bits != 0 && numIndices < maxIndices)
+			{
+				uint	bit = (bits & 0xc) ? ((bits & 0x8) ? 3 : 2) : ((bits & 0x2) ? 1 : 0);
+				indices[numIndices++] = i+bit;
+				bits &= ~(1 << bit);
+			}
+		}
+	}
+#endif
+
+	// remaining entities (or all of them without SSE2)
+	while (i > 0 && numIndices < maxIndices)
+	{
+		--i;
+		if ((cellMask & _WhoSeesMe[i]) == 0)
+			continue;
+		if (indoor && (float)(playerX-_X[i])*(float)(playerX-_X[i]) + (float)(playerY-_Y[i])*(float)(playerY-_Y[i]) > MAX_INDOOR_VISION_SQUARED_DISTANCE)
+			continue;
+		indices[numIndices++] = i;
+	}
+
+	return numIndices;
+}
+
+
+
 
 
 
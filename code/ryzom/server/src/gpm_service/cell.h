@@ -24,6 +24,72 @@
 
 #include "world_entity.h"
 
+#include <vector>
+
+
+/// Max squared distance (in mm²) to see an entity in an indoor cell
+const float	MAX_INDOOR_VISION_SQUARED_DISTANCE = 15625000000.0f;
+
+
+/**
+ * Contiguous copy of the entities of a cell (pointer, WhoSeesMe, X, Y), used to filter the
+ * entities seen from a cell without walking the entity list and reading the mirror for each
+ * entity.
+ *
+ * The membership is updated by CCell::add() and CCell::remove(), in O(1): an entity is appended,
+ * and a removed entity is replaced by the last one (CWorldEntity::CellArraysIndex is the index
+ * of an entity in the arrays of its cell). Therefore the order of the arrays is not the list
+ * order: when more entities than MAX_SEEN_ENTITIES are visible from a cell, the entities kept
+ * in the vision may differ from the ones kept from the lists.
+ * The values are gathered from the mirror by refresh(), once per tick for the cells in vision
+ * range of a computed cell.
+ */
+class CCellEntityArrays
+{
+public:
+
+	/// Return the number of entities
+	uint			size() const						{ return (uint)_Entities.size(); }
+
+	/// Append an entity
+	void			add( CWorldEntity *entity, uint32 whoSeesMe, sint32 x, sint32 y )
+	{
+		entity->CellArraysIndex = size();
+		_Entities.push_back( entity );
+		_WhoSeesMe.push_back( whoSeesMe );
+		_X.push_back( x );
+		_Y.push_back( y );
+	}
+
+	/// Remove an entity (the last entity takes its place)
+	void			remove( CWorldEntity *entity );
+
+	/// Gather the values of the entities from the mirror
+	void			refresh();
+
+	/// Get an entity
+	CWorldEntity	*entity( uint index ) const			{ return _Entities[index]; }
+
+	/// Get the WhoSeesMe value of an entity, as of the last refresh()
+	uint32			whoSeesMe( uint index ) const		{ return _WhoSeesMe[index]; }
+
+	/**
+	 * Select at most maxIndices entities for which cellMask & WhoSeesMe != 0 and, if indoor, the
+	 * distance to (playerX, playerY) is within MAX_INDOOR_VISION_SQUARED_DISTANCE. The arrays are
+	 * scanned from the end (most recently added first). Return the number of indices written.
+	 * Uses SSE2 when available (4 entities per iteration).
+	 */
+	uint			select( uint32 cellMask, bool indoor, sint32 playerX, sint32 playerY, uint32 *indices, uint maxIndices ) const;
+
+private:
+
+	std::vector<CWorldEntity*>	_Entities;
+	std::vector<uint32>			_WhoSeesMe;
+	std::vector<sint32>			_X;
+	std::vector<sint32>			_Y;
+};
+
+
 /**
  * CCell contained entity in this cell and updated entity
  * \author Alain Saffray
@@ -34,12 +100,13 @@ class CCell
 {
 public:
 	/// default constructor
-	CCell() : _LastVisionUpdate(0) {}
+	CCell() : _LastVisionUpdate(0), _LastArraysRefresh(0) {}
 
 	/// initialisation
 	void	init( sint32 cellId )
 	{ 
 		_LastVisionUpdate = 0;
+		_LastArraysRefresh = 0;
 		_CellId = cellId;
 	}
 
@@ -50,6 +117,7 @@ public:
 		nlassert(y <= 32767);
 
 		_LastVisionUpdate = 0;
+		_LastArraysRefresh = 0;
 		_CellId = (x<<16) + y;
 	}
 
@@ -62,7 +130,11 @@ public:
 	 *
 	 * \param entity pointer to the entity to add
 	 */
-	void	add(CWorldEntity* entity);
+	void	add(CWorldEntity* entity)
+	{
+		link(entity);
+		entity->Cell = _CellId;
+	}
 
 	/**
 	 * Removes an entity from the cell
@@ -123,7 +195,7 @@ public:
 		while (ent != NULL && fillPtr < endPtr)
 		{
 			sint32	mask = cellMask & (sint32)(ent->WhoSeesMe);
-			if (mask && indoor && (float)(player->X()-ent->X())*(float)(player->X()-ent->X()) + (float)(player->Y()-ent->Y())*(float)(player->Y()-ent->Y()) > 15625000000)
+			if (mask && indoor && (float)(player->X()-ent->X())*(float)(player->X()-ent->X()) + (float)(player->Y()-ent->Y())*(float)(player->Y()-ent->Y()) > MAX_INDOOR_VISION_SQUARED_DISTANCE)
 				mask = 0;
 			
 			//if (!ent->IsInvisibleToPlayer && mask != 0)
@@ -145,7 +217,7 @@ public:
 		while (ent != NULL && fillPtr < endPtr)
 		{
 			sint32	mask = cellMask & (sint32)(ent->WhoSeesMe);
-			if (mask && indoor && (float)(player->X()-ent->X())*(float)(player->X()-ent->X()) + (float)(player->Y()-ent->Y())*(float)(player->Y()-ent->Y()) > 15625000000)
+			if (mask && indoor && (float)(player->X()-ent->X())*(float)(player->X()-ent->X()) + (float)(player->Y()-ent->Y())*(float)(player->Y()-ent->Y()) > MAX_INDOOR_VISION_SQUARED_DISTANCE)
 				mask = 0;
 
 			//if (!ent->IsInvisibleToPlayer && mask != 0)
@@ -161,6 +233,27 @@ public:
 		return fillPtr;
 	}
 
+	/// Same as addEntities(), from the entity arrays (refreshArrays() must have been called in the tick)
+	CVisionEntry*	addEntitiesFromArrays(CVisionEntry* fillPtr, CVisionEntry* endPtr, uint32 cellMask, uint32 distance, bool indoor, CWorldEntity *player) const
+	{
+		return addFromArrays(_EntitiesArrays, fillPtr, endPtr, cellMask, distance, indoor, player);
+	}
+	/// Same as addObjects(), from the object arrays (refreshArrays() must have been called in the tick)
+	CVisionEntry*	addObjectsFromArrays(CVisionEntry* fillPtr, CVisionEntry* endPtr, uint32 cellMask, uint32 distance, bool indoor, CWorldEntity *player) const
+	{
+		return addFromArrays(_ObjectsArrays, fillPtr, endPtr, cellMask, distance, indoor, player);
+	}
+
+	/// Gather the values of the entity arrays from the mirror, once per tick
+	void				refreshArrays(NLMISC::TGameCycle gc)
+	{
+		if (_LastArraysRefresh == gc)
+			return;
+		_LastArraysRefresh = gc;
+		_EntitiesArrays.refresh();
+		_ObjectsArrays.refresh();
+	}
+
 	void				setVisionUpdateCycle(NLMISC::TGameCycle gc) { _LastVisionUpdate = gc; }
 	NLMISC::TGameCycle	visionUpdateCycle() { return _LastVisionUpdate; }
 
@@ -176,16 +269,28 @@ private:
 	//friend void	CWorldEntity::removeFromCellAsObject();
 	friend class CWorldPositionManager;
 
+	/// Link an entity in the lists and arrays of the cell, without setting its Cell property (see add())
+	void	link(CWorldEntity* entity);
+
 	sint32							_CellId;
 
 	TEntityList						_EntitiesList;		// visible moving entities in cell
 	TEntityList						_ObjectsList;		// objects in cell
 	CObjectList<CPlayerInfos>		_PlayersList;		// players in cell
+
+	CCellEntityArrays				_EntitiesArrays;	// same content as _EntitiesList, in arrays
+	CCellEntityArrays				_ObjectsArrays;		// same content as _ObjectsList, in arrays
 //	TEntityList						_InvisiblesList;	// invisible entities in cell
 
 	/// last vision update tick for this cell
 	NLMISC::TGameCycle				_LastVisionUpdate;
 
+	/// last tick the values of the arrays were gathered
+	NLMISC::TGameCycle				_LastArraysRefresh;
+
+	/// Fill the vision from entity arrays
+	static CVisionEntry*	addFromArrays(const CCellEntityArrays &arrays, CVisionEntry* fillPtr, CVisionEntry* endPtr, uint32 cellMask, uint32 distance, bool indoor, CWorldEntity *player);
+
 public:
 	/// Creates a new entity (new equivalent). This must be initialised later using init();
 	static CCell	*create()				{ return _CellAllocator.allocate(); }
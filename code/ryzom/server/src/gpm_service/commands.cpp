@@ -638,6 +638,36 @@ NLMISC_COMMAND(displayVisionCells, "display VisionCells info", "")
 
 	return true;
 }
+
+NLMISC_COMMAND(recordEntityDistribution, "save the position and visibility of the entities linked in cells (for benchCellVision)", "filename")
+{
+	if (args.size() != 1)
+		return false;
+
+	CWorldPositionManager::recordEntityDistribution(args[0], &log);
+
+	return true;
+}
+
+NLMISC_COMMAND(benchCellVision, "compare the cell visions computed from the entity lists and from the entity arrays", "[<distributionFile>|<nbRandomEntities>=20000] [<nbPasses>=10]")
+{
+	if (args.size() > 2)
+		return false;
+
+	string	filename;
+	uint	nbEntities = 20000;
+	uint	nbPasses = 10;
+	if (args.size() > 0 && !NLMISC::fromString(args[0], nbEntities))
+		filename = args[0];
+	if (args.size() > 1)
+		NLMISC::fromString(args[1], nbPasses);
+	if (nbPasses == 0)
+		nbPasses = 1;
+
+	CWorldPositionManager::benchCellVision(filename, nbEntities, nbPasses, &log);
+
+	return true;
+}
 //
 
 
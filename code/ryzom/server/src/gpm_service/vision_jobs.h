@@ -0,0 +1,146 @@
+// Ryzom - MMORPG Framework <http://dev.ryzom.com/projects/ryzom/>
+// Copyright (C) 2010  Winch Gate Property Limited
+//
+// This program is free software: you can redistribute it and/or modify
+// it under the terms of the GNU Affero General Public License as
+// published by the Free Software Foundation, either version 3 of the
+// License, or (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU Affero General Public License for more details.
+//
+// You should have received a copy of the GNU Affero General Public License
+// along with this program.  If not, see <http://www.gnu.org/licenses/>.
+
+
+
+#ifndef NL_VISION_JOBS_H
+#define NL_VISION_JOBS_H
+
+#include "nel/misc/types_nl.h"
+
+#include "game_share/player_vision_delta.h"
+
+#include "gpm_defs.h"
+#include "world_entity.h"
+
+#include <vector>
+#include <algorithm>
+
+
+/**
+ * Vision of a player, computed by a vision worker then applied by the main thread.
+ *
+ * The worker only writes the job and the CPlayerInfos of the player. Everything that is
+ * shared between players (closest player, counters, reference counts of the slots) is
+ * recorded in the job and applied by CWorldPositionManager::applyPlayerVisionJob(), in the
+ * order of the jobs, which gives the same result as the former serial computation.
+ */
+struct CPlayerVisionJob
+{
+	/// The player
+	CWorldEntity				*Entity;
+
+	/// Vision of the cell of the player (belongs to the cell job)
+	const CVisionEntry			*CellVision;
+	uint						NumEntities;
+
+	/// False if the vision of the player is not processed (see CWorldPositionManager::computePlayerVisionJob())
+	bool						Processed;
+
+	/// Delta to send to the front-end
+	CPlayerVisionDelta			Delta;
+
+	/// New content of the slots of the player (copied to CPlayerInfos::Slots when applied)
+	CWorldEntity				*Slots[MAX_SEEN_ENTITIES];
+
+	/// Entities removed from the slots of the player, then entities added
+	std::vector<CWorldEntity*>	EntitiesReleased;
+	std::vector<CWorldEntity*>	EntitiesAdded;
+};
+
+
+/**
+ * Vision of a cell, computed once for the players of the cell processed in the tick.
+ */
+struct CCellVisionJob
+{
+	CCellVisionJob() : Cell(NULL), Player(NULL), FirstPlayerJob(0), NbPlayerJobs(0), NumEntities(0) {}
+
+	/// The cell and the first player of the cell (used for the indoor distance check)
+	CCell						*Cell;
+	CWorldEntity				*Player;
+
+	/// Range of the player jobs of the cell
+	uint						FirstPlayerJob;
+	uint						NbPlayerJobs;
+
+	/// Entities seen from the cell (MAX_SEEN_ENTITIES+1, allocated once)
+	std::vector<CVisionEntry>	CellVision;
+	uint						NumEntities;
+};
+
+
+/**
+ * Temporary flags of a vision worker, indexed by the entity row.
+ * They replace the flags formerly stored in CWorldEntity, that several workers would write
+ * at the same time. A flag is set if its stamp is the current generation, which changes
+ * for each player, so that the flags do not need to be cleared between two players.
+ */
+class CVisionWorkspace
+{
+public:
+
+	enum TFlag { InVision, ControlInVision, ParentInVision, NbFlags };
+
+	/// Constructor
+	CVisionWorkspace() : _Generation(0) {}
+
+	/// Clear all the flags (call before processing a player)
+	void			nextPlayer()
+	{
+		++_Generation;
+		if ( _Generation == 0 )
+		{
+			// Wrap around: really clear the stamps
+			for ( uint f=0; f!=NbFlags; ++f )
+				std::fill( _Stamps[f].begin(), _Stamps[f].end(), 0 );
+			_Generation = 1;
+		}
+	}
+
+	/// Set or clear a flag
+	void			set( TFlag flag, const CWorldEntity *e, bool value )
+	{
+		uint32 index = e->Index.getIndex();
+		if ( index >= _Stamps[flag].size() )
+		{
+			if ( ! value )
+				return;
+			_Stamps[flag].resize( index + 1 + index/2, 0 );
+		}
+		_Stamps[flag][index] = value ? _Generation : 0;
+	}
+
+	/// Test a flag
+	bool			test( TFlag flag, const CWorldEntity *e ) const
+	{
+		uint32 index = e->Index.getIndex();
+		return (index < _Stamps[flag].size()) && (_Stamps[flag][index] == _Generation);
+	}
+
+	/// Entities with a controller or a parent in the vision of the player (temporary)
+	std::vector< std::pair<uint, CWorldEntity*> >	EntitiesLinked;
+
+private:
+
+	std::vector<uint32>	_Stamps [NbFlags];
+	uint32				_Generation;
+};
+
+
+#endif // NL_VISION_JOBS_H
+
+/* End of vision_jobs.h */
@@ -110,6 +110,42 @@ void	CWorldEntity::init( const CEntityId& id, const TDataSetRow &index )
 //	else
 //		Cell = -1;
 
+	VisionCounter = (uint8)0x0;
+
+	initMembers(id);
+
+} // CWorldEntity constructor
+
+/****************************************************************\
+						initOffline
+\****************************************************************/
+void	CWorldEntity::initOffline( const CEntityId& id, TYPE_POSX x, TYPE_POSY y, TYPE_WHO_SEES_ME whoSeesMe )
+{
+	Id = id;
+
+	// not in the mirror, the values used by the vision are stored locally
+	X.tempStore(x);
+	Y.tempStore(y);
+	WhoSeesMe.tempStore(whoSeesMe);
+
+	initMembers(id);
+}
+
+/****************************************************************\
+						releaseOffline
+\****************************************************************/
+void	CWorldEntity::releaseOffline()
+{
+	X.tempDelete();
+	Y.tempDelete();
+	WhoSeesMe.tempDelete();
+}
+
+/****************************************************************\
+						initMembers
+\****************************************************************/
+void	CWorldEntity::initMembers( const CEntityId& id )
+{
 	//IsStaticObject = false;
 	//IsInvisible = false;
 	//IsAgent = false;
@@ -120,8 +156,6 @@ void	CWorldEntity::init( const CEntityId& id, const TDataSetRow &index )
 	TickLock = 0;
 
 	TempVisionState = false;
-	TempControlInVision = false;
-	TempParentInVision = false;
 
 	HasVision = false;
 
@@ -141,11 +175,11 @@ void	CWorldEntity::init( const CEntityId& id, const TDataSetRow &index )
 	ForceUsePrimitive = false;
 	ForceDontUsePrimitive = false;
 
-	VisionCounter = (uint8)0x0;
 	PlayersSeeingMe = 0;
 	ClosestPlayer = NULL;
 
 	CellPtr = NULL;
+	CellArraysIndex = 0;
 
 	PatatEntryIndex = 0;
 
@@ -175,8 +209,7 @@ void	CWorldEntity::init( const CEntityId& id, const TDataSetRow &index )
 	//WhoSeesMe = 0xffffffff;
 
 	CheckMotion = true;
-
-} // CWorldEntity constructor
+}
 
 /****************************************************************\
 			CWorldEntity destructor
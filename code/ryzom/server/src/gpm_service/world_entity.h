@@ -108,6 +108,7 @@ public:
 	uint32											PatatEntryIndex;		// The patat entry for the _PatatSubscribeManager
 
 	CCell											*CellPtr;				// pointer on cell where entity is	
+	uint32											CellArraysIndex;		// index in the entity arrays of the cell (see CCellEntityArrays)
 
 	TWorldEntityList::iterator						ListIterator;			// Iterator on entity in world entity list
 	TWorldEntityList::iterator						PrimIterator;			// Iterator on entity in prmitived entity list
@@ -135,9 +136,7 @@ public:
 
 	std::vector<CEntitySheetId>						Content;
 
-	bool											TempVisionState;		// temporary flag for vision delta, telling if the entity is now visible
-	bool											TempControlInVision;	// temporary flag for vision delta, telling if the controller entity (if any) is in vision
-	bool											TempParentInVision;		// temporary flag for vision delta, telling if the parent (controlled) entity (if any) is in vision
+	bool											TempVisionState;		// temporary flag for the entities around computation, telling if the entity is now visible
 
 	sint32											RefCounter;				// Number of references on this entity -- used by smart pointer
 
@@ -153,6 +152,16 @@ public:
 	 */
 	void	init( const NLMISC::CEntityId& id, const TDataSetRow &index );
 
+	/**
+	 * Init an entity that is not in the mirror (used by CWorldPositionManager::benchCellVision()).
+	 * Only X, Y and WhoSeesMe can be read, they are in temporary storage: call releaseOffline()
+	 * before freeing the entity.
+	 */
+	void	initOffline( const NLMISC::CEntityId& id, TYPE_POSX x, TYPE_POSY y, TYPE_WHO_SEES_ME whoSeesMe );
+
+	/// Delete the temporary storage of an entity initialised by initOffline()
+	void	releaseOffline();
+
 	/**
 	 * Display debug
 	 */
@@ -308,6 +317,9 @@ protected:
 	 */
 	CWorldEntity() {}
 
+	/// Init the members that are not in the mirror
+	void	initMembers( const NLMISC::CEntityId& id );
+
 private:
 
 	/// Static cell allocator
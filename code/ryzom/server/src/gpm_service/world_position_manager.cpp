@@ -23,6 +23,7 @@
 #include "nel/misc/matrix.h"
 #include "nel/misc/aabbox.h"
 #include "nel/misc/variable.h"
+#include "nel/misc/random.h"
 
 //// Nel 3d
 //#include "nel/3d/u_instance_group.h"
@@ -84,6 +85,10 @@ sint			NbTicksInFuture2 = 0;
 CVariable<double>				SecuritySpeedFactor("gpms","SecuritySpeedFactor", "Security Margin For Player Speed", 1.0, 0, true);
 CVariable<bool>					VerboseSpeedAbuse("gpms", "VerboseSpeedAbuse", "Allows GPMS to log speed abuses", false, 0, true);
 
+static void cbNbVisionWorkersChanged( IVariable &var );
+CVariable<bool>					VisionCellArrays("gpms", "VisionCellArrays", "Compute the cell visions from the entity arrays of the cells instead of the entity lists", true, 0, true);
+CVariable<uint32>				NbVisionWorkers("gpms", "NbVisionWorkers", "Number of threads computing the player visions (1 = main thread only)", 1, 0, true, cbNbVisionWorkersChanged);
+
 CGenericXmlMsgHeaderManager		GenericXmlMsgManager;
 
 
@@ -156,6 +161,13 @@ uint8													CWorldPositionManager::_NbDynamicWorldImages;	// Number of dyn
 uint8													CWorldPositionManager::_FirstDynamicWorldImage;	// First dynamique world image;
 uint8													CWorldPositionManager::_CurrentWorldImage;		// Current world image
 uint16													CWorldPositionManager::_NbVisionPerTick = 200;
+NLMISC::CWorkerPool										CWorldPositionManager::_VisionWorkers;
+std::vector<CVisionWorkspace>							CWorldPositionManager::_VisionWorkspaces(1);
+std::vector<CCellVisionJob>								CWorldPositionManager::_CellVisionJobs;
+uint													CWorldPositionManager::_NbCellVisionJobs = 0;
+std::vector<CPlayerVisionJob>							CWorldPositionManager::_PlayerVisionJobs;
+uint													CWorldPositionManager::_NbPlayerVisionJobs = 0;
+bool													CWorldPositionManager::_UseCellArrays = true;
 
 //
 CPatatSubscribeManager									CWorldPositionManager::_PatatSubscribeManager;
@@ -233,6 +245,8 @@ void CWorldPositionManager::init( uint32 nbCellX, uint32 nbCellY, uint32 visionD
 
 	GenericXmlMsgManager.init(CPath::lookup("msg.xml"));
 
+	setNbVisionWorkers(NbVisionWorkers.get());
+
 } // constructor CWorldPositionManager
 
 
@@ -786,6 +800,8 @@ void CWorldPositionManager::release( )
 	// ANTIBUG: avoids gpms to assert on release (in CBlockMemory::purge())
 	NL3D_BlockMemoryAssertOnPurge = false;
 
+	_VisionWorkers.release();
+
 	// free entities
 	TWorldEntityContainer::iterator		ite;
 	while (!_EntitiesInWorld.empty())
@@ -1377,15 +1393,43 @@ void	CWorldPositionManager::updateMaxVisions()
 }
 
 
+/****************************************************************\
+						vision jobs
+\****************************************************************/
+class CCellVisionWorkerJobs : public IWorkerJobs
+{
+public:
+	virtual void	runJob(uint jobIndex, uint workerIndex)
+	{
+		CWorldPositionManager::runCellVisionJob(CWorldPositionManager::_CellVisionJobs[jobIndex], CWorldPositionManager::_VisionWorkspaces[workerIndex]);
+	}
+};
+
+static void cbNbVisionWorkersChanged( IVariable &var )
+{
+	CWorldPositionManager::setNbVisionWorkers(NbVisionWorkers.get());
+}
+
+/****************************************************************\
+						setNbVisionWorkers()
+\****************************************************************/
+void	CWorldPositionManager::setNbVisionWorkers( uint nbWorkers )
+{
+	nbWorkers = std::max(nbWorkers, (uint)1);
+	if (nbWorkers == _VisionWorkers.nbWorkers())
+		return;
+
+	_VisionWorkers.init(nbWorkers);
+	_VisionWorkspaces.resize(nbWorkers);
+	nlinfo("Visions computed by %u threads", nbWorkers);
+}
+
 /****************************************************************\
 						computeVision()
 \****************************************************************/
 void	CWorldPositionManager::computeVision()
 {
 	STOP_IF(IsRingShard,"Illegal use of CWorldPositionManager on ring shard");
-	//static pair<CWorldEntity*, sint32>				cellVisionArray[MAX_SEEN_ENTITIES+1];	// sint32 used for masking
-	static CVisionEntry				cellVisionArray[MAX_SEEN_ENTITIES+1];	// sint32 used for masking
-	uint							numEntities;
 	TMapFrontEndData::iterator		itFE;
 	
 	{
@@ -1451,11 +1495,13 @@ void	CWorldPositionManager::computeVision()
 	//
 
 
-	//
+	// select the cells and their players to update in this tick
 	TPlayerList::iterator	itpl = _UpdatePlayerList.begin();
 	sint					numVision = 0;
 	sint					maxVision = std::min((sint)_TotalPlayers, (sint)_NbVisionPerTick);
 
+	_NbCellVisionJobs = 0;
+	_NbPlayerVisionJobs = 0;
 	while (numVision < maxVision && itpl != _UpdatePlayerList.end())
 	{
 		CPlayerInfos	*player = *itpl;
@@ -1473,7 +1519,16 @@ void	CWorldPositionManager::computeVision()
 			break;
 
 		cell->setVisionUpdateCycle(CTickEventHandler::getGameCycle());
-		H_TIME(ComputeCellVision, computeCellVision(cell, cellVisionArray, numEntities, player->Entity););
+
+		if (_NbCellVisionJobs == _CellVisionJobs.size())
+		{
+			_CellVisionJobs.resize(_NbCellVisionJobs+1);
+			_CellVisionJobs.back().CellVision.resize(MAX_SEEN_ENTITIES+1);
+		}
+		CCellVisionJob	&cellJob = _CellVisionJobs[_NbCellVisionJobs++];
+		cellJob.Cell = cell;
+		cellJob.Player = player->Entity;
+		cellJob.FirstPlayerJob = _NbPlayerVisionJobs;
 
 		CPlayerInfos	*plv;
 		for (plv=cell->getPlayersList(); plv!=NULL; plv=plv->Next)
@@ -1484,7 +1539,9 @@ void	CWorldPositionManager::computeVision()
 				continue;
 
 			// else set cell vision to the player
-			H_TIME(SetVisionToPlayer, setCellVisionToEntity(plv->Entity, cellVisionArray, numEntities););
+			if (_NbPlayerVisionJobs == _PlayerVisionJobs.size())
+				_PlayerVisionJobs.resize(_NbPlayerVisionJobs+1);
+			_PlayerVisionJobs[_NbPlayerVisionJobs++].Entity = plv->Entity;
 			++numVision;
 			plv->LastVisionTick = CTickEventHandler::getGameCycle();
 
@@ -1497,13 +1554,40 @@ void	CWorldPositionManager::computeVision()
 			else
 				updateVisionState(plv->ItUpdatePlayer);
 		}
+
+		cellJob.NbPlayerJobs = _NbPlayerVisionJobs - cellJob.FirstPlayerJob;
+	}
+
+	// gather the entity arrays read by the jobs (once per tick for each cell, whatever the number of cells that see it)
+	_UseCellArrays = VisionCellArrays.get();
+	if (_UseCellArrays)
+	{
+		H_AUTO(RefreshCellArrays);
+		const NLMISC::TGameCycle	gc = CTickEventHandler::getGameCycle();
+		for (uint i=0; i!=_NbCellVisionJobs; ++i)
+			if (_CellVisionJobs[i].NbPlayerJobs != 0)
+				refreshCellArraysInVision(_CellVisionJobs[i].Cell, gc);
+	}
+
+	// compute the visions (read-only for the data shared between players, so the cells can be spread on the workers)
+	{
+		H_AUTO(ComputeVisionJobs);
+		CCellVisionWorkerJobs	jobs;
+		_VisionWorkers.run(jobs, _NbCellVisionJobs);
+	}
+
+	// then apply them in the order of selection, as if they were computed one after the other
+	{
+		H_AUTO(ApplyVisionJobs);
+		for (uint i=0; i!=_NbPlayerVisionJobs; ++i)
+			applyPlayerVisionJob(_PlayerVisionJobs[i]);
 	}
 
 	// treat vision for players that are no more in a cell
 	// all visions are treated in one tick (assuming there aren't many players in this case and it is quite fast)
 	while (_OutOfVisionEntities.getHead() != NULL)
 	{
-		setCellVisionToEntity(_OutOfVisionEntities.getHead(), cellVisionArray, 0);
+		setCellVisionToEntity(_OutOfVisionEntities.getHead(), NULL, 0);
 		_OutOfVisionEntities.remove(_OutOfVisionEntities.getHead());
 	}
 
@@ -1656,7 +1740,10 @@ void	CWorldPositionManager::computeCellVision( CCell *cell, CVisionEntry* entiti
 	// First adds objects
 	fillPtr = entitiesSeenFromCell;
 	endPtr = entitiesSeenFromCell+MAX_SEEN_OBJECTS;
-	fillPtr = cell->addObjects(fillPtr, endPtr, centerCellMask, 0, cell->isIndoor(), player);
+	if (_UseCellArrays)
+		fillPtr = cell->addObjectsFromArrays(fillPtr, endPtr, centerCellMask, 0, cell->isIndoor(), player);
+	else
+		fillPtr = cell->addObjects(fillPtr, endPtr, centerCellMask, 0, cell->isIndoor(), player);
 
 	// if the cell has vision on other cells
 	if (!cell->isIndoor())
@@ -1677,6 +1764,15 @@ void	CWorldPositionManager::computeCellVision( CCell *cell, CVisionEntry* entiti
 				continue;
 			}
 
+			if (_UseCellArrays)
+			{
+				fillPtr = pCell->addObjectsFromArrays(fillPtr, endPtr, (*offsetPtr).Mask, offsetPtr->Distance, false, NULL);
+				if (fillPtr >= endPtr)
+					break;
+				++offsetPtr;
+				continue;
+			}
+
 			CWorldEntity	*ent = pCell->getObjectsList();
 			while (ent != NULL && fillPtr < endPtr)
 			{
@@ -1706,7 +1802,10 @@ void	CWorldPositionManager::computeCellVision( CCell *cell, CVisionEntry* entiti
 
 	// then adds entities
 	endPtr = entitiesSeenFromCell+MAX_SEEN_ENTITIES;
-	fillPtr = cell->addEntities(fillPtr, endPtr, centerCellMask, 0, cell->isIndoor(), player);
+	if (_UseCellArrays)
+		fillPtr = cell->addEntitiesFromArrays(fillPtr, endPtr, centerCellMask, 0, cell->isIndoor(), player);
+	else
+		fillPtr = cell->addEntities(fillPtr, endPtr, centerCellMask, 0, cell->isIndoor(), player);
 
 	// if the cell has vision on other cells
 	if (!cell->isIndoor())
@@ -1726,6 +1825,15 @@ void	CWorldPositionManager::computeCellVision( CCell *cell, CVisionEntry* entiti
 				continue;
 			}
 
+			if (_UseCellArrays)
+			{
+				fillPtr = pCell->addEntitiesFromArrays(fillPtr, endPtr, (*offsetPtr).Mask, offsetPtr->Distance, false, NULL);
+				if (fillPtr >= endPtr)
+					break;
+				++offsetPtr;
+				continue;
+			}
+
 			CWorldEntity	*ent = pCell->getEntitiesList();
 			while (ent != NULL && fillPtr < endPtr)
 			{
@@ -1755,12 +1863,71 @@ void	CWorldPositionManager::computeCellVision( CCell *cell, CVisionEntry* entiti
 	numEntities = (uint)(fillPtr-entitiesSeenFromCell);
 }
 
+/****************************************************************\
+						refreshCellArraysInVision()
+\****************************************************************/
+void	CWorldPositionManager::refreshCellArraysInVision( CCell *cell, NLMISC::TGameCycle gc )
+{
+	cell->refreshArrays(gc);
+
+	// indoor cells do not see other cells
+	if (cell->isIndoor())
+		return;
+
+	// _ObjectVisionCellOffsets is a subset of _VisionCellOffsets
+	CCell	**centerCell = _WorldCellsEffectiveMap+getCellOffset(cell->x(), cell->y());
+	uint	i;
+	for (i=0; i<_VisionCellOffsets.size(); ++i)
+	{
+		CCell	*pCell = centerCell[ _VisionCellOffsets[i].Offset ];
+		if (pCell != NULL)
+			pCell->refreshArrays(gc);
+	}
+}
+
+/****************************************************************\
+						runCellVisionJob()
+\****************************************************************/
+void	CWorldPositionManager::runCellVisionJob( CCellVisionJob &cellJob, CVisionWorkspace &workspace )
+{
+	// no player of the cell was selected (front-end quotas reached)
+	if (cellJob.NbPlayerJobs == 0)
+		return;
+
+	computeCellVision(cellJob.Cell, &cellJob.CellVision[0], cellJob.NumEntities, cellJob.Player);
+
+	uint	i;
+	for (i=cellJob.FirstPlayerJob; i!=cellJob.FirstPlayerJob+cellJob.NbPlayerJobs; ++i)
+	{
+		CPlayerVisionJob	&job = _PlayerVisionJobs[i];
+		job.CellVision = &cellJob.CellVision[0];
+		job.NumEntities = cellJob.NumEntities;
+		computePlayerVisionJob(job, workspace);
+	}
+}
+
 /****************************************************************\
 						setCellVisionToEntity()
 \****************************************************************/
 void	CWorldPositionManager::setCellVisionToEntity( CWorldEntity *entity, CVisionEntry* cellVisionArray, uint numEntities)
 {
 	STOP_IF(IsRingShard,"Illegal use of CWorldPositionManager on ring shard");
+	static CPlayerVisionJob	job;
+	job.Entity = entity;
+	job.CellVision = cellVisionArray;
+	job.NumEntities = numEntities;
+	computePlayerVisionJob(job, _VisionWorkspaces[0]);
+	applyPlayerVisionJob(job);
+}
+
+/****************************************************************\
+						computePlayerVisionJob()
+\****************************************************************/
+void	CWorldPositionManager::computePlayerVisionJob( CPlayerVisionJob &job, CVisionWorkspace &workspace )
+{
+	CWorldEntity	*entity = job.Entity;
+	job.Processed = false;
+
 	// discard non player entities
 	if (!entity->HasVision)
 		return;
@@ -1781,9 +1948,67 @@ void	CWorldPositionManager::setCellVisionToEntity( CWorldEntity *entity, CVision
 	infos->Indoor = entity->CellPtr != NULL && entity->CellPtr->isIndoor();
 
 	// update the player vision, new entities in vision are stored in inVision, old ones in outVision
-	static CPlayerVisionDelta	visionDelta;
-	H_TIME(ComputePlayerDeltaVision, computePlayerDeltaVision( infos, cellVisionArray, numEntities, visionDelta ););
+	computePlayerDeltaVision(job, workspace);
+	job.Processed = true;
+}
+
+/****************************************************************\
+						applyPlayerVisionJob()
+\****************************************************************/
+void	CWorldPositionManager::applyPlayerVisionJob( CPlayerVisionJob &job )
+{
+	if (!job.Processed)
+		return;
 
+	CPlayerInfos	*infos = job.Entity->PlayerInfos;
+	uint			i;
+
+	// update the closest player of the entities seen from the cell
+	for (i=0; i<job.NumEntities; ++i)
+	{
+		CWorldEntity *e = job.CellVision[i].Entity;
+		if (job.CellVision[i].Distance < (0xffu-e->VisionCounter()))
+		{
+			// if I am closer to this entity, then update entity's closest player
+			e->ClosestPlayer = infos->Entity;
+			e->VisionCounter = 0xff-(uint8)(job.CellVision[i].Distance);
+		}
+		else if (e->ClosestPlayer == infos->Entity)
+		{
+			// if I was the closest player, the update distance
+			e->VisionCounter = 0xff-(uint8)(job.CellVision[i].Distance);
+		}
+	}
+
+	// entities that left the slots
+	for (i=0; i!=job.EntitiesReleased.size(); ++i)
+	{
+		CWorldEntity *e = job.EntitiesReleased[i];
+
+		// if I was the closest player, then set entity to be not seen
+		if (((CWorldEntity*)infos->Entity) == e->ClosestPlayer)
+		{
+			e->ClosestPlayer = NULL;
+			e->VisionCounter = 0x0;
+		}
+		e->PlayersSeeingMe = e->PlayersSeeingMe-1;
+	}
+
+	// entities that entered the slots
+	for (i=0; i!=job.EntitiesAdded.size(); ++i)
+	{
+		CWorldEntity *e = job.EntitiesAdded[i];
+		e->PlayersSeeingMe = e->PlayersSeeingMe+1;
+	}
+
+	// set the new slots (changes the reference counts of the entities)
+	for (i=0; i<MAX_SEEN_ENTITIES; ++i)
+	{
+		if (infos->Slots[i] != (const CWorldEntity*)job.Slots[i])
+			infos->Slots[i] = job.Slots[i];
+	}
+
+	const CPlayerVisionDelta	&visionDelta = job.Delta;
 	if (visionDelta.EntitiesIn.empty() && visionDelta.EntitiesOut.empty())
 		return;
 
@@ -1804,55 +2029,49 @@ void	CWorldPositionManager::setCellVisionToEntity( CWorldEntity *entity, CVision
 		(*itFE).second.VisionOut += (sint32)visionDelta.EntitiesOut.size();
 		//(*itFE).second.VisionReplace += visionDelta.EntitiesReplace.size();
 		
-		(*itFE).second.Message.serial(visionDelta);
+		(*itFE).second.Message.serial(const_cast<CPlayerVisionDelta&>(visionDelta));
 	}
 }
 
 /****************************************************************\
 						releaseSlot()
 \****************************************************************/
-inline void releaseSlot( CPlayerInfos *infos, CWorldEntity* e, uint slot )
+inline void releaseSlot( CPlayerVisionJob &job, CWorldEntity* e, uint slot )
 {
-	// if I was the closest player, then set entity to be not seen
-	if (((CWorldEntity*)infos->Entity) == e->ClosestPlayer)
-	{
-		e->ClosestPlayer = NULL;
-		e->VisionCounter = 0x0;
-	}
-
-	// free slot
-	e->PlayersSeeingMe = e->PlayersSeeingMe-1;
-	infos->Slots[slot] = NULL;
-	infos->FreeSlots.push_back(slot);
+	// free slot (the closest player and the counter of the entity are updated by applyPlayerVisionJob())
+	job.EntitiesReleased.push_back(e);
+	job.Slots[slot] = NULL;
+	job.Entity->PlayerInfos->FreeSlots.push_back(slot);
 }
 
 /****************************************************************\
 						addToEntitiesOut()
 \****************************************************************/
-inline void addToEntitiesOut( CPlayerInfos *infos, CWorldEntity* e, uint slot, CPlayerVisionDelta &visionDelta )
+inline void addToEntitiesOut( CPlayerVisionJob &job, CWorldEntity* e, uint slot )
 {
-	releaseSlot(infos, e, slot);
-	visionDelta.EntitiesOut.push_back(CPlayerVisionDelta::CIdSlot(e->Index, slot));
+	releaseSlot(job, e, slot);
+	job.Delta.EntitiesOut.push_back(CPlayerVisionDelta::CIdSlot(e->Index, slot));
 }
 
 /****************************************************************\
 						addToEntitiesIn()
 \****************************************************************/
-inline void addToEntitiesIn( CPlayerInfos *infos, CWorldEntity* e, CPlayerVisionDelta &visionDelta )
+inline void addToEntitiesIn( CPlayerVisionJob &job, CWorldEntity* e )
 {
 	// add the entity into the EntitiesIn delta
+	CPlayerInfos	*infos = job.Entity->PlayerInfos;
 	uint	slot = infos->FreeSlots.back();
-	visionDelta.EntitiesIn.push_back(CPlayerVisionDelta::CIdSlot(e->Index, slot));
+	job.Delta.EntitiesIn.push_back(CPlayerVisionDelta::CIdSlot(e->Index, slot));
 	infos->FreeSlots.pop_back();
-	nlassert(infos->Slots[slot] == NULL);
-	infos->Slots[slot] = e;
-	infos->Slots[slot]->PlayersSeeingMe = infos->Slots[slot]->PlayersSeeingMe+1;
+	nlassert(job.Slots[slot] == NULL);
+	job.Slots[slot] = e;
+	job.EntitiesAdded.push_back(e);
 }
 
 /****************************************************************\
 						removeFromVisionAndEntitiesIn()
 \****************************************************************/
-void removeFromVisionAndEntitiesIn( CPlayerInfos *infos, CWorldEntity* e, uint slot, CPlayerVisionDelta &visionDelta)
+void removeFromVisionAndEntitiesIn( CPlayerVisionJob &job, CWorldEntity* e, uint slot )
 {
 	// If the entity is in the pending EntitiesIn vector (not sent yet), remove it from it,
 	// and we must not add it into EntitiesOut.
@@ -1862,6 +2081,7 @@ void removeFromVisionAndEntitiesIn( CPlayerInfos *infos, CWorldEntity* e, uint s
 		1/ removeFromVisionAndEntitiesIn() is called very rarely
 		2/ visionDelta.EntitiesIn is not 255 in size, but something more like 10
 	*/
+	CPlayerVisionDelta	&visionDelta = job.Delta;
 	for (std::vector<CPlayerVisionDelta::CIdSlot>::iterator ite=visionDelta.EntitiesIn.begin(); ite!=visionDelta.EntitiesIn.end(); ++ite)
 	{
 		if ((*ite).Slot == slot)
@@ -1876,13 +2096,13 @@ void removeFromVisionAndEntitiesIn( CPlayerInfos *infos, CWorldEntity* e, uint s
 			visionDelta.EntitiesIn.pop_back();
 
 			// Remove from vision but do not send the removal as the addition has not been sent yet
-			releaseSlot(infos, e, slot);
+			releaseSlot(job, e, slot);
 			return;
 		}
 	}
 
 	// Otherwise act as a regular removal of entity from vision
-	addToEntitiesOut(infos, e, slot, visionDelta);
+	addToEntitiesOut(job, e, slot);
 }
 
 
@@ -1890,14 +2110,25 @@ void removeFromVisionAndEntitiesIn( CPlayerInfos *infos, CWorldEntity* e, uint s
 /****************************************************************\
 						computePlayerDeltaVision()
 \****************************************************************/
-void	CWorldPositionManager::computePlayerDeltaVision( CPlayerInfos *infos, CVisionEntry* cellVision, uint &numEntities, CPlayerVisionDelta &visionDelta )
+void	CWorldPositionManager::computePlayerDeltaVision( CPlayerVisionJob &job, CVisionWorkspace &workspace )
 {
 	STOP_IF(IsRingShard,"Illegal use of CWorldPositionManager on ring shard");
 	uint	i;
 
+	// Only the job and the player infos are written here: this may run in a vision worker
+	CPlayerInfos		*infos = job.Entity->PlayerInfos;
+	CPlayerVisionDelta	&visionDelta = job.Delta;
+	const CVisionEntry	*cellVision = job.CellVision;
+	uint				numEntities = job.NumEntities;
+
 	visionDelta.PlayerIndex = infos->Entity->Index;
 	visionDelta.EntitiesIn.clear();
 	visionDelta.EntitiesOut.clear();
+	job.EntitiesReleased.clear();
+	job.EntitiesAdded.clear();
+	for (i=0; i<MAX_SEEN_ENTITIES; ++i)
+		job.Slots[i] = infos->Slots[i];
+	workspace.nextPlayer();
 
 	if (infos->ActivateSlot0)
 	{
@@ -1931,87 +2162,71 @@ void	CWorldPositionManager::computePlayerDeltaVision( CPlayerInfos *infos, CVisi
 	infos->DesactivateSlot0 = false;
 	infos->ActivateSlot0 = false;
 
-	// first mark all entities in new vision: browse the computed vision and set TempVisionState to true for each visible entity
+	// first mark all entities in new vision: browse the computed vision and set the InVision flag for each visible entity
+	// (the closest player of the entities is updated by applyPlayerVisionJob())
 	for (i=0; i<numEntities; ++i)
 	{
-		CWorldEntity *e = cellVision[i].Entity;
-
 		// Check if entity in new vision
 		if ((cellVision[i].Mask & infos->WhoICanSee) != 0)
-			e->TempVisionState = true;
-
-		if (cellVision[i].Distance < (0xffu-e->VisionCounter()))
-		{
-			// if I am closer to this entity, then update entity's closest player
-			e->ClosestPlayer = infos->Entity;
-			e->VisionCounter = 0xff-(uint8)(cellVision[i].Distance);
-		}
-		else if (e->ClosestPlayer == infos->Entity)
-		{
-			// if I was the closest player, the update distance
-			e->VisionCounter = 0xff-(uint8)(cellVision[i].Distance);
-		}
+			workspace.set(CVisionWorkspace::InVision, cellVision[i].Entity, true);
 	}
 
 	// mark own entity as seen (to avoid allocating a slot for it)
-	infos->Entity->TempVisionState = true;
+	workspace.set(CVisionWorkspace::InVision, infos->Entity, true);
 
 	// check all entities that are no more in vision: browse the previous entities in vision and check their new state
 	for (i=1; i<MAX_SEEN_ENTITIES; ++i)
 	{
-		CWorldEntity *e = infos->Slots[i];
+		CWorldEntity *e = job.Slots[i];
 		if (e == NULL)
 			continue;
 
 		// if flag is not set -> entity is out
-		if (!e->TempVisionState)
+		if (!workspace.test(CVisionWorkspace::InVision, e))
 		{
-			addToEntitiesOut(infos, e, i, visionDelta);
+			addToEntitiesOut(job, e, i);
 		}
 		else
 		{
 			// unset the flag so that only the entities not browsed yet still have the flag set
-			e->TempVisionState = false;
+			workspace.set(CVisionWorkspace::InVision, e, false);
 		}
 	}
 
-	infos->Entity->TempVisionState = false;
+	workspace.set(CVisionWorkspace::InVision, infos->Entity, false);
 
 	// check all entities that were not in vision before (as long as there are still free slots)
+	// (the flags of the entities not checked because of a lack of slots are reset by nextPlayer())
 	for (i=0; i<numEntities && !infos->FreeSlots.empty(); ++i)
 	{
 		// if flag not changed -> entity is in
 		CWorldEntity *e = cellVision[i].Entity;
-		if (e->TempVisionState)
+		if (workspace.test(CVisionWorkspace::InVision, e))
 		{
-			addToEntitiesIn(infos, e, visionDelta);
-			e->TempVisionState = false;
+			addToEntitiesIn(job, e);
+			workspace.set(CVisionWorkspace::InVision, e, false);
 		}
 	}
 
-	// reset vision state for entities that were not checked (not enough slots)
-	for (; i<numEntities; ++i)
-		cellVision[i].Entity->TempVisionState = false;
-
 	// *** Prevent from splitting vision of controller/controlled entity.
 	// Ex: mounted mounts must not be visible if their rider is not visible.
 	// It might waste some free slot space but this way we are sure the players won't have invisible riders.
 
 	// First build a short list of entities that may have the problem
-	static std::vector< pair<uint, CWorldEntity*> >	entityLinked;
+	std::vector< pair<uint, CWorldEntity*> >	&entityLinked = workspace.EntitiesLinked;
 	entityLinked.clear();
 	// Must add the slot 0 (user) in the loop, to be sure its parent (eg: mektoub) is correctly handled
 	for (i=0; i!=MAX_SEEN_ENTITIES; ++i)
 	{
-		CWorldEntity *e = infos->Slots[i];
+		CWorldEntity *e = job.Slots[i];
 		if (e == NULL)
 			continue;
 		
 		// Set the InVision flag for each entity on its related entity
 		if (e->isControlled())
-			e->Control->TempParentInVision = true;	// My controller now knows that its parent (ie me) is in vision
+			workspace.set(CVisionWorkspace::ParentInVision, e->Control, true);	// My controller now knows that its parent (ie me) is in vision
 		if (e->hasControl())
-			e->Parent->TempControlInVision = true;	// My parent now knows that its controler (ie me) is in vision
+			workspace.set(CVisionWorkspace::ControlInVision, e->Parent, true);	// My parent now knows that its controler (ie me) is in vision
 
 		// add in the list
 		if (e->isControlled() || e->hasControl())
@@ -2028,23 +2243,13 @@ void	CWorldPositionManager::computePlayerDeltaVision( CPlayerInfos *infos, CVisi
 			continue;
 		
 		// If I am controlled (eg a mektoub) and my controller (eg my rider) is not in vision, then remove me!
-		if ((e->isControlled()) && (!e->TempControlInVision))
-			removeFromVisionAndEntitiesIn(infos, e, slot, visionDelta);
+		if ((e->isControlled()) && (!workspace.test(CVisionWorkspace::ControlInVision, e)))
+			removeFromVisionAndEntitiesIn(job, e, slot);
 
 		// If I am a controller (eg a rider) and my parent (eg my mektoub) is not in vision, then remove me!
 		// else if important to not remove twice
-		else if ((e->hasControl()) && (!e->TempParentInVision))
-			removeFromVisionAndEntitiesIn(infos, e, slot, visionDelta);
-	}
-
-	// Clean: parse the (short) list to reset flags
-	for (i=0; i!=entityLinked.size(); ++i)
-	{
-		CWorldEntity *e = entityLinked[i].second;
-		if (e->isControlled())
-			e->Control->TempParentInVision = false;
-		if (e->hasControl())
-			e->Parent->TempControlInVision = false;
+		else if ((e->hasControl()) && (!workspace.test(CVisionWorkspace::ParentInVision, e)))
+			removeFromVisionAndEntitiesIn(job, e, slot);
 	}
 }
 
@@ -3345,6 +3550,389 @@ void	CWorldPositionManager::displayVisionCells(NLMISC::CLog *log)
 		log->displayNL("_VisionCellOffsets[%d]: (%d, %X)", h, _VisionCellOffsets[h].Offset, _VisionCellOffsets[h].Mask);
 }
 
+
+/****************************************************************\
+					recordEntityDistribution()
+\****************************************************************/
+
+namespace
+{
+
+/// Position and visibility of an entity linked in a cell, as saved by recordEntityDistribution()
+struct CDistributionEntry
+{
+	sint32	Cell;			// < 0 for an indoor cell
+	sint32	X;
+	sint32	Y;
+	uint32	WhoSeesMe;
+	uint8	Type;			// CWorldEntity::TEntityType
+
+	void	serial(NLMISC::IStream &f)
+	{
+		f.serial(Cell, X, Y);
+		f.serial(WhoSeesMe, Type);
+	}
+};
+
+} // anonymous namespace
+
+bool	CWorldPositionManager::recordEntityDistribution(const string &filename, NLMISC::CLog *log)
+{
+	STOP_IF(IsRingShard,"Illegal use of CWorldPositionManager on ring shard");
+	vector<CDistributionEntry>	entries;
+	for (TWorldEntityList::iterator it=_EntityList.begin(); it!=_EntityList.end(); ++it)
+	{
+		CWorldEntity	*entity = *it;
+		if (!entity->isLinked())
+			continue;
+
+		CDistributionEntry	entry;
+		entry.Cell = entity->getCell()->id();
+		entry.X = entity->X();
+		entry.Y = entity->Y();
+		entry.WhoSeesMe = (uint32)entity->WhoSeesMe();
+		entry.Type = (uint8)entity->getType();
+		entries.push_back(entry);
+	}
+
+	try
+	{
+		string	filepath = IService::getInstance()->WriteFilesDirectory.toString()+CFile::getFilename(filename);
+		COFile	f(filepath);
+		f.serialVersion(0);
+		f.serialCont(entries);
+		log->displayNL("Saved %u entities in '%s'", (uint)entries.size(), filepath.c_str());
+	}
+	catch (const Exception &e)
+	{
+		log->displayNL("Couldn't save entity distribution '%s': %s", filename.c_str(), e.what());
+		return false;
+	}
+	return true;
+}
+
+
+/****************************************************************\
+						benchCellVision()
+\****************************************************************/
+
+namespace
+{
+
+/// Entity seen from a cell, compared independently of the order of the lists and arrays
+struct CBenchVisionEntry
+{
+	const CWorldEntity	*Entity;
+	uint32				Mask;
+	uint32				Distance;
+
+	bool	operator < (const CBenchVisionEntry &e) const
+	{
+		if (Entity != e.Entity)	return Entity < e.Entity;
+		if (Mask != e.Mask)		return Mask < e.Mask;
+		return Distance < e.Distance;
+	}
+	bool	operator == (const CBenchVisionEntry &e) const { return Entity == e.Entity && Mask == e.Mask && Distance == e.Distance; }
+};
+
+/// Sort a vision, return true if it reached MAX_SEEN_OBJECTS or MAX_SEEN_ENTITIES (then the kept entities depend on the order)
+bool	sortBenchVision(const CVisionEntry *vision, uint numEntities, vector<CBenchVisionEntry> &sorted)
+{
+	uint	numObjects = 0;
+	sorted.resize(numEntities);
+	for (uint i=0; i<numEntities; ++i)
+	{
+		sorted[i].Entity = vision[i].Entity;
+		sorted[i].Mask = vision[i].Mask;
+		sorted[i].Distance = vision[i].Distance;
+		if (vision[i].Entity->getType() == CWorldEntity::Object)
+			++numObjects;
+	}
+	std::sort(sorted.begin(), sorted.end());
+	return numObjects >= MAX_SEEN_OBJECTS || numEntities >= MAX_SEEN_ENTITIES;
+}
+
+/// Build a random distribution: entities grouped around places, some indoor, some invisible or seen from short range
+void	buildRandomDistribution(vector<CDistributionEntry> &entries, uint nbEntities, sint32 width)
+{
+	CRandom	random;
+	random.srand(12345);
+
+	const uint	NbPlaces = 50;
+	const uint	NbIndoorCells = 20;
+	vector<sint32>	placesX(NbPlaces), placesY(NbPlaces);
+	uint	i;
+	for (i=0; i<NbPlaces; ++i)
+	{
+		placesX[i] = (sint32)(random.frand(1.0) * width);
+		placesY[i] = -(sint32)(random.frand(1.0) * width);
+	}
+
+	entries.resize(nbEntities);
+	for (i=0; i<nbEntities; ++i)
+	{
+		CDistributionEntry	&entry = entries[i];
+		float	r = random.frand(1.0);
+
+		// 70% around a place (within 150 m), 25% anywhere, 5% indoor
+		if (r < 0.70f)
+		{
+			uint	place = random.rand(NbPlaces-1);
+			entry.X = std::max(std::min(placesX[place] + (sint32)random.frandPlusMinus(150000.0), width-1), (sint32)0);
+			entry.Y = std::min(std::max(placesY[place] + (sint32)random.frandPlusMinus(150000.0), -width+1), (sint32)0);
+			entry.Cell = 0;
+		}
+		else if (r < 0.95f)
+		{
+			entry.X = (sint32)(random.frand(1.0) * (width-1));
+			entry.Y = -(sint32)(random.frand(1.0) * (width-1));
+			entry.Cell = 0;
+		}
+		else
+		{
+			entry.X = (sint32)random.frandPlusMinus(100000.0);
+			entry.Y = (sint32)random.frandPlusMinus(100000.0);
+			entry.Cell = -2 - (sint32)random.rand(NbIndoorCells-1);
+		}
+
+		// 75% always visible, 15% seen from short range only, 10% invisible
+		r = random.frand(1.0);
+		entry.WhoSeesMe = (r < 0.75f) ? 0xffffffff : (r < 0.90f) ? 0x0000ffff : 0;
+
+		// 10% objects, 10% players
+		r = random.frand(1.0);
+		entry.Type = (uint8)((r < 0.10f) ? CWorldEntity::Object : (r < 0.20f) ? CWorldEntity::Player : CWorldEntity::AI);
+	}
+}
+
+} // anonymous namespace
+
+void	CWorldPositionManager::benchCellVision(const string &filename, uint nbEntities, uint nbPasses, NLMISC::CLog *log)
+{
+	STOP_IF(IsRingShard,"Illegal use of CWorldPositionManager on ring shard");
+	if (_VisionCellOffsets.empty())
+	{
+		log->displayNL("Vision cell offsets not loaded");
+		return;
+	}
+
+	// size of the vision in cells, from the skim table
+	const sint32	mapWidth = (sint32)_WorldMapEffectiveX;
+	sint32			margin = 0;
+	uint			i;
+	for (i=0; i<_VisionCellOffsets.size(); ++i)
+	{
+		sint32	offset = _VisionCellOffsets[i].Offset;
+		sint32	dy = (offset >= 0) ? (offset + mapWidth/2) / mapWidth : -((-offset + mapWidth/2) / mapWidth);
+		sint32	dx = offset - dy*mapWidth;
+		margin = std::max(margin, std::max(abs(dx), abs(dy)));
+	}
+
+	// load or build the distribution
+	vector<CDistributionEntry>	entries;
+	if (!filename.empty())
+	{
+		try
+		{
+			CIFile	f(CPath::lookup(filename));
+			f.serialVersion(0);
+			f.serialCont(entries);
+		}
+		catch (const Exception &e)
+		{
+			log->displayNL("Couldn't load entity distribution '%s': %s", filename.c_str(), e.what());
+			return;
+		}
+	}
+	else
+	{
+		sint32	widthInCells = std::min(mapWidth - 2*margin, (sint32)std::min(_WorldMapX, _WorldMapY));
+		sint32	width = std::min((sint32)4000000, (widthInCells - 1) * (sint32)_CellSize);
+		buildRandomDistribution(entries, nbEntities, width);
+	}
+	if (entries.empty())
+	{
+		log->displayNL("No entity to replay");
+		return;
+	}
+
+	// bounding box of the outdoor cells
+	sint32	minX = numeric_limits<sint32>::max(), minY = numeric_limits<sint32>::max();
+	sint32	maxX = numeric_limits<sint32>::min(), maxY = numeric_limits<sint32>::min();
+	for (i=0; i<entries.size(); ++i)
+	{
+		if (entries[i].Cell < 0)
+			continue;
+		sint32	cx = entries[i].X / (sint32)_CellSize;
+		sint32	cy = -entries[i].Y / (sint32)_CellSize;
+		minX = std::min(minX, cx);
+		maxX = std::max(maxX, cx);
+		minY = std::min(minY, cy);
+		maxY = std::max(maxY, cy);
+	}
+	if (minX > maxX)
+	{
+		minX = maxX = 0;
+		minY = maxY = 0;
+	}
+	if (maxX-minX+1 + 2*margin > mapWidth || maxX-minX >= (sint32)_WorldMapX || maxY-minY >= (sint32)_WorldMapY)
+	{
+		log->displayNL("Distribution too wide for the cell map (%dx%d cells)", maxX-minX+1, maxY-minY+1);
+		return;
+	}
+	const sint32	nbRows = maxY-minY+1 + 2*margin;
+
+	// entities spread in memory in a random order, as in a shard that has been running for a while
+	const uint					nbEntries = (uint)entries.size();
+	CBlockMemory<CWorldEntity>	entityAllocator;
+	vector<CWorldEntity*>		entities(nbEntries);
+	for (i=0; i<nbEntries; ++i)
+		entities[i] = entityAllocator.allocate();
+	CRandom	random;
+	random.srand(54321);
+	for (i=nbEntries-1; i>0; --i)
+		std::swap(entities[i], entities[(uint)(random.frand(1.0)*i)]);
+
+	// cells of the bench, in a map with the same layout as _WorldCellsEffectiveMap
+	vector<CCell*>				cellMap(nbRows*mapWidth, (CCell*)NULL);
+	CCell						**effectiveMap = &cellMap[margin*mapWidth + margin];
+	map<sint32, CCell*>			indoorCells;
+	vector<CCell*>				cells;
+	map<CCell*, CWorldEntity*>	cellPlayers;
+	for (i=0; i<nbEntries; ++i)
+	{
+		const CDistributionEntry	&entry = entries[i];
+		const uint16	cx = (entry.Cell < 0) ? 0 : (uint16)(entry.X/(sint32)_CellSize - minX);
+		const uint16	cy = (entry.Cell < 0) ? 0 : (uint16)(-entry.Y/(sint32)_CellSize - minY);
+		CCell	*&cell = (entry.Cell < 0) ? indoorCells[entry.Cell] : effectiveMap[getCellOffset(cx, cy)];
+		if (cell == NULL)
+		{
+			cell = CCell::create();
+			if (entry.Cell < 0)
+				cell->init(entry.Cell);
+			else
+				cell->init(cx, cy);
+			cells.push_back(cell);
+		}
+
+		uint8	type;
+		switch (entry.Type)
+		{
+		case CWorldEntity::Object:	type = RYZOMID::object; break;
+		case CWorldEntity::Player:	type = RYZOMID::player; break;
+		case CWorldEntity::Trigger:	type = RYZOMID::trigger; break;
+		default:					type = RYZOMID::npc; break;
+		}
+
+		// the values read by the vision are kept out of the mirror
+		CWorldEntity	*entity = entities[i];
+		entity->initOffline(CEntityId(type, i), entry.X, entry.Y, entry.WhoSeesMe);
+		cell->link(entity);
+		if (entity->getType() == CWorldEntity::Player)
+			cellPlayers[cell] = entity;
+	}
+
+	// the cells computed in a pass are the cells with players, as in computeVision()
+	vector<CCell*>			visionCells;
+	vector<CWorldEntity*>	visionPlayers;
+	for (i=0; i<cells.size(); ++i)
+	{
+		map<CCell*, CWorldEntity*>::iterator	it = cellPlayers.find(cells[i]);
+		if (it != cellPlayers.end())
+		{
+			visionCells.push_back((*it).first);
+			visionPlayers.push_back((*it).second);
+		}
+	}
+
+	// run the passes with computeCellVision() on the bench cells, from the lists then from the arrays
+	TWorldCellsMap	worldCellsEffectiveMap = _WorldCellsEffectiveMap;
+	bool			useCellArrays = _UseCellArrays;
+	_WorldCellsEffectiveMap = effectiveMap;
+
+	vector<CVisionEntry>		listVision(MAX_SEEN_ENTITIES+1), arraysVision(MAX_SEEN_ENTITIES+1);
+	vector<CBenchVisionEntry>	sortedList, sortedArrays;
+	const uint	nbVisionCells = (uint)visionCells.size();
+	TTicks		listTicks = 0, arraysTicks = 0, gatherTicks = 0;
+	uint		nbSeen = 0, nbDifferences = 0, nbTruncated = 0;
+	uint		numEntities;
+	uint		pass;
+	for (pass=1; pass<=nbPasses; ++pass)
+	{
+		// lists
+		_UseCellArrays = false;
+		TTicks	before = CTime::getPerformanceTime();
+		for (i=0; i<nbVisionCells; ++i)
+		{
+			computeCellVision(visionCells[i], &listVision[0], numEntities, visionPlayers[i]);
+			nbSeen += numEntities;
+		}
+		listTicks += CTime::getPerformanceTime() - before;
+
+		// arrays, including the gathering of the values once per pass (the pass is used as game cycle)
+		_UseCellArrays = true;
+		before = CTime::getPerformanceTime();
+		for (i=0; i<nbVisionCells; ++i)
+			refreshCellArraysInVision(visionCells[i], pass);
+		TTicks	gathered = CTime::getPerformanceTime();
+		for (i=0; i<nbVisionCells; ++i)
+			computeCellVision(visionCells[i], &arraysVision[0], numEntities, visionPlayers[i]);
+		TTicks	after = CTime::getPerformanceTime();
+		gatherTicks += gathered - before;
+		arraysTicks += after - before;
+
+		// check that both give the same visions (outside of the timings)
+		if (pass == 1)
+		{
+			for (i=0; i<nbVisionCells; ++i)
+			{
+				uint	nbList, nbArrays;
+				_UseCellArrays = false;
+				computeCellVision(visionCells[i], &listVision[0], nbList, visionPlayers[i]);
+				_UseCellArrays = true;
+				computeCellVision(visionCells[i], &arraysVision[0], nbArrays, visionPlayers[i]);
+				bool	truncated = sortBenchVision(&listVision[0], nbList, sortedList);
+				truncated = sortBenchVision(&arraysVision[0], nbArrays, sortedArrays) || truncated;
+				if (truncated)
+					++nbTruncated;
+				else if (sortedList != sortedArrays)
+					++nbDifferences;
+			}
+		}
+	}
+
+	_WorldCellsEffectiveMap = worldCellsEffectiveMap;
+	_UseCellArrays = useCellArrays;
+
+	// unlink the entities in random order (each one is replaced by the last one in the arrays)
+	TTicks	before = CTime::getPerformanceTime();
+	for (i=0; i<nbEntries; ++i)
+		entities[i]->CellPtr->remove(entities[i]);
+	TTicks	removeTicks = CTime::getPerformanceTime() - before;
+
+	for (i=0; i<nbEntries; ++i)
+	{
+		entities[i]->releaseOffline();
+		entityAllocator.freeBlock(entities[i]);
+	}
+	for (i=0; i<cells.size(); ++i)
+		CCell::remove(cells[i]);
+
+	double	listMs = CTime::ticksToSecond(listTicks) * 1000.0 / nbPasses;
+	double	arraysMs = CTime::ticksToSecond(arraysTicks) * 1000.0 / nbPasses;
+	double	gatherMs = CTime::ticksToSecond(gatherTicks) * 1000.0 / nbPasses;
+	log->displayNL("%u entities in %u cells, %u cell visions per pass (%.1f entities seen per vision), %u passes", nbEntries, (uint)cells.size(), nbVisionCells, nbVisionCells ? (float)nbSeen / (nbVisionCells*nbPasses) : 0.0f, nbPasses);
+#ifdef NL_HAS_SSE2
+	const char	*filterName = "SSE2";
+#else
+	const char	*filterName = "scalar";
+#endif
+	log->displayNL("Lists:  %.3f ms per pass", listMs);
+	log->displayNL("Arrays: %.3f ms per pass (gather %.3f ms, %s filter %.3f ms)", arraysMs, gatherMs, filterName, arraysMs-gatherMs);
+	log->displayNL("Speedup: %.2f, %s (%u full visions not compared)", arraysMs > 0.0 ? listMs/arraysMs : 0.0, nbDifferences == 0 ? "same visions" : toString("%u DIFFERENT VISIONS", nbDifferences).c_str(), nbTruncated);
+	log->displayNL("Unlinked the entities in %.3f ms", CTime::ticksToSecond(removeTicks) * 1000.0);
+}
+
 /*
 */
 
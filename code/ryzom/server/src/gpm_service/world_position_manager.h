@@ -22,6 +22,7 @@
 #include "nel/misc/types_nl.h"
 #include "nel/misc/time_nl.h"
 #include "nel/misc/block_memory.h"
+#include "nel/misc/worker_pool.h"
 #include "nel/pacs/u_move_container.h"
 #include "nel/pacs/u_move_primitive.h"
 #include "nel/pacs/u_collision_desc.h"
@@ -42,6 +43,7 @@
 #include "variables.h"
 #include "world_entity.h"
 #include "cell.h"
+#include "vision_jobs.h"
 
 
 
@@ -106,6 +108,8 @@ extern bool			EVSUp;
  */
 class CWorldPositionManager
 {
+	friend class CCellVisionWorkerJobs;
+
 private:
 
 	/// List of entity
@@ -229,6 +233,14 @@ private:
 
 	static uint16					_NbVisionPerTick;		// Number of visions computed per tick
 
+	static NLMISC::CWorkerPool		_VisionWorkers;			// Threads computing the visions of a tick (see computeVision())
+	static std::vector<CVisionWorkspace>	_VisionWorkspaces;	// Temporary data of each vision worker
+	static std::vector<CCellVisionJob>		_CellVisionJobs;	// Cells to compute in the current tick (the first _NbCellVisionJobs ones)
+	static uint						_NbCellVisionJobs;
+	static std::vector<CPlayerVisionJob>	_PlayerVisionJobs;	// Players to compute in the current tick (the first _NbPlayerVisionJobs ones)
+	static uint						_NbPlayerVisionJobs;
+	static bool						_UseCellArrays;			// Cell visions computed from the entity arrays of the cells (see CCellEntityArrays)
+
 	static CPatatSubscribeManager	_PatatSubscribeManager;
 	static float					_fXMin;
 	static float					_fYMin;
@@ -640,6 +652,16 @@ public:
 	 */
 	inline static uint16 getNbVisionPerTick() { return _NbVisionPerTick; }
 
+	/**
+	 * set the number of threads computing the visions (1 = computed by the main thread only)
+	 */
+	static void setNbVisionWorkers( uint nbWorkers );
+
+	/**
+	 * get the number of threads computing the visions
+	 */
+	inline static uint getNbVisionWorkers() { return _VisionWorkers.nbWorkers(); }
+
 
 
 
@@ -1001,6 +1023,12 @@ private:
 	 */
 	static void computeCellVision( CCell *cell, CVisionEntry* entitiesSeenFromCell, uint &numEntities, CWorldEntity *player);
 
+	/**
+	 * gather the entity arrays of the cells seen from a cell (before computeCellVision() uses them),
+	 * if not done yet in game cycle gc
+	 */
+	static void refreshCellArraysInVision( CCell *cell, NLMISC::TGameCycle gc );
+
 	/**
 	 * Update vision for this player
 	 */
@@ -1016,12 +1044,27 @@ private:
 	 */
 	static void	setCellVisionToEntity( CWorldEntity *entity, CVisionEntry* cellVisionArray, uint numEntities);
 
+	/**
+	 * compute the vision of a cell and of its players selected for this tick (called by the vision workers)
+	 */
+	static void runCellVisionJob( CCellVisionJob &cellJob, CVisionWorkspace &workspace );
+
+	/**
+	 * compute the vision of a player, without modifying the data shared with other players (called by the vision workers)
+	 */
+	static void computePlayerVisionJob( CPlayerVisionJob &job, CVisionWorkspace &workspace );
+
 	/**
 	 * compute Vision, 
-	 * \param infos the player info
-	 * \param cellVision the vision from the cell
+	 * \param job the player and the vision from the cell, receives the vision delta
+	 * \param workspace the temporary flags of the worker
 	 */
-	static void computePlayerDeltaVision( CPlayerInfos *infos, CVisionEntry* entitiesInCellVision, uint &numEntities, CPlayerVisionDelta &visionDelta );
+	static void computePlayerDeltaVision( CPlayerVisionJob &job, CVisionWorkspace &workspace );
+
+	/**
+	 * apply the shared changes of a computed player vision and store the delta for the front-end (main thread)
+	 */
+	static void applyPlayerVisionJob( CPlayerVisionJob &job );
 
 
 	/**
@@ -1291,6 +1334,12 @@ public:
 	static void		autoCheck(NLMISC::CLog *log = NLMISC::InfoLog);
 
 	static void		displayVisionCells(NLMISC::CLog *log = NLMISC::InfoLog);
+
+	/// Save the position and visibility of the entities linked in cells (read by benchCellVision())
+	static bool		recordEntityDistribution(const std::string &filename, NLMISC::CLog *log = NLMISC::InfoLog);
+
+	/// Compare the cell vision computed from entity lists and from entity arrays (computeCellVision() on temporary cells), on a recorded or random entity distribution
+	static void		benchCellVision(const std::string &filename, uint nbEntities, uint nbPasses, NLMISC::CLog *log = NLMISC::InfoLog);
 };
 
 
@@ -30,6 +30,7 @@
 
 #include "logger_service.h"
 #include "log_storage.h"
+#include "log_segment.h"
 
 struct EIncompatibleType : public NLMISC::Exception
 {
@@ -49,8 +50,144 @@ struct EIncompatibleType : public NLMISC::Exception
 
 };
 
-/// A set of log entry index, used as 'result set' for a predicate node
-typedef std::set<uint32>	TLogEntries;
+/** A set of log entry index stored as a bitmap, used as 'result set' for a predicate node.
+ *	The interface is the part of std::set used by the query, the combination of two
+ *	sets (see TAndCombiner and TOrCombiner) is done 32 entries at a time.
+ */
+class CLogEntrySet
+{
+public:
+	enum { EndIndex = 0xffffffff };
+
+	/// Iterate over the entries of the set, in ascending order
+	class const_iterator
+	{
+	public:
+		typedef std::forward_iterator_tag	iterator_category;
+		typedef uint32						value_type;
+		typedef ptrdiff_t					difference_type;
+		typedef const uint32				*pointer;
+		typedef const uint32				&reference;
+
+		const_iterator(const CLogEntrySet *entrySet, uint32 index)
+			:	_EntrySet(entrySet),
+				_Index(index)
+		{
+		}
+
+		uint32 operator * () const								{ return _Index; }
+		const_iterator &operator ++ ()							{ _Index = _EntrySet->findNext(_Index+1); return *this; }
+		bool operator == (const const_iterator &other) const	{ return _Index == other._Index; }
+		bool operator != (const const_iterator &other) const	{ return _Index != other._Index; }
+
+	private:
+		const CLogEntrySet	*_EntrySet;
+		uint32				_Index;
+	};
+	typedef const_iterator	iterator;
+
+	const_iterator begin() const	{ return const_iterator(this, findNext(0)); }
+	const_iterator end() const		{ return const_iterator(this, EndIndex); }
+
+	void insert(uint32 index)
+	{
+		uint32 word = index >> 5;
+		if (word >= _Bits.size())
+			_Bits.resize(word+1, 0);
+		_Bits[word] |= 1 << (index & 31);
+	}
+
+	template <class InputIterator>
+	void insert(InputIterator first, InputIterator last)
+	{
+		for (; first != last; ++first)
+			insert(*first);
+	}
+
+	bool contains(uint32 index) const
+	{
+		uint32 word = index >> 5;
+		return word < _Bits.size() && (_Bits[word] & (1 << (index & 31))) != 0;
+	}
+
+	/// Number of entries in the set
+	uint32 size() const
+	{
+		uint32 count = 0;
+		for (uint i=0; i<_Bits.size(); ++i)
+		{
+			// count the bits of the word
+			uint32 bits = _Bits[i] - ((_Bits[i] >> 1) & 0x55555555);
+			bits = (bits & 0x33333333) + ((bits >> 2) & 0x33333333);
+			count += (((bits + (bits >> 4)) & 0x0f0f0f0f) * 0x01010101) >> 24;
+		}
+		return count;
+	}
+
+	bool empty() const
+	{
+		return findNext(0) == EndIndex;
+	}
+
+	/// Keep only the entries that are also in the other set
+	CLogEntrySet &operator &= (const CLogEntrySet &other)
+	{
+		if (_Bits.size() > other._Bits.size())
+			_Bits.resize(other._Bits.size());
+		for (uint i=0; i<_Bits.size(); ++i)
+			_Bits[i] &= other._Bits[i];
+		return *this;
+	}
+
+	/// Add the entries of the other set
+	CLogEntrySet &operator |= (const CLogEntrySet &other)
+	{
+		if (_Bits.size() < other._Bits.size())
+			_Bits.resize(other._Bits.size(), 0);
+		for (uint i=0; i<other._Bits.size(); ++i)
+			_Bits[i] |= other._Bits[i];
+		return *this;
+	}
+
+	void swap(CLogEntrySet &other)
+	{
+		_Bits.swap(other._Bits);
+	}
+
+private:
+	/// Return the first entry of the set not lower than index, or EndIndex
+	uint32 findNext(uint32 index) const
+	{
+		if (index == EndIndex)
+			return EndIndex;
+
+		uint32 word = index >> 5;
+		if (word >= _Bits.size())
+			return EndIndex;
+
+		// skip the empty words
+		uint32 bits = _Bits[word] & (0xffffffff << (index & 31));
+		while (bits == 0)
+		{
+			++word;
+			if (word == _Bits.size())
+				return EndIndex;
+			bits = _Bits[word];
+		}
+
+		uint32 bit = 0;
+		while ((bits & 1) == 0)
+		{
+			bits >>= 1;
+			++bit;
+		}
+		return (word << 5) + bit;
+	}
+
+	std::vector<uint32>	_Bits;
+};
+
+typedef CLogEntrySet	TLogEntries;
 
 /// Define a time slice for opening log file
 struct TTimeSlice
@@ -145,6 +282,13 @@ struct TQueryNode
 	/// Evaluate a date against the predicate (only test the date predicate)
 	virtual TTimeLine evalDate() =0;
 
+	/// Check the summary of a block of a log segment, return true if no log
+	/// of the block can match the predicate (the date are checked with evalDate())
+	virtual bool skipBlock(const TLogBlockSummary &summary) const
+	{
+		return false;
+	}
+
 	/// dump the node
 	void dump(NLMISC::CLog &log, const std::string &tab) const
 	{
@@ -407,6 +551,13 @@ struct TCombineNode : public TQueryNode
 		return comb(left, right);
 	}
 
+	virtual bool skipBlock(const TLogBlockSummary &summary) const
+	{
+		nlassert(LeftNode && RightNode);
+
+		return Combiner::skipBlock(LeftNode->skipBlock(summary), RightNode->skipBlock(summary));
+	}
+
 
 	virtual void dumpNode(NLMISC::CLog &log, const std::string &tab) const
 	{
@@ -417,77 +568,109 @@ struct TCombineNode : public TQueryNode
 
 
 /// Given the parameter index selected, build the list of logs that use the selected param
-inline void buildSelectedLogList(const std::vector<uint32> &selectedIndex, const CLogStorage &logs, const std::vector<TSelectedParam> &selectedParams, TLogEntries &result)
+inline void buildSelectedLogList(const std::vector<uint32> &selectedIndex, const CLogStorage &logs, const CLogStorage::TLogParamId &lpi, const std::vector<TSelectedParam> &selectedParams, TLogEntries &result)
 {
-	// for each log type to test
+	const CLogStorage::TParamIndex *owners = logs.getParamOwners(lpi);
+	if (owners == NULL)
+		return;
+
+	// the log types that can use the param
+	std::vector<bool> selectedTypes;
 	for (uint j=0; j<selectedParams.size(); ++j)
 	{
-		uint entryIndex = 0;
-		// for each selected parameter index
-		for (uint k=0; k<selectedIndex.size(); ++k)
+		if (selectedParams[j].LogDefIndex >= selectedTypes.size())
+			selectedTypes.resize(selectedParams[j].LogDefIndex+1, false);
+		selectedTypes[selectedParams[j].LogDefIndex] = true;
+	}
+
+	// for each selected parameter index, the owner column give the log that use it
+	for (uint k=0; k<selectedIndex.size(); ++k)
+	{
+		uint32 entryIndex = (*owners)[selectedIndex[k]];
+		if (entryIndex >= logs._DiskLogEntries.size())
+			continue;
+
+		uint32 logType = logs._DiskLogEntries[entryIndex].LogType;
+		if (logType < selectedTypes.size() && selectedTypes[logType])
+			result.insert(entryIndex);
+	}
+}
+
+/** Select the part of a sorted index that match an operator.
+ *	Return false if the operator can't be evaluated with the index (the
+ *	values must then be scanned).
+ */
+template <class T, class Less>
+bool selectSortedRange(TTokenType operatorType, const std::vector<uint32> &sorted, const T &ref, const Less &less, std::vector<uint32> &selected)
+{
+	std::vector<uint32>::const_iterator first(sorted.begin()), last(sorted.end());
+	std::vector<uint32>::const_iterator lower, upper;
+
+	switch (operatorType)
+	{
+	case tt_EQUAL:
+	case tt_LESS:
+	case tt_LESS_EQUAL:
+	case tt_GREATER:
+	case tt_GREATER_EQUAL:
+	case tt_NOT_EQUAL:
+		lower = std::lower_bound(first, last, ref, less);
+		upper = std::upper_bound(lower, last, ref, less);
+		break;
+	default:
+		return false;
+	}
+
+	switch (operatorType)
+	{
+	case tt_EQUAL:
+		selected.insert(selected.end(), lower, upper);
+		break;
+	case tt_LESS:
+		selected.insert(selected.end(), first, lower);
+		break;
+	case tt_LESS_EQUAL:
+		selected.insert(selected.end(), first, upper);
+		break;
+	case tt_GREATER:
+		selected.insert(selected.end(), upper, last);
+		break;
+	case tt_GREATER_EQUAL:
+		selected.insert(selected.end(), lower, last);
+		break;
+	case tt_NOT_EQUAL:
+		selected.insert(selected.end(), first, lower);
+		selected.insert(selected.end(), upper, last);
+		break;
+	default:
+		break;
+	}
+	return true;
+}
+
+/// Select the index of the values of a param table that match an operator, using the sorted index if there is one
+template <class Operator>
+void selectParamValues(const CLogStorage &logs, const CLogStorage::TLogParamId &lpi, const CLogStorage::TParamsTable &pt, const LGS::TParamValue &ref, std::vector<uint32> &selectedIndex)
+{
+	if (ref.getType() == lpi.ParamType)
+	{
+		const CLogStorage::TParamIndex *sorted = logs.getSortedParamIndex(lpi);
+		if (sorted != NULL 
+			&& selectSortedRange(Operator::getOperatorType(), *sorted, ref, CLogStorage::TParamValueLess(pt), selectedIndex))
+			return;
+	}
+
+	Operator op;
+
+	// parse each entry of the param table
+	for (uint j=0; j<pt.size(); ++j)
+	{
+		// apply the operator
+		if (op(pt[j], ref))
 		{
-			uint32 currentParamIndex = selectedIndex[k];
-			
-			while (entryIndex < logs._DiskLogEntries.size())
-			{
-				const CLogStorage::TDiskLogEntry &dle = logs._DiskLogEntries[entryIndex];
-				
-				if (dle.LogType == selectedParams[j].LogDefIndex)
-				{
-					if (selectedParams[j].ListParam)
-					{
-						// read the variable parameter
-						const CLogStorage::TParamIndex &indexes = dle.ListParamIndex[selectedParams[j].ParamIndex];
-						if (indexes.empty() 
-							|| indexes.back() < currentParamIndex)
-						{
-							// this log is empty or too old, advance to next one
-							++entryIndex;
-							continue;
-						}
-						else if (indexes.front() <=  currentParamIndex)
-						{
-							// we found the list that contains the selected index
-							result.insert(entryIndex);
-							++entryIndex;
-							
-							// advance to next parameter
-							break;
-						}
-						else
-						{
-							// we have passed over the logs, no matching found!
-							break;
-						}
-					}
-					else
-					{
-						// the log type match
-						if (dle.ParamIndex[selectedParams[j].ParamIndex] < currentParamIndex)
-						{
-							// this log is too old, advance to next one
-							++entryIndex;
-							continue;
-						}
-						else if (dle.ParamIndex[selectedParams[j].ParamIndex] == currentParamIndex)
-						{
-							// this is the log we are looking for
-							result.insert(entryIndex);
-							++entryIndex;
-							
-							// advance to next parameter
-							break;
-						}
-						else
-						{
-							// we have passed over the logs, no matching found!
-							break;
-						}
-					}
-				}
-				else
-					++entryIndex;
-			}
+			// the operator returned true, add this log to the set of
+			// matching logs
+			selectedIndex.push_back(j);
 		}
 	}
 }
@@ -570,7 +753,6 @@ struct TTypePredicateNode : public TQueryNode
 
 	TLogEntries evalNode(const CLogStorage &logs)
 	{
-		Operator op;
 		TLogEntries ret;
 
 		// parse each param table, then look back in the logs for the selected entry
@@ -588,21 +770,11 @@ struct TTypePredicateNode : public TQueryNode
 			{
 				const CLogStorage::TParamsTable &pt = it->second;
 				
-				// parse each entry of the param table
-				for (uint j=0; j<pt.size(); ++j)
-				{
-					// apply the operator
-					
-					if (op(pt[j], _RefValue))
-					{
-						// the operator returned true, add this log to the set of
-						// matching logs
-						selectedIndex.push_back(j);
-					}
-				}
+				// select the matching entries of the param table
+				selectParamValues<Operator>(logs, lpi, pt, _RefValue, selectedIndex);
 				
 				// now, look back for the logs that use the selected parameter
-				buildSelectedLogList(selectedIndex, logs, sps, ret);
+				buildSelectedLogList(selectedIndex, logs, lpi, sps, ret);
 			}
 		}
 
@@ -618,6 +790,17 @@ struct TTypePredicateNode : public TQueryNode
 		return tl;
 	}
 
+	virtual bool skipBlock(const TLogBlockSummary &summary) const
+	{
+		// only an equality with an entity id can be checked against the block summary
+		if (Operator::getOperatorType() != tt_EQUAL 
+			|| _ParamType != LGS::TSupportedParamType::spt_entityId
+			|| _RefValue.getType() != LGS::TSupportedParamType::spt_entityId)
+			return false;
+
+		return !summary.mayContainEntity(_RefValue.get_entityId());
+	}
+
 
 	virtual void dumpNode(NLMISC::CLog &log, const std::string &tab) const
 	{
@@ -809,6 +992,23 @@ struct TPredicateNode : public TQueryNode
 		return TTimeLine(1, FullTimeSlice);
 	}
 
+	virtual bool skipBlock(const TLogBlockSummary &summary) const
+	{
+		// only an equality with an entity id can be checked against the block summary
+		if (Operator::getOperatorType() != tt_EQUAL || _SelectedParams.empty())
+			return false;
+
+		TSelectedParams::const_iterator first(_SelectedParams.begin()), last(_SelectedParams.end());
+		for (; first != last; ++first)
+		{
+			if (first->first.ParamType != LGS::TSupportedParamType::spt_entityId)
+				return false;
+		}
+
+		LGS::TParamValue ref = convertParam(_RefValue, LGS::TSupportedParamType::spt_entityId);
+		return !summary.mayContainEntity(ref.get_entityId());
+	}
+
 
 	TLogEntries evalNode(const CLogStorage &logs)
 	{
@@ -823,12 +1023,22 @@ struct TPredicateNode : public TQueryNode
 			{
 				LGS::TParamValue ref = convertParam(_RefValue, LGS::TSupportedParamType::spt_uint32);
 
-				// this is a date comparison
-				for (uint i=0; i<logs._DiskLogEntries.size(); ++i)
+				// this is a date comparison, use the date index if the logs are indexed
+				const CLogStorage::TParamIndex *dateIndex = logs.getDateIndex();
+				std::vector<uint32> selectedEntries;
+				if (dateIndex != NULL
+					&& selectSortedRange(Operator::getOperatorType(), *dateIndex, (uint64)_RefValue.get_uint32(), CLogStorage::TLogDateLess(logs._DiskLogEntries), selectedEntries))
 				{
-					const CLogStorage::TDiskLogEntry &dle = logs._DiskLogEntries[i];
-					if (op(dle.LogDate, _RefValue.get_uint32()))
-						ret.insert(i);
+					ret.insert(selectedEntries.begin(), selectedEntries.end());
+				}
+				else
+				{
+					for (uint i=0; i<logs._DiskLogEntries.size(); ++i)
+					{
+						const CLogStorage::TDiskLogEntry &dle = logs._DiskLogEntries[i];
+						if (op(dle.LogDate, _RefValue.get_uint32()))
+							ret.insert(i);
+					}
 				}
 			}
 			else if (_ParameterName == "LogName")
@@ -843,14 +1053,15 @@ struct TPredicateNode : public TQueryNode
 						matchingLogs.push_back(defIndex);
 				}
 
+				std::vector<bool> selectedTypes(_LogDefs.size(), false);
 				for (uint32 j=0; j<matchingLogs.size(); ++j)
+					selectedTypes[matchingLogs[j]] = true;
+
+				for (uint i=0; i<logs._DiskLogEntries.size(); ++i)
 				{
-					uint32 logType = matchingLogs[j];
-					for (uint i=0; i<logs._DiskLogEntries.size(); ++i)
-					{
-						if (logs._DiskLogEntries[i].LogType == logType)
-							ret.insert(i);
-					}
+					uint32 logType = logs._DiskLogEntries[i].LogType;
+					if (logType < selectedTypes.size() && selectedTypes[logType])
+						ret.insert(i);
 				}
 			}
 			else if (_ParameterName == "ShardId")
@@ -902,20 +1113,11 @@ struct TPredicateNode : public TQueryNode
 						ref = convertParam(_RefValue, lpi.ParamType);
 					}
 					
-					// parse each entry of the param table
-					for (uint j=0; j<pt.size(); ++j)
-					{
-						// apply the operator
-						if (op(pt[j], ref))
-						{
-							// the operator returned true, add this log to the set of
-							// matching logs
-							selectedIndex.push_back(j);
-						}
-					}
+					// select the matching entries of the param table
+					selectParamValues<Operator>(logs, lpi, pt, ref, selectedIndex);
 					
 					// now, look back for the logs that use the selected parameter
-					buildSelectedLogList(selectedIndex, logs, sps, ret);
+					buildSelectedLogList(selectedIndex, logs, lpi, sps, ret);
 				}
 			}
 		}
@@ -1019,14 +1221,17 @@ struct TOrCombiner
 {
 	TLogEntries operator () (const TLogEntries &leftEntry, const TLogEntries &rightEntry) const
 	{
-		TLogEntries ret;
-		std::set_union(leftEntry.begin(), leftEntry.end(), 
-			rightEntry.begin(), rightEntry.end(), 
-			std::inserter(ret, ret.begin()));
+		TLogEntries ret(leftEntry);
+		ret |= rightEntry;
 
 		return ret;
 	}
 
+	static bool skipBlock(bool skipLeft, bool skipRight)
+	{
+		return skipLeft && skipRight;
+	}
+
 	TTimeLine operator ()(const TTimeLine &left, const TTimeLine &right) const
 	{
 		TTimeLine ret;
@@ -1081,13 +1286,16 @@ struct TAndCombiner
 {
 	TLogEntries operator () (const TLogEntries &leftEntry, const TLogEntries &rightEntry) const
 	{
-		TLogEntries ret;
-		std::set_intersection(leftEntry.begin(), leftEntry.end(), 
-			rightEntry.begin(), rightEntry.end(), 
-			std::inserter(ret, ret.begin()));
+		TLogEntries ret(leftEntry);
+		ret &= rightEntry;
 		return ret;
 	}
 
+	static bool skipBlock(bool skipLeft, bool skipRight)
+	{
+		return skipLeft || skipRight;
+	}
+
 	TTimeLine operator ()(const TTimeLine &left, const TTimeLine &right) const
 	{
 		TTimeLine ret;
@@ -1272,4 +1480,47 @@ private:
 };
 
 
+/** A query parsed once for all the log storages it is run on.
+ *	The query tree depends on the log definitions, so the query is only parsed
+ *	again when it is run on logs that use other log definitions.
+ */
+class CParsedQuery
+{
+public:
+	CParsedQuery(const std::string &queryStr)
+		:	_QueryStr(queryStr),
+			_FullContext(false)
+	{
+	}
+
+	/// Return the query tree for logs using the given log definitions (throw CQueryParser::EInvalidQuery)
+	TQueryNode *getQueryTree(const TLogDefinitions &logDefs)
+	{
+		if (_QueryTree.get() == NULL || !(logDefs == _LogDefs))
+		{
+			// the nodes reference the log definitions, release them first
+			_QueryTree.reset();
+			_LogDefs = logDefs;
+
+			CQueryParser qp(_LogDefs);
+			CQueryParser::TParserResult pr = qp.parseQuery(_QueryStr, false);
+			_QueryTree = pr.QueryTree;
+			_FullContext = pr.FullContext;
+		}
+
+		return _QueryTree.get();
+	}
+
+	/// Option to extract full context with selected logs (valid once a query tree is built)
+	bool isFullContext() const	{ return _FullContext; }
+
+private:
+	std::string						_QueryStr;
+	/// The log definitions used to build the query tree
+	TLogDefinitions					_LogDefs;
+	std::shared_ptr<TQueryNode>		_QueryTree;
+	bool							_FullContext;
+};
+
+
 #endif //LOG_QUERY_H
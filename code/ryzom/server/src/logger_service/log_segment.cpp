@@ -0,0 +1,332 @@
+// Ryzom - MMORPG Framework <http://dev.ryzom.com/projects/ryzom/>
+// Copyright (C) 2010  Winch Gate Property Limited
+//
+// This program is free software: you can redistribute it and/or modify
+// it under the terms of the GNU Affero General Public License as
+// published by the Free Software Foundation, either version 3 of the
+// License, or (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU Affero General Public License for more details.
+//
+// You should have received a copy of the GNU Affero General Public License
+// along with this program.  If not, see <http://www.gnu.org/licenses/>.
+
+#include "log_segment.h"
+
+#include "nel/misc/mem_stream.h"
+#include "nel/misc/variable.h"
+
+#include <zlib.h>
+
+using namespace std;
+using namespace NLMISC;
+
+
+NLMISC::CVariable<uint32> LogSegmentBlockSize("lgs", "LogSegmentBlockSize", "The number of logs in each block of the log segment files", 4096, 0, true);
+
+/// Magic number at the start and at the end of the segment files
+static const uint32	SegmentMagic = NELID("LSEG");
+/// Version of the segment file format
+///	1 : the blocks contain the sorted indexes of the logs
+static const uint32	SegmentVersion = 1;
+/// Size of the footer of the segment files (position of the index and magic)
+static const uint32	SegmentFooterSize = 2*sizeof(uint32);
+
+
+/////////////////////////////////////////////////////////////////////////////
+/////    CLogSegmentWriter    ///////////////////////////////////////////////
+/////////////////////////////////////////////////////////////////////////////
+
+CLogSegmentWriter::CLogSegmentWriter(const TLogDefinitions &logDefs)
+	:	_LogDefs(logDefs),
+		_Block(logDefs),
+		_NbLogs(0),
+		_Failed(false)
+{
+}
+
+CLogSegmentWriter::~CLogSegmentWriter()
+{
+	if (!_FileName.empty())
+	{
+		// the segment was not closed, remove the temporary file
+		_File.close();
+		CFile::deleteFile(_FileName+".tmp");
+	}
+}
+
+bool CLogSegmentWriter::open(const std::string &fileName)
+{
+	nlassert(_FileName.empty());
+
+	if (!_File.open(fileName+".tmp"))
+	{
+		nlwarning("Failed to open log segment file '%s'", (fileName+".tmp").c_str());
+		return false;
+	}
+	_FileName = fileName;
+	_Blocks.clear();
+	_NbLogs = 0;
+	_Failed = false;
+
+	try
+	{
+		uint32 magic = SegmentMagic;
+		uint32 version = SegmentVersion;
+		_File.serial(magic);
+		_File.serial(version);
+		_File.serialCont(const_cast<TLogDefinitions&>(_LogDefs));
+	}
+	catch (const Exception &e)
+	{
+		nlwarning("Failed to write log segment file '%s' : %s", _FileName.c_str(), e.what());
+		_Failed = true;
+	}
+
+	return !_Failed;
+}
+
+void CLogSegmentWriter::addLog(const TLogEntry &logEntry)
+{
+	_Block.storeLog(logEntry);
+
+	// only end the block outside of any context, unless the contexts are never closed
+	uint32 nbLogs = (uint32)_Block._DiskLogEntries.size();
+	if ((nbLogs >= LogSegmentBlockSize && _Block._ContextStack == 0)
+		|| nbLogs >= LogSegmentBlockSize*8)
+	{
+		writeBlock(_Block);
+		_Block.clearLogs();
+	}
+}
+
+void CLogSegmentWriter::writeBlock(const CLogStorage &logs)
+{
+	nlassert(!_FileName.empty());
+
+	if (logs._DiskLogEntries.empty() || _Failed)
+		return;
+
+	TLogBlockSummary summary;
+	summary.NbLogs = (uint32)logs._DiskLogEntries.size();
+
+	// build the summary of the block
+	for (uint i=0; i<logs._DiskLogEntries.size(); ++i)
+	{
+		uint32 date = logs._DiskLogEntries[i].LogDate;
+		if (date != 0 && date != ~0)
+			summary.addDate(date);
+	}
+	CLogStorage::TParamsTables::const_iterator first(logs._ParamTables.begin()), last(logs._ParamTables.end());
+	for (; first != last; ++first)
+	{
+		if (first->first.ParamType != LGS::TSupportedParamType::spt_entityId)
+			continue;
+
+		const CLogStorage::TParamsTable &pt = first->second;
+		for (uint i=0; i<pt.size(); ++i)
+		{
+			if (pt[i].getType() == LGS::TSupportedParamType::spt_entityId)
+				summary.addEntity(pt[i].get_entityId());
+		}
+	}
+
+	// serial and compress the logs and their indexes
+	CMemStream ms;
+	const_cast<CLogStorage&>(logs).serialLogs(ms);
+	const_cast<CLogStorage&>(logs).serialIndexes(ms);
+
+	uLongf compressedSize = compressBound(ms.length());
+	_Buffer.resize(compressedSize);
+	if (compress2(&_Buffer[0], &compressedSize, ms.buffer(), ms.length(), Z_DEFAULT_COMPRESSION) != Z_OK)
+	{
+		nlwarning("Failed to compress a block of %u logs for log segment file '%s'", summary.NbLogs, _FileName.c_str());
+		_Failed = true;
+		return;
+	}
+
+	try
+	{
+		summary.Offset = _File.getPos();
+		summary.CompressedSize = (uint32)compressedSize;
+		summary.Size = ms.length();
+		_File.serialBuffer(&_Buffer[0], summary.CompressedSize);
+	}
+	catch (const Exception &e)
+	{
+		nlwarning("Failed to write log segment file '%s' : %s", _FileName.c_str(), e.what());
+		_Failed = true;
+		return;
+	}
+
+	_Blocks.push_back(summary);
+	_NbLogs += summary.NbLogs;
+}
+
+bool CLogSegmentWriter::close()
+{
+	nlassert(!_FileName.empty());
+
+	// write the last block
+	writeBlock(_Block);
+	_Block.clearLogs();
+
+	if (!_Failed)
+	{
+		try
+		{
+			// write the index and the footer
+			uint32 indexOffset = _File.getPos();
+			_File.serialCont(_Blocks);
+			uint32 magic = SegmentMagic;
+			_File.serial(indexOffset);
+			_File.serial(magic);
+		}
+		catch (const Exception &e)
+		{
+			nlwarning("Failed to write log segment file '%s' : %s", _FileName.c_str(), e.what());
+			_Failed = true;
+		}
+	}
+	_File.close();
+
+	string fileName;
+	fileName.swap(_FileName);
+	if (_Failed)
+	{
+		CFile::deleteFile(fileName+".tmp");
+		return false;
+	}
+
+	nldebug("Stored %u logs in %u blocks in file %s", _NbLogs, _Blocks.size(), fileName.c_str());
+
+	// rename the 'tmp" into finale output file
+	return CFile::moveFile(fileName, fileName+".tmp");
+}
+
+
+/////////////////////////////////////////////////////////////////////////////
+/////    CLogSegmentReader    ///////////////////////////////////////////////
+/////////////////////////////////////////////////////////////////////////////
+
+CLogSegmentReader::CLogSegmentReader()
+	:	_Data(NULL),
+		_Size(0),
+		_Version(0)
+{
+}
+
+CLogSegmentReader::~CLogSegmentReader()
+{
+	close();
+}
+
+bool CLogSegmentReader::open(const std::string &fileName)
+{
+	close();
+
+	uint32 size = CFile::getFileSize(fileName);
+	if (size < 2*sizeof(uint32)+SegmentFooterSize)
+	{
+		nlwarning("Invalid log segment file '%s'", fileName.c_str());
+		return false;
+	}
+
+	if (!_File.open(fileName) || _File.size() != size)
+	{
+		close();
+		return false;
+	}
+	_Data = _File.data();
+	_Size = size;
+
+	try
+	{
+		// read the footer
+		CMemStream footer(true);
+		footer.fill(_Data+_Size-SegmentFooterSize, SegmentFooterSize);
+		uint32 indexOffset, magic;
+		footer.serial(indexOffset);
+		footer.serial(magic);
+		if (magic != SegmentMagic || indexOffset > _Size-SegmentFooterSize)
+			throw EStream("invalid footer");
+
+		// read the index
+		CMemStream index(true);
+		index.fill(_Data+indexOffset, _Size-SegmentFooterSize-indexOffset);
+		index.serialCont(_Blocks);
+
+		// the header ends where the first block begins (only the header is copied, not the whole file)
+		uint32 headerSize = indexOffset;
+		for (uint i=0; i<_Blocks.size(); ++i)
+		{
+			if (_Blocks[i].Offset > indexOffset || _Blocks[i].CompressedSize > indexOffset-_Blocks[i].Offset)
+				throw EStream("invalid block");
+			headerSize = min(headerSize, _Blocks[i].Offset);
+		}
+
+		// read the header
+		CMemStream header(true);
+		header.fill(_Data, headerSize);
+		header.serial(magic);
+		header.serial(_Version);
+		if (magic != SegmentMagic || _Version > SegmentVersion)
+			throw EStream("invalid header");
+		header.serialCont(_LogDefs);
+	}
+	catch (const Exception &e)
+	{
+		nlwarning("Invalid log segment file '%s' : %s", fileName.c_str(), e.what());
+		close();
+		return false;
+	}
+
+	return true;
+}
+
+void CLogSegmentReader::close()
+{
+	_File.close();
+
+	_Data = NULL;
+	_Size = 0;
+	_Version = 0;
+	_LogDefs.clear();
+	_Blocks.clear();
+}
+
+bool CLogSegmentReader::loadBlock(uint32 index, CLogStorage &logs)
+{
+	nlassert(index < _Blocks.size());
+	const TLogBlockSummary &summary = _Blocks[index];
+
+	// uncompress the block
+	uLongf size = summary.Size;
+	_Buffer.resize(std::max(summary.Size, (uint32)1));
+	if (uncompress(&_Buffer[0], &size, _Data+summary.Offset, summary.CompressedSize) != Z_OK || size != summary.Size)
+	{
+		nlwarning("Failed to uncompress the block %u of a log segment file", index);
+		return false;
+	}
+
+	logs.clearLogs();
+	try
+	{
+		CMemStream ms(true);
+		ms.fill(&_Buffer[0], summary.Size);
+		logs.serialLogs(ms);
+		if (_Version >= 1)
+			logs.serialIndexes(ms);
+	}
+	catch (const Exception &e)
+	{
+		nlwarning("Failed to read the block %u of a log segment file : %s", index, e.what());
+		logs.clearLogs();
+		return false;
+	}
+
+	return true;
+}
@@ -0,0 +1,205 @@
+// Ryzom - MMORPG Framework <http://dev.ryzom.com/projects/ryzom/>
+// Copyright (C) 2010  Winch Gate Property Limited
+//
+// This program is free software: you can redistribute it and/or modify
+// it under the terms of the GNU Affero General Public License as
+// published by the Free Software Foundation, either version 3 of the
+// License, or (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU Affero General Public License for more details.
+//
+// You should have received a copy of the GNU Affero General Public License
+// along with this program.  If not, see <http://www.gnu.org/licenses/>.
+
+#ifndef LOG_SEGMENT_H
+#define LOG_SEGMENT_H
+
+#include "nel/misc/types_nl.h"
+#include "nel/misc/entity_id.h"
+#include "nel/misc/file.h"
+#include "nel/misc/mapped_file.h"
+
+#include "logger_service.h"
+#include "log_storage.h"
+
+/** Summary of a block of a log segment file.
+ *	It is stored in the index of the segment and allow a query to skip the
+ *	blocks that can't contain any matching log without reading them.
+ */
+struct TLogBlockSummary
+{
+	enum
+	{
+		/// Number of bits of the entity id filter
+		EntityFilterBits = 2048,
+		EntityFilterWords = EntityFilterBits/32
+	};
+
+	/// Position of the compressed block in the file
+	uint32		Offset;
+	/// Size of the compressed block
+	uint32		CompressedSize;
+	/// Size of the block once uncompressed
+	uint32		Size;
+	/// Number of logs in the block
+	uint32		NbLogs;
+	/// Dates of the first and last log of the block (the context logs are
+	/// not taken into account, MinDate > MaxDate if there is only context logs)
+	uint32		MinDate;
+	uint32		MaxDate;
+	/// A bit for each entity id used in the block (several entity id share each bit)
+	uint32		EntityFilter[EntityFilterWords];
+
+	TLogBlockSummary()
+		:	Offset(0),
+			CompressedSize(0),
+			Size(0),
+			NbLogs(0),
+			MinDate(~0),
+			MaxDate(0)
+	{
+		memset(EntityFilter, 0, sizeof(EntityFilter));
+	}
+
+	void addDate(uint32 date)
+	{
+		MinDate = std::min(MinDate, date);
+		MaxDate = std::max(MaxDate, date);
+	}
+
+	void addEntity(const NLMISC::CEntityId &eid)
+	{
+		uint32 bit = getEntityBit(eid);
+		EntityFilter[bit >> 5] |= 1 << (bit & 31);
+	}
+
+	/// Return false if the block doesn't contain the entity
+	bool mayContainEntity(const NLMISC::CEntityId &eid) const
+	{
+		uint32 bit = getEntityBit(eid);
+		return (EntityFilter[bit >> 5] & (1 << (bit & 31))) != 0;
+	}
+
+	/// Return true if the block contain logs between startDate (inclusive) and endDate (exclusive)
+	bool overlapDates(uint32 startDate, uint32 endDate) const
+	{
+		return MinDate <= MaxDate && MinDate < endDate && MaxDate >= startDate;
+	}
+
+	void serial(NLMISC::IStream &s)
+	{
+		s.serial(Offset);
+		s.serial(CompressedSize);
+		s.serial(Size);
+		s.serial(NbLogs);
+		s.serial(MinDate);
+		s.serial(MaxDate);
+		for (uint i=0; i<EntityFilterWords; ++i)
+			s.serial(EntityFilter[i]);
+	}
+
+private:
+	static uint32 getEntityBit(const NLMISC::CEntityId &eid)
+	{
+		// NB : the dynamic id is not part of the entity id comparison, so it must
+		// not be part of the hash
+		uint64 id = eid.getUniqueId();
+		uint32 hash = (uint32)(id ^ (id >> 32)) * 2654435761u;
+		return hash >> (32-11);
+	}
+};
+
+
+/** Writer of a log segment file.
+ *	A segment store the logs in blocks that are compressed separately. Each block
+ *	is a log storage (see CLogStorage::serialLogs()) followed by its sorted
+ *	indexes (see CLogStorage::serialIndexes()). The blocks only begin and end
+ *	outside of any log context, so that the context of a log are always in the
+ *	same block as the log.
+ *	The index at the end of the file give the summary of each block.
+ *
+ *	File layout :
+ *		- header : magic, version, log definitions
+ *		- the compressed blocks
+ *		- index : the block summaries
+ *		- footer : position of the index, magic
+ */
+class CLogSegmentWriter
+{
+public:
+	CLogSegmentWriter(const TLogDefinitions &logDefs);
+	~CLogSegmentWriter();
+
+	/// Start writing a segment (in a temporary file until closed)
+	bool open(const std::string &fileName);
+
+	/// Add a log to the current block, the block is written when it is full
+	void addLog(const TLogEntry &logEntry);
+
+	/// Write a complete log storage as a block (the storage must have the log definitions of the segment)
+	void writeBlock(const CLogStorage &logs);
+
+	/// Write the last block and the index, then rename the file. Return false if the file can't be written.
+	bool close();
+
+	uint32 getNbLogs() const		{ return _NbLogs; }
+	uint32 getNbBlocks() const		{ return (uint32)_Blocks.size(); }
+
+private:
+	/// The log definitions
+	const TLogDefinitions			&_LogDefs;
+	/// The block being filled
+	CLogStorage						_Block;
+	/// The output file
+	NLMISC::COFile					_File;
+	std::string						_FileName;
+	/// The summary of the blocks already written
+	std::vector<TLogBlockSummary>	_Blocks;
+	/// Buffer for the compressed blocks
+	std::vector<uint8>				_Buffer;
+	uint32							_NbLogs;
+	bool							_Failed;
+};
+
+
+/** Reader of a log segment file.
+ *	The file is memory mapped, only the header and the index are read
+ *	when it is opened, then each block is uncompressed on demand.
+ */
+class CLogSegmentReader
+{
+public:
+	CLogSegmentReader();
+	~CLogSegmentReader();
+
+	/// Map a segment file and read its index. Return false if the file is not a valid segment.
+	bool open(const std::string &fileName);
+
+	void close();
+
+	const TLogDefinitions &getLogDefs() const						{ return _LogDefs; }
+	uint32 getNbBlocks() const										{ return (uint32)_Blocks.size(); }
+	const TLogBlockSummary &getBlockSummary(uint32 index) const		{ return _Blocks[index]; }
+
+	/// Read a block in a log storage. The storage must have the log definitions of
+	/// the segment (see getLogDefs()). Return false if the block is corrupted.
+	bool loadBlock(uint32 index, CLogStorage &logs);
+
+private:
+	/// The mapped file (or the file content if it can't be mapped)
+	NLMISC::CMappedFile				_File;
+	const uint8						*_Data;
+	uint32							_Size;
+
+	/// The version of the segment file format
+	uint32							_Version;
+	TLogDefinitions					_LogDefs;
+	std::vector<TLogBlockSummary>	_Blocks;
+	/// Buffer for the uncompressed blocks
+	std::vector<uint8>				_Buffer;
+};
+
+#endif //LOG_SEGMENT_H
@@ -97,6 +97,19 @@ public:
 	/// The tables of all log params
 	TParamsTables	_ParamTables;
 
+	typedef std::map<TLogParamId, TParamIndex>	TParamsOwners;
+
+	/// For each param table, the index of the log entry that use each value
+	/// of the table (this is the column that link a param value back to its log)
+	TParamsOwners	_ParamOwners;
+
+	/// For the entity id and item id param tables, the index of the values
+	/// sorted by value (only for the blocks of the log segments, see serialIndexes())
+	TParamsOwners	_SortedParams;
+
+	/// The index of the log entries sorted by date (only for the blocks of the log segments, see serialIndexes())
+	TParamIndex		_DateIndex;
+
 
 	/// The log definition
 	TLogDefinitions			_LogDefs;
@@ -192,36 +205,12 @@ public:
 		saveLogfile("minutely_");
 	}
 
-	// Save all logs in memory on disk
-	void saveHourly(const TLogInfos &logInfos)
-	{
-		uint32 now = NLMISC::CTime::getSecondsSince1970();
-
-//		// go back to up to 1 minute ago
-//		TLogInfos::const_reverse_iterator it = logInfos.rbegin();
-//		while (it != logInfos.rend() && 
-//			(it->LogInfo.getTimeStamp() == 0
-//			|| it->LogInfo.getTimeStamp() == ~0
-//			|| it->LogInfo.getTimeStamp() > now-60*60))
-//			++it;
-
-		TLogInfos::const_iterator first(logInfos.begin()), last(logInfos.end());
-		// prepare the logs to save
-		for (; first != last; ++first)
-		{
-			storeLog(*first);
-		}
-
-		// write the container on disk
-		saveLogfile("hourly_");
-	}
-
-	void saveLogfile(const std::string &prefix)
+	/** Build the name of a log file from the current date (and create the log directory if needed).
+	 *	The date has a resolution of one second, a counter is added to the name
+	 *	if a file (or a file being written) already has this name.
+	 */
+	static std::string buildLogFileName(const std::string &prefix, const std::string &extension)
 	{
-		if (_DiskLogEntries.empty())
-			// no log, do not store anything
-			return;
-
 		NLMISC::CSString fileName;
 
 		// set the save directory and create it if needed
@@ -235,7 +224,24 @@ public:
 
 		strftime(dateStr, 1024, "%Y-%m-%d_%H-%M-%S", _tm);
 		
-		fileName << prefix << dateStr <<".binlog";
+		fileName << prefix << dateStr;
+
+		std::string baseName = fileName;
+		for (uint i=1; NLMISC::CFile::fileExists(fileName+extension) || NLMISC::CFile::fileExists(fileName+extension+".tmp"); ++i)
+		{
+			fileName = baseName+NLMISC::toString("_%u", i);
+		}
+
+		return fileName+extension;
+	}
+
+	void saveLogfile(const std::string &prefix)
+	{
+		if (_DiskLogEntries.empty())
+			// no log, do not store anything
+			return;
+
+		std::string fileName = buildLogFileName(prefix, ".binlog");
 
 		nldebug("Storing %u logs in file %s", _DiskLogEntries.size(), fileName.c_str());
 
@@ -259,6 +265,11 @@ public:
 
 		// create a log entry
 		TDiskLogEntry dle;
+		uint32 entryIndex = (uint32)_DiskLogEntries.size();
+
+		// the sorted indexes are no more valid
+		_SortedParams.clear();
+		_DateIndex.clear();
 
 		// set the shard id
 		dle.ShardId = logEntry.ShardId;
@@ -288,6 +299,7 @@ public:
 			TParamsTable &pt = _ParamTables[lpi];
 			uint32 index = (uint32)pt.size();
 			pt.push_back(pv);
+			_ParamOwners[lpi].push_back(entryIndex);
 
 			// store the index in the persistent log entry
 			dle.ParamIndex.push_back(index);
@@ -304,12 +316,14 @@ public:
 			
 			// get the parameter table for the type of parameter
 			TParamsTable &pt = _ParamTables[lpi];
+			TParamIndex &owners = _ParamOwners[lpi];
 
 			std::list < LGS::TParamValue >::const_iterator first(lpv.getParams().begin()), last(lpv.getParams().end());
 			for (; first != last; ++first)
 			{
 				uint32 index = (uint32)pt.size();
 				pt.push_back(*first);
+				owners.push_back(entryIndex);
 
 				// store the index in the persistent log entry
 				dle.ListParamIndex[i].push_back(index);
@@ -321,16 +335,45 @@ public:
 		_DiskLogEntries.push_back(dle);
 	}
 
+	TParamIndex *findParamOwners(const LGS::TParamDesc &pd)
+	{
+		TLogParamId lpi;
+		lpi.ParamName = pd.getName();
+		lpi.ParamType = pd.getType();
+
+		TParamsOwners::iterator it(_ParamOwners.find(lpi));
+		if (it == _ParamOwners.end())
+			return NULL;
+		return &it->second;
+	}
+
+	/// Remove all the logs (but keep the log definitions and the context stack)
+	void clearLogs()
+	{
+		_DiskLogEntries.clear();
+		_ParamTables.clear();
+		_ParamOwners.clear();
+		_SortedParams.clear();
+		_DateIndex.clear();
+	}
+
 	void serial(NLMISC::IStream &s)
 	{
 		// serial the log definition
 		s.serialCont(_LogDefs);
+		serialLogs(s);
+	}
+
+	/// Serial the logs without the log definition (the log definition must be set before reading)
+	void serialLogs(NLMISC::IStream &s)
+	{
 		// serial the log entryes
 		s.serialCont(_DiskLogEntries);
 		// serial the param tables
 		uint32 nbTable = (uint32)_ParamTables.size();
 		if (s.isReading())
 		{
+			_ParamTables.clear();
 			s.serial(nbTable);
 			for (uint i=0; i<nbTable; ++i)
 			{
@@ -342,6 +385,8 @@ public:
 
 				s.serialCont(pt);
 			}
+
+			buildParamOwners();
 		}
 		else
 		{
@@ -357,6 +402,210 @@ public:
 		}
 	}
 
+	/** Serial the sorted indexes of the logs (after serialLogs()).
+	 *	The indexes are built when writing, so that they are sorted only once
+	 *	when the logs are saved in a segment instead of each time the logs are
+	 *	queried (a storage is loaded for a single query).
+	 */
+	void serialIndexes(NLMISC::IStream &s)
+	{
+		if (s.isReading())
+		{
+			_SortedParams.clear();
+			uint32 nbIndex;
+			s.serial(nbIndex);
+			for (uint i=0; i<nbIndex; ++i)
+			{
+				TLogParamId lpi;
+				s.serial(lpi);
+				TParamIndex &sorted = _SortedParams[lpi];
+				s.serialCont(sorted);
+
+				TParamsTables::const_iterator it(_ParamTables.find(lpi));
+				if (it == _ParamTables.end() || !checkIndex(sorted, (uint32)it->second.size()))
+					throw NLMISC::EStream("invalid param index");
+			}
+
+			s.serialCont(_DateIndex);
+			if (!checkIndex(_DateIndex, (uint32)_DiskLogEntries.size()))
+				throw NLMISC::EStream("invalid date index");
+		}
+		else
+		{
+			TParamsOwners sortedParams;
+			TParamsTables::const_iterator first(_ParamTables.begin()), last(_ParamTables.end());
+			for (; first != last; ++first)
+			{
+				const TLogParamId &lpi = first->first;
+				if (lpi.ParamType != LGS::TSupportedParamType::spt_entityId
+					&& lpi.ParamType != LGS::TSupportedParamType::spt_itemId)
+					continue;
+
+				// values of another type don't have a defined order with the others
+				const TParamsTable &pt = first->second;
+				uint j;
+				for (j=0; j<pt.size() && pt[j].getType() == lpi.ParamType; ++j)
+					;
+				if (j != pt.size())
+					continue;
+
+				TParamIndex &sorted = sortedParams[lpi];
+				sorted.resize(pt.size());
+				for (uint32 k=0; k<sorted.size(); ++k)
+					sorted[k] = k;
+				std::sort(sorted.begin(), sorted.end(), TParamValueLess(pt));
+			}
+
+			uint32 nbIndex = (uint32)sortedParams.size();
+			s.serial(nbIndex);
+			TParamsOwners::iterator sfirst(sortedParams.begin()), slast(sortedParams.end());
+			for (; sfirst != slast; ++sfirst)
+			{
+				nlWrite(s, serial, sfirst->first);
+				s.serialCont(sfirst->second);
+			}
+
+			TParamIndex dateIndex(_DiskLogEntries.size());
+			for (uint32 i=0; i<dateIndex.size(); ++i)
+				dateIndex[i] = i;
+			// the logs are almost sorted by date, only the context logs are not
+			std::stable_sort(dateIndex.begin(), dateIndex.end(), TLogDateLess(_DiskLogEntries));
+			s.serialCont(dateIndex);
+		}
+	}
+
+	/// Check that a loaded index is a permutation of [0, size)
+	static bool checkIndex(const TParamIndex &index, uint32 size)
+	{
+		if (index.size() != size)
+			return false;
+		std::vector<bool> used(size, false);
+		for (uint i=0; i<index.size(); ++i)
+		{
+			if (index[i] >= size || used[index[i]])
+				return false;
+			used[index[i]] = true;
+		}
+		return true;
+	}
+
+	/// Rebuild the param owner columns from the log entries (after loading)
+	void buildParamOwners()
+	{
+		_ParamOwners.clear();
+		_SortedParams.clear();
+		_DateIndex.clear();
+
+		TParamsTables::const_iterator first(_ParamTables.begin()), last(_ParamTables.end());
+		for (; first != last; ++first)
+		{
+			_ParamOwners[first->first].resize(first->second.size(), ~0);
+		}
+
+		// for each log definition, retrieve the owner column of each param
+		// once instead of looking it up for each log entry
+		std::vector<std::vector<TParamIndex*> >	paramOwners(_LogDefs.size());
+		std::vector<std::vector<TParamIndex*> >	listParamOwners(_LogDefs.size());
+		for (uint i=0; i<_LogDefs.size(); ++i)
+		{
+			const LGS::TLogDefinition &ld = _LogDefs[i];
+			for (uint j=0; j<ld.getParams().size(); ++j)
+				paramOwners[i].push_back(findParamOwners(ld.getParams()[j]));
+			for (uint j=0; j<ld.getListParams().size(); ++j)
+				listParamOwners[i].push_back(findParamOwners(ld.getListParams()[j]));
+		}
+
+		for (uint32 i=0; i<_DiskLogEntries.size(); ++i)
+		{
+			const TDiskLogEntry &dle = _DiskLogEntries[i];
+			if (dle.LogType >= _LogDefs.size())
+				continue;
+
+			const std::vector<TParamIndex*> &po = paramOwners[dle.LogType];
+			for (uint j=0; j<dle.ParamIndex.size() && j<po.size(); ++j)
+			{
+				if (po[j] != NULL && dle.ParamIndex[j] < po[j]->size())
+					(*po[j])[dle.ParamIndex[j]] = i;
+			}
+
+			const std::vector<TParamIndex*> &lpo = listParamOwners[dle.LogType];
+			for (uint j=0; j<dle.ListParamIndex.size() && j<lpo.size(); ++j)
+			{
+				if (lpo[j] == NULL)
+					continue;
+				const TParamIndex &indexes = dle.ListParamIndex[j];
+				for (uint k=0; k<indexes.size(); ++k)
+				{
+					if (indexes[k] < lpo[j]->size())
+						(*lpo[j])[indexes[k]] = i;
+				}
+			}
+		}
+	}
+
+	/// Return the owner column of a param table, or NULL if there is no such table
+	const TParamIndex *getParamOwners(const TLogParamId &lpi) const
+	{
+		TParamsOwners::const_iterator it(_ParamOwners.find(lpi));
+		if (it == _ParamOwners.end())
+			return NULL;
+		return &it->second;
+	}
+
+	/// Compare param table values by index, or with a reference value
+	struct TParamValueLess
+	{
+		const TParamsTable	&Table;
+
+		TParamValueLess(const TParamsTable &table)
+			:	Table(table)
+		{
+		}
+
+		bool operator () (uint32 left, uint32 right) const				{ return Table[left] < Table[right]; }
+		bool operator () (uint32 left, const LGS::TParamValue &right) const	{ return Table[left] < right; }
+		bool operator () (const LGS::TParamValue &left, uint32 right) const	{ return left < Table[right]; }
+	};
+
+	/** Return the index of the values of a param table sorted by value.
+	 *	Only the entity id and item id tables of the blocks loaded from a log
+	 *	segment are indexed, NULL is returned for the others tables (or if a
+	 *	table contains values of another type), they must be scanned.
+	 */
+	const TParamIndex *getSortedParamIndex(const TLogParamId &lpi) const
+	{
+		TParamsOwners::const_iterator it(_SortedParams.find(lpi));
+		if (it == _SortedParams.end())
+			return NULL;
+
+		return &it->second;
+	}
+
+	/// Compare log entries by date, or with a reference date
+	struct TLogDateLess
+	{
+		const std::vector<TDiskLogEntry>	&Entries;
+
+		TLogDateLess(const std::vector<TDiskLogEntry> &entries)
+			:	Entries(entries)
+		{
+		}
+
+		bool operator () (uint32 left, uint32 right) const		{ return Entries[left].LogDate < Entries[right].LogDate; }
+		// NB : the reference date is passed as a 64 bits value to not be taken for an entry index
+		bool operator () (uint32 left, const uint64 &right) const	{ return Entries[left].LogDate < right; }
+		bool operator () (const uint64 &left, uint32 right) const	{ return left < Entries[right].LogDate; }
+	};
+
+	/// Return the index of the log entries sorted by date, NULL if the logs are not indexed (they must be scanned)
+	const TParamIndex *getDateIndex() const
+	{
+		if (_DiskLogEntries.empty() || _DateIndex.size() != _DiskLogEntries.size())
+			return NULL;
+
+		return &_DateIndex;
+	}
+
 	void dumpLogs(NLMISC::CLog &log)
 	{
 		for (uint i=0; i<_DiskLogEntries.size(); ++i)
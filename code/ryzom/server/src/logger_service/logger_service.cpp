@@ -35,6 +35,7 @@
 #include "logger_service.h"
 #include "log_query.h"
 #include "log_storage.h"
+#include "log_segment.h"
 
 #ifdef NL_OS_WINDOWS
 #	ifndef NL_COMP_MINGW
@@ -53,6 +54,7 @@ using namespace LGS;
 CVariable<string> LQLState("lgs", "LQLState", "The current Query state", "");
 CVariable<uint32> LastFinishedQuery("lgs", "LastFinishedQuery", "The number of the last finished request", 0);
 CVariable<string> LogQueryResultFile("lgs", "LogQueryResultFile", "The file used to output the query result", "log_query_result.txt");
+CVariable<uint32> MaxLogsInMemory("lgs", "MaxLogsInMemory", "The number of logs kept in memory before they are saved in a log segment file", 1000000, 0, true);
 
 
 extern void admin_modules_forceLink();
@@ -275,6 +277,8 @@ class CLoggerServiceMod
 	uint32						_LastMinuteOutput;
 	/// date of last 'hourly' consolidation
 	uint32						_LastHourlyProcess;
+	/// date of the last failure to save the logs in memory in a segment file
+	uint32						_LastSegmentSaveFailure;
 
 	/// Line counter of current request being written to backup service
 	uint32						_WriteLineCounter;
@@ -286,6 +290,8 @@ class CLoggerServiceMod
 	{
 		MinuteDelay = 60,
 		HourlyDelay = 60*60,
+		/// Min delay before saving again the logs in memory when there are too many of them
+		SegmentSaveRetryDelay = 60,
 	};
 
 	enum TQueryCommand
@@ -403,6 +409,7 @@ public:
 			_LogId(0),
 			_LastMinuteOutput(0),
 			_LastHourlyProcess(0),
+			_LastSegmentSaveFailure(0),
 			_LastQueryNumber(0),
 			_WriteLineCounter(0),
 			_QueryThread(NULL)
@@ -456,7 +463,10 @@ public:
 	{
 		uint32 now = CTime::getSecondsSince1970();
 
-		if (now > _LastHourlyProcess+HourlyDelay)
+		// after a failed save, too many logs in memory do not trigger a new try at each update
+		bool tooManyLogs = _LogInfosSize > MaxLogsInMemory && now > _LastSegmentSaveFailure+SegmentSaveRetryDelay;
+
+		if (now > _LastHourlyProcess+HourlyDelay || tooManyLogs)
 		{
 			// do the hourly process
 
@@ -579,10 +589,16 @@ public:
 	void doHourlyProcess()
 	{
 		// 1- generate the hourly output
-		CLogStorage ls(_LogDefs);
-		ls.saveHourly(_LogInfos);
+		if (!saveLogSegment(_LogInfos))
+		{
+			// keep the minutely outputs and the logs in memory, the save will
+			// be retried at the next hourly process (or at the next start from the minutely files)
+			nlwarning("Failed to save the hourly log segment, %u logs are kept in memory", _LogInfosSize);
+			_LastSegmentSaveFailure = CTime::getSecondsSince1970();
+			return;
+		}
 		// 2- remove minute outputs
-		std::string logRoot = ls.getLogRoot();
+		std::string logRoot = CLogStorage::getLogRoot();
 		vector<string> files;
 		CPath::getPathContent(logRoot, false, false, true, files, NULL, true);
 		
@@ -596,28 +612,82 @@ public:
 		}
 		// 3- cleanup logs from memory
 		_LogInfos.clear();
+		_LogInfosSize = 0;
+	}
+
+	/// Save logs in a new log segment file. Return false if the file can't be written.
+	bool saveLogSegment(const TLogInfos &logInfos)
+	{
+		if (logInfos.empty())
+			// no log, do not store anything
+			return true;
+
+		CLogSegmentWriter writer(_LogDefs);
+		if (!writer.open(CLogStorage::buildLogFileName("hourly_", ".logseg")))
+			return false;
+
+		TLogInfos::const_iterator first(logInfos.begin()), last(logInfos.end());
+		for (; first != last; ++first)
+		{
+			writer.addLog(*first);
+		}
+
+		return writer.close();
 	}
 
 
 	/// Rebuild the last 'hourly' from residual minutely files found on disk
 	void consolidatePreviousFiles()
 	{
-		CLogStorage ls;
-
-		std::string logRoot = ls.getLogRoot();
+		std::string logRoot = CLogStorage::getLogRoot();
 		vector<string> files;
 		CPath::getPathContent(logRoot, false, false, true, files, NULL, true);
-		
+
+		vector<string> minutelyFiles;
 		for (uint i=0; i<files.size(); ++i)
 		{
 			if (files[i].find("minutely") != string::npos && files[i].find(".binlog") == files[i].size()-7)
 			{
-				ls.loadLogs(files[i]);
+				minutelyFiles.push_back(files[i]);
 			}
 		}
 
-		// save all logs in one file
-		ls.saveLogfile("hourly_");
+		if (!minutelyFiles.empty())
+		{
+			// the file names contain the date, sort them to keep the logs in order
+			sort(minutelyFiles.begin(), minutelyFiles.end());
+
+			// save all logs in one segment, one block per file. The segment use
+			// the log definition of the first file.
+			CLogStorage ls;
+			ls.loadLogs(minutelyFiles[0]);
+			TLogDefinitions logDefs = ls._LogDefs;
+
+			CLogSegmentWriter writer(logDefs);
+			if (!writer.open(CLogStorage::buildLogFileName("hourly_", ".logseg")))
+				// keep the minutely files for the next start
+				return;
+
+			for (uint i=0; i<minutelyFiles.size(); ++i)
+			{
+				if (i > 0)
+					ls.loadLogs(minutelyFiles[i]);
+
+				if (ls._LogDefs == logDefs)
+				{
+					writer.writeBlock(ls);
+				}
+				else
+				{
+					nlwarning("Log file '%s' use another log format, it is saved in its own file", minutelyFiles[i].c_str());
+					ls.saveLogfile("hourly_");
+				}
+			}
+
+			if (!writer.close())
+				// keep the minutely files for the next start
+				return;
+		}
 
 		// delete minute files (even those .tmp file left by failed copy)
 		for (uint i=0; i<files.size(); ++i)
@@ -774,16 +844,15 @@ public:
 		}
 	}
 
-	void queryLogs(const std::string queryString, const CLogStorage &ls, list<string> &result, uint32 &totalLogParsed, uint32 &totalLogSelected, uint32 &totalLogOutput)
+	void queryLogs(CParsedQuery &query, const CLogStorage &ls, list<string> &result, uint32 &totalLogParsed, uint32 &totalLogSelected, uint32 &totalLogOutput)
 	{
 		uint32 now= CTime::getSecondsSince1970();
-		CQueryParser qp(ls._LogDefs);
-		CQueryParser::TParserResult pr = qp.parseQuery(queryString, false);
+		TQueryNode *queryTree = query.getQueryTree(ls._LogDefs);
 
-		if (pr.QueryTree.get() != NULL)
+		if (queryTree != NULL)
 		{
 			totalLogParsed += (uint32)ls._DiskLogEntries.size();
-			TLogEntries logs = pr.QueryTree->evalNode(ls);
+			TLogEntries logs = queryTree->evalNode(ls);
 			totalLogSelected += (uint32)logs.size();
 
 			// add the context log to the selection
@@ -802,7 +871,7 @@ public:
 					--id;
 					if (ls._DiskLogEntries[id].LogDate == 0)
 					{
-						if (stackSize == lowerStackSize || pr.FullContext)
+						if (stackSize == lowerStackSize || query.isFullContext())
 							contextLogs.push_back(id);
 						--stackSize;
 						lowerStackSize = min(lowerStackSize, stackSize);
@@ -811,10 +880,10 @@ public:
 					{
 						++stackSize;
 
-						if (pr.FullContext)
+						if (query.isFullContext())
 							contextLogs.push_back(id);
 					}
-					else if (pr.FullContext)
+					else if (query.isFullContext())
 					{
 						contextLogs.push_back(id);
 					}
@@ -829,17 +898,17 @@ public:
 					if (ls._DiskLogEntries[id].LogDate == 0)
 					{
 						++stackSize;
-						if (pr.FullContext)
+						if (query.isFullContext())
 							contextLogs.push_back(id);
 					}
 					else if (ls._DiskLogEntries[id].LogDate == ~0)
 					{
-						if (stackSize == lowerStackSize || pr.FullContext)
+						if (stackSize == lowerStackSize || query.isFullContext())
 							contextLogs.push_back(id);
 						--stackSize;
 						lowerStackSize = min(lowerStackSize, stackSize);
 					}
-					else if (pr.FullContext)
+					else if (query.isFullContext())
 					{
 						contextLogs.push_back(id);
 					}
@@ -917,6 +986,45 @@ public:
 		}
 	}
 
+	/// Run a query on the blocks of a log segment file that can match it
+	void querySegment(CParsedQuery &query, const std::string &fileName, const TTimeLine &timeLine, list<string> &result, uint32 &totalLogParsed, uint32 &totalLogSelected, uint32 &totalLogOutput, uint32 &totalBlockRead, uint32 &totalBlockSkipped)
+	{
+		CLogSegmentReader reader;
+		if (!reader.open(fileName))
+			return;
+
+		// the query tree used to check the block summaries
+		TQueryNode *queryTree = query.getQueryTree(reader.getLogDefs());
+		if (queryTree == NULL)
+			return;
+
+		CLogStorage ls(reader.getLogDefs());
+		for (uint32 i=0; i<reader.getNbBlocks(); ++i)
+		{
+			const TLogBlockSummary &summary = reader.getBlockSummary(i);
+
+			// check the timeline limits
+			bool inTimeLine = false;
+			for (uint j=0; j<timeLine.size() && !inTimeLine; ++j)
+			{
+				inTimeLine = summary.overlapDates(timeLine[j].StartDate, timeLine[j].EndDate);
+			}
+
+			if (!inTimeLine || queryTree->skipBlock(summary))
+			{
+				// no log can match inside this block
+				++totalBlockSkipped;
+				continue;
+			}
+
+			if (!reader.loadBlock(i, ls))
+				continue;
+
+			++totalBlockRead;
+			queryLogs(query, ls, result, totalLogParsed, totalLogSelected, totalLogOutput);
+		}
+	}
+
 	void executeQuery(std::string query, uint32 queryNumber)
 	{
 		CQueryParser optionsQp(_LogDefs);
@@ -944,16 +1052,17 @@ public:
 			uint32 totalLogOutput =0;
 			uint32 totalFileSelected =0;
 			uint32 totalFileFound =0;
+			uint32 totalBlockRead =0;
+			uint32 totalBlockSkipped =0;
 
 			// write the query at the start of the result set
 			result.push_back(query);
 			result.push_back(string("================================================================================"));
 
-			// prepare a request tree for file date checking
-			CQueryParser dateQp(_LogDefs);
-			CQueryParser::TParserResult parserResult = dateQp.parseQuery(query, false);
+			// parse the query once, the request tree is also used for file date checking
+			CParsedQuery parsedQuery(query);
 			// build the time line for the request
-			TTimeLine timeLine = parserResult.QueryTree->evalDate();
+			TTimeLine timeLine = parsedQuery.getQueryTree(_LogDefs)->evalDate();
 
 			if (timeLine.empty())
 			{
@@ -988,14 +1097,14 @@ public:
 
 			// first loop to select the file to read according to the date 
 //			set<uint32>	selectedFileIndex;
-			/// This is the ordered by date file selection
-			map<uint32, uint32> selectedFile;
+			/// This is the ordered by date file selection (several files can have the same date)
+			multimap<uint32, uint32> selectedFile;
 
 			uint32 previousDate = 0;
 
 			for (uint i=0; i<files.size(); ++i)
 			{
-				if (files[i].substr(files[i].size()-7) == ".binlog" 
+				if ((files[i].substr(files[i].size()-7) == ".binlog" || files[i].substr(files[i].size()-7) == ".logseg")
 					&& files[i].find("hourly_") != string::npos)
 				{
 					// extract the date from the file name
@@ -1064,27 +1173,34 @@ public:
 
 			totalFileSelected = (uint32)selectedFile.size();
 			// now, do the real job, query inside each selected file in ascending date order
-			map<uint32, uint32>::iterator first(selectedFile.begin()), last(selectedFile.end());
+			multimap<uint32, uint32>::iterator first(selectedFile.begin()), last(selectedFile.end());
 			for (uint counter=0; first != last; ++first, ++counter)
 			{
 				_QueryStatus.write(TThreadStatus(qs_lql_state, toString("Reading log file %u/%u", counter+1, selectedFile.size())));
 
-				CLogStorage ls(_LogDefs);
-				ls.loadLogs(files[first->second]);
-
-				// check the timeline limits
-				if (!ls._DiskLogEntries.empty() 
-					&& 
-						(ls._DiskLogEntries.begin()->LogDate >  timeLine.rbegin()->EndDate
-						|| ls._DiskLogEntries.rbegin()->LogDate <  timeLine.begin()->StartDate)
-						)
+				if (CFile::getExtension(files[first->second]) == "logseg")
 				{
-					// no log can match inside this file
-					continue;
+					querySegment(parsedQuery, files[first->second], timeLine, result, totalLogParsed, totalLogSelected, totalLogOutput, totalBlockRead, totalBlockSkipped);
 				}
+				else
+				{
+					CLogStorage ls(_LogDefs);
+					ls.loadLogs(files[first->second]);
+
+					// check the timeline limits
+					if (!ls._DiskLogEntries.empty() 
+						&& 
+							(ls._DiskLogEntries.begin()->LogDate >  timeLine.rbegin()->EndDate
+							|| ls._DiskLogEntries.rbegin()->LogDate <  timeLine.begin()->StartDate)
+							)
+					{
+						// no log can match inside this file
+						continue;
+					}
 
-				_QueryStatus.write(TThreadStatus(qs_lql_state, toString("Processing log file %u/%u", counter+1, selectedFile.size())));
-				queryLogs(query, ls, result, totalLogParsed, totalLogSelected, totalLogOutput);
+					_QueryStatus.write(TThreadStatus(qs_lql_state, toString("Processing log file %u/%u", counter+1, selectedFile.size())));
+					queryLogs(parsedQuery, ls, result, totalLogParsed, totalLogSelected, totalLogOutput);
+				}
 
 				// check the command channel for interrupt request
 				TThreadCommand qs;
@@ -1109,7 +1225,7 @@ public:
 					}
 				}
 
-				queryLogs(query, ls, result, totalLogParsed, totalLogSelected, totalLogOutput);
+				queryLogs(parsedQuery, ls, result, totalLogParsed, totalLogSelected, totalLogOutput);
 
 				// check the command channel for interrupt request
 				TThreadCommand qs;
@@ -1129,6 +1245,7 @@ public:
 			result.push_back("===============================================================================");
 			result.push_back("Query stats :");
 			result.push_back(toString("%u log files found, %u log file read", totalFileFound, totalFileSelected));
+			result.push_back(toString("%u log blocks read, %u log blocks skipped", totalBlockRead, totalBlockSkipped));
 			result.push_back(toString("%u log parsed, %u log selected, %u log written to output", totalLogParsed, totalLogSelected, totalLogOutput));
 
 
@@ -1490,10 +1607,15 @@ endQuery:
 	NLMISC_CLASS_COMMAND_DECL(saveLogs)
 	{
 		CAutoMutex<CMutex> lock(_LogMutex);
-		CLogStorage ls(_LogDefs);
-		ls.saveHourly(_LogInfos);
+		saveLogSegment(_LogInfos);
 //		ls.storeLogs(0, 0x7fffffff, _LogInfos);
 
+		CLogStorage ls(_LogDefs);
+		TLogInfos::const_iterator first(_LogInfos.begin()), last(_LogInfos.end());
+		for (; first != last; ++first)
+		{
+			ls.storeLog(*first);
+		}
 		ls.dumpLogs(log);
 
 		return true;
@@ -957,6 +957,149 @@ sint32			CDataSetMS::getNbChangesForPropChanges() const
 
 #endif
 
+/*
+ * Set the filter of the changes of a property for a local service
+ */
+void	CDataSetMS::setPropFilter( TPropertyIndex propIndex, NLNET::TServiceId8 serviceId, const CMirrorPropFilter& filter )
+{
+	if ( _PropFilters.size() < (uint)nbProperties() )
+		_PropFilters.resize( nbProperties() );
+
+	if ( filter.acceptsAll() )
+	{
+		_PropFilters[propIndex].erase( serviceId );
+		return;
+	}
+
+	if ( filter.hasArea() && (! setupPosPropIndices()) )
+		nlwarning( "Dataset %s has no X and Y sint32 properties, the area of the filter of %s will be ignored", name().c_str(), getPropertyName( propIndex ).c_str() );
+	_PropFilters[propIndex][serviceId] = filter;
+}
+
+
+/*
+ * Remove the filters of a local service
+ */
+void	CDataSetMS::removePropFilters( NLNET::TServiceId8 serviceId )
+{
+	for ( uint i=0; i!=_PropFilters.size(); ++i )
+	{
+		_PropFilters[i].erase( serviceId );
+	}
+}
+
+
+/*
+ * Get the filters of the local services reading a property (empty if one of them has no filter)
+ */
+void	CDataSetMS::getLocalPropFilters( TPropertyIndex propIndex, std::vector<CMirrorPropFilter>& filters ) const
+{
+	filters.clear();
+	const TSubscriberListForProp& propTrackers = _SubscribersByProperty[propIndex];
+	TSubscriberListForProp::const_iterator it;
+	for ( it=propTrackers.begin(); it!=propTrackers.end(); ++it )
+	{
+		if ( (*it).isLocal() && (! (*it).isWriteOnly()) )
+		{
+			const CMirrorPropFilter *filter = getPropFilter( propIndex, (*it).destServiceId() );
+			if ( ! filter )
+			{
+				// This service needs all the rows
+				filters.clear();
+				return;
+			}
+			filters.push_back( *filter );
+		}
+	}
+}
+
+
+/*
+ * Set the filters of the changes of a property sent to a remote MS
+ */
+void	CDataSetMS::setRemotePropFilters( TPropertyIndex propIndex, NLNET::TServiceId8 msId, const std::vector<CMirrorPropFilter>& filters )
+{
+	if ( _RemotePropFilters.size() < (uint)nbProperties() )
+		_RemotePropFilters.resize( nbProperties() );
+
+	if ( filters.empty() )
+	{
+		_RemotePropFilters[propIndex].erase( msId );
+		return;
+	}
+
+	CRemotePropFilter& remoteFilter = _RemotePropFilters[propIndex][msId];
+	remoteFilter.Filters = filters;
+	remoteFilter.HasArea = false;
+	for ( uint i=0; i!=filters.size(); ++i )
+	{
+		if ( filters[i].hasArea() )
+			remoteFilter.HasArea = true;
+	}
+	if ( remoteFilter.HasArea && (! setupPosPropIndices()) )
+	{
+		nlwarning( "Dataset %s has no X and Y sint32 properties, the area of the remote filter of %s will be ignored", name().c_str(), getPropertyName( propIndex ).c_str() );
+		remoteFilter.HasArea = false;
+	}
+	remoteFilter.AcceptedRows.clear();
+	if ( remoteFilter.HasArea )
+		remoteFilter.AcceptedRows.resize( maxNbRows(), false );
+}
+
+
+/*
+ * Remove the filters of a remote MS
+ */
+void	CDataSetMS::removeRemotePropFilters( NLNET::TServiceId8 msId )
+{
+	for ( uint i=0; i!=_RemotePropFilters.size(); ++i )
+	{
+		_RemotePropFilters[i].erase( msId );
+	}
+}
+
+
+/*
+ * Record the row in the trackers of the other filtered properties to the remote MS
+ */
+void	CDataSetMS::recordRowForRemoteMS( TDataSetIndex entityIndex, NLNET::TServiceId8 msId, TPropertyIndex exceptPropIndex )
+{
+	for ( TPropertyIndex propIndex=0; propIndex!=(TPropertyIndex)_RemotePropFilters.size(); ++propIndex )
+	{
+		if ( propIndex == exceptPropIndex )
+			continue;
+		TRemotePropFilters::iterator it = _RemotePropFilters[propIndex].find( msId );
+		if ( (it == _RemotePropFilters[propIndex].end()) || (*it).second.AcceptedRows.empty() || (*it).second.AcceptedRows[entityIndex] )
+			continue;
+
+		// Don't record the entry again when the change is pushed
+		(*it).second.AcceptedRows[entityIndex] = true;
+		CChangeTrackerMS *tracker = findPropTracker( propIndex, msId );
+		if ( tracker && tracker->isAllocated() )
+			tracker->recordChange( entityIndex );
+	}
+}
+
+
+/*
+ * Find the position properties used by the filters with an area
+ */
+bool	CDataSetMS::setupPosPropIndices()
+{
+	// The position of the rows is given by X and Y
+	_XPropIndex = getPropertyIndex( "X" );
+	_YPropIndex = getPropertyIndex( "Y" );
+	if ( (_XPropIndex == INVALID_PROPERTY_INDEX) || (_YPropIndex == INVALID_PROPERTY_INDEX) ||
+		 (getPropType( _XPropIndex ) != TypeSint32) || (getPropType( _YPropIndex ) != TypeSint32) )
+	{
+		_XPropIndex = INVALID_PROPERTY_INDEX;
+		_YPropIndex = INVALID_PROPERTY_INDEX;
+		return false;
+	}
+	return true;
+}
+
+
 /*
  * Empty a list without knowing the type of elements
  */
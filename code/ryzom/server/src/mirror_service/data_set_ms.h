@@ -700,6 +700,31 @@ typedef std::vector< CChangeTrackerMS > TSubscriberListForProp;
 typedef std::vector< CChangeTrackerMS > TSubscriberListForEnt;
 typedef std::vector< CChangeTrackerMS* > TDestTrackersForDelta; // must not be kept when subscriber lists changed (pointers invalidated by a possible reallocation)
 
+/// Filters of a property, by local service
+typedef std::map< NLNET::TServiceId8, CMirrorPropFilter > TPropFilters;
+
+/// Filters corresponding to TDestTrackersForDelta (NULL if no filter)
+typedef std::vector< const CMirrorPropFilter* > TDestFiltersForDelta;
+
+/**
+ * Filters of the changes of a property sent to a remote MS, i.e. the filters of the services
+ * reading the property on the remote machine. A row is sent if one of them accepts it.
+ */
+struct CRemotePropFilter
+{
+	/// Filters of the remote services
+	std::vector<CMirrorPropFilter>	Filters;
+
+	/// Rows accepted when their last change was pushed (only if one of the filters has an area)
+	std::vector<bool>				AcceptedRows;
+
+	/// True if one of the filters has an area
+	bool							HasArea;
+};
+
+/// Filters of a property, by remote MS
+typedef std::map< NLNET::TServiceId8, CRemotePropFilter > TRemotePropFilters;
+
 // Indexed by TPropertyIndex
 typedef std::vector< TSubscriberListForProp > TSubscriberLists;
 
@@ -724,7 +749,7 @@ class CDataSetMS : public CDataSetBase
 public:
 	
 	/// Constructor
-	CDataSetMS() : _MaxOutBandwidth(1024*1024), _NbLocalWriterProps(0), _BindingCountsToSet(NULL) /*, NbOnlineEntities(0)*/ {}
+	CDataSetMS() : _MaxOutBandwidth(1024*1024), _NbLocalWriterProps(0), _XPropIndex(INVALID_PROPERTY_INDEX), _YPropIndex(INVALID_PROPERTY_INDEX), _BindingCountsToSet(NULL) /*, NbOnlineEntities(0)*/ {}
 
 	/// Initialize
 	void							init( const NLMISC::CSheetId& sheetId, const TDataSetSheet& properties, TPropertiesInMirrorMS& propertyMap );
@@ -947,6 +972,10 @@ public:
 		NLMISC::TGameCycle& localTimestamp = _PropertyContainer.PropertyValueArrays[propIndex].ChangeTimestamps[entityIndex];
 		//if ( timestamp > localTimestamp )
 		{
+			// Keep the position before a move, for the filters with an area
+			sint32 prevPos [2];
+			const sint32 *movedFrom = getPosBeforeChange( entityIndex, propIndex, prevPos );
+
 			// Set value
 			T *ptvalue;
 			getPropPointer( &ptvalue, propIndex, TDataSetRow(entityIndex) );
@@ -960,7 +989,7 @@ public:
 #endif
 
 			// Fill local trackers
-			setChangedLocal( entityIndex, propIndex );
+			setChangedLocal( entityIndex, propIndex, movedFrom );
 		}
 		// Obsolete: now we don't handle the case anymore when a service can overwrite a property value in the same
 		// game cycle as another service.
@@ -1047,16 +1076,133 @@ public:
 		}
 	}
 
-	/// Add the specified property into the local trackers
-	void							setChangedLocal( TDataSetIndex entityIndex, TPropertyIndex propIndex )
+	/**
+	 * Add the specified property into the local trackers (except the ones of the services filtering out the row).
+	 * movedFrom is the position of the row before the change if the change moves it (see getPosBeforeChange()).
+	 */
+	void							setChangedLocal( TDataSetIndex entityIndex, TPropertyIndex propIndex, const sint32 *movedFrom=NULL )
 	{
 #ifdef NL_DEBUG
 		nlassert( (uint32)propIndex < _SubscribersByProperty.size() );
 #endif
-		for ( TDestTrackersForDelta::iterator it=_DestTrackersForDelta.begin(); it!=_DestTrackersForDelta.end(); ++it )
+		if ( _DestFiltersForDelta.empty() )
 		{
-			(*it)->recordChange( entityIndex );
+			for ( TDestTrackersForDelta::iterator it=_DestTrackersForDelta.begin(); it!=_DestTrackersForDelta.end(); ++it )
+			{
+				(*it)->recordChange( entityIndex );
+			}
+		}
+		else
+		{
+			for ( uint i=0; i!=_DestTrackersForDelta.size(); ++i )
+			{
+				if ( (! _DestFiltersForDelta[i]) || rowMatchesFilter( entityIndex, *_DestFiltersForDelta[i], movedFrom ) )
+					_DestTrackersForDelta[i]->recordChange( entityIndex );
+			}
+		}
+	}
+
+	/// Set the filter of the changes of a property for a local service (a filter accepting all the rows removes the filter)
+	void							setPropFilter( TPropertyIndex propIndex, NLNET::TServiceId8 serviceId, const CMirrorPropFilter& filter );
+
+	/// Remove the filters of a local service
+	void							removePropFilters( NLNET::TServiceId8 serviceId );
+
+	/// Get the filters of the local services reading a property (empty if one of them has no filter)
+	void							getLocalPropFilters( TPropertyIndex propIndex, std::vector<CMirrorPropFilter>& filters ) const;
+
+	/// Return true if a local service has a filter on the property
+	bool							hasPropFilters( TPropertyIndex propIndex ) const { return ((uint)propIndex < _PropFilters.size()) && (! _PropFilters[propIndex].empty()); }
+
+	/// Set the filters of the changes of a property sent to a remote MS (no filter removes the filtering)
+	void							setRemotePropFilters( TPropertyIndex propIndex, NLNET::TServiceId8 msId, const std::vector<CMirrorPropFilter>& filters );
+
+	/// Remove the filters of a remote MS
+	void							removeRemotePropFilters( NLNET::TServiceId8 msId );
+
+	/// Return the filters of a property for a remote MS, or NULL if there is none
+	CRemotePropFilter				*getRemotePropFilter( TPropertyIndex propIndex, NLNET::TServiceId8 msId )
+	{
+		if ( (uint)propIndex >= _RemotePropFilters.size() )
+			return NULL;
+		TRemotePropFilters::iterator it = _RemotePropFilters[propIndex].find( msId );
+		return (it != _RemotePropFilters[propIndex].end()) ? &((*it).second) : NULL;
+	}
+
+	/**
+	 * Return true if the change of the row must be sent to the remote MS of the filters.
+	 * With an area, the change that takes the row out of the area is sent as well, and
+	 * enteringRow is set to true when the row enters it (see recordRowForRemoteMS()).
+	 */
+	bool							rowMatchesRemoteFilter( TDataSetIndex entityIndex, CRemotePropFilter& remoteFilter, bool& enteringRow ) const
+	{
+		enteringRow = false;
+		bool accepted = false;
+		for ( uint i=0; i!=remoteFilter.Filters.size(); ++i )
+		{
+			if ( rowMatchesFilter( entityIndex, remoteFilter.Filters[i] ) )
+			{
+				accepted = true;
+				break;
+			}
+		}
+		if ( remoteFilter.HasArea && (accepted != remoteFilter.AcceptedRows[entityIndex]) )
+		{
+			enteringRow = accepted;
+			remoteFilter.AcceptedRows[entityIndex] = accepted;
+			return true;
 		}
+		return accepted;
+	}
+
+	/// Record the row in the trackers of the other filtered properties to the remote MS, to send the values skipped while it was out of the area
+	void							recordRowForRemoteMS( TDataSetIndex entityIndex, NLNET::TServiceId8 msId, TPropertyIndex exceptPropIndex );
+
+	/// Return the filter of a property for a local service, or NULL if there is none
+	const CMirrorPropFilter			*getPropFilter( TPropertyIndex propIndex, NLNET::TServiceId8 serviceId ) const
+	{
+		if ( (uint)propIndex >= _PropFilters.size() )
+			return NULL;
+		TPropFilters::const_iterator it = _PropFilters[propIndex].find( serviceId );
+		return (it != _PropFilters[propIndex].end()) ? &((*it).second) : NULL;
+	}
+
+	/**
+	 * Return true if the row is accepted by the filter. When the change moves the row (movedFrom not NULL),
+	 * it is accepted if the row was or is in the area, so that the service is notified of the move that
+	 * takes the row out of its area.
+	 * NB: X and Y are received in separate blocks, so a move is seen as a move along X then along Y.
+	 */
+	bool							rowMatchesFilter( TDataSetIndex entityIndex, const CMirrorPropFilter& filter, const sint32 *movedFrom=NULL ) const
+	{
+		if ( ! filter.acceptsRow( entityIndex ) )
+			return false;
+		sint32 pos [2];
+		if ( filter.hasArea() && getRowPos( entityIndex, pos ) )
+		{
+			return filter.acceptsPos( pos[0], pos[1] ) ||
+				   (movedFrom && filter.acceptsPos( movedFrom[0], movedFrom[1] ));
+		}
+		return true;
+	}
+
+	/// Get the position of a row used by the filters with an area. Return false if X or Y is not available.
+	bool							getRowPos( TDataSetIndex entityIndex, sint32 *pos ) const
+	{
+		if ( (_XPropIndex == INVALID_PROPERTY_INDEX) || (_YPropIndex == INVALID_PROPERTY_INDEX) ||
+			 (! _PropertyContainer.PropertyValueArrays[_XPropIndex].Values) || (! _PropertyContainer.PropertyValueArrays[_YPropIndex].Values) )
+			return false;
+		pos[0] = ((sint32*)_PropertyContainer.PropertyValueArrays[_XPropIndex].Values)[entityIndex];
+		pos[1] = ((sint32*)_PropertyContainer.PropertyValueArrays[_YPropIndex].Values)[entityIndex];
+		return true;
+	}
+
+	/// If changing the property moves the row and some local trackers have a filter, store the current position of the row in pos and return it (else return NULL)
+	const sint32					*getPosBeforeChange( TDataSetIndex entityIndex, TPropertyIndex propIndex, sint32 *pos ) const
+	{
+		if ( _DestFiltersForDelta.empty() || ((propIndex != _XPropIndex) && (propIndex != _YPropIndex)) )
+			return NULL;
+		return getRowPos( entityIndex, pos ) ? pos : NULL;
 	}
 
 	/*/// Force the property to be reemitted to the remote mirror service
@@ -1170,6 +1316,10 @@ public:
 
 private:
 
+	/// Find the position properties used by the filters with an area. Return false if they are not found.
+	bool					setupPosPropIndices();
+
+
 	/// Indexed by TPropertyIndex
 	TSubscriberLists		_SubscribersByProperty;
 
@@ -1179,6 +1329,18 @@ private:
 	/// Local trackers on which the delta being received must be applied
 	TDestTrackersForDelta	_DestTrackersForDelta;
 
+	/// Filters of _DestTrackersForDelta (empty if none of them has a filter)
+	TDestFiltersForDelta	_DestFiltersForDelta;
+
+	/// Filters of the local services, indexed by TPropertyIndex (may be smaller than the number of properties)
+	std::vector< TPropFilters >	_PropFilters;
+
+	/// Filters of the remote MS, indexed by TPropertyIndex (may be smaller than the number of properties)
+	std::vector< TRemotePropFilters >	_RemotePropFilters;
+
+	/// Position properties used by the filters with an area (INVALID_PROPERTY_INDEX if not found)
+	TPropertyIndex			_XPropIndex, _YPropIndex;
+
 	// Trackers on which the delta being received must be applied when bouncing a value changed by multiple services
 	//TDestTrackersForDelta	_DestTrackersForDeltaBounce;
 
@@ -23,6 +23,7 @@
 #include <nel/misc/variable.h>
 #include <nel/net/transport_class.h>
 #include <nel/georges/load_form.h>
+#include <zlib.h>
 
 #ifdef NL_OS_WINDOWS
 #	ifndef NL_COMP_MINGW
@@ -48,6 +49,10 @@ const string MirrorServiceVersion = string("1.10-")+string(ListRowSizeString); /
 CMirrorService *MSInstance = NULL;
 bool DestroyGhostSharedMemSegments = false;
 bool VerboseMessagesSent = false;
+CVariable<bool> CompressMirrorDeltas( "ms", "CompressMirrorDeltas", "Pack the property changes and compress the deltas sent to the other mirror services (the receivers must support DELTAZ)", false, 0, true );
+
+/// Minimum size of the changes in a delta for it to be compressed
+const uint32 MinDeltaSizeToCompress = 64;
 CDataSetMS *TNDataSetsMS::InvalidDataSet = NULL; // not used because expection thrown instead
 
 
@@ -175,6 +180,14 @@ void	CMirrorService::init()
 	nlinfo( "Initializing tick proxy subsystem..." );
 	CTickProxy::init( cbOnMasterTick, cbOnMasterSync );
 
+	// Create the shared memory tick channel for the local client services
+	if ( UseTickChannel.get() )
+	{
+		sint smid = _SMIdPool.getNewId();
+		if ( (smid != InvalidSMId) && (! CTickProxy::createTickChannel( smid, DestroyGhostSharedMemSegments )) )
+			_SMIdPool.releaseId( smid );
+	}
+
 	// Read sheets
 	nlinfo( "Loading sheets..." );
 
@@ -244,6 +257,7 @@ void	CMirrorService::release()
 	}*/
 
 	destroyPropertySegments();
+	CTickProxy::releaseTickChannel();
 }
 
 
@@ -342,9 +356,13 @@ void	CMirrorService::removeRemoteMS( NLNET::TServiceId serviceId )
 	}
 	setNewTag( serviceId, IniTag );
 
-	// Remove remote MS and trackers
+	// Remove remote MS, trackers and filters
 	_RemoteMSList.removeRemoteMS( (TServiceId)serviceId );
 	removeTrackers( serviceId );
+	for ( TSDataSetsMS::iterator ids=_SDataSets.begin(); ids!=_SDataSets.end(); ++ids )
+	{
+		GET_SDATASET(ids).removeRemotePropFilters( serviceId );
+	}
 	--_NumberOfOnlineMS;
 
 	// Remove remote MS from the "delta update expectation list"
@@ -481,6 +499,102 @@ void	CMirrorService::applyQuittingOf( NLNET::TServiceId clientServiceId )
 
 	// Remove the trackers of the service
 	removeTrackers( clientServiceId );
+
+	// Remove the filters of the service, and tell the other MS the rows now needed on this machine
+	for ( TSDataSetsMS::iterator ids=_SDataSets.begin(); ids!=_SDataSets.end(); ++ids )
+	{
+		CDataSetMS& dataset = GET_SDATASET(ids);
+		vector<TPropertyIndex> filteredProps;
+		for ( TPropertyIndex propIndex=0; propIndex!=dataset.nbProperties(); ++propIndex )
+		{
+			if ( dataset.hasPropFilters( propIndex ) )
+				filteredProps.push_back( propIndex );
+		}
+		dataset.removePropFilters( clientServiceId );
+		for ( uint i=0; i!=filteredProps.size(); ++i )
+		{
+			sendLocalPropFilters( dataset, filteredProps[i] );
+		}
+	}
+}
+
+
+/*
+ * Set the filter of the changes of a property for a local service (see CMirroredDataSet::setPropertyFilter())
+ */
+void	CMirrorService::setPropertyFilter( CMessage& msgin, NLNET::TServiceId serviceId )
+{
+	string propName;
+	CMirrorPropFilter filter;
+	msgin.serial( propName );
+	msgin.serial( filter );
+
+	TPropertyIndex propIndex;
+	CDataSetMS *ds = _PropertiesInMirror.getDataSetByPropName( propName, propIndex );
+	if ( (! ds) || (propIndex == INVALID_PROPERTY_INDEX) )
+	{
+		nlwarning( "Cannot set the filter of unknown property %s for %s", propName.c_str(), servStr(serviceId).c_str() );
+		return;
+	}
+	ds->setPropFilter( propIndex, serviceId, filter );
+	MIRROR_INFO( "MIRROR: %s %s filter of property %s", servStr(serviceId).c_str(), filter.acceptsAll() ? "removed the" : "set a", propName.c_str() );
+
+	// Tell the other MS which rows are needed on this machine
+	sendLocalPropFilters( *ds, propIndex );
+}
+
+
+/*
+ * Send the filters of the local services reading a property to the other MS (or to destMSId only),
+ * so that they send only the changes of the rows accepted by one of them.
+ */
+void	CMirrorService::sendLocalPropFilters( CDataSetMS& dataset, TPropertyIndex propIndex, NLNET::TServiceId destMSId )
+{
+	vector<CMirrorPropFilter> filters;
+	dataset.getLocalPropFilters( propIndex, filters );
+	CMessage msgout( "RPF" );
+	msgout.serial( const_cast<string&>(dataset.getPropertyName( propIndex )) );
+	msgout.serialCont( filters );
+	if ( destMSId.get() == 0 )
+		CUnifiedNetwork::getInstance()->send( "MS", msgout, false );
+	else
+		CUnifiedNetwork::getInstance()->send( destMSId, msgout );
+}
+
+
+/*
+ * Set the filters of the changes of a property sent to a remote MS (see sendLocalPropFilters())
+ */
+void	CMirrorService::setRemotePropFilters( CMessage& msgin, NLNET::TServiceId msId )
+{
+	string propName;
+	vector<CMirrorPropFilter> filters;
+	msgin.serial( propName );
+	msgin.serialCont( filters );
+
+	TPropertyIndex propIndex;
+	CDataSetMS *ds = _PropertiesInMirror.getDataSetByPropName( propName, propIndex );
+	if ( (! ds) || (propIndex == INVALID_PROPERTY_INDEX) )
+	{
+		nlwarning( "Cannot set the remote filters of unknown property %s for %s", propName.c_str(), servStr(msId).c_str() );
+		return;
+	}
+	ds->setRemotePropFilters( propIndex, msId, filters );
+	MIRROR_INFO( "MIRROR: %s set %u filters of property %s", servStr(msId).c_str(), (uint)filters.size(), propName.c_str() );
+
+	// Send again the current values, as the changes skipped by the previous filters may be needed now
+	CChangeTrackerMS *tracker = ds->findPropTracker( propIndex, msId );
+	if ( tracker && (! tracker->isLocal()) && tracker->isAllocated() && ds->_PropertyContainer.PropertyValueArrays[propIndex].ChangeTimestamps )
+	{
+		for ( TDataSetIndex i=0; i!=ds->maxNbRows(); ++i )
+		{
+			if ( ds->_PropertyContainer.EntityIdArray.isOnline( i ) &&
+				 (ds->_PropertyContainer.PropertyValueArrays[propIndex].ChangeTimestamps[i] != 0) )
+			{
+				tracker->recordChange( i );
+			}
+		}
+	}
 }
 
 
@@ -934,6 +1048,10 @@ void	CMirrorService::pushPropertyChanges( CDataSetMS& dataset, CChangeTrackerMS&
 			//nldebug( "Pushing prop changes %hd", propIndex );
 			TDataSetRow datasetrow( tracker.getFirstChanged() );
 
+			// Skip the rows not needed by the services of the remote machine (see setRemotePropFilters())
+			CRemotePropFilter *remoteFilter = dataset.getRemotePropFilter( propIndex, tracker.destServiceId() );
+			bool enteringRow;
+
 			/// Push changes until full or no more changes, pop changes from tracker
 			while ( (datasetrow != LAST_CHANGED) && (! delta->full( propIndex )) )
 			{
@@ -944,9 +1062,14 @@ void	CMirrorService::pushPropertyChanges( CDataSetMS& dataset, CChangeTrackerMS&
 				}
 				else
 				{
-					datasetrow.setCounter( dataset.getBindingCounter( datasetrow.getIndex() ) );
-					//MIRROR_DEBUG( "MIRROR: Pushing prop change for entity %u", datasetrow.getIndex() );
-					delta->pushPropChange( propIndex, datasetrow, typ );
+					if ( (! remoteFilter) || dataset.rowMatchesRemoteFilter( datasetrow.getIndex(), *remoteFilter, enteringRow ) )
+					{
+						datasetrow.setCounter( dataset.getBindingCounter( datasetrow.getIndex() ) );
+						//MIRROR_DEBUG( "MIRROR: Pushing prop change for entity %u", datasetrow.getIndex() );
+						delta->pushPropChange( propIndex, datasetrow, typ );
+						if ( remoteFilter && enteringRow )
+							dataset.recordRowForRemoteMS( datasetrow.getIndex(), tracker.destServiceId(), propIndex );
+					}
 					tracker.popFirstChanged();
 					datasetrow.initFromIndex( tracker.getFirstChanged() );
 				}
@@ -987,6 +1110,7 @@ void	CMirrorService::sendAllDeltas()
 		// Put current tick in delta
 		TGameCycle gamecycle = CTickProxy::getGameCycle();
 		msgout.serial( gamecycle );
+		sint32 changesPos = msgout.getPos();
 
 		TDeltaToMSList::iterator idl;
 		for ( idl=deltaList.begin(); idl!=deltaList.end(); ++idl )
@@ -1013,6 +1137,27 @@ void	CMirrorService::sendAllDeltas()
 
 		// Send
 		uint32 len = msgout.length();
+		_EmittedRawBytesPartialSum += len;
+		if ( CompressMirrorDeltas.get() && (len - changesPos >= MinDeltaSizeToCompress) )
+		{
+			// Compress the whole delta (after the header), sent as DELTAZ if it is smaller
+			uLongf compressedSize = compressBound( len - changesPos );
+			_CompressedDelta.resize( compressedSize );
+			if ( (compress2( &_CompressedDelta[0], &compressedSize, msgout.buffer() + changesPos, len - changesPos, Z_BEST_SPEED ) == Z_OK) &&
+				 (compressedSize + sizeof(uint32) < len - changesPos) )
+			{
+				CMessage msgz( "DELTAZ" );
+				msgz.serial( waitForMe );
+				msgz.serial( gamecycle );
+				uint32 uncompressedSize = len - changesPos;
+				msgz.serial( uncompressedSize );
+				msgz.serialBuffer( &_CompressedDelta[0], (uint)compressedSize );
+				len = msgz.length();
+				CUnifiedNetwork::getInstance()->send( (*isl), msgz );
+				_EmittedBytesPartialSum += len;
+				continue;
+			}
+		}
 		if ( VerboseMessagesSent && len > (5+5+6*3)*1 ) //TEMP
 			nlinfo( "Sending message (%u bytes) to %hu", len, isl->get());
 		CUnifiedNetwork::getInstance()->send( (*isl), msgout );
@@ -1040,7 +1185,9 @@ void	CMirrorService::computeDeltaStats()
 	{
 		// EmittedKBPerSecond = (EmittedBytes/1000) / (DeltaTimeMS/1000)
 		_EmittedKBytesPerSecond = (float)_EmittedBytesPartialSum / (float)(localTime-_TimeOfLatestEmittedBytesAvg);
+		_DeltaCompressionRatio = (_EmittedBytesPartialSum != 0) ? (float)_EmittedRawBytesPartialSum / (float)_EmittedBytesPartialSum : 1.0f;
 		_EmittedBytesPartialSum = 0;
+		_EmittedRawBytesPartialSum = 0;
 		_TimeOfLatestEmittedBytesAvg = localTime;
 	}
 }
@@ -1207,6 +1354,7 @@ void	CMirrorService::processReceivedDelta( CMessage& msgin, TServiceId serviceId
 				{
 					H_AUTO( applyPropertyChanges )
 					currentState = CDeltaToMS::RowManagementPropChangeBit;
+					bool packed = ((header & CDeltaToMS::PropChangesPackedBit) != 0);
 					TPropertyIndex propIndex;
 					msgin.fastRead( propIndex );
 					//nldebug( "%u: Applying changes of P%hd in %s", CTickProxy::getGameCycle(), propIndex, dataset.name().c_str() );
@@ -1215,18 +1363,18 @@ void	CMirrorService::processReceivedDelta( CMessage& msgin, TServiceId serviceId
 						setupDestPropTrackersInterestedByDelta( dataset, sourceMSTag, serviceId, propIndex );
 						switch( dataset.getPropType( propIndex ) )
 						{
-							case TypeUint8: applyPropertyChanges( msgin, dataset, propIndex, serviceId, (uint8*)NULL ); break;
-							case TypeSint8: applyPropertyChanges( msgin, dataset, propIndex, serviceId, (sint8*)NULL ); break;
-							case TypeUint16: applyPropertyChanges( msgin, dataset, propIndex, serviceId, (uint16*)NULL ); break;
-							case TypeSint16: applyPropertyChanges( msgin, dataset, propIndex, serviceId, (sint16*)NULL ); break;
-							case TypeUint32: applyPropertyChanges( msgin, dataset, propIndex, serviceId, (uint32*)NULL ); break;
-							case TypeSint32: applyPropertyChanges( msgin, dataset, propIndex, serviceId, (sint32*)NULL ); break;
-							case TypeUint64: applyPropertyChanges( msgin, dataset, propIndex, serviceId, (uint64*)NULL ); break;
-							case TypeSint64: applyPropertyChanges( msgin, dataset, propIndex, serviceId, (sint64*)NULL ); break;
-							case TypeFloat: applyPropertyChanges( msgin, dataset, propIndex, serviceId, (float*)NULL ); break;
-							case TypeDouble: applyPropertyChanges( msgin, dataset, propIndex, serviceId, (double*)NULL ); break;
-							case TypeCEntityId: applyPropertyChanges( msgin, dataset, propIndex, serviceId, (CEntityId*)NULL ); break;
-							case TypeBool: applyPropertyChanges( msgin, dataset, propIndex, serviceId, (bool*)NULL ); break;
+							case TypeUint8: applyPropertyChanges( msgin, dataset, propIndex, serviceId, packed, (uint8*)NULL ); break;
+							case TypeSint8: applyPropertyChanges( msgin, dataset, propIndex, serviceId, packed, (sint8*)NULL ); break;
+							case TypeUint16: applyPropertyChanges( msgin, dataset, propIndex, serviceId, packed, (uint16*)NULL ); break;
+							case TypeSint16: applyPropertyChanges( msgin, dataset, propIndex, serviceId, packed, (sint16*)NULL ); break;
+							case TypeUint32: applyPropertyChanges( msgin, dataset, propIndex, serviceId, packed, (uint32*)NULL ); break;
+							case TypeSint32: applyPropertyChanges( msgin, dataset, propIndex, serviceId, packed, (sint32*)NULL ); break;
+							case TypeUint64: applyPropertyChanges( msgin, dataset, propIndex, serviceId, packed, (uint64*)NULL ); break;
+							case TypeSint64: applyPropertyChanges( msgin, dataset, propIndex, serviceId, packed, (sint64*)NULL ); break;
+							case TypeFloat: applyPropertyChanges( msgin, dataset, propIndex, serviceId, packed, (float*)NULL ); break;
+							case TypeDouble: applyPropertyChanges( msgin, dataset, propIndex, serviceId, packed, (double*)NULL ); break;
+							case TypeCEntityId: applyPropertyChanges( msgin, dataset, propIndex, serviceId, packed, (CEntityId*)NULL ); break;
+							case TypeBool: applyPropertyChanges( msgin, dataset, propIndex, serviceId, packed, (bool*)NULL ); break;
 							default: nlwarning( "Unknown type for reading" );
 						}
 						msgin.fastRead( propIndex );
@@ -1255,6 +1403,7 @@ void	CMirrorService::processReceivedDelta( CMessage& msgin, TServiceId serviceId
 void	CMirrorService::setupDestEntityTrackersInterestedByDelta( CDataSetMS& dataset, const CMTRTag& sourceTag, TEntityTrackerIndex addRem, const std::vector<NLNET::TServiceId8>& listOfExcludedServices )
 {
 	dataset._DestTrackersForDelta.clear();
+	dataset._DestFiltersForDelta.clear();
 	for ( TSubscriberListForEnt::const_iterator it=dataset._EntityTrackers[addRem].begin(); it!=dataset._EntityTrackers[addRem].end(); ++it )
 	{
 		if ( (*it).isLocal() && // note: (*it).isAllocated() is always true for entity trackers
@@ -1273,6 +1422,7 @@ void	CMirrorService::setupDestEntityTrackersInterestedByDelta( CDataSetMS& datas
 void	CMirrorService::setupDestEntityTrackersInterestedBySyncDelta( CDataSetMS& dataset, const CMTRTag& sourceTag, std::vector<NLNET::TServiceId8> listOfInterestedServices )
 {
 	dataset._DestTrackersForDelta.clear();
+	dataset._DestFiltersForDelta.clear();
 	for ( TSubscriberListForEnt::const_iterator it=dataset._EntityTrackers[ADDING].begin(); it!=dataset._EntityTrackers[ADDING].end(); ++it )
 	{
 		if ( (*it).isLocal() && // note: (*it).isAllocated() is always true for entity trackers
@@ -1290,14 +1440,21 @@ void	CMirrorService::setupDestEntityTrackersInterestedBySyncDelta( CDataSetMS& d
 void	CMirrorService::setupDestPropTrackersInterestedByDelta( CDataSetMS& dataset, const CMTRTag& sourceTag, NLNET::TServiceId sourceMSId, TPropertyIndex propIndex )
 {
 	dataset._DestTrackersForDelta.clear();
+	dataset._DestFiltersForDelta.clear();
+	bool hasFilters = false;
 	for ( TSubscriberListForProp::const_iterator it=dataset._SubscribersByProperty[propIndex].begin(); it!=dataset._SubscribersByProperty[propIndex].end(); ++it )
 	{
 		if ( (*it).isLocal() && (*it).isAllocated() &&
 			 getTagOfService( (TServiceId)((*it).destServiceId()) ).doesAcceptTag( sourceTag ) )
 		{
 			dataset._DestTrackersForDelta.push_back( const_cast<CChangeTrackerMS*>(&(*it)) );
+			const CMirrorPropFilter *filter = dataset.getPropFilter( propIndex, (*it).destServiceId() );
+			dataset._DestFiltersForDelta.push_back( filter );
+			hasFilters = hasFilters || (filter != NULL);
 		}
 	}
+	if ( ! hasFilters )
+		dataset._DestFiltersForDelta.clear(); // faster setChangedLocal()
 	// Obsolete: now we don't handle the case anymore when a service can overwrite a property value in the same
 	// game cycle as another service.
 	/*// Add tracker to list of bounce dest trackers (rare event, the list could be built only 'on demand')
@@ -2415,6 +2572,12 @@ void	CMirrorService::broadcastSubscribeProperty( CMessage& msgin, const std::str
 	
 	// Add in local subscribers list
 	processPropSubscriptionByName( propName, serviceId, true, (options & PSOReadOnly)!=0, (options & PSONotifyChanges)!=0, notifyGroupByPropName, (options & PSOWriteOnly)!=0 );
+
+	// If the other local readers filter the property, the new one may need more rows
+	TPropertyIndex propIndex;
+	CDataSetMS *ds = _PropertiesInMirror.getDataSetByPropName( propName, propIndex );
+	if ( ds && (propIndex != INVALID_PROPERTY_INDEX) && ds->hasPropFilters( propIndex ) && (! (options & PSOWriteOnly)) )
+		sendLocalPropFilters( *ds, propIndex );
 }
 
 
@@ -3093,6 +3256,17 @@ void	CMirrorService::synchronizeSubscriptionsToNewMS( TServiceId newRemoteMSId )
 	CUnifiedNetwork::getInstance()->send( newRemoteMSId, msgout );
 	nlinfo( "Sent SYNC_MS to new MS-%hu for %u datasets", newRemoteMSId.get(), nbSubscribedDatasets );
 
+	// Send the filters of the local services
+	for ( ids=_SDataSets.begin(); ids!=_SDataSets.end(); ++ids )
+	{
+		CDataSetMS& dataset = GET_SDATASET(ids);
+		for ( TPropertyIndex propIndex=0; propIndex!=dataset.nbProperties(); ++propIndex )
+		{
+			if ( dataset.hasPropFilters( propIndex ) )
+				sendLocalPropFilters( dataset, propIndex, newRemoteMSId );
+		}
+	}
+
 	// Send an empty delta update to unblock the new MS
 	//CMessage msgout( "DELTA" );
 	//CUnifiedNetwork::getInstance()->send( newRemoteMSId, msgout );
@@ -3545,6 +3719,16 @@ void cbAllocateProperty( NLNET::CMessage& msgin, const std::string &serviceName,
 	MSInstance->allocateProperty( msgin, serviceId );
 }
 
+void cbSetPropertyFilter( NLNET::CMessage& msgin, const std::string &serviceName, TServiceId serviceId )
+{
+	MSInstance->setPropertyFilter( msgin, serviceId );
+}
+
+void cbSetRemotePropFilters( NLNET::CMessage& msgin, const std::string &serviceName, TServiceId serviceId )
+{
+	MSInstance->setRemotePropFilters( msgin, serviceId );
+}
+
 void cbGiveOtherProperties( NLNET::CMessage& msgin, const std::string &serviceName, TServiceId serviceId )
 {
 	MSInstance->giveOtherProperties( msgin, serviceId );
@@ -3836,6 +4020,7 @@ void cbForwardTransportClass2( NLNET::CMessage& msgin, const std::string &servic
 extern void cbTock( CMessage& msgin, const string& serviceName, TServiceId serviceId );
 extern void cbMessageToForward( CMessage& msgin, const string& serviceName, TServiceId serviceId );
 extern void cbRecvDelta( CMessage& msgin, const string& serviceName, TServiceId serviceId );
+extern void cbRecvCompressedDelta( CMessage& msgin, const string& serviceName, TServiceId serviceId );
 
 
 // Callback Array
@@ -3843,6 +4028,8 @@ TUnifiedCallbackItem MirrorCallbackArray[] =
 {
 	{ "DATASETS", cbDeclareDataSets },
 	{ "AP", cbAllocateProperty },
+	{ "SPF", cbSetPropertyFilter },
+	{ "RPF", cbSetRemotePropFilters },
 	{ "DET", cbDeclareEntityTypeOwner },
 	{ "RG", cbGiveRange },
 	//{ "DRG", cbRecvDeclaredRange },
@@ -3858,6 +4045,7 @@ TUnifiedCallbackItem MirrorCallbackArray[] =
 	{ "TOCK", cbTock },
 	{ "FWDMSG", cbMessageToForward },
 	{ "DELTA", cbRecvDelta },
+	{ "DELTAZ", cbRecvCompressedDelta },
 	{ "MARCS", cbAddRemoveRemoteClientService },
 	{ "REIR", cbReleaseEntitiesInRanges },
 	{ "TAG_CHG", cbTagChanged },
@@ -4031,6 +4219,12 @@ NLMISC_DYNVARIABLE( float, EmittedKBPerSec, "Output rate for mirror deltas & mes
 		*pointer = MSInstance->getEmittedKBytesPerSecond();
 }
 
+NLMISC_DYNVARIABLE( float, DeltaCompressionRatio, "Size of the deltas & messages to other MS before compression / emitted size" )
+{
+	if ( get )
+		*pointer = MSInstance->getDeltaCompressionRatio();
+}
+
 NLMISC_DYNVARIABLE( sint8, MainMTRTag, "Main MTR Tag" )
 {
 	if ( get )
@@ -22,6 +22,7 @@
 
 #include <nel/net/service.h>
 #include <nel/misc/shared_memory.h>
+#include <nel/misc/variable.h>
 
 //#include "game_share/tick_event_handler.h" //for debug info
 #include "game_share/property_allocator.h"
@@ -94,6 +95,81 @@ struct TMessageCarrierWithDestId : public TMessageCarrier
 typedef std::map<NLMISC::CSheetId, CDataSetMS> TSDataSetsMS;
 
 
+/// If true, the deltas to the other mirror services are packed and compressed (see CDeltaToMS::pushPropChange() and CMirrorService::sendAllDeltas())
+extern NLMISC::CVariable<bool> CompressMirrorDeltas;
+
+
+/*
+ * Variable-length integer (7 bits per byte, the high bit tells if another byte follows)
+ */
+inline void		writePackedUInt( NLMISC::CMemStream& s, uint64 value )
+{
+	while ( value >= 0x80 )
+	{
+		uint8 b = (uint8)(value | 0x80);
+		s.fastWrite( b );
+		value >>= 7;
+	}
+	uint8 b = (uint8)value;
+	s.fastWrite( b );
+}
+
+inline uint64	readPackedUInt( NLMISC::CMemStream& s )
+{
+	uint64 value = 0;
+	uint shift = 0;
+	uint8 b;
+	do
+	{
+		s.fastRead( b );
+		value |= ((uint64)(b & 0x7F)) << shift;
+		shift += 7;
+	}
+	while ( (b & 0x80) && (shift < 64) );
+	return value;
+}
+
+/*
+ * Difference with the previous value, as a variable-length integer (the sign is in the lowest bit,
+ * so that a small negative difference is as short as a small positive one). prev is updated.
+ */
+inline void		writePackedDiff( NLMISC::CMemStream& s, uint64 value, uint64& prev )
+{
+	uint64 diff = value - prev;
+	prev = value;
+	writePackedUInt( s, (diff << 1) ^ (uint64)(((sint64)diff) >> 63) );
+}
+
+inline uint64	readPackedDiff( NLMISC::CMemStream& s, uint64& prev )
+{
+	uint64 packed = readPackedUInt( s );
+	prev += (packed >> 1) ^ (uint64)(-(sint64)(packed & 1));
+	return prev;
+}
+
+/*
+ * Property value in the packed property changes: the integers are written as the difference
+ * with the previous value of the same property in the delta, the other types are written raw.
+ */
+template <class T>
+struct CPackedPropValue
+{
+	static void		write( NLMISC::CMemStream& s, const T& value, uint64& prev ) { writePackedDiff( s, (uint64)(sint64)value, prev ); }
+	static void		read( NLMISC::CMemStream& s, T& value, uint64& prev ) { value = (T)readPackedDiff( s, prev ); }
+};
+
+template <class T>
+struct CRawPropValue
+{
+	static void		write( NLMISC::CMemStream& s, const T& value, uint64& ) { s.fastWrite( value ); }
+	static void		read( NLMISC::CMemStream& s, T& value, uint64& ) { s.fastRead( value ); }
+};
+
+template <> struct CPackedPropValue<float> : public CRawPropValue<float> {};
+template <> struct CPackedPropValue<double> : public CRawPropValue<double> {};
+template <> struct CPackedPropValue<NLMISC::CEntityId> : public CRawPropValue<NLMISC::CEntityId> {};
+
+
 /**
  * Delta buffer in which the mirror service pushes the changes to send to a remove mirror service.
  */
@@ -101,14 +177,15 @@ class CDeltaToMS
 {
 public:
 
-	enum TRowManagementTypeMask { RowManagementBindingCountersBit=1, RowManagementAddingBit=2, RowManagementRemovingBit=4, RowManagementPropChangeBit=8, RowManagementSyncBit=16 /*extension of AddingBit (set at the same time)*/ };
+	enum TRowManagementTypeMask { RowManagementBindingCountersBit=1, RowManagementAddingBit=2, RowManagementRemovingBit=4, RowManagementPropChangeBit=8, RowManagementSyncBit=16 /*extension of AddingBit (set at the same time)*/, PropChangesPackedBit=32 /*the property changes are packed (see pushPropChange())*/ };
 
 	/// Constructor
 	CDeltaToMS( CDataSetMS *dataset ) :
 		_DataSet(dataset), _DeltaBuffer( false, false, 0 ), _Header(0), _MustTransmitAllBindingCounters(false),
 		_NbChangesPushed(0), _NbChangesPushedInTickRowMgt(0), _NbChangesPushedInTickProps(0),
 		_StoredNbChangesPushedRowMgt(0), _StoredNbChangesPushedProps(0),
-		_NbMessagesStored(0), _NbMessagesBufPos(0), _DatasetHeaderBufPos(0) {}
+		_NbMessagesStored(0), _NbMessagesBufPos(0), _DatasetHeaderBufPos(0),
+		_PrevPackedRow(0), _PrevPackedTimestamp(0), _PrevPackedValue(0), _PackPropChanges(false) {}
 
 	/// Set the initial capacity
 	void			setCapacity( uint32 initialByteCapacity )
@@ -184,6 +261,9 @@ public:
 		// Reserve sheetId and header (assumes sheetId.asInt() is uint32)
 		_DatasetHeaderBufPos = _DeltaBuffer.reserve( sizeof(uint32) + sizeof(uint8) );
 		_Header = 0x0;
+
+		// The format of the property changes must not change within the delta of the dataset
+		_PackPropChanges = CompressMirrorDeltas.get();
 	}
 
 	/// End pushing mirror delta (after row management & prop management)
@@ -315,6 +395,13 @@ public:
 			_Header |= RowManagementPropChangeBit;
 			//nldebug( "%u: Pushing property %hd", CTickProxy::getGameCycle(), propIndex );
 			_DeltaBuffer.fastWrite( propIndex );
+			if ( _PackPropChanges )
+			{
+				_Header |= PropChangesPackedBit;
+				_PrevPackedRow = 0;
+				_PrevPackedTimestamp = 0;
+				_PrevPackedValue = 0;
+			}
 			return true;
 		}
 		else
@@ -323,10 +410,22 @@ public:
 		}
 	}
 
-	/// Push one property change event (precondition: beginPropChanges() returned true)
+	/**
+	 * Push one property change event (precondition: beginPropChanges() returned true)
+	 *
+	 * In the packed format, the row index, the timestamp and the integer values are written as
+	 * variable-length differences with the ones of the previous change of the property
+	 * (see pushPackedPropChange()).
+	 */
 	template <class T>
-	void			pushPropChange( TPropertyIndex propIndex, TDataSetRow& datasetrow, T * )
+	void			pushPropChange( TPropertyIndex propIndex, TDataSetRow& datasetrow, T *typ )
 	{
+		if ( _PackPropChanges )
+		{
+			pushPackedPropChange( propIndex, datasetrow, typ );
+			return;
+		}
+
 		//nldebug( "Pushing prop change for E%d, prop %hd", entityIndex, propIndex );
 
 		sint32 oldPos = _DeltaBuffer.getPos();
@@ -391,11 +490,84 @@ public:
 		//nldebug( "Prop changes pushed: %d, size %u", _NbChangesPushed, _DeltaBuffer.length() );
 	}
 
+	/// Push one property change event in the packed format (see CMirrorService::applyPackedPropertyChanges())
+	template <class T>
+	void			pushPackedPropChange( TPropertyIndex propIndex, TDataSetRow& datasetrow, T * )
+	{
+		sint32 oldPos = _DeltaBuffer.getPos();
+		uint64 oldPrevRow = _PrevPackedRow, oldPrevTimestamp = _PrevPackedTimestamp, oldPrevValue = _PrevPackedValue;
+		try
+		{
+			// Write row (0 is the end of the changes, see endPropChanges()) and binding counter
+			uint64 row = (uint64)datasetrow.getIndex();
+			uint64 diff = row - _PrevPackedRow;
+			_PrevPackedRow = row;
+			writePackedUInt( _DeltaBuffer, ((diff << 1) ^ (uint64)(((sint64)diff) >> 63)) + 1 );
+			uint8 counter = datasetrow.counter();
+			_DeltaBuffer.fastWrite( counter );
+
+			if ( _DataSet->propIsList( propIndex ) )
+			{
+				TSharedListRow header;
+				NLMISC::TGameCycle timestamp;
+				_DataSet->getHeaderOfList( datasetrow, propIndex, header, timestamp, (T*)NULL );
+				writePackedDiff( _DeltaBuffer, (uint64)timestamp, _PrevPackedTimestamp );
+
+				// The items are written raw
+				CMirrorPropValueListMS<T> theList( const_cast<CDataSetMS&>(*_DataSet), datasetrow, propIndex );
+				typename CMirrorPropValueListMS<T>::size_type size = (TSharedListRow)theList.size();
+				if ( size == ~0 ) // TEMP workaround
+				{
+					nlwarning( "ERROR: List size freeze workaround" );
+					size = 0;
+				}
+				writePackedUInt( _DeltaBuffer, (uint64)size );
+				if ( size != 0 )
+				{
+					typename CMirrorPropValueListMS<T>::iterator it;
+					for ( it=theList.begin(); it!=theList.end(); ++it )
+					{
+						_DeltaBuffer.fastWrite( const_cast<T&>((*it)()) );
+					}
+				}
+			}
+			else
+			{
+				T value;
+				NLMISC::TGameCycle timestamp;
+				_DataSet->getValue( datasetrow, propIndex, value, timestamp );
+				writePackedDiff( _DeltaBuffer, (uint64)timestamp, _PrevPackedTimestamp );
+				CPackedPropValue<T>::write( _DeltaBuffer, value, _PrevPackedValue );
+			}
+			++_NbChangesPushed;
+		}
+		catch (const NLMISC::EReallocationFailed&)
+		{
+			nlwarning( "ERROR: Can't reallocate DeltaBuffer (E%u propIndex %hd packed, NbChangesPushed %d oldpos %d bufpos %d bufsize %u)",
+				datasetrow.getIndex(), propIndex, _NbChangesPushed, oldPos, _DeltaBuffer.getPos(), _DeltaBuffer.size() );
+
+			// Roll-back prop change
+			_DeltaBuffer.resize( oldPos );
+			_DeltaBuffer.seek( 0, NLMISC::IStream::end );
+			_PrevPackedRow = oldPrevRow;
+			_PrevPackedTimestamp = oldPrevTimestamp;
+			_PrevPackedValue = oldPrevValue;
+		}
+	}
+
 	/// End the current push cycle for property changes (precondition: beginPropChanges() returned true)
 	void			endPropChanges( TPropertyIndex propIndex )
 	{
-		TDataSetRow theEnd;
-		_DeltaBuffer.fastWrite( theEnd );
+		if ( _PackPropChanges )
+		{
+			uint8 theEnd = 0;
+			_DeltaBuffer.fastWrite( theEnd );
+		}
+		else
+		{
+			TDataSetRow theEnd;
+			_DeltaBuffer.fastWrite( theEnd );
+		}
 		_NbChangesPushedInTickProps += _NbChangesPushed;
 	}
 
@@ -491,11 +663,19 @@ private:
 	/// Position in the delta buffer of the room for dataset sheetid and header (valid only between beginMirrorDelta() and endMirrorDelta())
 	sint32				_DatasetHeaderBufPos;
 
+	/// Previous row index, timestamp and value of the packed property changes (valid only between beginPropChanges() and endPropChanges())
+	uint64				_PrevPackedRow;
+	uint64				_PrevPackedTimestamp;
+	uint64				_PrevPackedValue;
+
 	/// Header byte
 	uint8				_Header;
 
 	/// Flag to transmit all binding counters
 	bool				_MustTransmitAllBindingCounters;
+
+	/// True if the property changes of the current mirror delta are packed (set by beginMirrorDelta())
+	bool				_PackPropChanges;
 };
 
 
@@ -698,6 +878,7 @@ public:
 		_NumberOfOnlineMS(1),
 		_RangeManagerReady(false), _MirrorsOnline(false), _DeltaSent(false), _BlockedAwaitingATAck(false),
 		_EmittedKBytesPerSecond(0.0f), _EmittedBytesPartialSum(0), _TimeOfLatestEmittedBytesAvg(0),
+		_DeltaCompressionRatio(1.0f), _EmittedRawBytesPartialSum(0),
 		_NbDeltaUpdatesReceived(0), _NbExpectedDeltaUpdates(0), _IsPureReceiver(false)
 	{
 		for ( uint i=0; i!=256; ++i )
@@ -716,6 +897,15 @@ public:
 	/// Give the list of properties not subscribed but allocated on this machine for owned datasets
 	void			giveOtherProperties( NLNET::CMessage& msgin, NLNET::TServiceId serviceId );
 
+	/// Set the filter of the changes of a property for a local service
+	void			setPropertyFilter( NLNET::CMessage& msgin, NLNET::TServiceId serviceId );
+
+	/// Send the filters of the local services reading a property to the other MS (or to destMSId only)
+	void			sendLocalPropFilters( CDataSetMS& dataset, TPropertyIndex propIndex, NLNET::TServiceId destMSId=NLNET::TServiceId(0) );
+
+	/// Set the filters of the changes of a property sent to a remote MS
+	void			setRemotePropFilters( NLNET::CMessage& msgin, NLNET::TServiceId msId );
+
 	/// Unallocate (destroy) all the allocated segments
 	void			destroyPropertySegments();
 
@@ -831,6 +1021,8 @@ public:
 
 	void			receiveDeltaFromRemoteMS( NLNET::CMessage& msgin, NLNET::TServiceId senderMSId );
 
+	void			receiveCompressedDeltaFromRemoteMS( NLNET::CMessage& msgin, NLNET::TServiceId senderMSId );
+
 	void			serialToMessageFromLocalQueue( NLNET::CMessage& msgout, const TMessageCarrier& srcMsgInQueue );
 
 	void			testIfNotInQuittingServices( NLNET::TServiceId servId );
@@ -910,6 +1102,9 @@ public:
 	bool			mirrorsOnline() const { return _MirrorsOnline; }
 	sint			nbOfOnlineMS() const { return (sint)_NumberOfOnlineMS; }
 	float			getEmittedKBytesPerSecond() const { return _EmittedKBytesPerSecond; }
+
+	/// Return the size of the deltas & messages before compression divided by the emitted size
+	float			getDeltaCompressionRatio() const { return _DeltaCompressionRatio; }
 	CMTRTag&		mainTag() { return _AllServiceTags[getServiceId().get()][0]; }
 	bool			isPureReceiver() const { return _IsPureReceiver; }
 	
@@ -939,8 +1134,14 @@ protected:
 	
 	/// Apply the property changes coming from a remote mirror service
 	template <class T>
-	void			applyPropertyChanges( NLNET::CMessage& msgin, CDataSetMS& dataset, TPropertyIndex propIndex, NLNET::TServiceId serviceId, T * )
+	void			applyPropertyChanges( NLNET::CMessage& msgin, CDataSetMS& dataset, TPropertyIndex propIndex, NLNET::TServiceId serviceId, bool packed, T *typ )
 	{
+		if ( packed )
+		{
+			applyPackedPropertyChanges( msgin, dataset, propIndex, serviceId, typ );
+			return;
+		}
+
 		//sint NbChangesRead;
 		//NbChangesRead = 0;
 		TDataSetRow datasetRow;
@@ -993,6 +1194,51 @@ protected:
 		//nldebug( "Number of changes read for P%hd: %d", propIndex, NbChangesRead );
 	}
 
+	/// Apply the property changes coming from a remote mirror service, in the packed format (see CDeltaToMS::pushPackedPropChange())
+	template <class T>
+	void			applyPackedPropertyChanges( NLNET::CMessage& msgin, CDataSetMS& dataset, TPropertyIndex propIndex, NLNET::TServiceId serviceId, T * )
+	{
+		uint64 prevRow = 0, prevTimestamp = 0, prevValue = 0;
+		uint64 packedRow = readPackedUInt( msgin );
+		while ( packedRow != 0 )
+		{
+			// Read row, binding counter and timestamp
+			--packedRow;
+			prevRow += (packedRow >> 1) ^ (uint64)(-(sint64)(packedRow & 1));
+			uint8 counter;
+			msgin.fastRead( counter );
+			TDataSetRow datasetRow( (TDataSetIndex)prevRow, counter );
+			NLMISC::TGameCycle timestamp = (NLMISC::TGameCycle)readPackedDiff( msgin, prevTimestamp );
+
+			// Check remCounter
+			bool apply = ! dataset.dataSetRowIsTooOld( datasetRow );
+
+			if ( dataset._PropIsList[propIndex] )
+			{
+				// Read values
+				TSharedListRow size = (TSharedListRow)readPackedUInt( msgin );
+				slist<T> tempList;
+				for ( TSharedListRow i=0; i!=size; ++i )
+				{
+					T value;
+					msgin.fastRead( value ); // the values are stored in reverse order
+					tempList.push_front( value );
+				}
+				if ( apply )
+					dataset.applyListPropChange( datasetRow.getIndex(), propIndex, serviceId, tempList, timestamp );
+			}
+			else
+			{
+				T value;
+				CPackedPropValue<T>::read( msgin, value, prevValue );
+				if ( apply )
+					dataset.applyPropChange( datasetRow.getIndex(), propIndex, serviceId, value, timestamp );
+			}
+
+			packedRow = readPackedUInt( msgin );
+		}
+	}
+
 	/// 
 	void			setupDestEntityTrackersInterestedByDelta( CDataSetMS& dataset, const CMTRTag& sourceTag, TEntityTrackerIndex addRem, const std::vector<NLNET::TServiceId8>& listOfExcludedServices );
 
@@ -1093,6 +1339,16 @@ private:
 	/// Output rate statistics helper
 	NLMISC::TTime					_TimeOfLatestEmittedBytesAvg;
 
+	/// Compression statistics (size of the deltas before compression / emitted size)
+	float							_DeltaCompressionRatio;
+
+	/// Compression statistics helper
+	uint32							_EmittedRawBytesPartialSum;
+
+	/// Buffers for the compression and decompression of the deltas
+	std::vector<uint8>				_CompressedDelta;
+	std::vector<uint8>				_UncompressedDelta;
+
 	// This value indicates if we have received a delta update from all of the other services (we check it before sending master tock)
 	sint16							_NbDeltaUpdatesReceived;
 
@@ -71,6 +71,7 @@
 
 #include "mirror_service.h"
 #include "tick_proxy.h"
+#include <zlib.h>
 
 using namespace NLMISC;
 using namespace NLNET;
@@ -109,6 +110,15 @@ void cbRecvDelta( CMessage& msgin, const string& serviceName, TServiceId service
 }
 
 
+/*
+ * Compressed delta received from a remote MS (see CMirrorService::sendAllDeltas())
+ */
+void cbRecvCompressedDelta( CMessage& msgin, const string& serviceName, TServiceId serviceId )
+{
+	MSInstance->receiveCompressedDeltaFromRemoteMS( msgin, serviceId );
+}
+
+
 /*
  * Sync received from master (see tick proxy)
  */
@@ -340,6 +350,49 @@ void CMirrorService::receiveMessageToForwardFromClient( CMessage& msgin, TServic
 }
 
 
+/*
+ * Uncompress the delta and process it as a normal delta.
+ * If the delta can't be uncompressed, its changes are lost but it is still counted as received,
+ * otherwise the tick would be blocked.
+ */
+void CMirrorService::receiveCompressedDeltaFromRemoteMS( CMessage& msgin, TServiceId senderMSId )
+{
+	H_AUTO(receiveCompressedDeltaFromRemoteMS);
+
+	bool waitForIt;
+	TGameCycle gamecycle;
+	uint32 uncompressedSize;
+	msgin.serial( waitForIt );
+	msgin.serial( gamecycle );
+	msgin.serial( uncompressedSize );
+
+	CMessage delta( "DELTA" );
+	delta.serial( waitForIt );
+	delta.serial( gamecycle );
+	const uint32 MaxUncompressedDeltaSize = 64*1024*1024;
+	if ( uncompressedSize <= MaxUncompressedDeltaSize )
+	{
+		uLongf size = uncompressedSize;
+		_UncompressedDelta.resize( std::max( uncompressedSize, (uint32)1 ) );
+		if ( (uncompress( &_UncompressedDelta[0], &size, msgin.buffer() + msgin.getPos(), msgin.length() - msgin.getPos() ) == Z_OK) &&
+			 (size == uncompressedSize) )
+		{
+			delta.serialBuffer( &_UncompressedDelta[0], uncompressedSize );
+		}
+		else
+		{
+			nlwarning( "Can't uncompress delta %u from MS-%hu, its changes are lost", gamecycle, senderMSId.get() );
+		}
+	}
+	else
+	{
+		nlwarning( "Invalid size %u of compressed delta %u from MS-%hu, its changes are lost", uncompressedSize, gamecycle, senderMSId.get() );
+	}
+	delta.invert();
+	receiveDeltaFromRemoteMS( delta, senderMSId );
+}
+
+
 /*
  *
  */
@@ -503,6 +556,7 @@ void CMirrorService::tellLocalServicesAndSendMessages()
 		msgout.poke( nbMsgs, nbBufPos );
 		//H_BEFORE(tellUMMSend);
 		CUnifiedNetwork::getInstance()->send( (*ics).first, msgout );
+		CTickProxy::onUMMSent( (*ics).first );
 		//H_AFTER(tellUMMSend);
 		//if ( nbMsgs != 0 )
 		//	nldebug( "Sent UMM to %s with %u messages", servStr((*ics).first).c_str(), nbMsgs );
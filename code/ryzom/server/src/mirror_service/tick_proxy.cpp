@@ -53,6 +53,13 @@ std::vector<TServiceId>		CTickProxy::_TockedServices;
 
 TServiceId					CTickProxy::_MasterTickService(0);
 
+CTickChannelServer			CTickProxy::_TickChannel;
+
+std::map<TServiceId, uint32>	CTickProxy::_TickChannelSlots;
+
+/// Max number of client services receiving the ticks by the tick channel
+static const uint32 NbTickChannelSlots = 64;
+
 TTickTockState			CTickProxy::State = ExpectingMasterTick;
 
 CMirrorGameCycleTimeMeasure	CTickProxy::TimeMeasures;
@@ -87,7 +94,12 @@ uint64 getPerfTime()
  */
 static void cbRegisterToTickSystem(CMessage& msgin, const std::string &serviceName, TServiceId serviceId)
 {
-	CTickProxy::addService( serviceId );
+	// A service built without the tick channel doesn't send the flag
+	bool wantsTickChannel = false;
+	if ( (uint32)msgin.getPos() < msgin.length() )
+		msgin.serial( wantsTickChannel );
+
+	CTickProxy::addService( serviceId, wantsTickChannel );
 
 	/*if ( CTickProxy::alreadySyncd() )
 		CTickProxy::sendSyncToClient( serviceId );*/
@@ -149,6 +161,15 @@ static void cbStepAndTick(CMessage& msgin, const std::string &serviceName, TServ
 } // cbStepAndTick //
 
 
+// From a client service that has accessed the tick channel
+static void cbTickChannel( CMessage& msgin, const string& serviceName, TServiceId serviceId )
+{
+	uint32 slot;
+	msgin.serial( slot );
+	CTickProxy::activateTickChannel( serviceId, slot );
+}
+
+
 // From a client service
 void cbTock( CMessage& msgin, const string& serviceName, TServiceId serviceId )
 {
@@ -176,16 +197,27 @@ TUnifiedCallbackItem cbTickProxyArray[] =
 	{ "REGISTERED", cbSyncFromMaster },
 	{ "TICK", cbTickFromMaster },
 	{ "TOCK", cbTock },
+	{ "TICK_CHANNEL", cbTickChannel },
 	{ "STEP_TICK", cbStepAndTick },
 	{ "DISPLAY_TIME", cbDisplayTime },
 };
 
 
-void CTickProxy::addService( TServiceId serviceId )
+void CTickProxy::addService( TServiceId serviceId, bool wantsTickChannel )
 {
 	bool isFirstService = _Services.empty();
 	_Services.push_back( serviceId );
 
+	// Give a slot of the tick channel (sent with the sync)
+	if ( wantsTickChannel && _TickChannel.isCreated() )
+	{
+		uint32 slot = _TickChannel.allocateSlot();
+		if ( slot != (uint32)~0 )
+			_TickChannelSlots[serviceId] = slot;
+		else
+			nlwarning( "No free slot in the tick channel, %hu will receive tick messages", serviceId.get() );
+	}
+
 	// Send sync
 	if ( CTickProxy::alreadySyncd() )
 		CTickProxy::sendSyncToClient( serviceId );
@@ -210,6 +242,13 @@ void CTickProxy::removeService( TServiceId serviceId )
 	
 	_Services.erase( it );
 
+	std::map<TServiceId, uint32>::iterator itc = _TickChannelSlots.find( serviceId );
+	if ( itc != _TickChannelSlots.end() )
+	{
+		_TickChannel.freeSlot( (*itc).second );
+		_TickChannelSlots.erase( itc );
+	}
+
 	// Simulate Tock from leaving service if needed
 	if ( State == ExpectingLocalTocks )
 	{
@@ -289,12 +328,68 @@ void CTickProxy::masterTickUpdate( TServiceId serviceId )
 }
 
 
+bool CTickProxy::createTickChannel( sint32 smid, bool destroyGhostSegment )
+{
+	return _TickChannel.create( smid, NbTickChannelSlots, destroyGhostSegment );
+}
+
+
+void CTickProxy::releaseTickChannel()
+{
+	_TickChannel.release();
+	_TickChannelSlots.clear();
+}
+
+
+void CTickProxy::activateTickChannel( TServiceId serviceId, uint32 slot )
+{
+	std::map<TServiceId, uint32>::const_iterator itc = _TickChannelSlots.find( serviceId );
+	if ( (itc == _TickChannelSlots.end()) || ((*itc).second != slot) )
+	{
+		nlwarning( "Service %hu has not the tick channel slot %u", serviceId.get(), slot );
+		return;
+	}
+	_TickChannel.activateSlot( slot );
+	_QuickLog.displayNL( "%" NL_I64 "u: TCK-%u: Tick channel %hu", getPerfTime(), getGameCycle(), serviceId.get() );
+}
+
+
+void CTickProxy::onUMMSent( TServiceId serviceId )
+{
+	std::map<TServiceId, uint32>::const_iterator itc = _TickChannelSlots.find( serviceId );
+	if ( itc != _TickChannelSlots.end() )
+		_TickChannel.onUMMSent( (*itc).second );
+}
+
+
+uint CTickProxy::getNbServicesOnTickChannel()
+{
+	uint nb = 0;
+	for ( std::map<TServiceId, uint32>::const_iterator itc=_TickChannelSlots.begin(); itc!=_TickChannelSlots.end(); ++itc )
+	{
+		if ( _TickChannel.isSlotActive( (*itc).second ) )
+			++nb;
+	}
+	return nb;
+}
+
+
 void CTickProxy::sendSyncToClient( TServiceId serviceId )
 {
 	CMessage msgout( "REGISTERED" );
 	msgout.serial( _GameTime );
 	msgout.serial( _GameTimeStep );
 	msgout.serial( _GameCycle );
+
+	// Tick channel slot of the service, if any
+	std::map<TServiceId, uint32>::const_iterator itc = _TickChannelSlots.find( serviceId );
+	if ( itc != _TickChannelSlots.end() )
+	{
+		sint32 smid = _TickChannel.smid();
+		uint32 slot = (*itc).second;
+		msgout.serial( smid );
+		msgout.serial( slot );
+	}
 	CUnifiedNetwork::getInstance()->send( serviceId, msgout );
 	//nldebug( "TCK-%u: Sync %hu", getGameCycle(), serviceId );
 	//time_t t; time( &t );
@@ -306,14 +401,7 @@ void CTickProxy::sendSyncs()
 	vector<TServiceId>::const_iterator its;
 	for ( its=_Services.begin(); its!=_Services.end(); ++its )
 	{
-		CMessage msgout( "REGISTERED" );
-		msgout.serial( _GameTime );
-		msgout.serial( _GameTimeStep );
-		msgout.serial( _GameCycle );
-		CUnifiedNetwork::getInstance()->send( (*its), msgout );
-		//nldebug( "TCK-%u: Sync %hu", getGameCycle(), *its );
-		//time_t t; time( &t );
-		_QuickLog.displayNL( "%" NL_I64 "u: TCK-%u: Sync %hu", getPerfTime() /*IDisplayer::dateToHumanString( t )*/, getGameCycle(), its->get());
+		sendSyncToClient( *its );
 	}
 }
 
@@ -321,9 +409,19 @@ void CTickProxy::sendTicks()
 {
 	nlassert( CTickProxy::State == ExpectingMasterTick );
 
+	bool tickChannelUsed = false;
 	vector<TServiceId>::const_iterator its;
 	for ( its=_Services.begin(); its!=_Services.end(); ++its )
 	{
+		// Services on the tick channel get the tick posted below
+		std::map<TServiceId, uint32>::const_iterator itc = _TickChannelSlots.find( *its );
+		if ( (itc != _TickChannelSlots.end()) && _TickChannel.isSlotActive( (*itc).second ) )
+		{
+			tickChannelUsed = true;
+			_QuickLog.displayNL( "%" NL_I64 "u: TCK-%u: Tick %hu (channel)", getPerfTime(), getGameCycle(), its->get() );
+			continue;
+		}
+
 		CMessage msgout( "TICK" );
 		CUnifiedNetwork::getInstance()->send( (*its), msgout ); // can produce the warning "Can't find selected connection id 0 to send message to METS because connection is not valid or connected, find a valid connection id", if the service is disconnecting but we aren't aware yet
 
@@ -331,6 +429,9 @@ void CTickProxy::sendTicks()
 		//time_t t; time( &t );
 		_QuickLog.displayNL( "%" NL_I64 "u: TCK-%u: Tick %hu", getPerfTime() /*IDisplayer::dateToHumanString( t )*/, getGameCycle(), its->get() );
 	}
+	if ( tickChannelUsed )
+		_TickChannel.postTick();
+
 	// nldebug( "Now expecting local tocks" );
 	State = ExpectingLocalTocks;
 }
@@ -478,6 +579,14 @@ NLMISC_DYNVARIABLE(string, WaitingForServices, "Services that haven't tocked yet
 }
 
 
+NLMISC_DYNVARIABLE(uint, NbServicesOnTickChannel, "Number of client services receiving the ticks by the shared memory tick channel")
+{
+	// we can only read the value
+	if (get)
+		*pointer = CTickProxy::getNbServicesOnTickChannel();
+}
+
+
 NLMISC_DYNVARIABLE(NLMISC::TGameCycle, TickGameCycleProxy, "game cycle (in tick)")
 {
 	// we can only read the value
@@ -22,6 +22,8 @@
 
 #include "nel/misc/types_nl.h"
 #include "game_share/tick_proxy_time_measure.h"
+#include "game_share/tick_channel.h"
+#include <map>
 
 
 enum TTickTockState
@@ -76,14 +78,29 @@ public :
 	static void setMasterTickService( NLNET::TServiceId serviceId ) { _MasterTickService = serviceId; }
 	static bool alreadySyncd() { return _GameTimeStep != 0; }
 	
-	/// Register a client service
-	static void	addService( NLNET::TServiceId serviceId );
+	/// Register a client service (that may receive the ticks by the tick channel)
+	static void	addService( NLNET::TServiceId serviceId, bool wantsTickChannel=false );
 
 	/// Supports any service id, even one not added before (ignored then)
 	static void removeService( NLNET::TServiceId serviceId );
 
 	static void masterTickUpdate( NLNET::TServiceId serviceId );
 
+	/// Create the shared memory tick channel for the local client services
+	static bool createTickChannel( sint32 smid, bool destroyGhostSegment );
+
+	/// Destroy the tick channel
+	static void releaseTickChannel();
+
+	/// Post the next ticks to a client service by the tick channel (when it has accessed it)
+	static void activateTickChannel( NLNET::TServiceId serviceId, uint32 slot );
+
+	/// To call after sending an UMM message to a client service
+	static void onUMMSent( NLNET::TServiceId serviceId );
+
+	/// Return the number of client services receiving the ticks by the tick channel
+	static uint getNbServicesOnTickChannel();
+
 	static void sendSyncToClient( NLNET::TServiceId serviceId );
 	static void sendSyncs();
 	static void sendTicks();
@@ -136,6 +153,10 @@ private :
 
 	static NLNET::TServiceId				_MasterTickService;
 
+	/// Shared memory tick channel, and slot in it by client service
+	static CTickChannelServer						_TickChannel;
+	static std::map<NLNET::TServiceId, uint32>		_TickChannelSlots;
+
 	CTickProxy() {}
 };
 
@@ -99,6 +99,7 @@ void CServiceClass::tickUpdate()
 void CServiceClass::release()
 {
 	CSingletonRegistry::getInstance()->release();
+	CTickEventHandler::release();
 }
 
 
@@ -73,6 +73,15 @@ static NLMISC::TTime BeginOfTickTime = 0;
 CVariable<uint> TickSendingMode( "tick", "TickSendingMode", "0=Continuous 1=StepByStep 2=Fastest", 0,
 	0, true );
 
+CVariable<bool> AdaptiveTickPacing( "tick", "AdaptiveTickPacing", "In continuous mode, keep the ticks on a fixed schedule and catch up the late ticks instead of shifting the schedule", true,
+	0, true );
+
+CVariable<float> TickCatchUpRatio( "tick", "TickCatchUpRatio", "Max fraction of the time step by which the interval between two ticks can be shortened to catch up late ticks", 0.5f,
+	0, true );
+
+CVariable<float> TickCatchUpMaxDelay( "tick", "TickCatchUpMaxDelay", "Delay (in second) beyond which the late ticks are not caught up", 2.0f,
+	0, true );
+
 /*CVariable<float> WaitForBSThreshold( "tick", "WaitForBSThreshold", "Threshold for BSAckDelay beyond which tick starts to slow down to wait for BS (expressed as a factor of _TickTimeStep)", 1.0f,
 	0, true );
 */
@@ -286,6 +295,11 @@ void CTickService::addTock( NLNET::TServiceId serviceId )
 
 			if( _ClientInfos[serviceId.get()].TockMissingCount > 0 )
 			{
+				// only the tock of the last tick sent gives its latency
+				if( _ClientInfos[serviceId.get()].TockMissingCount == 1 )
+				{
+					MainTimeMeasures.addTockLatency( serviceId, (uint32)std::max( CTime::getLocalTime() - BeginOfTickTime, (TTime)0 ) );
+				}
 				_ClientInfos[serviceId.get()].TockMissingCount--;
 			}
 			else
@@ -345,6 +359,7 @@ void CTickService::checkTockReceived()
 	// set the TickSpeedLoop var to the same value
 	TickSpeedLoop = TotalSpeedLoop;
 	MainTimeMeasures.CurrentTickServiceMeasure[PrevTotalTickDuration] = (uint16)TotalSpeedLoop.get();
+	MainTimeMeasures.TickDurations.add( (uint32)std::max( TotalSpeedLoop.get(), (sint32)0 ) );
 	//nlinfo( "End of tick at %.6f", CTime::ticksToSecond( CTime::getPerformanceTime() ) );
 
 
@@ -370,9 +385,13 @@ void CTickService::checkTockReceived()
 		if( FirstTime )
 		{
 			_TickSendTime = currentTime - _TickTimeStep;
+			_ScheduledTickTime = _TickSendTime;
 			_LastTickTimeStep = _TickTimeStep;
 			FirstTime = false;
 		}
+
+		// predict the duration of the next tick from the tock latencies
+		_CriticalService = predictCriticalPath( _PredictedTickDuration );
 	
 		// setup the default value for the time step to use
 		NLMISC::TLocalTime effectiveTimeStep= _TickTimeStep;
@@ -388,6 +407,13 @@ void CTickService::checkTockReceived()
 		effectiveTimeStep= (effectiveTimeStep+3*_LastTickTimeStep)/4;
 		_LastTickTimeStep= effectiveTimeStep;
 
+		if ( AdaptiveTickPacing.get() && (TickSendingMode.get() == Continuous) )
+		{
+			waitForScheduledTickTime( currentTime, effectiveTimeStep );
+			broadcastTick();
+			return;
+		}
+
 		// if we have to wait before sending tick
 		while ( ( currentTime < (_TickSendTime + effectiveTimeStep) ) && ( TickSendingMode.get() != Fastest) )
 		{
@@ -431,6 +457,86 @@ void CTickService::checkTockReceived()
 
 
 
+//-----------------------------------------------
+//	waitForScheduledTickTime
+//
+//-----------------------------------------------
+void CTickService::waitForScheduledTickTime( TLocalTime currentTime, TLocalTime timeStep )
+{
+	_ScheduledTickTime += timeStep;
+
+	// The late ticks are caught up only if the delay is not too long, and if the services
+	// are predicted to tock within a time step (otherwise the delay would only grow)
+	TLocalTime lateness = currentTime - _ScheduledTickTime;
+	if ( (lateness > 0) && ((TLocalTime)_PredictedTickDuration >= timeStep*1000.0) )
+	{
+		++_NbScheduleResets;
+		_ScheduledTickTime = currentTime;
+	}
+	else if ( lateness > (TLocalTime)TickCatchUpMaxDelay.get() )
+	{
+		nlinfo( "Ticks late by %.3f s, not catching up", lateness );
+		++_NbScheduleResets;
+		_ScheduledTickTime = currentTime;
+	}
+	else if ( lateness < -timeStep )
+	{
+		// schedule in the future (time changed)
+		_ScheduledTickTime = currentTime;
+	}
+
+	// Catch up gracefully: the interval between two ticks is never shortened by more than TickCatchUpRatio
+	float catchUpRatio = std::min( std::max( TickCatchUpRatio.get(), 0.0f ), 1.0f );
+	TLocalTime sendTime = std::max( _ScheduledTickTime, _TickSendTime + timeStep*(1.0-catchUpRatio) );
+	while ( currentTime < sendTime )
+	{
+		if ( currentTime < _TickSendTime )
+		{
+			nlinfo( "Backward time sync detected (about %.1f s)", _TickSendTime - currentTime );
+			_ScheduledTickTime = currentTime;
+			break;
+		}
+		nlSleep( (uint32)((sendTime - currentTime)*1000.0) );
+		currentTime = ((double)CTime::getLocalTime())/1000.0;
+	}
+	_TickSendTime = currentTime;
+
+} // waitForScheduledTickTime //
+
+
+
+//-----------------------------------------------
+//	predictCriticalPath
+//
+//-----------------------------------------------
+NLNET::TServiceId CTickService::predictCriticalPath( uint32& predictedDurationMs ) const
+{
+	NLNET::TServiceId criticalService( 0 );
+	predictedDurationMs = 0;
+	for ( uint i=0; i!=_ClientInfos.size(); ++i )
+	{
+		// only the services that must tock at each tick can delay it
+		const CClientInfos& clientInfos = _ClientInfos[i];
+		if ( ! (clientInfos.Registered && clientInfos.Tocking && (clientInfos.Threshold == 0)) )
+			continue;
+
+		const CDurationHistogram *latency = MainTimeMeasures.getTockLatency( NLNET::TServiceId(i) );
+		if ( latency )
+		{
+			uint32 medianLatency = latency->getPercentile( 50 );
+			if ( medianLatency > predictedDurationMs )
+			{
+				predictedDurationMs = medianLatency;
+				criticalService = NLNET::TServiceId(i);
+			}
+		}
+	}
+	return criticalService;
+
+} // predictCriticalPath //
+
+
+
 //-----------------------------------------------
 //	broadcastTick
 //
@@ -440,7 +546,9 @@ void CTickService::broadcastTick()
 	if ( Pause == true ) return;
 
 	MainTimeMeasures.beginNewCycle();
-	BeginOfTickTime = CTime::getLocalTime();
+	NLMISC::TTime now = CTime::getLocalTime();
+	MainTimeMeasures.TickIntervals.add( (uint32)std::max( now - BeginOfTickTime, (TTime)0 ) );
+	BeginOfTickTime = now;
 
 	// increment the game time and cycle
 	_GameTime += _GameTimeStep;
@@ -515,6 +623,8 @@ void CTickService::unregisterClient( NLNET::TServiceId serviceId )
 			_ClientInfos[serviceId.get()].Tocking = true;
 			_ClientInfos[serviceId.get()].Threshold = 0;
 			_ClientInfos[serviceId.get()].TockMissingCount = 0;
+			if ( serviceId.get() < MainTimeMeasures.TockLatencyByService.size() )
+				MainTimeMeasures.TockLatencyByService[serviceId.get()].reset();
 			_QuickLog.displayNL( "%u: -%hu", getGameCycle(), serviceId.get() );
 		}
 		else
@@ -645,6 +755,9 @@ void CTickService::init()
 
 	// local time when last tick was sent
 	_TickSendTime = 0;
+	_ScheduledTickTime = 0;
+	_PredictedTickDuration = 0;
+	_NbScheduleResets = 0;
 	FirstTime = true;
 
 	CUnifiedNetwork::getInstance()->setServiceDownCallback("*", cbClientDisconnection, NULL);
@@ -828,6 +941,70 @@ bool CTickService::loadGameCycle()
 CTickServiceGameCycleTimeMeasure::CTickServiceGameCycleTimeMeasure() : HistoryMain( CTickService::getInstance()->getServiceId(), NLNET::TServiceId(std::numeric_limits<uint16>::max()), false ) {}
 
 
+/*
+ *
+ */
+void CDurationHistogram::add( uint32 durationMs )
+{
+	if ( _Buckets.empty() )
+	{
+		_Buckets.resize( NbBuckets, 0 );
+		_Window.resize( WindowSize, 0 );
+	}
+
+	uint16 bucket = (uint16)std::min( durationMs, (uint32)(NbBuckets-1) );
+	if ( _NbMeasures == WindowSize )
+		--_Buckets[_Window[_WindowPos]]; // forget the oldest measure
+	else
+		++_NbMeasures;
+	_Window[_WindowPos] = bucket;
+	++_Buckets[bucket];
+	_WindowPos = (_WindowPos + 1) % WindowSize;
+}
+
+
+/*
+ * Nearest-rank percentile
+ */
+uint32 CDurationHistogram::getPercentile( uint percent ) const
+{
+	if ( _NbMeasures == 0 )
+		return 0;
+
+	uint32 rank = std::max( (_NbMeasures*percent + 99) / 100, (uint32)1 );
+	uint32 count = 0;
+	for ( uint32 i=0; i!=NbBuckets; ++i )
+	{
+		count += _Buckets[i];
+		if ( count >= rank )
+			return i;
+	}
+	return NbBuckets-1;
+}
+
+
+/*
+ *
+ */
+void CDurationHistogram::reset()
+{
+	std::fill( _Buckets.begin(), _Buckets.end(), 0 );
+	_WindowPos = 0;
+	_NbMeasures = 0;
+}
+
+
+/*
+ *
+ */
+void CTickServiceGameCycleTimeMeasure::addTockLatency( NLNET::TServiceId serviceId, uint32 latencyMs )
+{
+	if ( serviceId.get() >= TockLatencyByService.size() )
+		TockLatencyByService.resize( serviceId.get()+1 );
+	TockLatencyByService[serviceId.get()].add( latencyMs );
+}
+
+
 /*
  *
  */
@@ -865,6 +1042,30 @@ void CTickServiceGameCycleTimeMeasure::resetMeasures()
 	HistoryByMirror.clear();
 	HistoryByService.clear();
 	HistoryMain.reset( false );
+	for ( std::vector<CDurationHistogram>::iterator il=TockLatencyByService.begin(); il!=TockLatencyByService.end(); ++il )
+		(*il).reset();
+	TickDurations.reset();
+	TickIntervals.reset();
+}
+
+
+/*
+ *
+ */
+void CTickServiceGameCycleTimeMeasure::displayLatencies( NLMISC::CLog *log )
+{
+	log->displayNL( "Tick latencies at GC %u, in ms over the last %u ticks:", CTickEventHandler::getGameCycle(), (uint)CDurationHistogram::WindowSize );
+	log->displayRawNL( "\tTickDuration: p50=%u p99=%u (%u measures)", TickDurations.getPercentile( 50 ), TickDurations.getPercentile( 99 ), TickDurations.getNbMeasures() );
+	log->displayRawNL( "\tTickInterval: p50=%u p99=%u (%u measures)", TickIntervals.getPercentile( 50 ), TickIntervals.getPercentile( 99 ), TickIntervals.getNbMeasures() );
+	for ( uint i=0; i!=TockLatencyByService.size(); ++i )
+	{
+		const CDurationHistogram& latency = TockLatencyByService[i];
+		if ( latency.getNbMeasures() != 0 )
+		{
+			log->displayRawNL( "\tTock of %s: p50=%u p99=%u (%u measures)", CUnifiedNetwork::getInstance()->getServiceUnifiedName( NLNET::TServiceId(i) ).c_str(),
+				latency.getPercentile( 50 ), latency.getPercentile( 99 ), latency.getNbMeasures() );
+		}
+	}
 }
 
 
@@ -967,6 +1168,41 @@ NLMISC_DYNVARIABLE(TLocalTime, TickTimeStep, "Current tick time step in second")
 	else TS->setTickTimeStep(*pointer);
 }
 
+NLMISC_DYNVARIABLE(uint32, TickDurationP50, "Median duration of the last ticks (from the tick to the last tock), in ms")
+{
+	if (get) *pointer = TS->MainTimeMeasures.TickDurations.getPercentile( 50 );
+}
+
+NLMISC_DYNVARIABLE(uint32, TickDurationP99, "99th percentile of the duration of the last ticks (from the tick to the last tock), in ms")
+{
+	if (get) *pointer = TS->MainTimeMeasures.TickDurations.getPercentile( 99 );
+}
+
+NLMISC_DYNVARIABLE(uint32, TickIntervalP50, "Median interval between the last ticks, in ms")
+{
+	if (get) *pointer = TS->MainTimeMeasures.TickIntervals.getPercentile( 50 );
+}
+
+NLMISC_DYNVARIABLE(uint32, TickIntervalP99, "99th percentile of the interval between the last ticks, in ms")
+{
+	if (get) *pointer = TS->MainTimeMeasures.TickIntervals.getPercentile( 99 );
+}
+
+NLMISC_DYNVARIABLE(uint32, PredictedTickDuration, "Predicted duration of the next tick (highest median tock latency), in ms")
+{
+	if (get) *pointer = TS->getPredictedTickDuration();
+}
+
+NLMISC_DYNVARIABLE(NLNET::TServiceId, CriticalService, "SId of the service predicted to tock last")
+{
+	if (get) *pointer = TS->getCriticalService();
+}
+
+NLMISC_DYNVARIABLE(uint32, NbTickScheduleResets, "Number of times the late ticks were not caught up")
+{
+	if (get) *pointer = TS->getNbScheduleResets();
+}
+
 NLMISC_DYNVARIABLE(string, TickMode, "Current ticking mode")
 {
 	if (get)
@@ -1013,6 +1249,13 @@ NLMISC_COMMAND(displayTimingsOfShard, "Display all timings", "" )
 	return true;
 }
 
+NLMISC_COMMAND(displayTickLatencies, "Display the percentiles of the tick durations and of the tock latencies", "" )
+{
+	TS->MainTimeMeasures.displayLatencies( &log );
+	log.displayNL( "Predicted tick duration: %u ms, critical service: %s", TS->getPredictedTickDuration(), CUnifiedNetwork::getInstance()->getServiceUnifiedName( TS->getCriticalService() ).c_str() );
+	return true;
+}
+
 NLMISC_COMMAND(resetTimingsOfShard, "Reset all timings", "" )
 {
 	TS->MainTimeMeasures.resetMeasures();
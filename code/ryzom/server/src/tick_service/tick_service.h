@@ -138,6 +138,46 @@ typedef CTimeMeasureHistory<CMirrorTimeMeasure> CMirrorTimeMeasureHistory;
 typedef CTimeMeasureHistory<CServiceTimeMeasure> CServiceTimeMeasureHistory;
 typedef CTimeMeasureHistory<CTickServiceTimeMeasure> CTickServiceMeasureHistory;
 
+
+/**
+ * Histogram of the last durations measured (in ms), to get their percentiles.
+ * The buckets are allocated at the first measure.
+ */
+class CDurationHistogram
+{
+public:
+
+	/// The durations of NbBuckets-1 ms or more are counted in the last bucket.
+	/// Only the last WindowSize measures are taken into account.
+	enum { NbBuckets = 1024, WindowSize = 256 };
+
+	///
+	CDurationHistogram() : _WindowPos(0), _NbMeasures(0) {}
+
+	/// Add a measure (replacing the oldest one when the window is full)
+	void			add( uint32 durationMs );
+
+	/// Return the duration (in ms) that percent % of the measures don't exceed (0 if there is no measure)
+	uint32			getPercentile( uint percent ) const;
+
+	///
+	uint32			getNbMeasures() const { return _NbMeasures; }
+
+	///
+	void			reset();
+
+private:
+
+	/// Number of measures by duration
+	std::vector<uint16>	_Buckets;
+
+	/// The last measures (circular buffer)
+	std::vector<uint16>	_Window;
+
+	uint32				_WindowPos;
+	uint32				_NbMeasures;
+};
+
 /**
  *
  */
@@ -153,9 +193,30 @@ public:
 	std::vector< CServiceTimeMeasureHistory >	HistoryByService;
 	CTickServiceMeasureHistory					HistoryMain;
 
+	/// Latency of the tocks (from the sending of the tick) by service id
+	std::vector< CDurationHistogram >			TockLatencyByService;
+
+	/// Durations of the ticks (from the sending of the tick to the last tock awaited)
+	CDurationHistogram							TickDurations;
+
+	/// Intervals between the sending of two ticks
+	CDurationHistogram							TickIntervals;
+
 	///
 	CTickServiceGameCycleTimeMeasure();
 
+	///
+	void			addTockLatency( NLNET::TServiceId serviceId, uint32 latencyMs );
+
+	/// Return the latency histogram of a service, or NULL if no tock of it has been measured
+	const CDurationHistogram	*getTockLatency( NLNET::TServiceId serviceId ) const
+	{
+		return ((serviceId.get() < TockLatencyByService.size()) && (TockLatencyByService[serviceId.get()].getNbMeasures() != 0)) ? &TockLatencyByService[serviceId.get()] : NULL;
+	}
+
+	///
+	void			displayLatencies( NLMISC::CLog *log );
+
 	///
 	void			beginNewCycle();
 
@@ -265,6 +326,21 @@ public :
 	 */
 	void checkTockReceived();
 
+	/**
+	 * Predict the duration of the next tick (the highest median tock latency of the
+	 * services that must tock). Return the service on the critical path.
+	 */
+	NLNET::TServiceId predictCriticalPath( uint32& predictedDurationMs ) const;
+
+	/// Return the predicted duration of the next tick (in ms)
+	uint32 getPredictedTickDuration() const { return _PredictedTickDuration; }
+
+	/// Return the service predicted on the critical path
+	NLNET::TServiceId getCriticalService() const { return _CriticalService; }
+
+	/// Return the number of times the tick schedule was given up because it was too late to catch up
+	uint32 getNbScheduleResets() const { return _NbScheduleResets; }
+
 	/**
 	 * give permission to send time in the step by step mode
 	 */
@@ -365,6 +441,19 @@ private :
 	/// time when the last tick was sent
 	NLMISC::TLocalTime _TickSendTime;
 
+	/// time when the last tick should have been sent (in adaptive pacing, advanced by the time step at each tick)
+	NLMISC::TLocalTime _ScheduledTickTime;
+
+	/// predicted duration of the next tick (in ms) and service on the critical path
+	uint32 _PredictedTickDuration;
+	NLNET::TServiceId _CriticalService;
+
+	/// number of times the tick schedule was given up
+	uint32 _NbScheduleResets;
+
+	/// Wait until the time to send the next tick (adaptive pacing), and set _TickSendTime
+	void waitForScheduledTickTime( NLMISC::TLocalTime currentTime, NLMISC::TLocalTime timeStep );
+
 	/// Log to recent history
 	NLMISC::CLog		_QuickLog;
 
@@ -20,6 +20,7 @@
 #include <stdio.h>
 #include <vector>
 #include "game_share/persistent_data.h"
+#include "game_share/persistent_data_view.h"
 
 using namespace std;
 using namespace NLMISC;
@@ -244,6 +245,7 @@ int main(int argc, char *argv[])
 		}
 
 		static CPersistentDataRecord pdr;
+		static CPersistentDataView view;
 		pdr.clear();
 
 		switch(mode)
@@ -266,7 +268,7 @@ int main(int argc, char *argv[])
 
 		case cm_to_xml:
 			printf("Converting '%s' (BINARY) to '%s' (XML)\n", fileName.c_str(), outputFileName.c_str() );
-			if (!pdr.readFromBinFile(fileName))
+			if (!view.open(fileName) || !pdr.fromView(view))
 				goto failureRead;
 			if (!pdr.writeToTxtFile(outputFileName, CPersistentDataRecord::XML_STRING))
 				goto failureWrite;
@@ -274,7 +276,7 @@ int main(int argc, char *argv[])
 
 		case cm_to_txt:
 			printf("Converting '%s' (BINARY) to '%s' (TXT)\n", fileName.c_str(), outputFileName.c_str() );
-			if (!pdr.readFromBinFile(fileName))
+			if (!view.open(fileName) || !pdr.fromView(view))
 				goto failureRead;
 			if (!pdr.writeToTxtFile(outputFileName, CPersistentDataRecord::LINES_STRING))
 				goto failureWrite;
@@ -0,0 +1,255 @@
+// Ryzom - MMORPG Framework <http://dev.ryzom.com/projects/ryzom/>
+// Copyright (C) 2010  Winch Gate Property Limited
+//
+// This program is free software: you can redistribute it and/or modify
+// it under the terms of the GNU Affero General Public License as
+// published by the Free Software Foundation, either version 3 of the
+// License, or (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU Affero General Public License for more details.
+//
+// You should have received a copy of the GNU Affero General Public License
+// along with this program.  If not, see <http://www.gnu.org/licenses/>.
+
+/*
+ * Stress test of a mirror change tracker shared by several processes.
+ *
+ * The main process creates a tracker in shared memory the way the mirror service
+ * does, then launches writer processes (this program with -writer) that record
+ * changes of random rows while it pops them, like a service reading its changes.
+ * Before recording a change, a writer increments the value of the row, and the
+ * reader reads the value after popping the row: at the end, the last value read
+ * for each row must be its final value, otherwise a change was lost.
+ * Build it (with ryzom_gameshare) with and without USE_LOCK_FREE_TRACKERS (see
+ * change_tracker_base.h) to compare the two tracker modes.
+ */
+
+#include "nel/misc/types_nl.h"
+#include "nel/misc/common.h"
+#include "nel/misc/shared_memory.h"
+#include "nel/misc/time_nl.h"
+#include "nel/misc/atomic.h"
+#include "game_share/change_tracker_client.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <vector>
+
+using namespace std;
+using namespace NLMISC;
+
+
+/// First shared memory id tried for the tracker
+static const sint32 BaseSMId = 0x7ac0;
+
+/// Control block, after the tracker in the shared memory segment
+struct TStressControl
+{
+	volatile uint32		NbChangesPerWriter;
+	volatile uint32		NbWritersStarted;
+	volatile uint32		NbWritersDone;
+	volatile uint32		Start;
+	/// Number of changes recorded by the writers (including the changes of rows already in the tracker)
+	volatile uint32		NbRecorded;
+};
+
+static uint32 getSegmentSize( uint32 nbRows )
+{
+	return sizeof(TChangeTrackerHeader) + nbRows*sizeof(TChangeTrackerItem) + sizeof(TStressControl) + nbRows*sizeof(uint32);
+}
+
+static TStressControl *getControl( void *segment, uint32 nbRows )
+{
+	return (TStressControl*)(((uint8*)segment) + sizeof(TChangeTrackerHeader) + nbRows*sizeof(TChangeTrackerItem));
+}
+
+static volatile uint32 *getValues( TStressControl *control )
+{
+	return (volatile uint32*)(control+1);
+}
+
+
+/*
+ * Writer process
+ */
+static int runWriter( sint32 smid, uint32 nbRows, uint32 writerIndex )
+{
+	CChangeTrackerClient tracker;
+	tracker.access( smid );
+	if ( ! tracker.isAllocated() )
+	{
+		printf( "Writer %u: cannot access the tracker (smid %d)\n", writerIndex, smid );
+		return 1;
+	}
+	tracker.createMutex( 0, false );
+
+	void *segment = CSharedMemory::accessSharedMemory( toSharedMemId( smid ) );
+	TStressControl *control = getControl( segment, nbRows );
+	uint32 nbChanges = control->NbChangesPerWriter;
+	volatile uint32 *values = getValues( control );
+
+	atomicFetchAdd( &control->NbWritersStarted, (uint32)1 );
+	while ( control->Start == 0 )
+		nlSleep( 0 );
+
+	// Record the changes of random rows, in bursts to have the tracker alternatively
+	// empty and full (the change of the last row is the tricky one)
+	uint32 seed = 12345 + writerIndex*7919;
+	for ( uint32 i=0; i!=nbChanges; ++i )
+	{
+		seed = seed*1103515245 + 12345;
+		TDataSetIndex row = (seed >> 8) % nbRows;
+		atomicFetchAdd( &values[row], (uint32)1 );
+		tracker.recordChange( row );
+		if ( (i & 1023) == 1023 )
+			nlSleep( 0 );
+	}
+
+	atomicFetchAdd( &control->NbRecorded, nbChanges );
+	atomicFetchAdd( &control->NbWritersDone, (uint32)1 );
+	tracker.release();
+	CSharedMemory::closeSharedMemory( segment );
+	return 0;
+}
+
+
+/*
+ * Reader process (creating the tracker and launching the writers)
+ */
+static int runReader( const char *programName, uint32 nbWriters, uint32 nbRows, uint32 nbChangesPerWriter )
+{
+	// Create the tracker segment, like CChangeTrackerMS::allocate()
+	uint32 segmentSize = getSegmentSize( nbRows );
+	sint32 smid = BaseSMId;
+	void *segment = NULL;
+	for ( ; smid != BaseSMId+64; ++smid )
+	{
+		segment = CSharedMemory::createSharedMemory( toSharedMemId( smid ), segmentSize );
+		if ( segment )
+			break;
+	}
+	if ( ! segment )
+	{
+		printf( "Cannot create the shared memory segment\n" );
+		return 1;
+	}
+	TChangeTrackerHeader *header = (TChangeTrackerHeader*)segment;
+	TChangeTrackerItem *items = (TChangeTrackerItem*)(((uint8*)segment) + sizeof(TChangeTrackerHeader));
+	header->First = LAST_CHANGED;
+	header->Last = INVALID_DATASET_INDEX;
+	header->NbDistinctChanges = 0;
+	for ( uint32 i=0; i!=nbRows; ++i )
+		items[i].NextChanged = INVALID_DATASET_INDEX;
+	TStressControl *control = getControl( segment, nbRows );
+	memset( (void*)control, 0, sizeof(TStressControl) + nbRows*sizeof(uint32) );
+	control->NbChangesPerWriter = nbChangesPerWriter;
+	volatile uint32 *values = getValues( control );
+
+	CChangeTrackerClient tracker;
+	tracker.access( smid );
+	tracker.createMutex( 0, true );
+
+	for ( uint32 i=0; i!=nbWriters; ++i )
+	{
+		if ( ! launchProgram( programName, toString( "-writer %d %u %u", smid, nbRows, i ), false ) )
+		{
+			printf( "Cannot launch writer %u\n", i );
+			control->Start = 1;
+			nbWriters = i;
+			break;
+		}
+	}
+
+	// Start when all the writers are ready
+	TTime timeout = CTime::getLocalTime() + 30000;
+	while ( control->NbWritersStarted != nbWriters && CTime::getLocalTime() < timeout )
+		nlSleep( 1 );
+	if ( control->NbWritersStarted != nbWriters )
+	{
+		printf( "Only %u writers of %u started\n", control->NbWritersStarted, nbWriters );
+		nbWriters = control->NbWritersStarted;
+	}
+	vector<uint32> lastRead( nbRows, 0 );
+	uint32 nbPopped = 0;
+	uint32 nbEmptyPolls = 0;
+	TTicks start = CTime::getPerformanceTime();
+	control->Start = 1;
+
+	// Pop the changes until all the writers are done and the tracker is empty
+	for (;;)
+	{
+		bool writersDone = (control->NbWritersDone == nbWriters);
+		TDataSetIndex row = tracker.getFirstChanged();
+		if ( row == LAST_CHANGED )
+		{
+			if ( writersDone )
+				break;
+			++nbEmptyPolls;
+			continue;
+		}
+		tracker.popFirstChanged();
+		lastRead[row] = values[row];
+		++nbPopped;
+	}
+	double time = CTime::ticksToSecond( CTime::getPerformanceTime() - start );
+
+	// Check that the last change of each row was read
+	uint32 nbLost = 0;
+	for ( uint32 i=0; i!=nbRows; ++i )
+	{
+		if ( lastRead[i] != values[i] )
+			++nbLost;
+	}
+
+#ifdef USE_LOCK_FREE_TRACKERS
+	const char *mode = "lock-free";
+#else
+	const char *mode = "mutex";
+#endif
+	printf( "Tracker mode: %s, %u writers, %u rows\n", mode, nbWriters, nbRows );
+	printf( "%u changes recorded, %u popped (%u empty polls) in %.3f s: %.0f changes/s recorded, %.0f pops/s\n",
+		control->NbRecorded, nbPopped, nbEmptyPolls, time, (double)control->NbRecorded/time, (double)nbPopped/time );
+	printf( "Remaining changes count: %d, rows with a lost change: %u\n", header->NbDistinctChanges, nbLost );
+
+	tracker.release();
+	CSharedMemory::closeSharedMemory( segment );
+	CSharedMemory::destroySharedMemory( toSharedMemId( smid ) );
+	return (nbLost == 0) ? 0 : 2;
+}
+
+
+int main( int argc, char *argv[] )
+{
+	NLMISC::CApplicationContext context;
+
+	if ( (argc == 5) && (string(argv[1]) == "-writer") )
+	{
+		sint32 smid;
+		uint32 nbRows, writerIndex;
+		NLMISC::fromString( argv[2], smid );
+		NLMISC::fromString( argv[3], nbRows );
+		NLMISC::fromString( argv[4], writerIndex );
+		return runWriter( smid, nbRows, writerIndex );
+	}
+
+	if ( (argc > 4) || ((argc > 1) && (argv[1][0] == '-')) )
+	{
+		printf( "Usage : %s [<nbWriters>(default 2) [<nbRows>(default 20000) [<nbChangesPerWriter>(default 10000000)]]]\n", argv[0] );
+		printf( "  Launches nbWriters processes recording changes in a tracker while this process pops them\n" );
+		return -1;
+	}
+
+	uint32 nbWriters = 2, nbRows = 20000, nbChangesPerWriter = 10000000;
+	if ( argc > 1 )
+		NLMISC::fromString( argv[1], nbWriters );
+	if ( argc > 2 )
+		NLMISC::fromString( argv[2], nbRows );
+	if ( argc > 3 )
+		NLMISC::fromString( argv[3], nbChangesPerWriter );
+	if ( (nbWriters == 0) || (nbRows == 0) || (nbRows >= LAST_CHANGED) )
+		return -1;
+
+	return runReader( argv[0], nbWriters, nbRows, nbChangesPerWriter );
+}
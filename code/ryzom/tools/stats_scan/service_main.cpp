@@ -85,6 +85,7 @@ public :
 	void release()
 	{
 		CSingletonRegistry::getInstance()->release();
+		CTickEventHandler::release();
 	}
 
 };